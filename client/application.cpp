@@ -20,6 +20,7 @@
 #include "application.h"
 
 #include "openxr/openxr.h"
+#include "render/scene_loader.h"
 #include "scene.h"
 #include "spdlog/common.h"
 #include "spdlog/spdlog.h"
@@ -1803,6 +1804,12 @@ void application::run()
 		loop();
 	}
 }
+
+void application::benchmark_scene_loader(const std::filesystem::path & gltf_path)
+{
+	scene_loader loader(vk_device, vk_physical_device, vk_queue, vk_queue_family_index, std::make_shared<renderer::material>(), cache_path / "textures");
+	loader.benchmark(gltf_path);
+}
 #endif
 
 std::shared_ptr<scene> application::current_scene()
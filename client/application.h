@@ -277,6 +277,10 @@ public:
 	}
 
 	void run();
+#ifndef __ANDROID__
+	// Load a scene with an increasing number of texture decoding threads and log the load times
+	void benchmark_scene_loader(const std::filesystem::path & gltf_path);
+#endif
 
 	static void push_scene(std::shared_ptr<scene>);
 
@@ -123,19 +123,7 @@ int32_t wivrn::android::audio::microphone_data_cb(AAudioStream * stream, void *
 		return AAUDIO_CALLBACK_RESULT_STOP;
 	}
 
-	size_t frame_size = AAudioStream_getChannelCount(stream) * sizeof(uint16_t);
-
-	// Copy data because we encrypt in-place, we don't want to write on the input data
-	thread_local std::vector<uint8_t> data_copy;
-	data_copy.assign(audio_data, audio_data + frame_size * num_frames);
-	try
-	{
-		self->session.send_control(wivrn::audio_data{
-		        .timestamp = self->instance.now(),
-		        .payload = std::span(data_copy),
-		});
-	}
-	catch (...)
+	if (self->microphone_send_error)
 	{
 		self->microphone_stop_ack = true;
 		self->microphone_stop_ack.notify_all();
@@ -143,9 +131,33 @@ int32_t wivrn::android::audio::microphone_data_cb(AAudioStream * stream, void *
 		return AAUDIO_CALLBACK_RESULT_STOP;
 	}
 
+	size_t frame_size = AAudioStream_getChannelCount(stream) * sizeof(uint16_t);
+
+	// Realtime thread: the samples are copied and sent from microphone_sender
+	self->microphone_queue->push(std::span(audio_data, frame_size * num_frames), self->instance.now());
+
 	return AAUDIO_CALLBACK_RESULT_CONTINUE;
 }
 
+void wivrn::android::audio::microphone_send()
+{
+	while (microphone_queue->wait())
+	{
+		while (auto packet = microphone_queue->pop())
+		{
+			try
+			{
+				session.send_stream(std::move(*packet));
+			}
+			catch (std::exception & e)
+			{
+				spdlog::warn("Failed to send microphone data: {}", e.what());
+				microphone_send_error = true;
+			}
+		}
+	}
+}
+
 void wivrn::android::audio::build_microphone(AAudioStreamBuilder * builder, int32_t sample_rate, int32_t num_channels)
 {
 	AAudioStreamBuilder_setDirection(builder, AAUDIO_DIRECTION_INPUT);
@@ -257,10 +269,17 @@ wivrn::android::audio::audio(const wivrn::to_headset::audio_stream_description &
 		throw std::runtime_error(std::string("Cannot create stream builder: ") + AAudio_convertResultToText(result));
 
 	if (desc.microphone)
+	{
+		microphone_queue.emplace(desc.microphone->num_channels, desc.microphone->sample_rate);
+		microphone_sender = utils::named_thread("audio_mic_send", [this]() { microphone_send(); });
 		build_microphone(builder, desc.microphone->sample_rate, desc.microphone->num_channels);
+	}
 
 	if (desc.speaker)
+	{
+		speaker_concealment.emplace(desc.speaker->num_channels);
 		build_speaker(builder, desc.speaker->sample_rate, desc.speaker->num_channels);
+	}
 
 	AAudioStreamBuilder_delete(builder);
 }
@@ -275,6 +294,11 @@ wivrn::android::audio::~audio()
 			AAudioStream_close(stream);
 	}
 
+	if (microphone_queue)
+		microphone_queue->stop();
+	if (microphone_sender.joinable())
+		microphone_sender.join();
+
 	std::unique_lock lock(mutex);
 	if (recreate_thread.joinable())
 		recreate_thread.join();
@@ -282,9 +306,14 @@ wivrn::android::audio::~audio()
 
 void wivrn::android::audio::operator()(wivrn::audio_data && data)
 {
-	auto size = data.payload.size_bytes();
-	if (output_buffer.write(std::move(data)))
-		buffer_size_bytes.fetch_add(size);
+	if (not speaker_concealment)
+		return;
+	for (auto & packet: (*speaker_concealment)(std::move(data)))
+	{
+		auto size = packet.payload.size_bytes();
+		if (output_buffer.write(std::move(packet)))
+			buffer_size_bytes.fetch_add(size);
+	}
 }
 
 void wivrn::android::audio::set_mic_state(bool running)
@@ -295,6 +324,7 @@ void wivrn::android::audio::set_mic_state(bool running)
 	auto old = mic_running.exchange(running);
 	if (old == running)
 		return;
+	microphone_send_error = false;
 	if (running)
 		AAudioStream_requestStart(microphone);
 	else
@@ -19,10 +19,12 @@
 
 #pragma once
 
+#include "audio_transport.h"
 #include "utils/ring_buffer.h"
 #include "wivrn_packets.h"
 #include <atomic>
 #include <mutex>
+#include <optional>
 #include <thread>
 
 struct AAudioStreamStruct;
@@ -51,6 +53,7 @@ class audio
 	void build_microphone(AAudioStreamBuilderStruct *, int32_t, int32_t);
 	void build_speaker(AAudioStreamBuilderStruct *, int32_t, int32_t);
 
+	std::optional<wivrn::audio_loss_concealment> speaker_concealment;
 	utils::ring_buffer<wivrn::audio_data, 100> output_buffer;
 	std::atomic<size_t> buffer_size_bytes;
 
@@ -60,6 +63,11 @@ class audio
 	AAudioStreamStruct * microphone = nullptr;
 	std::atomic<bool> microphone_stop_ack = false;
 	std::atomic<bool> mic_running = false;
+	// Filled from the realtime callback, sent from microphone_sender
+	std::optional<wivrn::audio_send_queue> microphone_queue;
+	std::atomic<bool> microphone_send_error = false;
+	std::thread microphone_sender;
+	void microphone_send();
 
 	wivrn_session & session;
 	xr::instance & instance;
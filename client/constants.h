@@ -119,6 +119,9 @@ namespace constants::stream
 constexpr float fade_delay = 3;
 constexpr float fade_duration = 0.25;
 
+// Refresh period of the statistics overlay and compact view, in seconds
+constexpr float info_panel_refresh_period = 0.1;
+
 constexpr float urgent_fade_delay = 5;
 constexpr ImVec4 urgent_border_color = {8.f, .6f, 0.f, .8f};
 
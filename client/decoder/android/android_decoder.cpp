@@ -114,7 +114,7 @@ decoder::decoder(
 	spdlog::info("hbm_mutex.native_handle() = {}", (void *)hbm_mutex.native_handle());
 
 	auto width = description.width;
-	auto height = description.height / (stream_index == 2 ? 2 : 1);
+	auto height = description.height / (stream_index == 2 and not description.depth ? 2 : 1);
 
 	AImageReader * ir;
 	check(AImageReader_newWithUsage(
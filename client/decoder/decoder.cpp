@@ -53,6 +53,7 @@ std::shared_ptr<wivrn::decoder> wivrn::decoder::make(
 			return std::make_shared<wivrn::ffmpeg::decoder>(
 			        device,
 			        phys_dev,
+			        vk_queue_family_index,
 			        description,
 			        stream_index,
 			        scene,
@@ -19,17 +19,17 @@
 
 #include "ffmpeg_decoder.h"
 
+#include "application.h"
 #include "scenes/stream.h"
 #include "spdlog/spdlog.h"
+#include <algorithm>
 #include <cassert>
 #include <vulkan/vulkan.hpp>
 
 extern "C"
 {
 #include <libavcodec/avcodec.h>
-#include <libavutil/buffer.h>
-#include <libavutil/hwcontext.h>
-#include <libavutil/hwcontext_vulkan.h>
+#include <libavutil/imgutils.h>
 #include <libswscale/swscale.h>
 }
 
@@ -63,110 +63,126 @@ static AVCodecID codec_id(wivrn::video_codec codec)
 	__builtin_unreachable();
 }
 
+static int plane_count(vk::Format format)
+{
+	return format == vk::Format::eR8Unorm ? 1 : 3;
+}
+
+static vk::Extent2D plane_extent(vk::Extent2D extent, int plane)
+{
+	if (plane == 0)
+		return extent;
+	return {(extent.width + 1) / 2, (extent.height + 1) / 2};
+}
+
 struct decoder::ffmpeg_blit_handle : public wivrn::decoder::blit_handle
 {
-	int image_index;
-	wivrn::ffmpeg::decoder * self;
+	std::atomic_bool & free;
 
 	ffmpeg_blit_handle(
 	        const wivrn::from_headset::feedback & feedback,
 	        const wivrn::to_headset::video_stream_data_shard::view_info_t & view_info,
-	        vk::ImageView image_view,
-	        vk::Image image,
-	        vk::Extent2D extent,
-	        vk::ImageLayout & current_layout,
-	        int image_index,
-	        wivrn::ffmpeg::decoder * self) :
+	        decoder::image & item,
+	        vk::Extent2D extent) :
 	        wivrn::decoder::blit_handle{
 	                feedback,
 	                view_info,
-	                image_view,
-	                image,
+	                *item.image_view,
+	                item.image,
 	                extent,
-	                current_layout,
+	                item.current_layout,
+	                *item.semaphore,
+	                &item.semaphore_val,
 	        },
-	        image_index(image_index),
-	        self(self)
+	        free(item.free)
 	{}
 
 	~ffmpeg_blit_handle()
 	{
-		std::unique_lock lock(self->mutex);
-		if (image_index < 0)
-			return;
-
-		self->free_images.push_back(image_index);
+		free = true;
 	}
 };
 
 decoder::decoder(
         vk::raii::Device & device,
         vk::raii::PhysicalDevice & physical_device,
+        uint32_t vk_queue_family_index,
         const wivrn::to_headset::video_stream_description & description,
         uint8_t stream_index,
         std::weak_ptr<scenes::stream> scene,
         shard_accumulator * accumulator) :
         device(device),
+        extent{
+                .width = description.width,
+                .height = description.height / (stream_index == 2 and not description.depth ? 2u : 1u),
+        },
+        format(stream_index == 2 ? vk::Format::eR8Unorm : vk::Format::eG8B8R83Plane420Unorm),
+        command_pool(device, vk::CommandPoolCreateInfo{
+                                     .flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+                                     .queueFamilyIndex = vk_queue_family_index,
+                             }),
+        cmd(device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
+                .commandPool = *command_pool,
+                .commandBufferCount = 1,
+        })[0]
+                    .release()),
+        fence(device, vk::FenceCreateInfo{.flags = vk::FenceCreateFlagBits::eSignaled}),
         codec(nullptr, free_codec_context),
         sws(nullptr, sws_freeContext),
         weak_scene(scene),
-        accumulator(accumulator),
-        extent{
-                .width = description.width,
-                .height = description.height / (stream_index == 2 ? 2u : 1u),
-        }
+        accumulator(accumulator)
 {
-	free_images.resize(image_count);
-
-	for (int i = 0; i < image_count; i++)
+	vk::Filter filter = vk::Filter::eLinear;
+	if (format != vk::Format::eR8Unorm)
 	{
-		free_images[i] = i;
-
-		vk::ImageCreateInfo image_info{
-		        .imageType = vk::ImageType::e2D,
-		        .format = vk::Format::eA8B8G8R8SrgbPack32,
-		        .extent = {
-		                .width = extent.width,
-		                .height = extent.height,
-		                .depth = 1,
-		        },
-		        .mipLevels = 1,
-		        .arrayLayers = 1,
-		        .samples = vk::SampleCountFlagBits::e1,
-		        .tiling = vk::ImageTiling::eLinear,
-		        .usage = vk::ImageUsageFlagBits::eSampled,
-		        .initialLayout = vk::ImageLayout::eUndefined,
-		};
-
-		VmaAllocationCreateInfo alloc_info{
-		        .requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
-
-		decoded_images[i].image = image_allocation(device, image_info, alloc_info);
-
-		decoded_images[i].image.map();
-
-		vk::ImageSubresource resource;
-		resource.aspectMask = vk::ImageAspectFlagBits::eColor;
-
-		decoded_images[i].layout = decoded_images[i].image->getSubresourceLayout(resource);
+		if (not(physical_device.getFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageYcbcrConversionLinearFilter))
+			filter = vk::Filter::eNearest;
+
+		// Same colour space as the other decoders
+		ycbcr_conversion = vk::raii::SamplerYcbcrConversion(device, {
+		                                                                    .format = format,
+		                                                                    .ycbcrModel = vk::SamplerYcbcrModelConversion::eYcbcr709,
+		                                                                    .ycbcrRange = vk::SamplerYcbcrRange::eItuFull,
+		                                                                    .chromaFilter = filter,
+		                                                            });
+	}
 
-		decoded_images[i].image_view = vk::raii::ImageView(
-		        device,
-		        {
-		                .image = (vk::Image)decoded_images[i].image,
-		                .viewType = vk::ImageViewType::e2D,
-		                .format = image_info.format,
-		                .subresourceRange = {
-		                        .aspectMask = vk::ImageAspectFlagBits::eColor,
-		                        .baseMipLevel = 0,
-		                        .levelCount = 1,
-		                        .baseArrayLayer = 0,
-		                        .layerCount = 1,
-		                },
-		        });
+	vk::StructureChain sampler_info{
+	        vk::SamplerCreateInfo{
+	                .magFilter = filter,
+	                .minFilter = filter,
+	                .mipmapMode = vk::SamplerMipmapMode::eNearest,
+	                .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+	                .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+	                .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+	                .maxAnisotropy = 1,
+	        },
+	        vk::SamplerYcbcrConversionInfo{
+	                .conversion = *ycbcr_conversion,
+	        },
+	};
+	if (*ycbcr_conversion == VK_NULL_HANDLE)
+		sampler_info.unlink<vk::SamplerYcbcrConversionInfo>();
+	sampler_ = vk::raii::Sampler(device, sampler_info.get());
 
-		decoded_images[i].current_layout = vk::ImageLayout::eUndefined;
+	vk::DeviceSize staging_size = 0;
+	for (int plane = 0; plane < plane_count(format); ++plane)
+	{
+		auto e = plane_extent(extent, plane);
+		staging_size += e.width * e.height;
 	}
+	staging = buffer_allocation(
+	        device,
+	        {
+	                .size = staging_size,
+	                .usage = vk::BufferUsageFlagBits::eTransferSrc,
+	        },
+	        {
+	                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+	                .usage = VMA_MEMORY_USAGE_AUTO,
+	        },
+	        "ffmpeg staging buffer");
+	staging.map();
 
 	auto avcodec = avcodec_find_decoder(codec_id(description.codec[stream_index]));
 	if (avcodec == nullptr)
@@ -176,22 +192,21 @@ decoder::decoder(
 
 	codec.reset(avcodec_alloc_context3(avcodec));
 
+	// Output each frame as soon as it is decoded, frame threading would add one frame of latency per thread
+	codec->flags |= AV_CODEC_FLAG_LOW_DELAY;
+	codec->thread_type = FF_THREAD_SLICE;
+	codec->thread_count = 0;
+
 	int ret = avcodec_open2(codec.get(), avcodec, nullptr);
 	if (ret < 0)
 		throw std::runtime_error{"avcodec_open2 failed"};
+}
 
-	rgb_sampler = vk::raii::Sampler(
-	        device,
-	        {
-	                .flags = {},
-	                .magFilter = vk::Filter::eLinear,
-	                .minFilter = vk::Filter::eLinear,
-	                .mipmapMode = vk::SamplerMipmapMode::eNearest,
-	                .addressModeU = vk::SamplerAddressMode::eClampToEdge,
-	                .addressModeV = vk::SamplerAddressMode::eClampToEdge,
-	                .addressModeW = vk::SamplerAddressMode::eClampToEdge,
-	                .unnormalizedCoordinates = false,
-	        });
+decoder::~decoder()
+{
+	// The last upload may still be running
+	if (device.waitForFences(*fence, true, UINT64_MAX) != vk::Result::eSuccess)
+		spdlog::warn("waitForFences failed");
 }
 
 void decoder::push_data(std::span<std::span<const uint8_t>> data, uint64_t frame_index, bool partial)
@@ -235,43 +250,204 @@ void decoder::frame_completed(const wivrn::from_headset::feedback & feedback, co
 
 	this->packet.clear();
 
-	if (!sws)
-	{
-		sws.reset(sws_getContext(frame->width, frame->height, (AVPixelFormat)frame->format, extent.width, extent.height, AV_PIX_FMT_RGB0, SWS_BILINEAR, nullptr, nullptr, nullptr));
-	}
-
-	std::unique_lock lock(mutex);
-	if (free_images.empty())
+	auto item = get_free();
+	if (not item)
 	{
 		spdlog::warn("No free image");
 		return;
 	}
 
-	int index = free_images.back();
-	free_images.pop_back();
-	lock.unlock();
-
-	decoded_images[index].frame_index = frame_index;
-	int dstStride = decoded_images[index].layout.rowPitch;
-	uint8_t * out = decoded_images[index].image.data<uint8_t>();
-	res = sws_scale(sws.get(), frame->data, frame->linesize, 0, frame->height, &out, &dstStride);
-	if (res == 0)
-		throw std::runtime_error{"sws_scale failed"};
-
-	auto handle = std::make_shared<ffmpeg_blit_handle>(
-	        feedback,
-	        view_info,
-	        *decoded_images[index].image_view,
-	        decoded_images[index].image,
-	        extent,
-	        decoded_images[index].current_layout,
-	        index,
-	        this);
+	upload(*frame, *item);
+
+	auto handle = std::make_shared<ffmpeg_blit_handle>(feedback, view_info, *item, extent);
 
 	if (auto scene = weak_scene.lock())
 		scene->push_blit_handle(accumulator, std::move(handle));
 }
 
+decoder::image * decoder::get_free()
+{
+	for (int i = 0; i < image_count; ++i)
+	{
+		if (images[i].free.exchange(false))
+			return &images[i];
+	}
+
+	if (image_count == max_image_count)
+		return nullptr;
+
+	auto & item = images[image_count++];
+	item.free = false;
+	item.image = image_allocation(
+	        device,
+	        vk::ImageCreateInfo{
+	                .imageType = vk::ImageType::e2D,
+	                .format = format,
+	                .extent = {
+	                        .width = extent.width,
+	                        .height = extent.height,
+	                        .depth = 1,
+	                },
+	                .mipLevels = 1,
+	                .arrayLayers = 1,
+	                .tiling = vk::ImageTiling::eOptimal,
+	                .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+	        },
+	        {
+	                .usage = VMA_MEMORY_USAGE_AUTO,
+	        },
+	        "ffmpeg decoder image");
+
+	vk::SamplerYcbcrConversionInfo conv{
+	        .conversion = *ycbcr_conversion,
+	};
+	item.image_view = vk::raii::ImageView(
+	        device,
+	        {
+	                .pNext = *ycbcr_conversion == VK_NULL_HANDLE ? nullptr : &conv,
+	                .image = item.image,
+	                .viewType = vk::ImageViewType::e2D,
+	                .format = format,
+	                .subresourceRange = {
+	                        .aspectMask = vk::ImageAspectFlagBits::eColor,
+	                        .levelCount = 1,
+	                        .layerCount = 1,
+	                },
+	        });
+
+	item.semaphore = vk::raii::Semaphore(
+	        device,
+	        vk::StructureChain{
+	                vk::SemaphoreCreateInfo{},
+	                vk::SemaphoreTypeCreateInfo{
+	                        .semaphoreType = vk::SemaphoreType::eTimeline,
+	                },
+	        }
+	                .get());
+
+	spdlog::debug("ffmpeg decoder: {} images", image_count);
+	return &item;
+}
+
+void decoder::upload(const AVFrame & frame, image & item)
+{
+	// The staging buffer is used by the previous upload
+	if (device.waitForFences(*fence, true, UINT64_MAX) != vk::Result::eSuccess)
+		spdlog::warn("waitForFences failed");
+
+	const int planes = plane_count(format);
+	const std::array aspects{
+	        vk::ImageAspectFlagBits::ePlane0,
+	        vk::ImageAspectFlagBits::ePlane1,
+	        vk::ImageAspectFlagBits::ePlane2,
+	};
+	std::array<uint8_t *, 3> dst{};
+	std::array<int, 3> dst_stride{};
+	std::array<vk::BufferImageCopy, 3> regions{};
+	vk::DeviceSize offset = 0;
+	for (int plane = 0; plane < planes; ++plane)
+	{
+		auto e = plane_extent(extent, plane);
+		dst[plane] = staging.data<uint8_t>() + offset;
+		dst_stride[plane] = e.width;
+		regions[plane] = vk::BufferImageCopy{
+		        .bufferOffset = offset,
+		        .imageSubresource = {
+		                .aspectMask = planes == 1 ? vk::ImageAspectFlagBits::eColor : aspects[plane],
+		                .layerCount = 1,
+		        },
+		        .imageExtent = {
+		                .width = e.width,
+		                .height = e.height,
+		                .depth = 1,
+		        },
+		};
+		offset += e.width * e.height;
+	}
+
+	if (frame.format == AV_PIX_FMT_YUV420P or frame.format == AV_PIX_FMT_YUVJ420P)
+	{
+		// Alpha only uses the luma plane
+		const vk::Extent2D frame_extent{uint32_t(frame.width), uint32_t(frame.height)};
+		for (int plane = 0; plane < planes; ++plane)
+		{
+			auto e = plane_extent(extent, plane);
+			auto f = plane_extent(frame_extent, plane);
+			av_image_copy_plane(dst[plane], dst_stride[plane], frame.data[plane], frame.linesize[plane], std::min(e.width, f.width), std::min(e.height, f.height));
+		}
+	}
+	else
+	{
+		sws.reset(sws_getCachedContext(sws.release(), frame.width, frame.height, (AVPixelFormat)frame.format, extent.width, extent.height, planes == 1 ? AV_PIX_FMT_GRAY8 : AV_PIX_FMT_YUV420P, SWS_BILINEAR, nullptr, nullptr, nullptr));
+		if (not sws)
+			throw std::runtime_error{"sws_getCachedContext failed"};
+		if (sws_scale(sws.get(), frame.data, frame.linesize, 0, frame.height, dst.data(), dst_stride.data()) == 0)
+			throw std::runtime_error{"sws_scale failed"};
+	}
+
+	cmd.reset();
+	cmd.begin({.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+	vk::ImageMemoryBarrier barrier{
+	        .srcAccessMask = vk::AccessFlagBits::eNone,
+	        .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+	        .oldLayout = vk::ImageLayout::eUndefined,
+	        .newLayout = vk::ImageLayout::eTransferDstOptimal,
+	        .image = item.image,
+	        .subresourceRange = {
+	                .aspectMask = vk::ImageAspectFlagBits::eColor,
+	                .levelCount = 1,
+	                .layerCount = 1,
+	        },
+	};
+	cmd.pipelineBarrier(
+	        vk::PipelineStageFlagBits::eAllCommands,
+	        vk::PipelineStageFlagBits::eTransfer,
+	        {},
+	        {},
+	        {},
+	        barrier);
+
+	cmd.copyBufferToImage(
+	        staging,
+	        item.image,
+	        vk::ImageLayout::eTransferDstOptimal,
+	        planes,
+	        regions.data());
+
+	barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+	barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+	barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	cmd.pipelineBarrier(
+	        vk::PipelineStageFlagBits::eTransfer,
+	        vk::PipelineStageFlagBits::eFragmentShader,
+	        {},
+	        {},
+	        {},
+	        barrier);
+	item.current_layout = barrier.newLayout;
+
+	cmd.end();
+
+	device.resetFences(*fence);
+	application::get_queue().lock()->submit(
+	        vk::StructureChain{
+	                vk::SubmitInfo{
+	                        .commandBufferCount = 1,
+	                        .pCommandBuffers = &cmd,
+	                        .signalSemaphoreCount = 1,
+	                        .pSignalSemaphores = &*item.semaphore,
+	                },
+	                vk::TimelineSemaphoreSubmitInfo{
+	                        .signalSemaphoreValueCount = 1,
+	                        .pSignalSemaphoreValues = &++item.semaphore_val,
+	                },
+	        }
+	                .get(),
+	        *fence);
+}
+
 void decoder::supported_codecs(std::vector<wivrn::video_codec> & res)
 {
 	// As long as we do software decoding, prefer faster ones
@@ -22,8 +22,9 @@
 #include "decoder/decoder.h"
 #include "vk/allocation.h"
 #include "wivrn_packets.h"
+#include <array>
+#include <atomic>
 #include <memory>
-#include <mutex>
 #include <span>
 #include <vector>
 #include <vulkan/vulkan_raii.hpp>
@@ -35,8 +36,8 @@ class shard_accumulator;
 
 extern "C"
 {
-	struct AVBufferRef;
 	struct AVCodecContext;
+	struct AVFrame;
 	struct SwsContext;
 }
 
@@ -47,43 +48,60 @@ class stream;
 
 namespace wivrn::ffmpeg
 {
+// Decodes on the CPU and uploads the Y'CbCr planes as they are, the colour conversion is done
+// by the sampler when the image is read.
 class decoder : public wivrn::decoder
 {
 private:
 	struct ffmpeg_blit_handle;
-	static const int image_count = 12;
+	// Images are allocated when all existing ones are in use, so that the pool follows the
+	// number of frames held between decoding and display
+	static const int max_image_count = 12;
 	struct image
 	{
 		image_allocation image;
-		vk::SubresourceLayout layout;
-		uint64_t frame_index;
 		vk::raii::ImageView image_view = nullptr;
 		vk::ImageLayout current_layout = vk::ImageLayout::eUndefined;
+		std::atomic_bool free = true;
+		vk::raii::Semaphore semaphore = nullptr;
+		uint64_t semaphore_val = 0;
 	};
 
 	vk::raii::Device & device;
-	vk::raii::Sampler rgb_sampler = nullptr;
+	const vk::Extent2D extent;
+	// 3 planes 4:2:0 for colour, luma only for alpha
+	const vk::Format format;
+	vk::raii::SamplerYcbcrConversion ycbcr_conversion = nullptr;
+	vk::raii::Sampler sampler_ = nullptr;
+
+	vk::raii::CommandPool command_pool;
+	vk::CommandBuffer cmd;
+	vk::raii::Fence fence;
+	buffer_allocation staging;
 
-	std::array<image, image_count> decoded_images;
-	std::vector<int> free_images;
+	std::array<image, max_image_count> images;
+	int image_count = 0;
 
 	std::unique_ptr<AVCodecContext, void (*)(AVCodecContext *)> codec;
+	// Only for decoded frames in another pixel format
 	std::unique_ptr<SwsContext, void (*)(SwsContext *)> sws;
 	std::vector<uint8_t> packet;
 	uint64_t frame_index;
 	std::weak_ptr<scenes::stream> weak_scene;
 	shard_accumulator * accumulator;
-	const vk::Extent2D extent;
 
-	std::mutex mutex;
+	image * get_free();
+	void upload(const AVFrame &, image &);
 
 public:
 	decoder(vk::raii::Device & device,
 	        vk::raii::PhysicalDevice & physical_device,
+	        uint32_t vk_queue_family_index,
 	        const wivrn::to_headset::video_stream_description & description,
 	        uint8_t stream_index,
 	        std::weak_ptr<scenes::stream> scene,
 	        shard_accumulator * accumulator);
+	~decoder();
 
 	void push_data(std::span<std::span<const uint8_t>> data, uint64_t frame_index, bool partial) override;
 
@@ -93,7 +111,7 @@ public:
 
 	vk::Sampler sampler() override
 	{
-		return *rgb_sampler;
+		return *sampler_;
 	}
 
 	static void supported_codecs(std::vector<wivrn::video_codec> &);
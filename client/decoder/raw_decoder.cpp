@@ -100,7 +100,7 @@ raw_decoder::raw_decoder(
         stream_index(stream_index),
         extent{
                 .width = description.width,
-                .height = description.height / (stream_index == 2 ? 2u : 1u),
+                .height = description.height / (stream_index == 2 and not description.depth ? 2u : 1u),
         },
         weak_scene(scene),
         accumulator(accumulator)
@@ -63,10 +63,10 @@ static bool is_complete(const shard_set & shards)
 	return true;
 }
 
-std::optional<uint16_t> shard_set::insert(data_shard && shard, xr::instance & instance)
+std::optional<uint16_t> shard_set::insert(data_shard && shard, XrTime received)
 {
 	if (empty())
-		feedback.received_first_packet = instance.now();
+		feedback.received_first_packet = received;
 
 	auto idx = shard.shard_idx;
 	if (idx >= data.size())
@@ -103,15 +103,41 @@ static void debug_why_not_sent(const shard_set & shards)
 	spdlog::info("frame {} was not sent with {} data shards, {}{} missing", frame_idx, data, end ? "" : "at least ", missing);
 }
 
+shard_accumulator::~shard_accumulator()
+{
+	stopping = true;
+	frames_pushed++;
+	frames_pushed.notify_one();
+
+	if (dropped or superseded)
+		spdlog::info("Stream {}: {} frames dropped before decoding, {} superseded by an IDR frame", current.feedback.stream_index, dropped.load(), superseded.load());
+
+	// See scenes::stream::create, the scene is never destroyed by a worker
+	assert(worker.get_id() != std::this_thread::get_id());
+	if (worker.joinable())
+		worker.join();
+}
+
+static thread_local bool is_worker_thread = false;
+
+bool shard_accumulator::on_worker_thread()
+{
+	return is_worker_thread;
+}
+
 void shard_accumulator::advance()
 {
 	std::swap(current, next);
 	next.reset(current.frame_index() + 1);
+
+	// The frame may have been completed while it was next
+	try_submit_frame();
 }
 
-void shard_accumulator::push_shard(video_stream_data_shard && shard)
+void shard_accumulator::push_shard(video_stream_data_shard && shard, XrTime received)
 {
 	assert(current.frame_index() + 1 == next.frame_index());
+	shard_received = received;
 
 	uint8_t frame_diff = shard.frame_idx - current.frame_index();
 	if (shard.frame_idx < current.frame_index())
@@ -121,20 +147,18 @@ void shard_accumulator::push_shard(video_stream_data_shard && shard)
 	}
 	else if (frame_diff == 0)
 	{
-		auto shard_idx = current.insert(std::move(shard), instance);
-		try_submit_frame(shard_idx);
+		if (current.insert(std::move(shard), received))
+			try_submit_frame();
 	}
 	else if (frame_diff == 1)
 	{
-		next.insert(std::move(shard), instance);
+		next.insert(std::move(shard), received);
 		if (is_complete(next))
 		{
 			debug_why_not_sent(current);
 			send_feedback(current.feedback);
 
 			advance();
-
-			try_submit_frame(0);
 		}
 	}
 	else if (frame_diff == 2)
@@ -144,7 +168,7 @@ void shard_accumulator::push_shard(video_stream_data_shard && shard)
 
 		advance();
 
-		push_shard(std::move(shard));
+		push_shard(std::move(shard), received);
 	}
 	else
 	{
@@ -155,44 +179,18 @@ void shard_accumulator::push_shard(video_stream_data_shard && shard)
 		current.reset(shard.frame_idx);
 		next.reset(shard.frame_idx + 1);
 
-		push_shard(std::move(shard));
+		push_shard(std::move(shard), received);
 	}
 }
 
-void shard_accumulator::try_submit_frame(std::optional<uint16_t> shard_idx)
+void shard_accumulator::try_submit_frame()
 {
-	if (shard_idx)
-		try_submit_frame(*shard_idx);
-}
+	if (not is_complete(current))
+		return;
 
-void shard_accumulator::try_submit_frame(uint16_t shard_idx)
-{
 	auto & data_shards = current.data;
 
-	for (size_t idx = 0; idx < shard_idx; ++idx)
-		if (not data_shards[idx])
-			return;
-
-	uint16_t last_idx = shard_idx + 1;
-	for (size_t size = data_shards.size();
-	     last_idx < size and data_shards[last_idx];
-	     ++last_idx)
-	{
-	}
-
-	std::vector<std::span<const uint8_t>> payload;
-	payload.reserve(last_idx - shard_idx);
-	for (size_t idx = shard_idx; idx < last_idx; ++idx)
-		payload.emplace_back(data_shards[idx]->payload);
-
-	bool frame_complete = last_idx == data_shards.size() and data_shards.back()->timing_info;
-	decoder_->push_data(payload, data_shards[shard_idx]->frame_idx, not frame_complete);
-
-	if (not frame_complete)
-		return;
-
-	current.feedback.received_last_packet = instance.now();
-	current.feedback.sent_to_decoder = current.feedback.received_last_packet;
+	current.feedback.received_last_packet = shard_received;
 	data_shard::timing_info_t timing_info = data_shards.back()->timing_info.value_or(data_shard::timing_info_t{});
 	current.feedback.encode_begin = timing_info.encode_begin;
 	current.feedback.encode_end = timing_info.encode_end;
@@ -205,14 +203,92 @@ void shard_accumulator::try_submit_frame(uint16_t shard_idx)
 		return;
 	}
 
-	// Try to extract a frame
-	decoder_->frame_completed(current.feedback, *data_shards.front()->view_info);
+	bool idr = data_shards.front()->view_info->idr;
+	bool queued = false;
+	if (drop_policy.accept(idr, frames.size()))
+	{
+		frame f{.feedback = current.feedback};
+		f.shards.reserve(data_shards.size());
+		for (auto & shard: data_shards)
+			f.shards.push_back(std::move(*shard));
 
-	send_feedback(current.feedback);
+		queued = frames.write(std::move(f));
+	}
+
+	if (queued)
+	{
+		drop_policy.queued(current.frame_index(), idr);
+		frames_pushed++;
+		frames_pushed.notify_one();
+	}
+	else
+	{
+		// Feedback without sent_to_decoder makes the server send an IDR frame, the server
+		// ignores it for frames encoded before the IDR frame it already sent
+		++dropped;
+		spdlog::info("Decoder is late, drop frame {} of stream {} ({} frames waiting)", current.frame_index(), current.feedback.stream_index, frames.size());
+		drop_policy.dropped();
+		send_feedback(current.feedback);
+	}
 
 	advance();
 }
 
+void shard_accumulator::decode_loop()
+{
+	is_worker_thread = true;
+	uint64_t seen = 0;
+	while (true)
+	{
+		frames_pushed.wait(seen);
+		seen = frames_pushed;
+		if (stopping)
+			return;
+
+		while (auto f = frames.read())
+		{
+			// A late decoder decodes all frames, unless an IDR frame is waiting: the server does
+			// not need to know about frames skipped that way
+			if (drop_policy.superseded(f->feedback.frame_index))
+			{
+				++superseded;
+				continue;
+			}
+
+			try
+			{
+				decode(*f);
+			}
+			catch (std::exception & e)
+			{
+				spdlog::error("Failed to decode frame {} of stream {}: {}", f->feedback.frame_index, f->feedback.stream_index, e.what());
+				f->feedback.sent_to_decoder = 0;
+				send_feedback(f->feedback);
+			}
+		}
+	}
+}
+
+void shard_accumulator::decode(frame & f)
+{
+	std::vector<std::span<const uint8_t>> payload;
+	payload.reserve(f.shards.size());
+	for (const auto & shard: f.shards)
+		payload.emplace_back(shard.payload);
+
+	f.feedback.sent_to_decoder = instance.now();
+	decoder_->push_data(payload, f.feedback.frame_index, false);
+
+	// Try to extract a frame
+	const auto & view_info = *f.shards.front().view_info;
+	decoder_->frame_completed(f.feedback, view_info);
+
+	// The server waits for this before sending P frames, the other frames are reported by the
+	// feedback batch once displayed
+	if (view_info.idr)
+		send_feedback(f.feedback);
+}
+
 void shard_accumulator::send_feedback(wivrn::from_headset::feedback & feedback)
 {
 	if (not feedback.received_last_packet)
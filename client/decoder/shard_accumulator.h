@@ -20,10 +20,16 @@
 #pragma once
 
 #include "decoder.h"
+#include "frame_drop_policy.h"
+#include "utils/named_thread.h"
+#include "utils/ring_buffer.h"
 #include "wivrn_packets.h"
 
+#include <atomic>
 #include <memory>
 #include <optional>
+#include <string>
+#include <thread>
 #include <vector>
 #include <vulkan/vulkan_raii.hpp>
 
@@ -40,6 +46,8 @@ class stream;
 namespace wivrn
 {
 
+// Reassembles frames from shards on the network thread and decodes them on a worker thread,
+// so that decoding never delays the reception of packets.
 class shard_accumulator
 {
 	std::shared_ptr<decoder> decoder_;
@@ -53,7 +61,7 @@ public:
 		void reset(uint64_t frame_index);
 		bool empty() const;
 
-		std::optional<uint16_t> insert(data_shard &&, xr::instance & instance);
+		std::optional<uint16_t> insert(data_shard &&, XrTime received);
 
 		wivrn::from_headset::feedback feedback{};
 
@@ -70,10 +78,32 @@ public:
 	};
 
 private:
+	// A complete frame waiting for the decoder
+	struct frame
+	{
+		std::vector<data_shard> shards;
+		wivrn::from_headset::feedback feedback;
+	};
+
 	shard_set current;
 	shard_set next;
 	std::weak_ptr<scenes::stream> weak_scene;
 	xr::instance & instance;
+	// Reception time of the shard being pushed
+	XrTime shard_received = 0;
+
+	// Written by the network thread, read by the worker, holds up to 7 frames
+	utils::ring_buffer<frame, 8> frames;
+	static_assert(frame_drop_policy::max_waiting < 7);
+	frame_drop_policy drop_policy;
+	std::atomic<uint64_t> frames_pushed = 0;
+	std::atomic<bool> stopping = false;
+	std::thread worker;
+
+	// Frames dropped because the queue was full or while waiting for an IDR frame after that,
+	// and queued frames skipped because an IDR frame was queued after them
+	std::atomic<uint64_t> dropped = 0;
+	std::atomic<uint64_t> superseded = 0;
 
 public:
 	explicit shard_accumulator(
@@ -91,9 +121,16 @@ public:
 	        instance(instance)
 	{
 		next.reset(1);
+		worker = utils::named_thread("decoder_worker_" + std::to_string(stream_index), &shard_accumulator::decode_loop, this);
 	}
 
-	void push_shard(wivrn::to_headset::video_stream_data_shard &&);
+	~shard_accumulator();
+
+	// True on the decoding worker of any stream, the scene must not be destroyed there
+	static bool on_worker_thread();
+
+	// received: time at which the shard was received by the kernel
+	void push_shard(wivrn::to_headset::video_stream_data_shard &&, XrTime received);
 
 	vk::Sampler sampler()
 	{
@@ -103,9 +140,11 @@ public:
 	using blit_handle = decoder::blit_handle;
 
 private:
-	void try_submit_frame(std::optional<uint16_t> shard_idx);
-	void try_submit_frame(uint16_t shard_idx);
+	void try_submit_frame();
 	void send_feedback(wivrn::from_headset::feedback & feedback);
 	void advance();
+
+	void decode_loop();
+	void decode(frame &);
 };
 } // namespace wivrn
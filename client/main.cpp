@@ -23,7 +23,11 @@
 #include "version.h"
 
 #include <arpa/inet.h>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
 #include <netdb.h>
+#include <optional>
 #include <sys/socket.h>
 #include <sys/types.h>
 
@@ -38,7 +42,7 @@
 #ifdef __ANDROID__
 void real_main(android_app * native_app)
 #else
-void real_main()
+void real_main(std::optional<std::filesystem::path> benchmark_scene)
 #endif
 {
 	if (wivrn::is_tag)
@@ -55,6 +59,14 @@ void real_main()
 		info.version = VK_MAKE_VERSION(1, 0, 0);
 		application app(info);
 
+#ifndef __ANDROID__
+		if (benchmark_scene)
+		{
+			app.benchmark_scene_loader(*benchmark_scene);
+			return;
+		}
+#endif
+
 		app.push_scene<scenes::lobby>();
 
 		app.run();
@@ -124,6 +136,18 @@ int main(int argc, char * argv[])
 			spdlog::warn("Invalid value for WIVRN_LOGLEVEL environment variable");
 	}
 
-	real_main();
+	std::optional<std::filesystem::path> benchmark_scene;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--benchmark-scene-loader") == 0 and i + 1 < argc)
+			benchmark_scene = argv[++i];
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--benchmark-scene-loader scene.glb]" << std::endl;
+			return 1;
+		}
+	}
+
+	real_main(benchmark_scene);
 }
 #endif
@@ -97,6 +97,16 @@ public:
 		return add(4, indices.data(), indices.size_bytes());
 	}
 
+	// Already converted indices, e.g. from the geometry cache
+	size_t add_indices(std::span<const std::byte> indices, vk::IndexType type)
+	{
+		if (type == vk::IndexType::eUint8EXT and not feat_uint8.indexTypeUint8)
+			throw std::runtime_error("8-bit indices are not supported");
+
+		usage |= vk::BufferUsageFlagBits::eIndexBuffer;
+		return add(4, indices.data(), indices.size());
+	}
+
 	std::pair<size_t, vk::IndexType> add_indices(const fastgltf::Accessor & accessor)
 	{
 		usage |= vk::BufferUsageFlagBits::eIndexBuffer;
@@ -158,4 +168,9 @@ public:
 	{
 		return bytes.size();
 	}
+
+	std::span<const std::byte> data(size_t offset, size_t size) const
+	{
+		return std::span{bytes}.subspan(offset, size);
+	}
 };
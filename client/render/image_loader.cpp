@@ -20,13 +20,17 @@
 #include "image_loader.h"
 
 #include "application.h"
+#include "utils/ranges.h"
 #include "utils/thread_safe.h"
 #include "vk/allocation.h"
 #include "vk/vk_allocator.h"
+#include <atomic>
 #include <cstdint>
 #include <ktx.h>
 #include <ktxvulkan.h>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <span>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
@@ -102,6 +106,11 @@ public:
 	{
 		return handle_;
 	}
+
+	std::shared_ptr<ktxTexture2> release()
+	{
+		return std::shared_ptr<ktxTexture2>(std::exchange(handle_, nullptr), [](ktxTexture2 * texture) { ktxTexture_Destroy(ktxTexture(texture)); });
+	}
 };
 
 namespace libktx_vma_glue
@@ -398,41 +407,10 @@ static void premultiply_alpha(void * destination, const void * source, vk::Exten
 	}
 }
 
-loaded_image image_loader::do_load_raw(const void * pixels, vk::Extent3D extent, vk::Format format, const std::string & name, bool premultiply)
+image_allocation image_loader::record_raw_upload(vk::raii::CommandBuffer & cb, vk::DeviceSize staging_offset, vk::Extent3D extent, vk::Format format, uint32_t num_mipmaps, const std::string & name)
 {
-	auto cb = std::move(device.allocateCommandBuffers({
-	        .commandPool = *cb_pool,
-	        .level = vk::CommandBufferLevel::ePrimary,
-	        .commandBufferCount = 1,
-	})[0]);
-
-	cb.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
-
 	assert(format != vk::Format::eUndefined);
 
-	uint32_t num_mipmaps = std::floor(std::log2(std::max(extent.width, extent.height))) + 1;
-
-	size_t byte_size = extent.width * extent.height * extent.depth * bytes_per_pixel(format);
-
-	// Copy to staging buffer
-	staging_buffer = buffer_allocation{
-	        device,
-	        vk::BufferCreateInfo{
-	                .size = byte_size,
-	                .usage = vk::BufferUsageFlagBits::eTransferSrc},
-	        VmaAllocationCreateInfo{
-	                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-	                .usage = VMA_MEMORY_USAGE_AUTO,
-	        },
-	        name + " (staging)"};
-
-	if (premultiply)
-		premultiply_alpha(staging_buffer.map(), pixels, extent, format);
-	else
-		memcpy(staging_buffer.map(), pixels, byte_size);
-
-	staging_buffer.unmap();
-
 	// Allocate image
 	image_allocation image{
 	        device,
@@ -480,7 +458,7 @@ loaded_image image_loader::do_load_raw(const void * pixels, vk::Extent3D extent,
 	        image,
 	        vk::ImageLayout::eTransferDstOptimal,
 	        vk::BufferImageCopy{
-	                .bufferOffset = 0,
+	                .bufferOffset = staging_offset,
 	                .bufferRowLength = 0,
 	                .bufferImageHeight = 0,
 	                .imageSubresource = {
@@ -591,53 +569,143 @@ loaded_image image_loader::do_load_raw(const void * pixels, vk::Extent3D extent,
 	                },
 	        });
 
-	cb.end();
-	vk::SubmitInfo info;
-	info.setCommandBuffers(*cb);
-	auto fence = device.createFence(vk::FenceCreateInfo{});
-	queue.lock()->submit(info, *fence);
-	if (auto result = device.waitForFences(*fence, true, 1'000'000'000); result != vk::Result::eSuccess)
-		throw std::runtime_error("vkWaitForfences: " + vk::to_string(result));
-
-	vk::ImageViewType image_view_type;
-	if (extent.depth > 1)
-		image_view_type = vk::ImageViewType::e3D;
-	else
-		image_view_type = vk::ImageViewType::e2D;
+	return image;
+}
 
-	vk::raii::ImageView image_view{
-	        device,
-	        vk::ImageViewCreateInfo{
-	                .image = image,
-	                .viewType = image_view_type,
-	                .format = format,
-	                .subresourceRange = {
-	                        .aspectMask = vk::ImageAspectFlagBits::eColor,
-	                        .baseMipLevel = 0,
-	                        .levelCount = num_mipmaps,
-	                        .baseArrayLayer = 0,
-	                        .layerCount = 1,
-	                },
-	        },
-	};
+size_t decoded_image::byte_size() const
+{
+	if (ktx)
+		return ktxTexture_GetDataSize(ktxTexture(ktx.get()));
 
-	return loaded_image{
-	        .image = std::move(image),
-	        .image_view = std::move(image_view),
-	        .format = format,
-	        .extent = extent,
-	        .num_mipmaps = num_mipmaps,
-	        .image_view_type = image_view_type,
-	        .is_alpha_premultiplied = premultiply,
-	};
+	// Keep each image aligned for vkCmdCopyBufferToImage
+	return (extent.width * extent.height * extent.depth * bytes_per_pixel(format) + 15) & ~size_t(15);
+}
+
+std::vector<loaded_image> image_loader::upload(std::span<decoded_image> images)
+{
+	std::vector<std::optional<loaded_image>> loaded(images.size());
+
+	size_t staging_size = 0;
+	for (const decoded_image & image: images)
+	{
+		if (not image.ktx)
+			staging_size += image.byte_size();
+	}
+
+	if (staging_size > 0)
+	{
+		auto cb = std::move(device.allocateCommandBuffers({
+		        .commandPool = *cb_pool,
+		        .level = vk::CommandBufferLevel::ePrimary,
+		        .commandBufferCount = 1,
+		})[0]);
+
+		cb.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+		// Copy to staging buffer
+		staging_buffer = buffer_allocation{
+		        device,
+		        vk::BufferCreateInfo{
+		                .size = staging_size,
+		                .usage = vk::BufferUsageFlagBits::eTransferSrc},
+		        VmaAllocationCreateInfo{
+		                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+		                .usage = VMA_MEMORY_USAGE_AUTO,
+		        },
+		        images.size() == 1 ? images[0].name + " (staging)" : "image_loader staging buffer"};
+
+		std::byte * staging = (std::byte *)staging_buffer.map();
+
+		std::vector<std::tuple<size_t, image_allocation, uint32_t>> raw_images;
+		vk::DeviceSize offset = 0;
+		for (auto && [index, image]: utils::enumerate(images))
+		{
+			if (image.ktx)
+				continue;
+
+			size_t byte_size = image.extent.width * image.extent.height * image.extent.depth * bytes_per_pixel(image.format);
+
+			if (image.premultiply)
+				premultiply_alpha(staging + offset, image.pixels.get(), image.extent, image.format);
+			else
+				memcpy(staging + offset, image.pixels.get(), byte_size);
+
+			uint32_t num_mipmaps = std::floor(std::log2(std::max(image.extent.width, image.extent.height))) + 1;
+
+			raw_images.emplace_back(index, record_raw_upload(cb, offset, image.extent, image.format, num_mipmaps, image.name), num_mipmaps);
+
+			offset += image.byte_size();
+		}
+
+		staging_buffer.unmap();
+
+		cb.end();
+		vk::SubmitInfo info;
+		info.setCommandBuffers(*cb);
+		auto fence = device.createFence(vk::FenceCreateInfo{});
+		queue.lock()->submit(info, *fence);
+		if (auto result = device.waitForFences(*fence, true, 1'000'000'000); result != vk::Result::eSuccess)
+			throw std::runtime_error("vkWaitForfences: " + vk::to_string(result));
+
+		for (auto & [index, image, num_mipmaps]: raw_images)
+		{
+			const decoded_image & decoded = images[index];
+
+			vk::ImageViewType image_view_type;
+			if (decoded.extent.depth > 1)
+				image_view_type = vk::ImageViewType::e3D;
+			else
+				image_view_type = vk::ImageViewType::e2D;
+
+			vk::raii::ImageView image_view{
+			        device,
+			        vk::ImageViewCreateInfo{
+			                .image = image,
+			                .viewType = image_view_type,
+			                .format = decoded.format,
+			                .subresourceRange = {
+			                        .aspectMask = vk::ImageAspectFlagBits::eColor,
+			                        .baseMipLevel = 0,
+			                        .levelCount = num_mipmaps,
+			                        .baseArrayLayer = 0,
+			                        .layerCount = 1,
+			                },
+			        },
+			};
+
+			loaded[index] = loaded_image{
+			        .image = std::move(image),
+			        .image_view = std::move(image_view),
+			        .format = decoded.format,
+			        .extent = decoded.extent,
+			        .num_mipmaps = num_mipmaps,
+			        .image_view_type = image_view_type,
+			        .is_alpha_premultiplied = decoded.premultiply,
+			};
+		}
+	}
+
+	// libktx records its own command buffers, KTX2 images are uploaded one by one
+	for (auto && [index, image]: utils::enumerate(images))
+	{
+		if (image.ktx)
+			loaded[index] = upload_ktx(image);
+	}
+
+	std::vector<loaded_image> result;
+	result.reserve(loaded.size());
+	for (auto & i: loaded)
+		result.push_back(std::move(*i));
+
+	return result;
 }
 
-loaded_image image_loader::do_load_ktx(std::span<const std::byte> bytes, bool srgb, const std::string & name, const std::filesystem::path & output_file)
+decoded_image image_loader::decode_ktx(std::span<const std::byte> bytes, bool srgb, const std::string & name, const std::filesystem::path & output_file) const
 {
 	KTXTexture2 texture{};
 	// KTX_TEXTURE_CREATE_CHECK_GLTF_BASISU_BIT checks that the file is compatible with the KHR_texture_basisu glTF extension
-	// ktxResult err = ktxTexture2_CreateFromMemory(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture);
-	ktxResult err = ktxTexture2_CreateFromMemory(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size(), 0, &texture);
+	// KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT is needed so that the decoded image does not reference bytes
+	ktxResult err = ktxTexture2_CreateFromMemory(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture);
 	// ktxResult err = ktxTexture2_CreateFromMemory(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size(), KTX_TEXTURE_CREATE_CHECK_GLTF_BASISU_BIT | KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture);
 
 	if (err != KTX_SUCCESS)
@@ -650,12 +718,25 @@ loaded_image image_loader::do_load_ktx(std::span<const std::byte> bytes, bool sr
 	{
 		auto format = srgb ? supported_srgb_formats.front() : supported_linear_formats.front();
 
+		// libktx lazily initializes the Basis Universal transcoder tables on the first
+		// transcode without any synchronization, make sure it happens on a single thread
+		static std::mutex transcoder_init_mutex;
+		static std::atomic<bool> transcoder_initialized = false;
+
+		std::unique_lock lock{transcoder_init_mutex, std::defer_lock};
+		if (not transcoder_initialized)
+			lock.lock();
+
 		if (ktxTexture2_TranscodeBasis(texture, format.second, 0) != KTX_SUCCESS)
 		{
 			spdlog::warn("ktxTexture2_TranscodeBasis: error {}", ktxErrorString(err));
 			throw std::runtime_error("ktxTexture2_TranscodeBasis");
 		}
 
+		transcoder_initialized = true;
+		if (lock)
+			lock.unlock();
+
 		if (output_file != "")
 		{
 			spdlog::debug("Saving transcoded texture to {}", output_file.native());
@@ -671,10 +752,18 @@ loaded_image image_loader::do_load_ktx(std::span<const std::byte> bytes, bool sr
 		}
 	}
 
+	return decoded_image{
+	        .name = name,
+	        .ktx = texture.release(),
+	};
+}
+
+loaded_image image_loader::upload_ktx(decoded_image & image)
+{
+	ktxTexture2 * texture = image.ktx.get();
+
 	ktxVulkanTexture vk_texture;
-	{
-		err = ktxTexture2_VkUploadEx_WithSuballocator(texture, &vdi, &vk_texture, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &libktx_vma_glue::suballocator_callbacks);
-	}
+	ktxResult err = ktxTexture2_VkUploadEx_WithSuballocator(texture, &vdi, &vk_texture, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, &libktx_vma_glue::suballocator_callbacks);
 
 	if (err != KTX_SUCCESS)
 	{
@@ -683,7 +772,7 @@ loaded_image image_loader::do_load_ktx(std::span<const std::byte> bytes, bool sr
 	}
 
 	return loaded_image{
-	        .image{libktx_vma_glue::release(vk_texture.allocationId), device, vk_texture.image, name}, // Take over ownership of vk_texture, do not call ktxTexture2_destruct
+	        .image{libktx_vma_glue::release(vk_texture.allocationId), device, vk_texture.image, image.name}, // Take over ownership of vk_texture, do not call ktxTexture2_destruct
 	        .image_view{
 	                device,
 	                vk::ImageViewCreateInfo{
@@ -711,7 +800,7 @@ static constexpr bool starts_with(std::span<const std::byte> data, std::span<con
 	return data.size() >= prefix.size() && !memcmp(data.data(), prefix.data(), prefix.size());
 }
 
-loaded_image image_loader::do_load_image(std::span<const std::byte> bytes, bool srgb, const std::string & name, bool premultiply)
+decoded_image image_loader::decode_image(std::span<const std::byte> bytes, bool srgb, const std::string & name, bool premultiply) const
 {
 	const stbi_uc * image_data = (const stbi_uc *)bytes.data();
 	size_t image_size = bytes.size();
@@ -744,25 +833,38 @@ loaded_image image_loader::do_load_image(std::span<const std::byte> bytes, bool
 		format = srgb ? get_format_srgb(num_channels) : get_format<uint8_t>(num_channels);
 	}
 
-	vk::Extent3D extent{
-	        .width = uint32_t(w),
-	        .height = uint32_t(h),
-	        .depth = 1,
-	};
+	if (not pixels)
+		throw std::runtime_error(stbi_failure_reason());
 
-	return do_load_raw(pixels.get(), extent, format, name, premultiply);
+	return decoded_image{
+	        .name = name,
+	        .pixels = std::move(pixels),
+	        .extent = {
+	                .width = uint32_t(w),
+	                .height = uint32_t(h),
+	                .depth = 1,
+	        },
+	        .format = format,
+	        .premultiply = premultiply,
+	};
 }
 
-// Load a PNG/JPEG/KTX2 file
-loaded_image image_loader::load(std::span<const std::byte> bytes, bool srgb, const std::string & name, bool premultiply, const std::filesystem::path & output_file)
+decoded_image image_loader::decode(std::span<const std::byte> bytes, bool srgb, const std::string & name, bool premultiply, const std::filesystem::path & output_file) const
 {
 	const uint8_t ktx1_magic[] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
 	const uint8_t ktx2_magic[] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
 
 	if (starts_with(bytes, ktx1_magic) || starts_with(bytes, ktx2_magic))
-		return do_load_ktx(bytes, srgb, name, output_file);
+		return decode_ktx(bytes, srgb, name, output_file);
 	else
-		return do_load_image(bytes, srgb, name, premultiply);
+		return decode_image(bytes, srgb, name, premultiply);
+}
+
+// Load a PNG/JPEG/KTX2 file
+loaded_image image_loader::load(std::span<const std::byte> bytes, bool srgb, const std::string & name, bool premultiply, const std::filesystem::path & output_file)
+{
+	decoded_image image = decode(bytes, srgb, name, premultiply, output_file);
+	return std::move(upload(std::span{&image, 1}).front());
 }
 
 // Load raw pixel data
@@ -771,5 +873,13 @@ loaded_image image_loader::load(const void * pixels, size_t size, vk::Extent3D e
 	if (size < extent.width * extent.height * extent.depth * bytes_per_pixel(format))
 		throw std::invalid_argument("size");
 
-	return do_load_raw(pixels, extent, format, name, premultiply);
+	decoded_image image{
+	        .name = name,
+	        .pixels = std::shared_ptr<const void>(std::shared_ptr<void>{}, pixels), // Not owned
+	        .extent = extent,
+	        .format = format,
+	        .premultiply = premultiply,
+	};
+
+	return std::move(upload(std::span{&image, 1}).front());
 }
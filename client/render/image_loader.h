@@ -28,7 +28,9 @@
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 #include <ktxvulkan.h>
+#include <memory>
 #include <span>
+#include <string>
 #include <utility>
 #include <vector>
 #include <vulkan/vulkan.hpp>
@@ -45,6 +47,24 @@ struct loaded_image
 	bool is_alpha_premultiplied;
 };
 
+// CPU side of an image, before it is uploaded to the GPU
+struct decoded_image
+{
+	std::string name;
+
+	// Set for KTX2 images, already transcoded if needed
+	std::shared_ptr<ktxTexture2> ktx;
+
+	// Set for all other images
+	std::shared_ptr<const void> pixels;
+	vk::Extent3D extent;
+	vk::Format format;
+	bool premultiply = false;
+
+	// Size of the pixel data, rounded up to keep raw images aligned in the staging buffer
+	size_t byte_size() const;
+};
+
 struct image_loader
 {
 	image_loader(vk::raii::Device & device, vk::raii::PhysicalDevice physical_device, thread_safe<vk::raii::Queue> & queue, uint32_t queue_family_index);
@@ -81,6 +101,14 @@ struct image_loader
 		return std::make_shared<loaded_image>(load(bytes, srgb, name, premultiply));
 	}
 
+	// Decode a PNG/JPEG/KTX2 file and transcode it if needed, without using the GPU.
+	// This can be called concurrently from several threads, the result does not reference bytes.
+	decoded_image decode(std::span<const std::byte> bytes, bool srgb, const std::string & name = "", bool premultiply = false, const std::filesystem::path & output_file = "") const;
+
+	// Upload decoded images to the GPU, all PNG/JPEG images are copied and
+	// mipmapped with a single command buffer submission
+	std::vector<loaded_image> upload(std::span<decoded_image> images);
+
 private:
 	ktxVulkanDeviceInfo vdi;
 	vk::raii::Device & device;
@@ -92,8 +120,9 @@ private:
 
 	buffer_allocation staging_buffer;
 
-	loaded_image do_load_raw(const void * pixels, vk::Extent3D extent, vk::Format format, const std::string & name, bool premultiply);
+	image_allocation record_raw_upload(vk::raii::CommandBuffer & cb, vk::DeviceSize staging_offset, vk::Extent3D extent, vk::Format format, uint32_t num_mipmaps, const std::string & name);
+	loaded_image upload_ktx(decoded_image & image);
 
-	loaded_image do_load_image(std::span<const std::byte> bytes, bool srgb, const std::string & name, bool premultiply);
-	loaded_image do_load_ktx(std::span<const std::byte> bytes, bool srgb, const std::string & name, const std::filesystem::path & output_file = "");
+	decoded_image decode_image(std::span<const std::byte> bytes, bool srgb, const std::string & name, bool premultiply) const;
+	decoded_image decode_ktx(std::span<const std::byte> bytes, bool srgb, const std::string & name, const std::filesystem::path & output_file = "") const;
 };
@@ -37,6 +37,7 @@
 #include <boost/locale.hpp>
 #include <cmath>
 #include <cstddef>
+#include <functional>
 #include <glm/gtc/matrix_access.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <imgui.h>
@@ -284,6 +285,58 @@ glm::vec3 imgui_context::rw_from_vp(const ImVec2 & position)
 	return {};
 }
 
+static void hash_combine(size_t & seed, size_t value)
+{
+	seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+static void hash_bytes(size_t & seed, const void * data, size_t size)
+{
+	hash_combine(seed, std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char *>(data), size)));
+}
+
+// Everything that can change the rendered image: geometry, clip rectangles and textures
+static size_t hash_draw_data(const ImDrawData * draw_data)
+{
+	size_t seed = 0;
+
+	hash_bytes(seed, &draw_data->DisplayPos, sizeof(draw_data->DisplayPos));
+	hash_bytes(seed, &draw_data->DisplaySize, sizeof(draw_data->DisplaySize));
+
+	for (const ImDrawList * draw_list: draw_data->CmdLists)
+	{
+		hash_bytes(seed, draw_list->VtxBuffer.Data, draw_list->VtxBuffer.size_in_bytes());
+		hash_bytes(seed, draw_list->IdxBuffer.Data, draw_list->IdxBuffer.size_in_bytes());
+
+		for (const ImDrawCmd & cmd: draw_list->CmdBuffer)
+		{
+			hash_bytes(seed, &cmd.ClipRect, sizeof(cmd.ClipRect));
+			hash_combine(seed, std::hash<const void *>{}(cmd.TexRef._TexData));
+			hash_combine(seed, std::hash<ImTextureID>{}(cmd.TexRef._TexID));
+			hash_combine(seed, cmd.VtxOffset);
+			hash_combine(seed, cmd.IdxOffset);
+			hash_combine(seed, cmd.ElemCount);
+			hash_combine(seed, std::hash<const void *>{}(reinterpret_cast<const void *>(cmd.UserCallback)));
+		}
+	}
+
+	return seed;
+}
+
+static bool has_texture_updates(const ImDrawData * draw_data)
+{
+	if (not draw_data->Textures)
+		return false;
+
+	for (const ImTextureData * texture: *draw_data->Textures)
+	{
+		if (texture->Status != ImTextureStatus_OK)
+			return true;
+	}
+
+	return false;
+}
+
 imgui_context::imgui_frame & imgui_context::get_frame(vk::Image destination)
 {
 	for (auto & i: frames)
@@ -369,6 +422,13 @@ imgui_context::imgui_context(
 		cb.fence = device.createFence(vk::FenceCreateInfo{.flags = vk::FenceCreateFlagBits::eSignaled});
 	}
 
+	query_pool = vk::raii::QueryPool(
+	        device,
+	        vk::QueryPoolCreateInfo{
+	                .queryType = vk::QueryType::eTimestamp,
+	                .queryCount = uint32_t(2 * command_buffers.size()),
+	        });
+
 	ImGui_ImplVulkan_InitInfo init_info = {
 	        .Instance = *application::get_vulkan_instance(),
 	        .PhysicalDevice = *physical_device,
@@ -830,9 +890,6 @@ void imgui_context::new_frame(XrTime display_time)
 		ImGui::ShowDemoWindow(&show_demo_window);
 #endif
 
-	image_index = swapchain.acquire();
-	swapchain.wait();
-
 	hovered_item_prev = hovered_item;
 	hovered_item = 0;
 }
@@ -846,8 +903,6 @@ std::vector<std::pair<int, XrCompositionLayerQuad>> imgui_context::end_frame()
 			application::haptic_start(haptic_output, XR_NULL_PATH, 10'000'000, 1000, 1);
 	}
 
-	vk::Image destination = swapchain.image(image_index);
-
 	ImGui::SetCurrentContext(context);
 	ImPlot::SetCurrentContext(plot_context);
 
@@ -958,17 +1013,44 @@ std::vector<std::pair<int, XrCompositionLayerQuad>> imgui_context::end_frame()
 
 	ImGui::Render();
 
+	// The swapchain image is kept by the runtime until the next release, if the GUI did not
+	// change there is no need to render it again
+	ImDrawData * draw_data = ImGui::GetDrawData();
+	size_t draw_data_hash = hash_draw_data(draw_data);
+	if (draw_data_hash == last_draw_data_hash and not has_texture_updates(draw_data))
+	{
+		last_gpu_time = 0;
+		return layer_quads();
+	}
+
+	int image_index = swapchain.acquire();
+	swapchain.wait();
+	vk::Image destination = swapchain.image(image_index);
+
 	current_command_buffer = (current_command_buffer + 1) % command_buffers.size();
 
 	auto & f = get_frame(destination);
 	auto & cb = get_command_buffer().command_buffer;
 	auto & fence = get_command_buffer().fence;
+	uint32_t first_query = 2 * current_command_buffer;
 
 	if (auto result = device.waitForFences(*fence, true, 1'000'000'000); result != vk::Result::eSuccess)
 		throw std::runtime_error("vkWaitForfences: " + vk::to_string(result));
 	device.resetFences(*fence);
 
+	// This is the time of the previous use of this command buffer, it is at most a few frames old
+	last_gpu_time = 0;
+	if (get_command_buffer().timestamps_written)
+	{
+		auto [res, timestamps] = query_pool.getResults<uint64_t>(first_query, 2, 2 * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+		if (res == vk::Result::eSuccess)
+			last_gpu_time = (timestamps[1] - timestamps[0]) * application::get_physical_device_properties().limits.timestampPeriod / 1e9;
+	}
+
 	cb.begin({.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+	cb.resetQueryPool(*query_pool, first_query, 2);
+	cb.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *query_pool, first_query);
 
 	vk::ClearValue clear{vk::ClearColorValue(0, 0, 0, 0)};
 
@@ -985,11 +1067,12 @@ std::vector<std::pair<int, XrCompositionLayerQuad>> imgui_context::end_frame()
 	{
 		auto _ = queue.lock(); // ImGui_ImplVulkan_RenderDrawData uses the queue internally (in ImGui_ImplVulkan_UpdateTexture)
 		// TODO: patch imgui_impl_vulkan to accept a mutex
-		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), *cb);
+		ImGui_ImplVulkan_RenderDrawData(draw_data, *cb);
 	}
 
 	cb.endRenderPass();
 
+	cb.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *query_pool, first_query + 1);
 	cb.end();
 
 	queue.lock()->submit(vk::SubmitInfo{
@@ -997,9 +1080,27 @@ std::vector<std::pair<int, XrCompositionLayerQuad>> imgui_context::end_frame()
 	                             .pCommandBuffers = &*cb,
 	                     },
 	                     *fence);
+	get_command_buffer().timestamps_written = true;
 
 	swapchain.release();
+	last_draw_data_hash = draw_data_hash;
+
+	return layer_quads();
+}
 
+std::vector<std::pair<int, XrCompositionLayerQuad>> imgui_context::previous_frame()
+{
+	last_gpu_time = 0;
+
+	// Nothing has been released in the swapchain yet
+	if (not last_draw_data_hash)
+		return {};
+
+	return layer_quads();
+}
+
+std::vector<std::pair<int, XrCompositionLayerQuad>> imgui_context::layer_quads()
+{
 	std::vector<std::pair<int, XrCompositionLayerQuad>> quads;
 	quads.reserve(layers_.size());
 
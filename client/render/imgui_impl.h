@@ -82,6 +82,7 @@ class imgui_context : public imgui_textures
 	{
 		vk::raii::CommandBuffer command_buffer = nullptr;
 		vk::raii::Fence fence = nullptr;
+		bool timestamps_written = false;
 	};
 
 public:
@@ -167,6 +168,10 @@ private:
 
 	std::vector<command_buffer> command_buffers;
 	size_t current_command_buffer = 0;
+
+	// Two timestamps per command buffer
+	vk::raii::QueryPool query_pool = nullptr;
+	float last_gpu_time = 0;
 	command_buffer & get_command_buffer()
 	{
 		return command_buffers[current_command_buffer];
@@ -179,7 +184,9 @@ private:
 	std::vector<viewport> layers_;
 
 	xr::swapchain swapchain;
-	int image_index;
+
+	// Hash of the draw data in the last released swapchain image, used to skip rendering identical frames
+	std::optional<size_t> last_draw_data_hash;
 
 	ImGuiContext * context;
 	ImPlotContext * plot_context;
@@ -208,6 +215,8 @@ private:
 	std::vector<controller_state> read_controllers_state(XrTime display_time);
 	size_t choose_focused_controller(const std::vector<controller_state> & new_states) const;
 
+	std::vector<std::pair<int, XrCompositionLayerQuad>> layer_quads();
+
 public:
 	imgui_context(
 	        vk::raii::PhysicalDevice physical_device,
@@ -236,6 +245,16 @@ public:
 	void new_frame(XrTime display_time);
 	std::vector<std::pair<int, XrCompositionLayerQuad>> end_frame();
 
+	// Submit the same layers as the last call to end_frame without starting a new ImGui frame,
+	// the layers can still be moved
+	std::vector<std::pair<int, XrCompositionLayerQuad>> previous_frame();
+
+	// GPU time used by the last call to end_frame in seconds, 0 if nothing was rendered
+	float gpu_time() const
+	{
+		return last_gpu_time;
+	}
+
 	size_t get_focused_controller() const
 	{
 		return focused_controller;
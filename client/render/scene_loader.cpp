@@ -29,7 +29,10 @@
 #include "utils/ranges.h"
 #include "vk/shader.h"
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <entt/entt.hpp>
 #include <fastgltf/base64.hpp>
@@ -44,6 +47,9 @@
 #include <glm/ext.hpp>
 #include <glm/fwd.hpp>
 #include <limits>
+#include <mutex>
+#include <optional>
+#include <pthread.h>
 #include <ranges>
 #include <simdjson/dom.h>
 #include <simdjson/dom/element.h>
@@ -51,6 +57,8 @@
 #include <simdjson/error.h>
 #include <spdlog/spdlog.h>
 #include <string>
+#include <thread>
+#include <unistd.h>
 #include <vulkan/vulkan_format_traits.hpp>
 
 namespace fastgltf
@@ -380,6 +388,27 @@ void fill_vertex_attributes(
 	write_vertex_attribute(buffer, attribute.offset, binding.stride, attribute.format, value, size);
 }
 
+std::vector<size_t> vertex_buffer_sizes(const renderer::vertex_layout & layout, size_t vertex_count)
+{
+	int max_binding = std::ranges::max(layout.bindings, {}, &vk::VertexInputBindingDescription::binding).binding;
+
+	std::vector<size_t> sizes(max_binding + 1, 0);
+	for (const vk::VertexInputBindingDescription & binding: layout.bindings)
+	{
+		switch (binding.inputRate)
+		{
+			case vk::VertexInputRate::eVertex:
+				sizes[binding.binding] = binding.stride * vertex_count;
+				break;
+			case vk::VertexInputRate::eInstance:
+				sizes[binding.binding] = binding.stride;
+				break;
+		}
+	}
+
+	return sizes;
+}
+
 std::pair<size_t, std::vector<std::vector<std::byte>>> create_vertex_buffers(
         const renderer::vertex_layout & layout,
         const fastgltf::Asset & asset,
@@ -397,20 +426,10 @@ std::pair<size_t, std::vector<std::vector<std::byte>>> create_vertex_buffers(
 	}
 
 	// Allocate buffers
-	int max_binding = std::ranges::max(layout.bindings, {}, &vk::VertexInputBindingDescription::binding).binding;
-	buffers.resize(max_binding + 1);
-	for (const vk::VertexInputBindingDescription & binding: layout.bindings)
-	{
-		switch (binding.inputRate)
-		{
-			case vk::VertexInputRate::eVertex:
-				buffers[binding.binding].resize(binding.stride * vertex_count);
-				break;
-			case vk::VertexInputRate::eInstance:
-				buffers[binding.binding].resize(binding.stride);
-				break;
-		}
-	}
+	auto sizes = vertex_buffer_sizes(layout, vertex_count);
+	buffers.resize(sizes.size());
+	for (auto && [buffer, size]: std::views::zip(buffers, sizes))
+		buffer.resize(size);
 
 	// Copy attributes
 	for (auto && [name, attribute]: std::views::zip(layout.attribute_names, layout.attributes))
@@ -478,23 +497,19 @@ fastgltf::MimeType guess_mime_type(std::span<const std::byte> image_data)
 		return fastgltf::MimeType::None;
 }
 
-loaded_image do_load_image(
-        image_loader & loader,
+decoded_image do_decode_image(
+        const image_loader & loader,
         std::span<const std::byte> image_data,
         bool srgb,
-        const std::pmr::string & name,
+        const std::string & name,
         const std::filesystem::path & output_path)
 {
 	switch (guess_mime_type(image_data))
 	{
 		case fastgltf::MimeType::JPEG:
 		case fastgltf::MimeType::PNG:
-		case fastgltf::MimeType::KTX2: {
-			auto image = loader.load(image_data, srgb, name.c_str(), false /*premultiply*/, output_path);
-
-			spdlog::debug("{}: {}x{}, format {}, {} mipmaps, {} bytes", name, image.extent.width, image.extent.height, vk::to_string(image.format), image.num_mipmaps, image.image.size());
-			return image;
-		}
+		case fastgltf::MimeType::KTX2:
+			return loader.decode(image_data, srgb, name, false /*premultiply*/, output_path);
 
 		default:
 			throw std::runtime_error{"Unsupported image MIME type"};
@@ -517,6 +532,167 @@ struct : std::error_category
 } fastgltf_error_category;
 // END
 
+// BEGIN Geometry cache
+// The geometry cache contains the index and vertex buffers of all primitives, already converted to the
+// layout of their vertex shader. It is stored in the texture cache directory so that it is invalidated
+// together with the transcoded textures when the glTF file changes.
+struct geometry_cache_error : std::runtime_error
+{
+	using std::runtime_error::runtime_error;
+};
+
+constexpr uint64_t geometry_cache_magic = 0x4f45472d6e525669; // "iVRn-GEO"
+constexpr uint32_t geometry_cache_version = 2;
+
+class geometry_cache_reader
+{
+	utils::mapped_file file;
+	std::span<const std::byte> remaining;
+
+public:
+	geometry_cache_reader(const std::filesystem::path & path) :
+	        file(path),
+	        remaining(file)
+	{
+		if (read<uint64_t>() != geometry_cache_magic)
+			throw geometry_cache_error("invalid magic number");
+
+		if (read<uint32_t>() != geometry_cache_version)
+			throw geometry_cache_error("unsupported version");
+	}
+
+	std::span<const std::byte> read_bytes(size_t size)
+	{
+		if (size > remaining.size())
+			throw geometry_cache_error("truncated file");
+
+		auto bytes = remaining.subspan(0, size);
+		remaining = remaining.subspan(size);
+		return bytes;
+	}
+
+	template <typename T>
+	        requires std::is_trivially_copyable_v<T>
+	T read()
+	{
+		T value;
+		memcpy(&value, read_bytes(sizeof(T)).data(), sizeof(T));
+		return value;
+	}
+
+	std::string read_string()
+	{
+		auto bytes = read_bytes(read<uint32_t>());
+		return {reinterpret_cast<const char *>(bytes.data()), bytes.size()};
+	}
+
+	renderer::vertex_layout read_layout()
+	{
+		renderer::vertex_layout layout;
+		layout.bindings.resize(read<uint32_t>());
+		for (auto & binding: layout.bindings)
+		{
+			binding.binding = read<uint32_t>();
+			binding.stride = read<uint32_t>();
+			binding.inputRate = read<vk::VertexInputRate>();
+		}
+
+		layout.attributes.resize(read<uint32_t>());
+		for (auto & attribute: layout.attributes)
+		{
+			layout.attribute_names.push_back(read_string());
+			attribute.location = read<uint32_t>();
+			attribute.binding = read<uint32_t>();
+			attribute.format = read<vk::Format>();
+			attribute.offset = read<uint32_t>();
+		}
+		return layout;
+	}
+};
+
+class geometry_cache_writer
+{
+	std::vector<std::byte> bytes;
+
+public:
+	geometry_cache_writer()
+	{
+		write(geometry_cache_magic);
+		write(geometry_cache_version);
+	}
+
+	void write_bytes(std::span<const std::byte> data)
+	{
+		bytes.insert(bytes.end(), data.begin(), data.end());
+	}
+
+	template <typename T>
+	        requires std::is_trivially_copyable_v<T>
+	void write(const T & value)
+	{
+		write_bytes(std::as_bytes(std::span{&value, 1}));
+	}
+
+	void write_string(std::string_view value)
+	{
+		write<uint32_t>(value.size());
+		write_bytes(std::as_bytes(std::span{value}));
+	}
+
+	void write_layout(const renderer::vertex_layout & layout)
+	{
+		write<uint32_t>(layout.bindings.size());
+		for (const auto & binding: layout.bindings)
+		{
+			write(binding.binding);
+			write(binding.stride);
+			write(binding.inputRate);
+		}
+
+		write<uint32_t>(layout.attributes.size());
+		for (auto && [name, attribute]: std::views::zip(layout.attribute_names, layout.attributes))
+		{
+			write_string(name);
+			write(attribute.location);
+			write(attribute.binding);
+			write(attribute.format);
+			write(attribute.offset);
+		}
+	}
+
+	void save(const std::filesystem::path & path)
+	{
+		// Write to a temporary file first so that a partially written cache is never used
+		std::filesystem::path tmp = path;
+		tmp += ".tmp";
+
+		std::ofstream file{tmp, std::ios::binary};
+		file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+		file.close();
+
+		if (not file)
+			throw std::runtime_error("cannot write " + tmp.native());
+
+		std::filesystem::rename(tmp, path);
+	}
+};
+
+size_t index_size(vk::IndexType type)
+{
+	switch (type)
+	{
+		case vk::IndexType::eUint8EXT:
+			return 1;
+		case vk::IndexType::eUint16:
+			return 2;
+		case vk::IndexType::eUint32:
+			return 4;
+		default:
+			throw std::invalid_argument("type");
+	}
+}
+// END
+
 fastgltf::Asset load_gltf_asset(fastgltf::GltfDataBuffer & buffer, const std::filesystem::path & directory, std::function<void(simdjson::dom::object &, std::size_t, fastgltf::Category)> extra_callback)
 {
 	fastgltf::Parser parser(
@@ -661,17 +837,10 @@ public:
 		                  source);
 	}
 
-	std::unordered_map<int, std::shared_ptr<vk::raii::ImageView>> images;
-	std::shared_ptr<vk::raii::ImageView> load_image(int index, const std::filesystem::path & texture_cache, bool srgb)
+	// Called from the texture decoding threads, must not modify the loader context
+	decoded_image decode_image(size_t index, std::span<const std::byte> image_data, const std::filesystem::path & texture_cache, bool srgb) const
 	{
-		auto it = images.find(index);
-		if (it != images.end())
-			return it->second;
-
-		if (index > gltf.images.size())
-			throw std::runtime_error(std::format("Image index {} out of range", index));
-
-		std::pmr::string image_name;
+		std::string image_name;
 		if (gltf.images[index].name == "")
 			image_name = std::format("{}(image {})", name, index);
 		else
@@ -681,15 +850,15 @@ public:
 
 		if (texture_cache != "")
 		{
-			cached_texture = texture_cache / (std::to_string(index) + ".ktx");
+			// The same image may be used both as colour and as linear data
+			cached_texture = texture_cache / std::format("{}-{}.ktx", index, srgb ? "srgb" : "linear");
 
 			if (std::filesystem::exists(cached_texture))
 			{
 				try
 				{
-					utils::mapped_file image_data{cached_texture};
-					auto image_ptr = std::make_shared<loaded_image>(do_load_image(loader, image_data, srgb, image_name, ""));
-					return std::shared_ptr<vk::raii::ImageView>(image_ptr, &image_ptr->image_view);
+					utils::mapped_file cached_data{cached_texture};
+					return do_decode_image(loader, cached_data, srgb, image_name, "");
 				}
 				catch (std::exception & e)
 				{
@@ -700,13 +869,33 @@ public:
 			}
 		}
 
-		auto [image_data, mime_type] = visit_source(gltf.images[index].data);
-		auto image_ptr = std::make_shared<loaded_image>(do_load_image(loader, image_data, srgb, image_name, cached_texture));
+		if (cached_texture == "")
+			return do_decode_image(loader, image_data, srgb, image_name, "");
+
+		// Another process loading the same scene may be reading the cache: only complete files
+		// are renamed into place
+		static std::atomic<uint64_t> temp_index = 0;
+		std::filesystem::path temp_file = cached_texture;
+		temp_file += std::format(".{}.{}.tmp", getpid(), temp_index++);
 
-		return std::shared_ptr<vk::raii::ImageView>(image_ptr, &image_ptr->image_view);
+		std::error_code ec;
+		try
+		{
+			auto image = do_decode_image(loader, image_data, srgb, image_name, temp_file);
+			if (std::filesystem::exists(temp_file, ec))
+				std::filesystem::rename(temp_file, cached_texture, ec);
+			if (ec)
+				spdlog::warn("Cannot save cached image {}: {}", cached_texture.native(), ec.message());
+			return image;
+		}
+		catch (...)
+		{
+			std::filesystem::remove(temp_file, ec);
+			throw;
+		}
 	}
 
-	std::vector<std::shared_ptr<renderer::texture>> load_all_textures(const std::filesystem::path & texture_cache, std::function<void(float)> progress_cb)
+	std::vector<std::shared_ptr<renderer::texture>> load_all_textures(const std::filesystem::path & texture_cache, std::function<void(float)> progress_cb, unsigned int num_threads)
 	{
 		// Determine which texture is sRGB
 		std::vector<uint8_t> srgb_array;
@@ -720,11 +909,40 @@ public:
 				srgb_array.at(gltf_material.emissiveTexture->textureIndex) = true;
 		}
 
+		// An image decoded with a given colour space, shared by all the jobs that use it so that
+		// it is decoded and uploaded once
+		struct decoded_source
+		{
+			std::mutex mutex;
+			bool decoded = false;
+			bool valid = false;
+			std::string error;
+			std::optional<decoded_image> image;
+
+			// Main thread only
+			bool queued = false;
+			std::shared_ptr<vk::raii::ImageView> image_view;
+		};
+		std::map<std::pair<size_t, bool>, decoded_source> sources;
+
+		// A job decodes the first image that can be loaded from a list of candidates,
+		// textures with the same candidates share the job
+		struct decode_job
+		{
+			std::vector<std::pair<size_t, std::span<const std::byte>>> candidates;
+			bool srgb;
+			std::vector<std::string> errors;
+			decoded_source * source = nullptr;
+		};
+
+		std::vector<decode_job> jobs;
+		std::map<std::pair<std::vector<size_t>, bool>, size_t> job_ids;
+		std::vector<size_t> texture_jobs;
+		texture_jobs.reserve(gltf.textures.size());
+
 		std::vector<std::shared_ptr<renderer::texture>> textures;
 		textures.reserve(gltf.textures.size());
 
-		int loaded_textures = 0;
-		int total_textures = gltf.textures.size();
 		for (auto && [srgb, gltf_texture]: std::views::zip(srgb_array, gltf.textures))
 		{
 			auto & texture_ref = *textures.emplace_back(std::make_shared<renderer::texture>());
@@ -732,23 +950,10 @@ public:
 			if (gltf_texture.samplerIndex)
 				texture_ref.sampler = convert(gltf.samplers.at(*gltf_texture.samplerIndex));
 
-			std::vector<std::string> errors;
+			std::vector<size_t> candidates;
 
 			if (gltf_texture.basisuImageIndex)
-			{
-				try
-				{
-					texture_ref.image_view = load_image(*gltf_texture.basisuImageIndex, texture_cache, srgb);
-					loaded_textures++;
-					if (progress_cb)
-						progress_cb((float)loaded_textures / total_textures);
-					continue;
-				}
-				catch (std::exception & e)
-				{
-					errors.push_back(std::format("Cannot load image {}: {}", *gltf_texture.basisuImageIndex, e.what()));
-				}
-			}
+				candidates.push_back(*gltf_texture.basisuImageIndex);
 
 			// if (gltf_texture.ddsImageIndex)
 			// {
@@ -761,28 +966,173 @@ public:
 			// }
 
 			if (gltf_texture.imageIndex)
+				candidates.push_back(*gltf_texture.imageIndex);
+
+			auto [iter, inserted] = job_ids.emplace(std::pair{candidates, (bool)srgb}, jobs.size());
+			texture_jobs.push_back(iter->second);
+
+			if (not inserted)
+				continue;
+
+			// Resolve the image sources here, visit_source is not thread safe
+			decode_job & job = jobs.emplace_back();
+			job.srgb = srgb;
+			for (size_t index: candidates)
 			{
 				try
 				{
-					texture_ref.image_view = load_image(*gltf_texture.imageIndex, texture_cache, srgb);
-					loaded_textures++;
-					if (progress_cb)
-						progress_cb((float)loaded_textures / total_textures);
-					continue;
+					if (index >= gltf.images.size())
+						throw std::runtime_error(std::format("Image index {} out of range", index));
+
+					auto [image_data, mime_type] = visit_source(gltf.images[index].data);
+					job.candidates.emplace_back(index, std::span<const std::byte>{image_data.data(), image_data.size()});
+					sources.try_emplace({index, job.srgb});
 				}
 				catch (std::exception & e)
 				{
-					errors.push_back(std::format("Cannot load image {}: {}", *gltf_texture.imageIndex, e.what()));
+					job.errors.push_back(std::format("Cannot load image {}: {}", index, e.what()));
+				}
+			}
+		}
+
+		// Decode and transcode the images on worker threads
+		std::atomic<size_t> next_job = 0;
+		std::mutex decoded_jobs_mutex;
+		std::condition_variable decoded_jobs_cv;
+		std::vector<size_t> decoded_jobs;
+
+		auto worker = [&](std::stop_token stop) {
+			while (not stop.stop_requested())
+			{
+				size_t job_id = next_job++;
+				if (job_id >= jobs.size())
+					return;
+
+				decode_job & job = jobs[job_id];
+				for (auto [index, image_data]: job.candidates)
+				{
+					decoded_source & source = sources.at({index, job.srgb});
+					std::unique_lock lock{source.mutex};
+					if (not source.decoded)
+					{
+						try
+						{
+							source.image = decode_image(index, image_data, texture_cache, job.srgb);
+							source.valid = true;
+						}
+						catch (std::exception & e)
+						{
+							source.error = e.what();
+						}
+						source.decoded = true;
+					}
+
+					if (source.valid)
+					{
+						job.source = &source;
+						break;
+					}
+					job.errors.push_back(std::format("Cannot load image {}: {}", index, source.error));
+				}
+
+				std::unique_lock lock{decoded_jobs_mutex};
+				decoded_jobs.push_back(job_id);
+				decoded_jobs_cv.notify_one();
+			}
+		};
+
+		// Declared after the shared state so that the threads are stopped and joined first if an exception is thrown
+		std::vector<std::jthread> workers;
+		for (size_t i = 0, n = std::min<size_t>(std::max(num_threads, 1u), jobs.size()); i < n; i++)
+		{
+			auto & thread = workers.emplace_back(worker);
+			pthread_setname_np(thread.native_handle(), "texture_decode");
+		}
+
+		// Upload the decoded images in batches, to limit both the number of queue submissions
+		// and the memory held by decoded images
+		const size_t max_batch_size = 64 * 1024 * 1024;
+		std::vector<decoded_source *> batch;
+		size_t batch_size = 0;
+
+		size_t nb_decoded = 0;
+		size_t nb_uploaded = 0;
+		auto report_progress = [&]() {
+			if (progress_cb)
+				progress_cb(float(nb_decoded + nb_uploaded) / (2 * jobs.size()));
+		};
+
+		auto upload_batch = [&]() {
+			std::vector<decoded_image> images;
+			images.reserve(batch.size());
+			for (decoded_source * source: batch)
+			{
+				// Workers may still be checking whether the source is decoded
+				std::unique_lock lock{source->mutex};
+				images.push_back(std::move(*source->image));
+				source->image.reset();
+			}
+
+			auto loaded_images = loader.upload(images);
+
+			for (auto && [source, decoded, image]: std::views::zip(batch, images, loaded_images))
+			{
+				spdlog::debug("{}: {}x{}, format {}, {} mipmaps", decoded.name, image.extent.width, image.extent.height, vk::to_string(image.format), image.num_mipmaps);
+
+				auto image_ptr = std::make_shared<loaded_image>(std::move(image));
+				source->image_view = std::shared_ptr<vk::raii::ImageView>(image_ptr, &image_ptr->image_view);
+			}
+
+			nb_uploaded += batch.size();
+			batch.clear();
+			batch_size = 0;
+			report_progress();
+		};
+
+		while (nb_decoded < jobs.size())
+		{
+			std::vector<size_t> newly_decoded;
+			{
+				std::unique_lock lock{decoded_jobs_mutex};
+				decoded_jobs_cv.wait(lock, [&]() { return not decoded_jobs.empty(); });
+				std::swap(newly_decoded, decoded_jobs);
+			}
+
+			for (size_t job_id: newly_decoded)
+			{
+				nb_decoded++;
+
+				decode_job & job = jobs[job_id];
+				if (not job.source)
+				{
+					spdlog::error("{}: cannot load texture:", name);
+					for (auto & error: job.errors)
+						spdlog::error("    {}", error);
+
+					throw std::runtime_error("Unsupported image type");
+				}
+
+				// Another job already uploads this image
+				if (std::exchange(job.source->queued, true))
+				{
+					nb_uploaded++;
+					continue;
 				}
+
+				batch.push_back(job.source);
+				std::unique_lock lock{job.source->mutex};
+				batch_size += job.source->image->byte_size();
 			}
 
-			spdlog::error("{}: cannot load texture {}:", name, name);
-			for (auto & error: errors)
-				spdlog::error("    {}", error);
+			report_progress();
 
-			throw std::runtime_error("Unsupported image type");
+			if (not batch.empty() and (batch_size >= max_batch_size or nb_decoded == jobs.size()))
+				upload_batch();
 		}
 
+		for (auto && [texture, job_id]: std::views::zip(textures, texture_jobs))
+			texture->image_view = jobs[job_id].source->image_view;
+
 		return textures;
 	}
 
@@ -885,8 +1235,119 @@ public:
 		return materials;
 	}
 
-	std::vector<std::shared_ptr<renderer::mesh>> load_all_meshes(std::vector<std::shared_ptr<renderer::material>> & materials, gpu_buffer & staging_buffer)
+	// Index and vertex data of a primitive, its layout must already be known
+	void load_primitive_data(const fastgltf::Primitive & gltf_primitive, renderer::primitive & primitive_ref, gpu_buffer & staging_buffer)
+	{
+		if (gltf_primitive.indicesAccessor)
+		{
+			fastgltf::Accessor & indices_accessor = gltf.accessors.at(*gltf_primitive.indicesAccessor);
+
+			primitive_ref.indexed = true;
+			std::tie(primitive_ref.index_offset, primitive_ref.index_type) = staging_buffer.add_indices(indices_accessor);
+			primitive_ref.index_count = indices_accessor.count;
+		}
+		else
+			primitive_ref.indexed = false;
+
+		auto [vertex_count, buffers] = create_vertex_buffers(primitive_ref.layout, gltf, gltf_primitive);
+		primitive_ref.vertex_count = vertex_count;
+
+		for (auto & buffer: buffers)
+			primitive_ref.vertex_offset.push_back(staging_buffer.add_vertices(buffer));
+
+		// Compute the OBB
+		glm::vec3 obb_min{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+		glm::vec3 obb_max = -obb_min;
+		fastgltf::iterateAccessor<glm::vec3>(gltf, gltf.accessors.at(gltf_primitive.findAttribute("POSITION")->accessorIndex), [&](glm::vec3 position) {
+			obb_min.x = std::min(obb_min.x, position.x);
+			obb_min.y = std::min(obb_min.y, position.y);
+			obb_min.z = std::min(obb_min.z, position.z);
+			obb_max.x = std::max(obb_max.x, position.x);
+			obb_max.y = std::max(obb_max.y, position.y);
+			obb_max.z = std::max(obb_max.z, position.z);
+		});
+		primitive_ref.obb_min = obb_min;
+		primitive_ref.obb_max = obb_max;
+	}
+
+	void write_primitive_data(geometry_cache_writer & writer, const renderer::primitive & primitive_ref, const gpu_buffer & staging_buffer)
+	{
+		writer.write_string(primitive_ref.vertex_shader);
+		writer.write_layout(primitive_ref.layout);
+		writer.write<uint8_t>(primitive_ref.indexed);
+		if (primitive_ref.indexed)
+		{
+			writer.write(primitive_ref.index_type);
+			writer.write(primitive_ref.index_count);
+			writer.write_bytes(staging_buffer.data(primitive_ref.index_offset, primitive_ref.index_count * index_size(primitive_ref.index_type)));
+		}
+
+		writer.write(primitive_ref.vertex_count);
+		writer.write(primitive_ref.obb_min);
+		writer.write(primitive_ref.obb_max);
+
+		auto sizes = vertex_buffer_sizes(primitive_ref.layout, primitive_ref.vertex_count);
+		writer.write<uint32_t>(sizes.size());
+		for (auto && [offset, size]: std::views::zip(primitive_ref.vertex_offset, sizes))
+		{
+			writer.write<uint64_t>(size);
+			writer.write_bytes(staging_buffer.data(offset, size));
+		}
+	}
+
+	void read_primitive_data(geometry_cache_reader & reader, const fastgltf::Primitive & gltf_primitive, renderer::primitive & primitive_ref, gpu_buffer & staging_buffer)
+	{
+		// The layout depends on the vertex shader, which can be overridden by the HMD traits
+		if (reader.read_string() != primitive_ref.vertex_shader)
+			throw geometry_cache_error("vertex shader mismatch");
+
+		// The converted data depends on the formats and offsets of the attributes, not only on the strides
+		if (reader.read_layout() != primitive_ref.layout)
+			throw geometry_cache_error("vertex layout mismatch");
+
+		primitive_ref.indexed = reader.read<uint8_t>();
+		if (primitive_ref.indexed != gltf_primitive.indicesAccessor.has_value())
+			throw geometry_cache_error("index buffer mismatch");
+
+		if (primitive_ref.indexed)
+		{
+			primitive_ref.index_type = reader.read<vk::IndexType>();
+			primitive_ref.index_count = reader.read<uint32_t>();
+			auto indices = reader.read_bytes(primitive_ref.index_count * index_size(primitive_ref.index_type));
+			primitive_ref.index_offset = staging_buffer.add_indices(indices, primitive_ref.index_type);
+		}
+
+		primitive_ref.vertex_count = reader.read<uint32_t>();
+		primitive_ref.obb_min = reader.read<glm::vec3>();
+		primitive_ref.obb_max = reader.read<glm::vec3>();
+
+		auto sizes = vertex_buffer_sizes(primitive_ref.layout, primitive_ref.vertex_count);
+		if (reader.read<uint32_t>() != sizes.size())
+			throw geometry_cache_error("vertex buffer count mismatch");
+
+		for (size_t size: sizes)
+		{
+			if (reader.read<uint64_t>() != size)
+				throw geometry_cache_error("vertex buffer size mismatch");
+
+			primitive_ref.vertex_offset.push_back(staging_buffer.add_vertices(reader.read_bytes(size)));
+		}
+	}
+
+	// If cache_reader is set, the index and vertex data are read from it instead of the glTF accessors.
+	// If cache_writer is set, the converted data is written to it.
+	std::vector<std::shared_ptr<renderer::mesh>> load_all_meshes(
+	        std::vector<std::shared_ptr<renderer::material>> & materials,
+	        gpu_buffer & staging_buffer,
+	        geometry_cache_reader * cache_reader,
+	        geometry_cache_writer * cache_writer)
 	{
+		if (cache_reader and cache_reader->read<uint32_t>() != gltf.meshes.size())
+			throw geometry_cache_error("mesh count mismatch");
+
+		if (cache_writer)
+			cache_writer->write<uint32_t>(gltf.meshes.size());
+
 		std::vector<std::shared_ptr<renderer::mesh>> meshes;
 		meshes.reserve(gltf.meshes.size());
 		for (const fastgltf::Mesh & gltf_mesh: gltf.meshes)
@@ -897,21 +1358,16 @@ public:
 
 			mesh_ref->primitives.reserve(gltf_mesh.primitives.size());
 
+			if (cache_reader and cache_reader->read<uint32_t>() != gltf_mesh.primitives.size())
+				throw geometry_cache_error("primitive count mismatch");
+
+			if (cache_writer)
+				cache_writer->write<uint32_t>(gltf_mesh.primitives.size());
+
 			for (const fastgltf::Primitive & gltf_primitive: gltf_mesh.primitives)
 			{
 				auto & primitive_ref = mesh_ref->primitives.emplace_back();
 
-				if (gltf_primitive.indicesAccessor)
-				{
-					fastgltf::Accessor & indices_accessor = gltf.accessors.at(*gltf_primitive.indicesAccessor);
-
-					primitive_ref.indexed = true;
-					std::tie(primitive_ref.index_offset, primitive_ref.index_type) = staging_buffer.add_indices(indices_accessor);
-					primitive_ref.index_count = indices_accessor.count;
-				}
-				else
-					primitive_ref.indexed = false;
-
 				renderer::vertex_layout & layout = primitive_ref.layout;
 
 				if (auto it = extras.find({fastgltf::Category::Meshes, mesh_id, "vertex_shader"}); it != extras.end())
@@ -947,25 +1403,13 @@ public:
 					layout.add_vertex_attribute(semantic, input.format, binding, input.location, input.array_size);
 				}
 
-				auto [vertex_count, buffers] = create_vertex_buffers(layout, gltf, gltf_primitive);
-				primitive_ref.vertex_count = vertex_count;
-
-				for (auto & buffer: buffers)
-					primitive_ref.vertex_offset.push_back(staging_buffer.add_vertices(buffer));
-
-				// Compute the OBB
-				glm::vec3 obb_min{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
-				glm::vec3 obb_max = -obb_min;
-				fastgltf::iterateAccessor<glm::vec3>(gltf, gltf.accessors.at(gltf_primitive.findAttribute("POSITION")->accessorIndex), [&](glm::vec3 position) {
-					obb_min.x = std::min(obb_min.x, position.x);
-					obb_min.y = std::min(obb_min.y, position.y);
-					obb_min.z = std::min(obb_min.z, position.z);
-					obb_max.x = std::max(obb_max.x, position.x);
-					obb_max.y = std::max(obb_max.y, position.y);
-					obb_max.z = std::max(obb_max.z, position.z);
-				});
-				primitive_ref.obb_min = obb_min;
-				primitive_ref.obb_max = obb_max;
+				if (cache_reader)
+					read_primitive_data(*cache_reader, gltf_primitive, primitive_ref, staging_buffer);
+				else
+					load_primitive_data(gltf_primitive, primitive_ref, staging_buffer);
+
+				if (cache_writer)
+					write_primitive_data(*cache_writer, primitive_ref, staging_buffer);
 
 				if (gltf_primitive.materialIndex)
 					primitive_ref.material_ = materials.at(*gltf_primitive.materialIndex);
@@ -1158,7 +1602,8 @@ scene_loader::scene_loader(vk::raii::Device & device, vk::raii::PhysicalDevice p
         queue(queue),
         queue_family_index(queue_family_index),
         default_material(default_material),
-        texture_cache(std::move(texture_cache_))
+        texture_cache(std::move(texture_cache_)),
+        decode_threads(std::max(1u, std::thread::hardware_concurrency()))
 {
 	clear_texture_cache();
 }
@@ -1199,13 +1644,53 @@ std::shared_ptr<entt::registry> scene_loader::operator()(
 	gpu_buffer staging_buffer(physical_device, asset);
 
 	// Load all textures
-	auto textures = ctx.load_all_textures(gltf_texture_cache, progress_cb);
+	auto textures = ctx.load_all_textures(gltf_texture_cache, progress_cb, decode_threads);
 
 	// Load all materials
 	auto materials = ctx.load_all_materials(textures, staging_buffer, *default_material);
 
-	// Load all meshes
-	auto meshes = ctx.load_all_meshes(materials, staging_buffer);
+	// Load all meshes, from the geometry cache if possible
+	std::vector<std::shared_ptr<renderer::mesh>> meshes;
+	std::filesystem::path geometry_cache = gltf_texture_cache.empty() ? "" : gltf_texture_cache / "geometry.bin";
+	bool geometry_cache_valid = false;
+
+	if (geometry_cache != "" and std::filesystem::exists(geometry_cache))
+	{
+		try
+		{
+			geometry_cache_reader reader{geometry_cache};
+			meshes = ctx.load_all_meshes(materials, staging_buffer, &reader, nullptr);
+			geometry_cache_valid = true;
+		}
+		catch (std::exception & e)
+		{
+			// Data already added to the staging buffer is wasted, but this only happens once per cache entry
+			spdlog::warn("Cannot load cached geometry {}: {}, deleting it", geometry_cache.native(), e.what());
+			std::error_code ec;
+			std::filesystem::remove(geometry_cache, ec);
+		}
+	}
+
+	if (not geometry_cache_valid)
+	{
+		std::optional<geometry_cache_writer> writer;
+		if (geometry_cache != "")
+			writer.emplace();
+
+		meshes = ctx.load_all_meshes(materials, staging_buffer, nullptr, writer ? &*writer : nullptr);
+
+		if (writer)
+		{
+			try
+			{
+				writer->save(geometry_cache);
+			}
+			catch (std::exception & e)
+			{
+				spdlog::warn("Cannot save geometry cache {}: {}", geometry_cache.native(), e.what());
+			}
+		}
+	}
 
 	// Load all nodes
 	auto loaded_scene = std::make_shared<entt::registry>();
@@ -1391,3 +1876,39 @@ void scene_loader::clear_texture_cache()
 		// Ignore errors if the texture cache directory does not exist
 	}
 }
+
+void scene_loader::benchmark(const std::filesystem::path & gltf_path, int iterations)
+{
+	utils::mapped_file gltf_file(gltf_path);
+
+	unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> thread_counts;
+	for (unsigned int n = 1; n < max_threads; n *= 2)
+		thread_counts.push_back(n);
+	thread_counts.push_back(max_threads);
+
+	unsigned int saved_decode_threads = decode_threads;
+
+	spdlog::info("Benchmarking scene loader with {}, {} iteration(s)", gltf_path.native(), iterations);
+	for (unsigned int n: thread_counts)
+	{
+		decode_threads = n;
+
+		std::chrono::duration<double, std::milli> min_duration{std::numeric_limits<double>::max()};
+		std::chrono::duration<double, std::milli> total_duration{0};
+		for (int i = 0; i < iterations; i++)
+		{
+			// Bypass the texture cache so that every texture is decoded and transcoded
+			auto t0 = std::chrono::steady_clock::now();
+			(*this)(gltf_file, gltf_path.filename(), gltf_path.parent_path());
+			auto duration = std::chrono::steady_clock::now() - t0;
+
+			min_duration = std::min<std::chrono::duration<double, std::milli>>(min_duration, duration);
+			total_duration += duration;
+		}
+
+		spdlog::info("    {:2} thread(s): min {:.1f} ms, average {:.1f} ms", n, min_duration.count(), total_duration.count() / iterations);
+	}
+
+	decode_threads = saved_decode_threads;
+}
@@ -34,6 +34,7 @@ class scene_loader
 	uint32_t queue_family_index;
 	std::shared_ptr<renderer::material> default_material;
 	std::filesystem::path texture_cache;
+	unsigned int decode_threads;
 
 	std::shared_ptr<entt::registry> operator()(
 	        std::span<const std::byte> data,
@@ -58,4 +59,7 @@ public:
 	        std::function<void(float)> progress_cb = {});
 
 	void clear_texture_cache();
+
+	// Load a scene with an increasing number of texture decoding threads and log the load times
+	void benchmark(const std::filesystem::path & gltf_path, int iterations = 5);
 };
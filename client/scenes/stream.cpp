@@ -34,12 +34,14 @@
 #include "audio/audio.h"
 #include "boost/pfr/core.hpp"
 #include "decoder/shard_accumulator.h"
+#include "depth_packing.h"
 #include "inplace_vector.hpp"
 #include "spdlog/spdlog.h"
 #include "utils/named_thread.h"
 #include "utils/ranges.h"
 #include "wivrn_packets.h"
 #include <algorithm>
+#include <limits>
 #include <mutex>
 #include <ranges>
 #include <thread>
@@ -212,10 +214,10 @@ static from_headset::visibility_mask_changed::masks get_visibility_mask(xr::inst
 
 std::shared_ptr<scenes::stream> scenes::stream::create(std::unique_ptr<wivrn_session> network_session, float guessed_fps, std::string server_name, scene & parent_scene)
 {
-	std::shared_ptr<stream> self{new stream{std::move(server_name), parent_scene}};
+	std::shared_ptr<stream> self{new stream{std::move(server_name), parent_scene}, &stream::destroy};
 	self->network_session = std::move(network_session);
 
-	self->network_session->send_control([&]() {
+	self->headset_info = [&]() {
 		from_headset::headset_info_packet info{
 		        .language = application::get_messages_info().language,
 		        .country = application::get_messages_info().country,
@@ -322,6 +324,7 @@ std::shared_ptr<scenes::stream> scenes::stream::create(std::unique_ptr<wivrn_ses
 
 		info.palm_pose = application::space(xr::spaces::palm_left) or application::space(xr::spaces::palm_right);
 		info.passthrough = self->system.passthrough_supported() != xr::passthrough_type::none;
+		info.composition_layer_depth = self->instance.has_extension(XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME);
 		info.system_name = std::string(self->system.properties().systemName);
 
 		audio::get_audio_description(info);
@@ -345,46 +348,18 @@ std::shared_ptr<scenes::stream> scenes::stream::create(std::unique_ptr<wivrn_ses
 			info.supported_codecs = decoder::supported_codecs();
 
 		return info;
-	}());
-
-	self->network_session->send_control(from_headset::session_state_changed{
-	        .state = application::get_session_state(),
-	});
-	self->network_session->send_control(from_headset::stream_tab_changed{
-	        .tab = self->gui_status,
-	});
-
-	if (self->instance.has_extension(XR_KHR_VISIBILITY_MASK_EXTENSION_NAME))
-	{
-		for (uint8_t view = 0; view < view_count; ++view)
-		{
-			try
-			{
-				self->network_session->send_control(from_headset::visibility_mask_changed{
-				        .data = get_visibility_mask(self->instance, self->session, view),
-				        .view_index = view});
-			}
-			catch (std::exception & e)
-			{
-				spdlog::warn("Failed to get visibility mask: ", e.what());
-			}
-		}
-	}
+	}();
+	self->network_session->send_control(from_headset::headset_info_packet{self->headset_info});
 
 	{
 		const auto & config = application::get_config();
 		self->override_foveation_enable = config.override_foveation_enable;
 		self->override_foveation_pitch = config.override_foveation_pitch;
 		self->override_foveation_distance = config.override_foveation_distance;
-
-		if (self->override_foveation_enable)
-			self->network_session->send_control(from_headset::override_foveation_center{
-			        .enabled = self->override_foveation_enable,
-			        .pitch = self->override_foveation_pitch,
-			        .distance = self->override_foveation_distance,
-			});
 	}
 
+	self->send_session_state();
+
 	self->network_thread = utils::named_thread("network_thread", &stream::process_packets, self.get());
 
 	self->command_buffer = std::move(self->device.allocateCommandBuffers({
@@ -573,6 +548,8 @@ void scenes::stream::on_focused()
 	{
 		session.set_performance_level(XR_PERF_SETTINGS_DOMAIN_CPU_EXT, XR_PERF_SETTINGS_LEVEL_SUSTAINED_HIGH_EXT);
 		session.set_performance_level(XR_PERF_SETTINGS_DOMAIN_GPU_EXT, XR_PERF_SETTINGS_LEVEL_SUSTAINED_HIGH_EXT);
+		// Shards of a frame arrive in bursts, keep the network thread awake between them
+		network_session->set_busy_poll(std::chrono::microseconds(200));
 	}
 	else
 	{
@@ -583,6 +560,7 @@ void scenes::stream::on_focused()
 
 void scenes::stream::on_unfocused()
 {
+	network_session->set_busy_poll(std::chrono::microseconds(0));
 	renderer->wait_idle(); // Must be before the scene data because the renderer uses its descriptor sets;
 	world.clear();
 	input.reset();
@@ -593,6 +571,49 @@ void scenes::stream::on_unfocused()
 	imgui_ctx.reset();
 }
 
+void scenes::stream::send_session_state()
+{
+	network_session->send_control(from_headset::session_state_changed{
+	        .state = application::get_session_state(),
+	});
+	network_session->send_control(from_headset::stream_tab_changed{
+	        .tab = gui_status,
+	});
+
+	if (instance.has_extension(XR_KHR_VISIBILITY_MASK_EXTENSION_NAME))
+	{
+		for (uint8_t view = 0; view < view_count; ++view)
+		{
+			try
+			{
+				network_session->send_control(from_headset::visibility_mask_changed{
+				        .data = get_visibility_mask(instance, session, view),
+				        .view_index = view});
+			}
+			catch (std::exception & e)
+			{
+				spdlog::warn("Failed to get visibility mask: ", e.what());
+			}
+		}
+	}
+
+	if (override_foveation_enable)
+		network_session->send_control(from_headset::override_foveation_center{
+		        .enabled = override_foveation_enable,
+		        .pitch = override_foveation_pitch,
+		        .distance = override_foveation_distance,
+		});
+}
+
+void scenes::stream::destroy(stream * self)
+{
+	// The destructor joins the decoder workers, which may drop the last reference
+	if (shard_accumulator::on_worker_thread())
+		utils::named_thread("stream_destroy", [self]() { delete self; }).detach();
+	else
+		delete self;
+}
+
 scenes::stream::~stream()
 {
 	exit();
@@ -650,14 +671,21 @@ std::array<std::shared_ptr<shard_accumulator::blit_handle>, 3> scenes::stream::c
 	if (decoders.empty())
 		return {};
 	std::unique_lock lock(frames_mutex);
+
+	// Foveation parameters are sent on the control socket and may arrive after the frame,
+	// such frames are kept until they can be defoveated
+	auto has_foveation = [this](const shard_accumulator::blit_handle & frame, size_t view) {
+		return bool(get_foveation_parameters(frame.view_info.foveation[view]));
+	};
+
 	inplace_vector<shard_accumulator::blit_handle *, decoder_count> common_frames;
-	const bool alpha = decoders[0].latest_frames[0] and decoders[0].latest_frames[0]->view_info.alpha;
-	for (size_t i = 0; i < view_count + alpha; ++i)
+	const bool alpha_or_depth = decoders[0].latest_frames[0] and (decoders[0].latest_frames[0]->view_info.alpha or decoders[0].latest_frames[0]->view_info.depth);
+	for (size_t i = 0; i < view_count + alpha_or_depth; ++i)
 	{
 		if (i == 0)
 		{
 			for (const auto & h: decoders[i].latest_frames)
-				if (h)
+				if (h and has_foveation(*h, 0) and has_foveation(*h, 1))
 					common_frames.push_back(h.get());
 		}
 		else
@@ -717,12 +745,13 @@ std::array<std::shared_ptr<shard_accumulator::blit_handle>, 3> scenes::stream::c
 			{
 				auto min = std::ranges::min_element(decoder.latest_frames,
 				                                    std::ranges::less{},
-				                                    [display_time](auto frame) {
-					                                    if (not frame)
+				                                    [&](auto frame) {
+					                                    if (not frame or (i < view_count and not has_foveation(*frame, i)))
 						                                    return std::numeric_limits<XrTime>::max();
 					                                    return std::abs(frame->view_info.display_time - display_time);
 				                                    });
-				result[i] = *min;
+				if (*min and (i >= view_count or has_foveation(**min, i)))
+					result[i] = *min;
 			}
 		}
 	}
@@ -898,17 +927,21 @@ void scenes::stream::render(const XrFrameState & frame_state)
 	current_blit_handles = common_frame(frame_state.predictedDisplayTime);
 	std::array<XrPosef, view_count> pose;
 	std::array<XrFovf, view_count> fov;
-	std::array<wivrn::to_headset::foveation_parameter, view_count> foveation;
+	// Missing views or parameters give an empty image
+	static const auto no_foveation = std::make_shared<const wivrn::to_headset::foveation_parameter_set>();
+	std::array<std::shared_ptr<const wivrn::to_headset::foveation_parameter_set>, view_count> foveation;
+	foveation.fill(no_foveation);
 	bool use_alpha = false;
+	bool use_depth = false;
 
 	std::array<stream_defoveator::input, view_count> images;
-	for (size_t i = 0; i < view_count + use_alpha; ++i)
+	for (size_t i = 0; i < view_count + (use_alpha or use_depth); ++i)
 	{
 		auto & blit_handle = current_blit_handles[i];
 		if (not blit_handle)
 		{
 			if (i == view_count)
-				use_alpha = false;
+				use_alpha = use_depth = false;
 			continue;
 		}
 
@@ -919,6 +952,8 @@ void scenes::stream::render(const XrFrameState & frame_state)
 		blit_handle->feedback.displayed = frame_state.predictedDisplayTime;
 
 		use_alpha = blit_handle->view_info.alpha;
+		// The server only sends depth if the runtime supports depth layers
+		use_depth = blit_handle->view_info.depth and depth_format != vk::Format::eUndefined;
 
 		if (blit_handle->current_layout == vk::ImageLayout::eUndefined)
 		{
@@ -941,7 +976,10 @@ void scenes::stream::render(const XrFrameState & frame_state)
 
 		if (i < view_count)
 		{
-			foveation[i] = blit_handle->view_info.foveation[i];
+			if (auto params = get_foveation_parameters(blit_handle->view_info.foveation[i]))
+				foveation[i] = std::move(params);
+			else
+				spdlog::warn("Unknown foveation parameters {}", blit_handle->view_info.foveation[i]);
 			pose[i] = blit_handle->view_info.pose[i];
 			fov[i] = blit_handle->view_info.fov[i];
 			// colour image
@@ -972,6 +1010,19 @@ void scenes::stream::render(const XrFrameState & frame_state)
 				        },
 				};
 				images[j].layout_a = blit_handle->current_layout;
+				images[j].alpha = use_alpha;
+				if (use_depth)
+					images[j].rect_depth = vk::Rect2D{
+					        // in full size pixels, below alpha
+					        .offset = {
+					                .x = j * video_stream_description->width,
+					                .y = int32_t(blit_handle->extent.height),
+					        },
+					        .extent = {
+					                .width = blit_handle->extent.width * 2,
+					                .height = blit_handle->extent.height * 2,
+					        },
+					};
 			}
 		}
 	}
@@ -987,12 +1038,14 @@ void scenes::stream::render(const XrFrameState & frame_state)
 			int32_t max_height = 0;
 			for (size_t i = 0; i < view_count; ++i)
 			{
-				extents[i] = stream_defoveator::defoveated_size(foveation[i]);
+				extents[i] = stream_defoveator::defoveated_size(foveation[i]->parameter);
 				max_width = std::max(max_width, extents[i].width);
 				max_height = std::max(max_height, extents[i].height);
 			}
 			if (not swapchain)
-				setup_reprojection_swapchain(max_width, max_height);
+				setup_reprojection_swapchain(max_width, max_height, use_depth);
+			else if (use_depth and not depth_swapchain)
+				setup_reprojection_swapchain(std::max(max_width, swapchain.width()), std::max(max_height, swapchain.height()), true);
 			else if (swapchain.width() < max_width or swapchain.height() < max_height)
 			{
 				// If the defoveated image is larger than the swapchain, try to reallocate one
@@ -1003,7 +1056,7 @@ void scenes::stream::render(const XrFrameState & frame_state)
 					             swapchain.height(),
 					             max_width,
 					             max_height);
-					setup_reprojection_swapchain(max_width, max_height);
+					setup_reprojection_swapchain(max_width, max_height, bool(depth_swapchain));
 				}
 				catch (std::exception & e)
 				{
@@ -1020,6 +1073,12 @@ void scenes::stream::render(const XrFrameState & frame_state)
 		// defoveate the image, apply scale/bias
 		int image_index = swapchain.acquire();
 		swapchain.wait();
+		int depth_image_index = -1;
+		if (use_depth)
+		{
+			depth_image_index = depth_swapchain.acquire();
+			depth_swapchain.wait();
+		}
 
 		switch (gui_status)
 		{
@@ -1048,7 +1107,8 @@ void scenes::stream::render(const XrFrameState & frame_state)
 		                      images,
 		                      {scale, scale, scale, 1.},
 		                      {bias, bias, bias, 0.},
-		                      image_index);
+		                      image_index,
+		                      depth_image_index);
 
 		command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *query_pool, 1);
 
@@ -1083,6 +1143,8 @@ void scenes::stream::render(const XrFrameState & frame_state)
 		renderdoc_end(*vk_instance);
 #endif
 		swapchain.release();
+		if (use_depth)
+			depth_swapchain.release();
 
 		if (use_alpha)
 			session.enable_passthrough(system);
@@ -1111,10 +1173,31 @@ void scenes::stream::render(const XrFrameState & frame_state)
 			                },
 			        };
 		}
+		// The depth of the stream lets the runtime correct head translation
+		std::array<XrCompositionLayerDepthInfoKHR, view_count> layer_depth;
+		for (uint32_t view = 0; view < view_count; view++)
+		{
+			layer_depth[view] = {
+			        .type = XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR,
+			        .subImage = {
+			                .swapchain = depth_swapchain,
+			                .imageRect = {
+			                        .offset = {0, 0},
+			                        .extent = extents[view],
+			                },
+			                .imageArrayIndex = view,
+			        },
+			        .minDepth = 0,
+			        .maxDepth = 1,
+			        .nearZ = std::numeric_limits<float>::infinity(),
+			        .farZ = wivrn::depth_packing::near_plane,
+			};
+		}
 		add_projection_layer(
 		        use_alpha ? XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT : 0,
 		        application::space(xr::spaces::world),
-		        layer_view);
+		        layer_view,
+		        use_depth ? std::span<XrCompositionLayerDepthInfoKHR>(layer_depth) : std::span<XrCompositionLayerDepthInfoKHR>());
 
 		if (const configuration::openxr_post_processing_settings openxr_post_processing = application::get_config().openxr_post_processing;
 		    (openxr_post_processing.sharpening | openxr_post_processing.super_sampling) > 0)
@@ -1139,26 +1222,20 @@ void scenes::stream::render(const XrFrameState & frame_state)
 
 	// Network operations may be blocking, do them once everything was submitted
 	{
-		// Keep a copy of the feedback packets as they can be modified if they're encrypted
 		inplace_vector<from_headset::feedback, decoder_count> feedbacks;
-		inplace_vector<serialization_packet, decoder_count> packets;
-
 		feedbacks.reserve(current_blit_handles.size());
-		packets.reserve(current_blit_handles.size());
 
 		for (const auto & handle: current_blit_handles)
 		{
 			if (handle)
-			{
-				auto & packet = packets.emplace_back();
-				wivrn_session::control_socket_t::serialize(packet, feedbacks.emplace_back(handle->feedback));
-			}
+				feedbacks.push_back(handle->feedback);
 		}
-		if (not packets.empty())
+		if (not feedbacks.empty())
 		{
 			try
 			{
-				network_session->send_control(std::span(packets));
+				// One packet for all streams, with the previous frames in case it is lost
+				network_session->send_stream(feedback_sender.push(feedbacks));
 			}
 			catch (std::exception & e)
 			{
@@ -1208,6 +1285,8 @@ void scenes::stream::setup(const to_headset::video_stream_description & descript
 	spdlog::info("setup, refresh rate {}", description.refresh_rate);
 	session.set_refresh_rate(description.refresh_rate);
 
+	// Decoder threads may be waiting for decoder_mutex, destroy the previous decoders after releasing it
+	decltype(decoders) old_decoders;
 	std::unique_lock lock(decoder_mutex);
 	if (video_stream_description == description)
 		return;
@@ -1216,6 +1295,7 @@ void scenes::stream::setup(const to_headset::video_stream_description & descript
 
 	for (const auto & [stream_index, item]: utils::enumerate(decoders))
 	{
+		old_decoders[stream_index] = std::move(item);
 		item = accumulator_images{
 		        .decoder = std::make_unique<shard_accumulator>(device, physical_device, instance, queue_family_index, description, shared_from_this(), stream_index),
 		};
@@ -1225,7 +1305,7 @@ void scenes::stream::setup(const to_headset::video_stream_description & descript
 		defoveator->reset_pipelines();
 }
 
-void scenes::stream::setup_reprojection_swapchain(uint32_t swapchain_width, uint32_t swapchain_height)
+void scenes::stream::setup_reprojection_swapchain(uint32_t swapchain_width, uint32_t swapchain_height, bool depth)
 {
 	assert(swapchain_width);
 	assert(swapchain_height);
@@ -1243,6 +1323,16 @@ void scenes::stream::setup_reprojection_swapchain(uint32_t swapchain_width, uint
 			spdlog::warn("Swapchain size larger than maximum {}x{}", view.maxImageRectWidth, view.maxImageRectHeight);
 	}
 
+	std::vector<vk::Image> depth_images;
+	if (depth)
+	{
+		depth_swapchain = xr::swapchain(instance, session, device, depth_format, swapchain.width(), swapchain.height(), 1, views.size());
+		spdlog::info("Created stream depth swapchain: {}", magic_enum::enum_name(depth_format));
+		depth_images = depth_swapchain.images();
+	}
+	else
+		depth_swapchain = xr::swapchain();
+
 	spdlog::info("Initializing reprojector");
 	vk::Extent2D extent = {(uint32_t)swapchain.width(), (uint32_t)swapchain.height()};
 
@@ -1251,7 +1341,9 @@ void scenes::stream::setup_reprojection_swapchain(uint32_t swapchain_width, uint
 	        physical_device,
 	        swapchain.images(),
 	        extent,
-	        swapchain.format());
+	        swapchain.format(),
+	        std::move(depth_images),
+	        depth_format);
 }
 
 scene::meta & scenes::stream::get_meta_scene()
@@ -22,6 +22,7 @@
 #include "app_launcher.h"
 #include "audio/audio.h"
 #include "decoder/shard_accumulator.h"
+#include "feedback_batch.h"
 #include "render/imgui_impl.h"
 #include "scene.h"
 #include "scenes/input_profile.h"
@@ -31,6 +32,7 @@
 #include "wivrn_client.h"
 #include "wivrn_packets.h"
 #include "xr/space.h"
+#include <map>
 #include <mutex>
 #include <optional>
 #include <queue>
@@ -76,6 +78,8 @@ private:
 
 	std::unique_ptr<wivrn_session> network_session;
 	std::thread network_thread;
+	// Sent again when the session is resumed
+	from_headset::headset_info_packet headset_info;
 	thread_safe<to_headset::tracking_control> tracking_control{};
 	std::array<std::atomic<interaction_profile>, 3> interaction_profiles; // left hand, right hand, gamepad
 	std::atomic<bool> interaction_profile_changed = false;
@@ -118,6 +122,8 @@ private:
 	}
 
 	xr::swapchain swapchain;
+	// Receives the depth of the stream when the server sends it
+	xr::swapchain depth_swapchain;
 
 	std::optional<audio> audio_handle;
 
@@ -166,6 +172,8 @@ private:
 
 	thread_safe<std::optional<gui_toast>> gui_toast;
 	std::atomic<XrTime> gui_status_last_change;
+	XrTime last_gui_refresh = 0;
+	float gui_gpu_time = 0;
 
 	thread_safe<std::queue<std::string>> stream_error_queue;
 
@@ -198,11 +206,20 @@ private:
 
 	// Keep a reference to the resources needed to blit the images until vkWaitForFences
 	std::array<std::shared_ptr<wivrn::shard_accumulator::blit_handle>, decoder_count> current_blit_handles;
+	// Render thread only
+	wivrn::feedback_batch_sender feedback_sender;
 
 	XrTime running_application_req = 0;
 	thread_safe<to_headset::running_applications> running_applications;
 
+	// Foveation parameters referenced by id in the video frames, only the
+	// last foveation_parameter_set::headset_history ids are kept
+	thread_safe<std::map<uint32_t, std::shared_ptr<const to_headset::foveation_parameter_set>>> foveation_parameters;
+	std::shared_ptr<const to_headset::foveation_parameter_set> get_foveation_parameters(uint32_t id);
+
 	stream(std::string server_name, scene & parent_scene);
+	// Deleter of the shared pointer returned by create
+	static void destroy(stream *);
 
 	bool forward_hid_input(from_headset::hid::input_t, bool device_enabled);
 
@@ -244,6 +261,7 @@ public:
 	void operator()(to_headset::application_list &&);
 	void operator()(to_headset::application_icon &&);
 	void operator()(to_headset::running_applications &&);
+	void operator()(to_headset::foveation_parameter_set &&);
 	void operator()(audio_data &&);
 
 	void push_blit_handle(wivrn::shard_accumulator * decoder, std::shared_ptr<wivrn::shard_accumulator::blit_handle> handle);
@@ -270,6 +288,8 @@ public:
 
 private:
 	void process_packets();
+	bool resume_session();
+	void send_session_state();
 	void tracking();
 	void read_actions();
 
@@ -277,7 +297,7 @@ private:
 	void send_derived_pose();
 
 	void setup(const to_headset::video_stream_description &);
-	void setup_reprojection_swapchain(uint32_t width, uint32_t height);
+	void setup_reprojection_swapchain(uint32_t width, uint32_t height, bool depth);
 
 	vk::raii::QueryPool query_pool = nullptr;
 	bool query_pool_filled = false;
@@ -285,6 +305,8 @@ private:
 	// Used for plots
 	uint64_t bytes_received = 0;
 	uint64_t bytes_sent = 0;
+	uint64_t packets_received = 0;
+	uint64_t network_wakeups = 0;
 	float bandwidth_rx = 0;
 	float bandwidth_tx = 0;
 
@@ -299,6 +321,8 @@ private:
 		float cpu_time = 0;
 		float bandwidth_rx = 0;
 		float bandwidth_tx = 0;
+		float gui_gpu_time = 0;
+		float packets_per_wakeup = 0;
 	};
 
 	struct plot
@@ -351,6 +375,7 @@ private:
 	void gui_foveation_settings(float predicted_display_period);
 	void gui_applications();
 	void gui_toasts();
+	void draw_gui_windows(XrTime predicted_display_time, XrDuration predicted_display_period, bool is_urgent);
 	void draw_gui(XrTime predicted_display_time, XrDuration predicted_display_period);
 };
 } // namespace scenes
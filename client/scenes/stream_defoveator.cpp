@@ -24,9 +24,11 @@
 #include "vk/pipeline.h"
 #include "vk/shader.h"
 #include "vk/specialization_constants.h"
+#include <algorithm>
 #include <array>
 #include <glm/glm.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <optional>
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan_core.h>
 #include <vulkan/vulkan_raii.hpp>
@@ -43,6 +45,7 @@ struct vert_pc
 {
 	glm::ivec4 rgb_rect;
 	glm::ivec4 a_rect;
+	glm::ivec4 depth_rect;
 	std::array<float, 4> scale;
 	std::array<float, 4> bias;
 };
@@ -50,7 +53,7 @@ struct vert_pc
 void stream_defoveator::ensure_vertices(size_t num_vertices)
 {
 	vk::BufferCreateInfo create_info{
-	        .size = num_vertices * sizeof(vertex) * view_count,
+	        .size = num_vertices * sizeof(vertex) * view_count * mesh_slots,
 	        .usage = vk::BufferUsageFlagBits::eVertexBuffer,
 	        .sharingMode = vk::SharingMode::eExclusive,
 	};
@@ -64,29 +67,34 @@ void stream_defoveator::ensure_vertices(size_t num_vertices)
 
 	buffer = buffer_allocation(device, create_info, alloc_info);
 	vertices_size = num_vertices * sizeof(vertex);
+	meshes = {};
 }
 
-stream_defoveator::vertex * stream_defoveator::get_vertices(size_t view)
+size_t stream_defoveator::vertices_offset(size_t view, size_t slot) const
+{
+	return (view * mesh_slots + slot) * vertices_size;
+}
+
+stream_defoveator::vertex * stream_defoveator::get_vertices(size_t view, size_t slot)
 {
 	assert(buffer);
-	return reinterpret_cast<vertex *>(reinterpret_cast<uintptr_t>(buffer.map()) + view * vertices_size);
+	return reinterpret_cast<vertex *>(reinterpret_cast<uintptr_t>(buffer.map()) + vertices_offset(view, slot));
 }
 
-stream_defoveator::pipeline_t & stream_defoveator::ensure_pipeline(size_t view, vk::Sampler rgb, vk::Sampler a)
+stream_defoveator::pipeline_t & stream_defoveator::ensure_pipeline(size_t view, vk::Sampler rgb, vk::Sampler a, bool alpha, bool depth)
 {
-	auto & target = a ? pipeline_a[view] : pipeline_rgb[view];
+	auto & target = pipelines[view][alpha | depth << 1];
 	if (*target.pipeline)
 		return target;
 
 	std::array samplers{rgb, a};
-	int32_t alpha = a ? 1 : 0;
 
 	// Create VkDescriptorSetLayout
 	std::array layout_binding{
 	        vk::DescriptorSetLayoutBinding{
 	                .binding = 0,
 	                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
-	                .descriptorCount = uint32_t(alpha + 1),
+	                .descriptorCount = alpha or depth ? 2u : 1u,
 	                .stageFlags = vk::ShaderStageFlagBits::eFragment,
 	                .pImmutableSamplers = samplers.data(),
 	        },
@@ -127,9 +135,19 @@ stream_defoveator::pipeline_t & stream_defoveator::ensure_pipeline(size_t view,
 	// Fragment shader
 	auto specialization = make_specialization_constants(
 	        int32_t(alpha),
-	        VkBool32(application::get_hmd_traits().needs_srgb_conversion));
+	        VkBool32(application::get_hmd_traits().needs_srgb_conversion),
+	        int32_t(depth));
 	auto fragment_shader = load_shader(device, "reprojection.frag");
 
+	// The depth test is only enabled to write depth
+	std::optional<vk::PipelineDepthStencilStateCreateInfo> depth_state;
+	if (depth)
+		depth_state = vk::PipelineDepthStencilStateCreateInfo{
+		        .depthTestEnable = true,
+		        .depthWriteEnable = true,
+		        .depthCompareOp = vk::CompareOp::eAlways,
+		};
+
 	vk::pipeline_builder pipeline_info{
 	        .flags = {},
 	        .Stages = {
@@ -178,13 +196,14 @@ stream_defoveator::pipeline_t & stream_defoveator::ensure_pipeline(size_t view,
 	        .MultisampleState = {{
 	                .rasterizationSamples = vk::SampleCountFlagBits::e1,
 	        }},
+	        .DepthStencilState = depth_state,
 	        .ColorBlendState = {.flags = {}},
 	        .ColorBlendAttachments = {{
 	                .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
 	        }},
 	        .DynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor},
 	        .layout = *target.layout,
-	        .renderPass = *renderpass,
+	        .renderPass = depth ? *renderpass_depth : *renderpass,
 	        .subpass = 0,
 	};
 
@@ -197,7 +216,9 @@ stream_defoveator::stream_defoveator(
         vk::raii::PhysicalDevice & physical_device,
         std::vector<vk::Image> output_images_,
         vk::Extent2D output_extent,
-        vk::Format format) :
+        vk::Format format,
+        std::vector<vk::Image> depth_images,
+        vk::Format depth_format) :
         device(device),
         physical_device(physical_device),
         output_images(std::move(output_images_)),
@@ -233,13 +254,38 @@ stream_defoveator::stream_defoveator(
 
 	renderpass = vk::raii::RenderPass(device, renderpass_info.get());
 
+	if (not depth_images.empty())
+	{
+		std::array attachments{
+		        attachment,
+		        vk::AttachmentDescription{
+		                .format = depth_format,
+		                .samples = vk::SampleCountFlagBits::e1,
+		                .loadOp = vk::AttachmentLoadOp::eDontCare,
+		                .storeOp = vk::AttachmentStoreOp::eStore,
+		                .finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+		        },
+		};
+		vk::AttachmentReference depth_ref{
+		        .attachment = 1,
+		        .layout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+		};
+		subpass.pDepthStencilAttachment = &depth_ref;
+		renderpass_depth = vk::raii::RenderPass(device, vk::RenderPassCreateInfo{
+		                                                        .attachmentCount = attachments.size(),
+		                                                        .pAttachments = attachments.data(),
+		                                                        .subpassCount = 1,
+		                                                        .pSubpasses = &subpass,
+		                                                });
+	}
+
 	vk::DescriptorPoolSize pool_size{
 	        .type = vk::DescriptorType::eCombinedImageSampler,
-	        .descriptorCount = view_count * 4,
+	        .descriptorCount = view_count * 8,
 	};
 
 	ds_pool = device.createDescriptorPool(vk::DescriptorPoolCreateInfo{
-	        .maxSets = view_count * 2,
+	        .maxSets = view_count * 4,
 	        .poolSizeCount = 1,
 	        .pPoolSizes = &pool_size,
 	});
@@ -283,14 +329,60 @@ stream_defoveator::stream_defoveator(
 			framebuffers.emplace_back(device, fb_create_info);
 		}
 	}
+
+	// Colour and depth swapchains are acquired independently, so any pair of images can be used
+	depth_image_views.reserve(depth_images.size() * view_count);
+	framebuffers_depth.reserve(output_images.size() * depth_images.size() * view_count);
+	for (auto image: depth_images)
+	{
+		for (uint32_t view = 0; view < view_count; ++view)
+		{
+			depth_image_views.emplace_back(
+			        device,
+			        vk::ImageViewCreateInfo{
+			                .image = image,
+			                .viewType = vk::ImageViewType::e2DArray,
+			                .format = depth_format,
+			                .subresourceRange = {
+			                        .aspectMask = vk::ImageAspectFlagBits::eDepth,
+			                        .baseMipLevel = 0,
+			                        .levelCount = 1,
+			                        .baseArrayLayer = view,
+			                        .layerCount = 1,
+			                },
+			        });
+		}
+	}
+
+	for (size_t i = 0; i < output_images.size(); ++i)
+	{
+		for (size_t j = 0; j < depth_images.size(); ++j)
+		{
+			for (uint32_t view = 0; view < view_count; ++view)
+			{
+				std::array attachments{
+				        *output_image_views[i * view_count + view],
+				        *depth_image_views[j * view_count + view],
+				};
+				vk::FramebufferCreateInfo fb_create_info{
+				        .renderPass = *renderpass_depth,
+				        .width = output_extent.width,
+				        .height = output_extent.height,
+				        .layers = 1,
+				};
+				fb_create_info.setAttachments(attachments);
+
+				framebuffers_depth.emplace_back(device, fb_create_info);
+			}
+		}
+	}
 }
 
 void stream_defoveator::reset_pipelines()
 {
-	for (auto & p: pipeline_rgb)
-		p = {};
-	for (auto & p: pipeline_a)
-		p = {};
+	for (auto & view: pipelines)
+		for (auto & p: view)
+			p = {};
 }
 
 static size_t required_vertices(const wivrn::to_headset::foveation_parameter & p)
@@ -303,44 +395,24 @@ static size_t required_vertices(const wivrn::to_headset::foveation_parameter & p
 	return (2 * (p.x.size() + 1) + 1) * p.y.size();
 }
 
-void stream_defoveator::defoveate(vk::raii::CommandBuffer & command_buffer,
-                                  const std::array<wivrn::to_headset::foveation_parameter, 2> & foveation,
-                                  const std::array<input, 2> & inputs,
-                                  std::array<float, 4> scale,
-                                  std::array<float, 4> bias,
-                                  int destination)
+size_t stream_defoveator::ensure_mesh(size_t view, const wivrn::to_headset::foveation_parameter_set & foveation)
 {
-	if (destination < 0 || destination >= (int)output_images.size())
-		throw std::runtime_error("Invalid destination image index");
-
-	ensure_vertices(std::max(required_vertices(foveation[0]), required_vertices(foveation[1])));
-
-	for (size_t view = 0; view < view_count; ++view)
+	auto & slots = meshes[view];
+	auto slot = std::ranges::find(slots, foveation.id, &mesh::id);
+	if (slot == slots.end())
 	{
-		const auto out_size = defoveated_size(foveation[view]);
-		auto vertices = get_vertices(view);
-		const auto & [px, py] = foveation[view];
+		// Replace the least recently used mesh
+		slot = std::ranges::min_element(slots, {}, &mesh::last_used);
+		slot->id = foveation.id;
+
+		const auto out_size = defoveated_size(foveation.parameter);
+		auto vertices = get_vertices(view, slot - slots.begin());
+		const auto & [px, py] = foveation.parameter;
 		assert(px.size() % 2 == 1);
 		assert(py.size() % 2 == 1);
 		const int n_ratio_y = (py.size() - 1) / 2;
 		const int n_ratio_x = (px.size() - 1) / 2;
 
-		command_buffer.setScissor(
-		        0,
-		        vk::Rect2D{
-		                .extent = {.width = uint32_t(out_size.width), .height = uint32_t(out_size.height)},
-		        });
-		command_buffer.setViewport(
-		        0,
-		        vk::Viewport{
-		                .x = 0,
-		                .y = 0,
-		                .width = float(out_size.width),
-		                .height = float(out_size.height),
-		                .minDepth = 0,
-		                .maxDepth = 1,
-		        });
-
 		glm::uvec2 in(0);
 		glm::vec2 out(-0.5 * out_size.width, -0.5 * out_size.height); // pixel coordinates
 		glm::vec2 out_pixel_size(2. / out_size.width,
@@ -381,20 +453,65 @@ void stream_defoveator::defoveate(vk::raii::CommandBuffer & command_buffer,
 			};
 		}
 	}
+	slot->last_used = frame_counter;
+	return slot - slots.begin();
+}
 
+void stream_defoveator::defoveate(vk::raii::CommandBuffer & command_buffer,
+                                  const std::array<std::shared_ptr<const wivrn::to_headset::foveation_parameter_set>, 2> & foveation,
+                                  const std::array<input, 2> & inputs,
+                                  std::array<float, 4> scale,
+                                  std::array<float, 4> bias,
+                                  int destination,
+                                  int depth_destination)
+{
+	if (destination < 0 || destination >= (int)output_images.size())
+		throw std::runtime_error("Invalid destination image index");
+	const size_t depth_image_count = depth_image_views.size() / view_count;
+	if (depth_destination >= (int)depth_image_count)
+		throw std::runtime_error("Invalid depth destination image index");
+
+	ensure_vertices(std::max(required_vertices(foveation[0]->parameter), required_vertices(foveation[1]->parameter)));
+	++frame_counter;
+
+	std::array<size_t, view_count> slot;
 	for (size_t view = 0; view < view_count; ++view)
 	{
+		slot[view] = ensure_mesh(view, *foveation[view]);
+
+		const auto out_size = defoveated_size(foveation[view]->parameter);
+		command_buffer.setScissor(
+		        0,
+		        vk::Rect2D{
+		                .extent = {.width = uint32_t(out_size.width), .height = uint32_t(out_size.height)},
+		        });
+		command_buffer.setViewport(
+		        0,
+		        vk::Viewport{
+		                .x = 0,
+		                .y = 0,
+		                .width = float(out_size.width),
+		                .height = float(out_size.height),
+		                .minDepth = 0,
+		                .maxDepth = 1,
+		        });
+	}
+
+	for (size_t view = 0; view < view_count; ++view)
+	{
+		const auto & input = inputs[view];
+		const bool depth = input.rect_depth.extent.width > 0 and depth_destination >= 0;
+
 		vk::RenderPassBeginInfo begin_info{
-		        .renderPass = *renderpass,
-		        .framebuffer = *framebuffers[destination * view_count + view],
+		        .renderPass = depth ? *renderpass_depth : *renderpass,
+		        .framebuffer = depth ? *framebuffers_depth[(destination * depth_image_count + depth_destination) * view_count + view] : *framebuffers[destination * view_count + view],
 		        .renderArea = {
 		                .offset = {0, 0},
 		                .extent = output_extent,
 		        },
 		};
 
-		const auto & input = inputs[view];
-		auto & pipeline = ensure_pipeline(view, input.sampler_rgb, input.sampler_a);
+		auto & pipeline = ensure_pipeline(view, input.sampler_rgb, input.sampler_a, input.alpha, depth);
 
 		std::array image_info{
 		        vk::DescriptorImageInfo{
@@ -413,7 +530,7 @@ void stream_defoveator::defoveate(vk::raii::CommandBuffer & command_buffer,
 		        vk::WriteDescriptorSet{
 		                .dstSet = pipeline.ds,
 		                .dstBinding = 0,
-		                .descriptorCount = input.sampler_a ? 2u : 1u,
+		                .descriptorCount = input.alpha or depth ? 2u : 1u,
 		                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
 		                .pImageInfo = image_info.data(),
 		        },
@@ -428,6 +545,10 @@ void stream_defoveator::defoveate(vk::raii::CommandBuffer & command_buffer,
 		                             input.rect_a.offset.y,
 		                             input.rect_a.extent.width,
 		                             input.rect_a.extent.height),
+		        .depth_rect = glm::ivec4(input.rect_depth.offset.x,
+		                                 input.rect_depth.offset.y,
+		                                 input.rect_depth.extent.width,
+		                                 input.rect_depth.extent.height),
 		        .scale = scale,
 		        .bias = bias,
 		};
@@ -438,8 +559,8 @@ void stream_defoveator::defoveate(vk::raii::CommandBuffer & command_buffer,
 		command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipeline.pipeline);
 		command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *pipeline.layout, 0, pipeline.ds, {});
 		command_buffer.pushConstants<vert_pc>(*pipeline.layout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, pc);
-		command_buffer.bindVertexBuffers(0, vk::Buffer(buffer), vertices_size * view);
-		command_buffer.draw(required_vertices(foveation[view]), 1, 0, 0);
+		command_buffer.bindVertexBuffers(0, vk::Buffer(buffer), vertices_offset(view, slot[view]));
+		command_buffer.draw(required_vertices(foveation[view]->parameter), 1, 0, 0);
 		command_buffer.endRenderPass();
 	}
 }
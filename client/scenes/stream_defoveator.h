@@ -21,6 +21,7 @@
 
 #include "vk/allocation.h"
 #include "wivrn_packets.h"
+#include <memory>
 #include <vulkan/vulkan_raii.hpp>
 #include <openxr/openxr.h>
 
@@ -28,15 +29,27 @@ class stream_defoveator
 {
 	struct vertex;
 	static const uint32_t view_count = 2;
-	// Vertex buffer
+	// Vertex buffer, mesh_slots meshes per view
+	static const size_t mesh_slots = 4;
 	buffer_allocation buffer;
 	size_t vertices_size = 0;
 
+	// Meshes are cached by foveation parameter id
+	struct mesh
+	{
+		uint32_t id = 0;
+		uint64_t last_used = 0;
+	};
+	std::array<std::array<mesh, mesh_slots>, view_count> meshes;
+	uint64_t frame_counter = 0;
+
 	vk::raii::Device & device;
 	vk::raii::PhysicalDevice & physical_device;
 
 	// Graphic pipeline
 	vk::raii::RenderPass renderpass = nullptr;
+	// Also writes depth, nullptr without depth images
+	vk::raii::RenderPass renderpass_depth = nullptr;
 	vk::raii::DescriptorPool ds_pool = nullptr;
 	struct pipeline_t
 	{
@@ -45,19 +58,24 @@ class stream_defoveator
 		vk::raii::PipelineLayout layout = nullptr;
 		vk::raii::Pipeline pipeline = nullptr;
 	};
-	pipeline_t pipeline_rgb[view_count];
-	pipeline_t pipeline_a[view_count];
+	// Indexed by alpha | depth << 1
+	pipeline_t pipelines[view_count][4];
 
 	// Destination images
 	std::vector<vk::Image> output_images;
 	std::vector<vk::raii::ImageView> output_image_views;
 	std::vector<vk::raii::Framebuffer> framebuffers;
+	std::vector<vk::raii::ImageView> depth_image_views;
+	std::vector<vk::raii::Framebuffer> framebuffers_depth;
 	vk::Extent2D output_extent;
 
 	void ensure_vertices(size_t num_vertices);
-	vertex * get_vertices(size_t view);
+	size_t vertices_offset(size_t view, size_t slot) const;
+	vertex * get_vertices(size_t view, size_t slot);
+	// Returns the slot where the mesh for the parameters is, builds it if needed
+	size_t ensure_mesh(size_t view, const wivrn::to_headset::foveation_parameter_set &);
 
-	pipeline_t & ensure_pipeline(size_t view, vk::Sampler rgb, vk::Sampler a);
+	pipeline_t & ensure_pipeline(size_t view, vk::Sampler rgb, vk::Sampler a, bool alpha, bool depth);
 
 public:
 	struct input
@@ -66,18 +84,26 @@ public:
 		vk::Sampler sampler_rgb;
 		vk::Rect2D rect_rgb;
 		vk::ImageLayout layout_rgb;
+		// Alpha and depth image
 		vk::ImageView a;
 		vk::Sampler sampler_a;
 		vk::Rect2D rect_a;
 		vk::ImageLayout layout_a;
+		bool alpha;
+		// Depth in the alpha image, see depth_packing.h, not used if empty
+		vk::Rect2D rect_depth;
 	};
 
+	// Depth images are optional, they receive the depth of the stream as
+	// a reversed Z projection with an infinite far plane
 	stream_defoveator(
 	        vk::raii::Device & device,
 	        vk::raii::PhysicalDevice & physical_device,
 	        std::vector<vk::Image> output_images,
 	        vk::Extent2D output_extent,
-	        vk::Format format);
+	        vk::Format format,
+	        std::vector<vk::Image> depth_images = {},
+	        vk::Format depth_format = vk::Format::eUndefined);
 
 	stream_defoveator(const stream_defoveator &) = delete;
 
@@ -85,11 +111,12 @@ public:
 
 	void defoveate(
 	        vk::raii::CommandBuffer & command_buffer,
-	        const std::array<wivrn::to_headset::foveation_parameter, 2> & foveation,
+	        const std::array<std::shared_ptr<const wivrn::to_headset::foveation_parameter_set>, 2> & foveation,
 	        const std::array<input, 2> & inputs,
 	        std::array<float, 4> scale,
 	        std::array<float, 4> bias,
-	        int destination);
+	        int destination,
+	        int depth_destination = -1);
 
 	static XrExtent2Di defoveated_size(const wivrn::to_headset::foveation_parameter &);
 };
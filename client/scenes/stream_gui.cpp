@@ -96,6 +96,8 @@ void scenes::stream::accumulate_metrics(XrTime predicted_display_time, const std
 {
 	uint64_t rx = network_session->bytes_received();
 	uint64_t tx = network_session->bytes_sent();
+	uint64_t packets = network_session->packets_received();
+	uint64_t wakeups = network_session->wakeups();
 
 	float dt = (predicted_display_time - last_metric_time) * 1e-9f;
 
@@ -117,10 +119,16 @@ void scenes::stream::accumulate_metrics(XrTime predicted_display_time, const std
 	bytes_received = rx;
 	bytes_sent = tx;
 
+	float packets_per_wakeup = wakeups > network_wakeups ? float(packets - packets_received) / (wakeups - network_wakeups) : 0;
+	packets_received = packets;
+	network_wakeups = wakeups;
+
 	*(gpu_timestamps *)&global_metrics[metrics_offset] = timestamps;
 	global_metrics[metrics_offset].cpu_time = application::get_cpu_time().count() * 1e-9f;
 	global_metrics[metrics_offset].bandwidth_rx = bandwidth_rx * 8;
 	global_metrics[metrics_offset].bandwidth_tx = bandwidth_tx * 8;
+	global_metrics[metrics_offset].gui_gpu_time = gui_gpu_time;
+	global_metrics[metrics_offset].packets_per_wakeup = packets_per_wakeup;
 
 	std::vector<shard_accumulator::blit_handle *> active_handles;
 	active_handles.reserve(blit_handles.size());
@@ -178,10 +186,13 @@ void scenes::stream::gui_performance_metrics()
 	        // clang-format off
 	        plot(_("CPU time"), {{"",          &global_metric::cpu_time}},     "s"),
 
-	        plot(_("GPU time"), {{_("Defoveate"), &global_metric::gpu_time}},  "s"),
+	        plot(_("GPU time"), {{_("Defoveate"), &global_metric::gpu_time},
+	                             {_("GUI"),       &global_metric::gui_gpu_time}}, "s"),
 
 	        plot(_("Network"), {{_("Download"),  &global_metric::bandwidth_rx},
 	                            {_("Upload"),    &global_metric::bandwidth_tx}}, "bit/s"),
+
+	        plot(_("Packets per wakeup"), {{"",  &global_metric::packets_per_wakeup}}, ""),
 	        // clang-format on
 	};
 
@@ -627,138 +638,8 @@ void scenes::stream::gui_toasts()
 	ImGui::Text("%s", (*toast)->content.c_str());
 }
 
-void scenes::stream::draw_gui(XrTime predicted_display_time, XrDuration predicted_display_period)
+void scenes::stream::draw_gui_windows(XrTime predicted_display_time, XrDuration predicted_display_period, bool is_urgent)
 {
-	if (auto new_status = next_gui_status.load(); new_status != gui_status)
-	{
-		spdlog::info("Switch tab from {} to {}", magic_enum::enum_name(gui_status), magic_enum::enum_name(new_status));
-
-		if (not is_gui_interactable() and is_interactable(new_status))
-		{
-			if (auto head_position = application::locate_controller(application::space(xr::spaces::view), application::space(xr::spaces::world), predicted_display_time))
-			{
-				world_gui_orientation = head_position->second * head_gui_orientation;
-				world_gui_position = head_position->first + glm::mat3_cast(head_position->second) * head_gui_position;
-			}
-		}
-		else if (is_gui_interactable() and not is_interactable(new_status))
-		{
-			if (auto head_position = application::locate_controller(application::space(xr::spaces::view), application::space(xr::spaces::world), predicted_display_time))
-			{
-				head_gui_orientation = glm::conjugate(head_position->second) * world_gui_orientation;
-				head_gui_position = glm::mat3_cast(glm::conjugate(head_position->second)) * (world_gui_position - head_position->first);
-			}
-		}
-
-		stored_gui_status = gui_status;
-		gui_status = new_status;
-		gui_status_last_change = predicted_display_time;
-
-		// Override session state if the GUI is interactable
-		if (not is_gui_interactable())
-			network_session->send_control(from_headset::session_state_changed{
-			        .state = application::get_session_state(),
-			});
-		else if (application::get_session_state() == XR_SESSION_STATE_FOCUSED)
-			network_session->send_control(from_headset::session_state_changed{
-			        .state = XR_SESSION_STATE_VISIBLE,
-			});
-
-		network_session->send_control(from_headset::stream_tab_changed{.tab = new_status});
-	}
-
-	bool interactable = true;
-	XrSpace world_space = application::space(xr::spaces::world);
-	auto views = session.locate_views(viewconfig, predicted_display_time, world_space).second;
-
-	switch (gui_status)
-	{
-		case stream_tab::hidden:
-		case stream_tab::foveation_settings:
-		case stream_tab::overlay_only:
-		case stream_tab::compact:
-			interactable = false;
-			break;
-		case stream_tab::stats:
-		case stream_tab::settings:
-		case stream_tab::applications:
-		case stream_tab::application_launcher:
-			break;
-	}
-	imgui_ctx->set_controllers_enabled(interactable and not recentering_context);
-	if (interactable)
-	{
-		if (system.hand_tracking_supported())
-		{
-			if (not left_hand)
-				left_hand = session.create_hand_tracker(XR_HAND_LEFT_EXT);
-			if (not right_hand)
-				right_hand = session.create_hand_tracker(XR_HAND_RIGHT_EXT);
-		}
-	}
-	else
-	{
-		left_hand.reset();
-		right_hand.reset();
-	}
-
-	float alpha = 1;
-	bool is_urgent = false;
-	if (gui_status == stream_tab::hidden)
-	{
-		auto toast = gui_toast.lock();
-		if (toast->has_value())
-			is_urgent = (*toast)->is_urgent;
-
-		float t = (predicted_display_time - gui_status_last_change) * 1.e-9f;
-		float delay = is_urgent ? constants::stream::urgent_fade_delay : constants::stream::fade_delay;
-
-		alpha = std::clamp<float>(1 - (t - delay) / constants::stream::fade_duration, 0, 1);
-
-		if (alpha == 0)
-		{
-			toast->reset();
-			return;
-		}
-	}
-
-	// Lock the GUI position to the head, do it before displaying the GUI to avoid being off by one frame when gui_status changes
-	std::optional<std::pair<glm::vec3, glm::quat>> head_position = application::locate_controller(application::space(xr::spaces::view), world_space, predicted_display_time);
-	if (head_position)
-	{
-		glm::mat3 M = glm::mat3_cast(head_position->second);
-		switch (gui_status)
-		{
-			case stream_tab::foveation_settings:
-				imgui_ctx->layers()[0].orientation = head_position->second;
-				imgui_ctx->layers()[0].position = head_position->first + M * glm::vec3{0, override_foveation_distance * sin(override_foveation_pitch), -override_foveation_distance};
-				break;
-
-			case stream_tab::hidden:
-				// Always use the same position for the GUI shortcut tip
-				imgui_ctx->layers()[0].orientation = head_position->second;
-				imgui_ctx->layers()[0].position = head_position->first + M * glm::vec3{0.0, -0.4, -1.0};
-				break;
-
-			case stream_tab::overlay_only:
-			case stream_tab::compact:
-				imgui_ctx->layers()[0].orientation = head_position->second * head_gui_orientation;
-				imgui_ctx->layers()[0].position = head_position->first + M * head_gui_position;
-				break;
-
-			case stream_tab::stats:
-			case stream_tab::settings:
-			case stream_tab::applications:
-			case stream_tab::application_launcher:
-				imgui_ctx->layers()[0].orientation = world_gui_orientation;
-				imgui_ctx->layers()[0].position = world_gui_position;
-				break;
-		}
-	}
-
-	// popup layer floats in front of the main panel so combos and modals pop as their own quad
-	imgui_ctx->place_layer_relative(2, 0, constants::gui::popup_position);
-
 	const float tab_width = wivrn::ui::metrics::sidebar_width;
 	const float top_bar_h = wivrn::ui::metrics::top_bar_height;
 	const float content_margin = wivrn::ui::metrics::content_margin;
@@ -1049,8 +930,157 @@ void scenes::stream::draw_gui(XrTime predicted_display_time, XrDuration predicte
 	ImGui::End();
 	ImGui::PopStyleVar(2);  // ImGuiStyleVar_ChildBorderSize, ImGuiStyleVar_WindowPadding
 	ImGui::PopStyleColor(); // ImGuiCol_WindowBg
+}
+
+void scenes::stream::draw_gui(XrTime predicted_display_time, XrDuration predicted_display_period)
+{
+	if (auto new_status = next_gui_status.load(); new_status != gui_status)
+	{
+		spdlog::info("Switch tab from {} to {}", magic_enum::enum_name(gui_status), magic_enum::enum_name(new_status));
+
+		if (not is_gui_interactable() and is_interactable(new_status))
+		{
+			if (auto head_position = application::locate_controller(application::space(xr::spaces::view), application::space(xr::spaces::world), predicted_display_time))
+			{
+				world_gui_orientation = head_position->second * head_gui_orientation;
+				world_gui_position = head_position->first + glm::mat3_cast(head_position->second) * head_gui_position;
+			}
+		}
+		else if (is_gui_interactable() and not is_interactable(new_status))
+		{
+			if (auto head_position = application::locate_controller(application::space(xr::spaces::view), application::space(xr::spaces::world), predicted_display_time))
+			{
+				head_gui_orientation = glm::conjugate(head_position->second) * world_gui_orientation;
+				head_gui_position = glm::mat3_cast(glm::conjugate(head_position->second)) * (world_gui_position - head_position->first);
+			}
+		}
+
+		stored_gui_status = gui_status;
+		gui_status = new_status;
+		gui_status_last_change = predicted_display_time;
+
+		// Override session state if the GUI is interactable
+		if (not is_gui_interactable())
+			network_session->send_control(from_headset::session_state_changed{
+			        .state = application::get_session_state(),
+			});
+		else if (application::get_session_state() == XR_SESSION_STATE_FOCUSED)
+			network_session->send_control(from_headset::session_state_changed{
+			        .state = XR_SESSION_STATE_VISIBLE,
+			});
+
+		network_session->send_control(from_headset::stream_tab_changed{.tab = new_status});
+	}
+
+	bool interactable = true;
+	XrSpace world_space = application::space(xr::spaces::world);
+	auto views = session.locate_views(viewconfig, predicted_display_time, world_space).second;
+
+	switch (gui_status)
+	{
+		case stream_tab::hidden:
+		case stream_tab::foveation_settings:
+		case stream_tab::overlay_only:
+		case stream_tab::compact:
+			interactable = false;
+			break;
+		case stream_tab::stats:
+		case stream_tab::settings:
+		case stream_tab::applications:
+		case stream_tab::application_launcher:
+			break;
+	}
+	imgui_ctx->set_controllers_enabled(interactable and not recentering_context);
+	if (interactable)
+	{
+		if (system.hand_tracking_supported())
+		{
+			if (not left_hand)
+				left_hand = session.create_hand_tracker(XR_HAND_LEFT_EXT);
+			if (not right_hand)
+				right_hand = session.create_hand_tracker(XR_HAND_RIGHT_EXT);
+		}
+	}
+	else
+	{
+		left_hand.reset();
+		right_hand.reset();
+	}
+
+	float alpha = 1;
+	bool is_urgent = false;
+	if (gui_status == stream_tab::hidden)
+	{
+		auto toast = gui_toast.lock();
+		if (toast->has_value())
+			is_urgent = (*toast)->is_urgent;
+
+		float t = (predicted_display_time - gui_status_last_change) * 1.e-9f;
+		float delay = is_urgent ? constants::stream::urgent_fade_delay : constants::stream::fade_delay;
+
+		alpha = std::clamp<float>(1 - (t - delay) / constants::stream::fade_duration, 0, 1);
+
+		if (alpha == 0)
+		{
+			toast->reset();
+			gui_gpu_time = 0;
+			return;
+		}
+	}
+
+	// Lock the GUI position to the head, do it before displaying the GUI to avoid being off by one frame when gui_status changes
+	std::optional<std::pair<glm::vec3, glm::quat>> head_position = application::locate_controller(application::space(xr::spaces::view), world_space, predicted_display_time);
+	if (head_position)
+	{
+		glm::mat3 M = glm::mat3_cast(head_position->second);
+		switch (gui_status)
+		{
+			case stream_tab::foveation_settings:
+				imgui_ctx->layers()[0].orientation = head_position->second;
+				imgui_ctx->layers()[0].position = head_position->first + M * glm::vec3{0, override_foveation_distance * sin(override_foveation_pitch), -override_foveation_distance};
+				break;
+
+			case stream_tab::hidden:
+				// Always use the same position for the GUI shortcut tip
+				imgui_ctx->layers()[0].orientation = head_position->second;
+				imgui_ctx->layers()[0].position = head_position->first + M * glm::vec3{0.0, -0.4, -1.0};
+				break;
+
+			case stream_tab::overlay_only:
+			case stream_tab::compact:
+				imgui_ctx->layers()[0].orientation = head_position->second * head_gui_orientation;
+				imgui_ctx->layers()[0].position = head_position->first + M * head_gui_position;
+				break;
+
+			case stream_tab::stats:
+			case stream_tab::settings:
+			case stream_tab::applications:
+			case stream_tab::application_launcher:
+				imgui_ctx->layers()[0].orientation = world_gui_orientation;
+				imgui_ctx->layers()[0].position = world_gui_position;
+				break;
+		}
+	}
 
-	auto layers = imgui_ctx->end_frame();
+	// popup layer floats in front of the main panel so combos and modals pop as their own quad
+	imgui_ctx->place_layer_relative(2, 0, constants::gui::popup_position);
+
+	std::vector<std::pair<int, XrCompositionLayerQuad>> layers;
+
+	// The statistics panels are not interactable and do not need to be refreshed at the display rate
+	bool info_panel = gui_status == stream_tab::overlay_only or gui_status == stream_tab::compact;
+	if (info_panel and last_gui_refresh > gui_status_last_change and
+	    (predicted_display_time - last_gui_refresh) * 1e-9f < constants::stream::info_panel_refresh_period)
+	{
+		layers = imgui_ctx->previous_frame();
+	}
+	else
+	{
+		draw_gui_windows(predicted_display_time, predicted_display_period, is_urgent);
+		layers = imgui_ctx->end_frame();
+		last_gui_refresh = predicted_display_time;
+	}
+	gui_gpu_time = imgui_ctx->gpu_time();
 
 	// Display controllers and handle recentering
 	if (interactable)
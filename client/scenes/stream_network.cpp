@@ -23,7 +23,9 @@
 #include "utils/i18n.h"
 #include "utils/named_thread.h"
 
+#include <chrono>
 #include <spdlog/spdlog.h>
+#include <thread>
 #include <uni_algo/case.h>
 
 void scenes::stream::process_packets()
@@ -39,10 +41,37 @@ void scenes::stream::process_packets()
 		}
 		catch (std::exception & e)
 		{
-			spdlog::info("Exception in network thread, exiting: {}", e.what());
-			exit();
+			spdlog::info("Exception in network thread: {}", e.what());
+			if (not resume_session())
+			{
+				spdlog::info("Exiting network thread");
+				exit();
+			}
+		}
+	}
+}
+
+bool scenes::stream::resume_session()
+{
+	// The decoders and the rest of the scene are kept, the server forces an IDR frame
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (network_session->can_resume() and state_ != state::shutdown and std::chrono::steady_clock::now() < deadline)
+	{
+		try
+		{
+			network_session->resume();
+			network_session->send_control(from_headset::headset_info_packet{headset_info});
+			send_session_state();
+			spdlog::info("Session resumed");
+			return true;
+		}
+		catch (std::exception & e)
+		{
+			spdlog::info("Cannot resume session: {}", e.what());
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
 		}
 	}
+	return false;
 }
 
 void scenes::stream::operator()(to_headset::server_message && message)
@@ -76,7 +105,7 @@ void scenes::stream::operator()(to_headset::video_stream_data_shard && shard)
 		// We don't know (yet?) about this stream, ignore packet
 		return;
 	}
-	decoders[idx].decoder->push_shard(std::move(shard));
+	decoders[idx].decoder->push_shard(std::move(shard), instance.from_monotonic(network_session->receive_time()));
 }
 
 void scenes::stream::operator()(to_headset::feature_control && control)
@@ -106,6 +135,8 @@ void scenes::stream::operator()(to_headset::audio_stream_description && desc)
 
 void scenes::stream::operator()(to_headset::video_stream_description && desc)
 {
+	// The server starts numbering the foveation parameters again
+	foveation_parameters.lock()->clear();
 	setup(desc);
 
 	if (not tracking_thread)
@@ -130,9 +161,12 @@ void scenes::stream::operator()(to_headset::stream_tab_change && tab)
 
 void scenes::stream::operator()(to_headset::timesync_query && query)
 {
+	// The server takes the middle of its round trip, answer with the middle of the time the query
+	// spent on the headset, from the kernel timestamp to now
+	XrTime received = instance.from_monotonic(network_session->receive_time());
 	network_session->send_stream(from_headset::timesync_response{
 	        .query = query.query,
-	        .response = instance.now(),
+	        .response = (received + instance.now()) / 2,
 	});
 }
 
@@ -169,6 +203,26 @@ void scenes::stream::operator()(to_headset::running_applications && apps)
 	*running_applications.lock() = std::move(apps);
 }
 
+void scenes::stream::operator()(to_headset::foveation_parameter_set && set)
+{
+	auto params = foveation_parameters.lock();
+	uint32_t id = set.id;
+	params->insert_or_assign(id, std::make_shared<const to_headset::foveation_parameter_set>(std::move(set)));
+
+	// Ids are increasing, the server sends again sets older than headset_history
+	if (id >= to_headset::foveation_parameter_set::headset_history)
+		params->erase(params->begin(), params->upper_bound(id - to_headset::foveation_parameter_set::headset_history));
+}
+
+std::shared_ptr<const to_headset::foveation_parameter_set> scenes::stream::get_foveation_parameters(uint32_t id)
+{
+	auto params = foveation_parameters.lock();
+	auto it = params->find(id);
+	if (it == params->end())
+		return nullptr;
+	return it->second;
+}
+
 void scenes::stream::start_application(std::string appid)
 {
 	network_session->send_control(wivrn::from_headset::start_app{
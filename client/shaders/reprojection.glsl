@@ -22,6 +22,7 @@ layout(push_constant) uniform pc
 {
 	ivec4 rgb_rect;
 	ivec4 a_rect;
+	ivec4 depth_rect;
 	vec4 scale;
 	vec4 bias;
 };
@@ -32,6 +33,7 @@ layout (location = 0) in vec2 vPosition;
 layout (location = 1) in uvec2 vUV;
 
 layout(location = 0) out vec4 outUV;
+layout(location = 1) out vec2 outDepthUV;
 
 void main()
 {
@@ -39,6 +41,7 @@ void main()
 	vec2 uv = vUV;
 	outUV.xy = (uv + rgb_rect.xy) / rgb_rect.zw;
 	outUV.zw = (uv + a_rect.xy) / a_rect.zw;
+	outDepthUV = (uv + depth_rect.xy) / max(depth_rect.zw, 1);
 }
 #endif
 
@@ -46,10 +49,13 @@ void main()
 
 layout(constant_id = 0) const int alpha = 1;
 layout(constant_id = 1) const bool do_srgb = false;
+// Depth is below alpha in the same image
+layout(constant_id = 2) const int depth = 0;
 
-layout(set = 0, binding = 0) uniform sampler2D rgb[alpha + 1];
+layout(set = 0, binding = 0) uniform sampler2D rgb[1 + (alpha | depth)];
 
 layout(location = 0) in vec4 inUV;
+layout(location = 1) in vec2 inDepthUV;
 
 layout(location = 0) out vec4 outColor;
 
@@ -69,20 +75,32 @@ vec4 sRGB_to_linear_rgba(vec4 x)
 	        x.a);
 }
 
-void main()
+// Avoid sampling between the eyes, or between alpha and depth
+vec2 same_eye(vec2 a)
 {
-	if (alpha == 1)
+	float d = a.x - 0.5;
+	if (abs(d) *a_rect.z < 1)
+		a.x += (d > 0 ? 1 : -1)  / float(a_rect.z);
+	if (depth == 1)
 	{
-		// Avoid sampling between the eyes
-		vec2 a = inUV.zw;
-		float d = a.x - 0.5;
-		if (abs(d) *a_rect.z < 1)
-			a.x += (d > 0 ? 1 : -1)  / float(a_rect.z);
-		outColor = vec4(texture(rgb[0], inUV.xy).rgb, texture(rgb[1], a).r);
+		float e = a.y - 0.5;
+		if (abs(e) * a_rect.w < 1)
+			a.y += (e > 0 ? 1 : -1) / float(a_rect.w);
 	}
+	return a;
+}
+
+void main()
+{
+	if (alpha == 1)
+		outColor = vec4(texture(rgb[0], inUV.xy).rgb, texture(rgb[1], same_eye(inUV.zw)).r);
 	else
 		outColor = texture(rgb[0], inUV.xy).rgba;
 
+	// Packed depth is the depth buffer of a reversed Z projection with an infinite far plane
+	if (depth == 1)
+		gl_FragDepth = texture(rgb[1], same_eye(inDepthUV)).r;
+
 	if (do_srgb)
 	{
 		outColor = sRGB_to_linear_rgba(outColor);
@@ -26,4 +26,5 @@ class PhysicalDevice;
 class Device;
 class Queue;
 class CommandPool;
+class CommandBuffer;
 } // namespace vk::raii
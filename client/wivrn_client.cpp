@@ -33,6 +33,7 @@
 #include <poll.h>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -62,7 +63,7 @@ void init_stream(T & stream)
 } // namespace
 
 template <typename T>
-void wivrn_session::handshake(T address, bool tcp_only, crypto::key & headset_keypair, std::function<std::string(int fd)> pin_enter)
+void wivrn_session::handshake(T address, std::function<std::string(int fd)> pin_enter)
 {
 	// FIXME this comment
 	// Wait for handshake on control socket,
@@ -99,21 +100,36 @@ void wivrn_session::handshake(T address, bool tcp_only, crypto::key & headset_ke
 		}
 	};
 
-	send_control(from_headset::crypto_handshake{
+	std::optional<from_headset::crypto_handshake::resume_request> resume;
+	if (keys)
+	{
+		resume = from_headset::crypto_handshake::resume_request{.ticket = keys->resume_ticket()};
+		crypto::random_bytes(resume->nonce);
+	}
+
+	control.send(from_headset::crypto_handshake{
 	        .protocol_version = wivrn::protocol_version,
 	        .public_key = headset_keypair.public_key(),
 	        .name = application::get_hmd_traits().model_name(),
+	        .resume = resume,
 	});
 
 	to_headset::crypto_handshake crypto_handshake = std::get<to_headset::crypto_handshake>(receive(10s));
 
+	if (resume and crypto_handshake.state != to_headset::crypto_handshake::crypto_state::resumed)
+	{
+		// The server discards the ticket once presented
+		keys.reset();
+		throw std::runtime_error("Session cannot be resumed");
+	}
+
 	std::string pin = "000000";
 	switch (crypto_handshake.state)
 	{
 		case to_headset::crypto_handshake::crypto_state::encryption_disabled: {
 			spdlog::info("Encryption is disabled on server");
 
-			send_control(from_headset::crypto_handshake{});
+			control.send(from_headset::crypto_handshake{});
 
 			to_headset::handshake h{std::get<to_headset::handshake>(receive(10s))};
 			if (h.stream_port > 0 && !tcp_only)
@@ -135,12 +151,12 @@ void wivrn_session::handshake(T address, bool tcp_only, crypto::key & headset_ke
 				crypto::smp pin_check;
 
 				auto msg1 = pin_check.step1(pin);
-				send_control(from_headset::pin_check_1{msg1});
+				control.send(from_headset::pin_check_1{msg1});
 
 				auto msg2 = std::get<to_headset::pin_check_2>(receive(10s)).message;
 
 				auto msg3 = pin_check.step3(msg2);
-				send_control(from_headset::pin_check_3{msg3});
+				control.send(from_headset::pin_check_3{msg3});
 
 				auto msg4 = std::get<to_headset::pin_check_4>(receive(10s)).message;
 				bool pin_match = pin_check.step5(msg4);
@@ -155,15 +171,29 @@ void wivrn_session::handshake(T address, bool tcp_only, crypto::key & headset_ke
 
 			[[fallthrough]];
 
-		case to_headset::crypto_handshake::crypto_state::client_already_paired: {
-			spdlog::info("Using pin \"{}\"", pin);
+		case to_headset::crypto_handshake::crypto_state::client_already_paired:
+		case to_headset::crypto_handshake::crypto_state::resumed: {
+			if (crypto_handshake.state == to_headset::crypto_handshake::crypto_state::resumed)
+			{
+				if (not resume)
+					throw std::runtime_error("Invalid handshake");
+
+				spdlog::info("Resuming session");
+				keys = secrets{*keys, resume->nonce, crypto_handshake.nonce};
+			}
+			else
+			{
+				spdlog::info("Using pin \"{}\"", pin);
+
+				crypto::key server_key = crypto::key::from_public_key(crypto_handshake.public_key);
+				keys.emplace(headset_keypair, server_key, pin);
+			}
 
-			crypto::key server_key = crypto::key::from_public_key(crypto_handshake.public_key);
-			secrets s{headset_keypair, server_key, pin};
+			const secrets & s = *keys;
 			control.set_aes_key_and_ivs(s.control_key, s.control_iv_to_headset, s.control_iv_from_headset);
 
 			// Confirm that encryption is set up
-			send_control(from_headset::crypto_handshake{});
+			control.send(from_headset::crypto_handshake{});
 
 			to_headset::handshake h{std::get<to_headset::handshake>(receive(10s))};
 			if (h.stream_port > 0 && !tcp_only)
@@ -186,8 +216,13 @@ void wivrn_session::handshake(T address, bool tcp_only, crypto::key & headset_ke
 			throw std::runtime_error(_("Incompatible server version"));
 	}
 
+	watch_sockets();
+
 	// may be on control socket if forced TCP
-	send_stream(from_headset::handshake{});
+	if (stream)
+		stream.send(from_headset::handshake{});
+	else
+		control.send(from_headset::handshake{});
 
 	// Wait for second handshake
 	auto timeout = std::chrono::steady_clock::now() + 10s;
@@ -209,12 +244,32 @@ void wivrn_session::handshake(T address, bool tcp_only, crypto::key & headset_ke
 	}
 }
 
+void wivrn_session::watch_sockets()
+{
+	epoll = fd_base(epoll_create1(EPOLL_CLOEXEC));
+	if (epoll.get_fd() < 0)
+		throw std::system_error(errno, std::system_category());
+
+	for (auto [fd, id]: {std::pair{stream.get_fd(), stream_id}, std::pair{control.get_fd(), control_id}})
+	{
+		if (fd < 0)
+			continue;
+
+		epoll_event event{
+		        .events = EPOLLIN,
+		        .data = {.u32 = id},
+		};
+		if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) < 0)
+			throw std::system_error(errno, std::system_category());
+	}
+}
+
 wivrn_session::wivrn_session(in6_addr address, int port, bool tcp_only, crypto::key & headset_keypair, std::function<std::string(int fd)> pin_enter) :
-        control(address, port), stream(-1), address(address)
+        control(address, port), stream(-1), port(port), tcp_only(tcp_only), headset_keypair(headset_keypair), address(address)
 {
 	try
 	{
-		handshake(address, tcp_only, headset_keypair, pin_enter);
+		handshake(address, pin_enter);
 	}
 	catch (std::exception & e)
 	{
@@ -223,14 +278,47 @@ wivrn_session::wivrn_session(in6_addr address, int port, bool tcp_only, crypto::
 }
 
 wivrn_session::wivrn_session(in_addr address, int port, bool tcp_only, crypto::key & headset_keypair, std::function<std::string(int fd)> pin_enter) :
-        control(address, port), stream(-1), address(address)
+        control(address, port), stream(-1), port(port), tcp_only(tcp_only), headset_keypair(headset_keypair), address(address)
 {
 	try
 	{
-		handshake(address, tcp_only, headset_keypair, pin_enter);
+		handshake(address, pin_enter);
 	}
 	catch (std::exception & e)
 	{
 		throw handshake_error{e.what()};
 	}
 }
+
+void wivrn_session::resume()
+{
+	if (not keys)
+		throw std::runtime_error("Session cannot be resumed");
+
+	resuming = true;
+	std::unique_lock lock(socket_mutex);
+
+	// Close the previous connection first so that the server notices it is lost
+	connected = false;
+	control = control_socket_t();
+	stream = stream_socket_t(-1);
+
+	try
+	{
+		std::visit([this](auto address) {
+			control = control_socket_t(address, port);
+			handshake(address, [](int) -> std::string { throw std::runtime_error("Session cannot be resumed"); });
+		},
+		           address);
+	}
+	catch (...)
+	{
+		resuming = false;
+		throw;
+	}
+	connected = true;
+	resuming = false;
+
+	if (auto dropped = dropped_packets.exchange(0))
+		spdlog::info("{} packets dropped while resuming the session", dropped);
+}
@@ -20,10 +20,14 @@
 #pragma once
 
 #include "crypto.h"
+#include "secrets.h"
 #include "wivrn_packets.h"
 #include "wivrn_sockets.h"
 #include <chrono>
-#include <poll.h>
+#include <functional>
+#include <optional>
+#include <shared_mutex>
+#include <sys/epoll.h>
 
 using namespace wivrn;
 
@@ -48,9 +52,105 @@ private:
 
 	std::atomic<uint64_t> bytes_sent_ = 0;
 	std::atomic<uint64_t> bytes_received_ = 0;
+	std::atomic<uint64_t> packets_received_ = 0;
+	std::atomic<uint64_t> wakeups_ = 0;
+	int64_t receive_time_ = 0;
+
+	// Watches the control and stream sockets, rebuilt by the handshake when they are replaced
+	fd_base epoll;
+	enum socket_id : uint32_t
+	{
+		stream_id,
+		control_id,
+	};
+
+	// Time spent polling without sleeping before blocking in epoll_wait, 0 to disable
+	std::atomic<std::chrono::microseconds> busy_poll_{};
+
+	// Maximum number of packets read from one socket per wakeup, so that the stream socket
+	// cannot starve the control socket
+	static constexpr int max_batch = 256;
+
+	int port;
+	bool tcp_only;
+	crypto::key & headset_keypair;
+	// Keys of the encrypted session, used to resume it
+	std::optional<secrets> keys;
+
+	// Held exclusively while the sockets are replaced by resume
+	std::shared_mutex socket_mutex;
+	bool connected = true; // Locked by socket_mutex
+	// Set before resume locks socket_mutex, senders drop their packets instead of waiting for
+	// the handshake
+	std::atomic<bool> resuming = false;
+	// Packets dropped by send_locked, logged after resuming
+	std::atomic<uint64_t> dropped_packets = 0;
 
 	template <typename T>
-	void handshake(T address, bool tcp_only, crypto::key & headset_keypair, std::function<std::string(int fd)> pin_enter);
+	void handshake(T address, std::function<std::string(int fd)> pin_enter);
+	void watch_sockets();
+
+	template <typename Socket, typename T>
+	int dispatch_pending(Socket & socket, T & visitor)
+	{
+		int n = 0;
+		while (auto packet = socket.receive_pending(&bytes_received_))
+		{
+			receive_time_ = socket.receive_time();
+			std::visit(visitor, std::move(*packet));
+			++n;
+		}
+		return n;
+	}
+
+	// Reads until the socket would block, each recvmmsg batch is dispatched before the next
+	// syscall
+	template <typename Socket, typename T>
+	int drain(Socket & socket, T & visitor)
+	{
+		int n = 0;
+		while (n < max_batch)
+		{
+			auto packet = socket.receive(&bytes_received_);
+			if (not packet)
+				break;
+			receive_time_ = socket.receive_time();
+			std::visit(visitor, std::move(*packet));
+			n += 1 + dispatch_pending(socket, visitor);
+		}
+		return n;
+	}
+
+	// Packets are dropped while resuming. When the session can be resumed, socket errors are
+	// left to poll on the network thread which reconnects.
+	template <typename F>
+	void send_locked(F && send)
+	{
+		std::shared_lock lock(socket_mutex, std::try_to_lock);
+		// try_lock_shared may fail spuriously, only resume holds the lock for long
+		if (not lock and not resuming)
+			lock.lock();
+		if (not lock or not connected)
+		{
+			++dropped_packets;
+			return;
+		}
+
+		try
+		{
+			bytes_sent_ += send();
+		}
+		catch (std::system_error &)
+		{
+			if (not keys)
+				throw;
+		}
+		catch (socket_shutdown &)
+		{
+			if (not keys)
+				throw;
+		}
+	}
 
 public:
 	std::variant<in_addr, in6_addr> address;
@@ -60,64 +160,100 @@ public:
 	wivrn_session(const wivrn_session &) = delete;
 	wivrn_session & operator=(const wivrn_session &) = delete;
 
+	bool can_resume() const
+	{
+		return keys.has_value();
+	}
+
+	// Opens a new connection to the same server and resumes the session with a ticket derived from
+	// its keys, without a key exchange. Throws if the server refuses it. Must be called from the
+	// thread that polls.
+	void resume();
+
 	template <typename T>
 	void send_control(T && packet)
 	{
-		bytes_sent_ += control.send(std::forward<T>(packet));
+		send_locked([&]() { return control.send(std::forward<T>(packet)); });
 	}
 
 	template <typename T>
 	void send_stream(T && packet)
 	{
-		if (stream)
-			bytes_sent_ += stream.send(std::forward<T>(packet));
-		else
-			bytes_sent_ += control.send(std::forward<T>(packet));
+		send_locked([&]() {
+			if (stream)
+				return stream.send(std::forward<T>(packet));
+			return control.send(std::forward<T>(packet));
+		});
+	}
+
+	// CLOCK_MONOTONIC time at which the packet being handled by poll was received by the kernel
+	int64_t receive_time() const
+	{
+		return receive_time_;
+	}
+
+	// Spin on the sockets for the given time after each wakeup before sleeping, trading CPU time
+	// for latency while streaming
+	void set_busy_poll(std::chrono::microseconds duration)
+	{
+		busy_poll_ = duration;
 	}
 
 	template <typename T>
 	int poll(T && visitor, std::chrono::milliseconds timeout)
 	{
-		pollfd fds[2] = {};
-		fds[0].events = POLLIN;
-		fds[0].fd = stream.get_fd();
-		fds[1].events = POLLIN;
-		fds[1].fd = control.get_fd();
-
-		while (auto packet = stream.receive_pending(&bytes_received_))
-			std::visit(std::forward<T>(visitor), std::move(*packet));
-		while (auto packet = control.receive_pending(&bytes_received_))
-			std::visit(std::forward<T>(visitor), std::move(*packet));
-
-		int r = ::poll(fds, std::size(fds), timeout.count());
-		if (r < 0)
-			throw std::system_error(errno, std::system_category());
+		// Packets left over when the previous batch was cut short
+		int packets = dispatch_pending(stream, visitor) + dispatch_pending(control, visitor);
 
-		if (fds[0].revents & (POLLHUP | POLLERR))
-			throw std::runtime_error("Error on stream socket");
+		epoll_event events[2];
+		int r = 0;
+		if (auto busy_poll = busy_poll_.load(); busy_poll.count() > 0 or packets > 0)
+		{
+			auto deadline = std::chrono::steady_clock::now() + busy_poll;
+			do
+			{
+				r = epoll_wait(epoll, events, std::size(events), 0);
+			} while (r == 0 and std::chrono::steady_clock::now() < deadline);
+		}
+		if (r == 0 and packets == 0)
+			r = epoll_wait(epoll, events, std::size(events), timeout.count());
 
-		if (fds[1].revents & (POLLHUP | POLLERR))
-			throw std::runtime_error("Error on control socket");
+		if (r < 0)
+			throw std::system_error(errno, std::system_category());
 
-		if (fds[0].revents & POLLIN)
+		for (int i = 0; i < r; ++i)
 		{
-			auto packet = stream.receive(&bytes_received_);
-			if (packet)
-			{
-				std::visit(std::forward<T>(visitor), std::move(*packet));
-			}
+			if (events[i].events & (EPOLLHUP | EPOLLERR))
+				throw std::runtime_error(events[i].data.u32 == stream_id ? "Error on stream socket" : "Error on control socket");
 		}
 
-		if (fds[1].revents & POLLIN)
+		for (int i = 0; i < r; ++i)
 		{
-			auto packet = control.receive(&bytes_received_);
-			if (packet)
-				std::visit(std::forward<T>(visitor), std::move(*packet));
+			if (events[i].data.u32 == stream_id)
+				packets += drain(stream, visitor);
+			else
+				packets += drain(control, visitor);
 		}
 
+		if (r > 0)
+			++wakeups_;
+		packets_received_ += packets;
+
 		return r;
 	}
 
+	uint64_t packets_received() const
+	{
+		return packets_received_;
+	}
+
+	// Number of times poll returned with readable sockets, packets_received() / wakeups() is the
+	// average batch size
+	uint64_t wakeups() const
+	{
+		return wakeups_;
+	}
+
 	uint64_t bytes_received() const
 	{
 		return bytes_received_;
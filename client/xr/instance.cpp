@@ -343,6 +343,19 @@ XrTime xr::instance::now()
 	return res;
 }
 
+XrTime xr::instance::from_monotonic(int64_t ns)
+{
+	static PFN_xrConvertTimespecTimeToTimeKHR xrConvertTimespecTimeToTimeKHR =
+	        get_proc<PFN_xrConvertTimespecTimeToTimeKHR>("xrConvertTimespecTimeToTimeKHR");
+	timespec ts{
+	        .tv_sec = time_t(ns / 1'000'000'000),
+	        .tv_nsec = long(ns % 1'000'000'000),
+	};
+	XrTime res;
+	CHECK_XR(xrConvertTimespecTimeToTimeKHR(id, &ts, &res));
+	return res;
+}
+
 std::vector<XrExtensionProperties> xr::instance::extensions(const char * layer_name)
 {
 	return xr::details::enumerate<XrExtensionProperties>(xrEnumerateInstanceExtensionProperties, layer_name);
@@ -97,6 +97,8 @@ public:
 	                      std::vector<XrActionSuggestedBinding> & bindings);
 
 	XrTime now();
+	// Converts a CLOCK_MONOTONIC time in ns
+	XrTime from_monotonic(int64_t ns);
 
 	static std::vector<XrExtensionProperties> extensions(const char * layer_name = nullptr);
 
@@ -0,0 +1,158 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "audio_transport.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace wivrn
+{
+
+audio_send_queue::audio_send_queue(uint8_t num_channels, uint32_t sample_rate) :
+        frame_size(num_channels * sizeof(int16_t)),
+        sample_rate(sample_rate)
+{
+}
+
+bool audio_send_queue::push(std::span<const uint8_t> samples, XrTime timestamp)
+{
+	const size_t packet_size = max_payload_size / frame_size * frame_size;
+	bool ok = true;
+	size_t frames = 0;
+	while (not samples.empty())
+	{
+		packet p;
+		p.timestamp = timestamp + int64_t(frames) * 1'000'000'000 / sample_rate;
+		p.sequence = sequence++;
+		p.size = std::min(packet_size, samples.size());
+		memcpy(p.samples.data(), samples.data(), p.size);
+		samples = samples.subspan(p.size);
+		frames += p.size / frame_size;
+
+		// The sequence number is still used: the receiver conceals the dropped packet
+		ok = packets.write(std::move(p)) and ok;
+	}
+	pushed.fetch_add(1);
+	pushed.notify_one();
+	return ok;
+}
+
+bool audio_send_queue::wait()
+{
+	pushed.wait(popped);
+	popped = pushed;
+	return not stopping;
+}
+
+std::optional<audio_data> audio_send_queue::pop()
+{
+	auto p = packets.read();
+	if (not p)
+		return std::nullopt;
+	current = *p;
+	return audio_data{
+	        .timestamp = current.timestamp,
+	        .sequence = current.sequence,
+	        .payload = std::span(current.samples.data(), current.size),
+	};
+}
+
+void audio_send_queue::stop()
+{
+	stopping = true;
+	pushed.fetch_add(1);
+	pushed.notify_all();
+}
+
+namespace
+{
+// Multiplies the samples by a gain going linearly from begin to end
+void fade(std::span<uint8_t> payload, size_t num_channels, float begin, float end)
+{
+	const size_t frames = payload.size() / (num_channels * sizeof(int16_t));
+	for (size_t i = 0; i < frames; ++i)
+	{
+		float gain = begin + (end - begin) * i / frames;
+		for (size_t c = 0; c < num_channels; ++c)
+		{
+			// payload may not be aligned
+			uint8_t * ptr = payload.data() + (i * num_channels + c) * sizeof(int16_t);
+			int16_t sample;
+			memcpy(&sample, ptr, sizeof(sample));
+			sample = int16_t(sample * gain);
+			memcpy(ptr, &sample, sizeof(sample));
+		}
+	}
+}
+} // namespace
+
+audio_loss_concealment::audio_loss_concealment(uint8_t num_channels) :
+        num_channels(num_channels)
+{
+}
+
+std::vector<audio_data> audio_loss_concealment::operator()(audio_data && packet)
+{
+	std::vector<audio_data> res;
+
+	int32_t gap = next_sequence ? int32_t(packet.sequence - *next_sequence) : 0;
+	// The sender restarted, such as after a reconnection
+	if (gap < -int32_t(max_gap))
+		gap = 0;
+	if (gap < 0)
+	{
+		++late;
+		return res;
+	}
+
+	if (gap > 0 and uint32_t(gap) <= max_gap and not last.empty())
+	{
+		// Duration of a packet, to date the replacements
+		const XrTime duration = (packet.timestamp - last_timestamp) / (gap + 1);
+		for (int i = 0; i < gap; ++i)
+		{
+			audio_data replacement{
+			        .timestamp = last_timestamp + (i + 1) * duration,
+			        .sequence = *next_sequence + i,
+			        .data = {std::make_shared<uint8_t[]>(last.size())},
+			};
+			replacement.payload = std::span(replacement.data.c.get(), last.size());
+			// The first replacement fades out the previous packet, the others are silent
+			if (i == 0)
+			{
+				memcpy(replacement.payload.data(), last.data(), last.size());
+				fade(replacement.payload, num_channels, 1, 0);
+			}
+			res.push_back(std::move(replacement));
+		}
+		concealed += gap;
+	}
+	if (gap > 0)
+		fade(packet.payload, num_channels, 0, 1);
+
+	last.assign(packet.payload.begin(), packet.payload.end());
+	last_timestamp = packet.timestamp;
+	next_sequence = packet.sequence + 1;
+	res.push_back(std::move(packet));
+	return res;
+}
+
+} // namespace wivrn
@@ -0,0 +1,107 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "utils/ring_buffer.h"
+#include "wivrn_packets.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace wivrn
+{
+
+// Audio samples captured in a realtime callback, sent from another thread.
+//
+// push() copies the samples into preallocated packets and never allocates nor blocks, so that
+// it can be called from the PipeWire or AAudio callbacks. Packets are small enough to be sent
+// on the stream socket without fragmentation and are numbered for audio_loss_concealment.
+class audio_send_queue
+{
+public:
+	static constexpr size_t max_payload_size = 1024;
+
+private:
+	struct packet
+	{
+		XrTime timestamp;
+		uint32_t sequence;
+		uint16_t size;
+		std::array<uint8_t, max_payload_size> samples;
+	};
+
+	utils::ring_buffer<packet, 64> packets;
+	// Last packet returned by pop
+	packet current;
+	std::atomic<uint32_t> pushed = 0;
+	uint32_t popped = 0;
+	std::atomic<bool> stopping = false;
+
+	const size_t frame_size;
+	const uint32_t sample_rate;
+	uint32_t sequence = 0;
+
+public:
+	audio_send_queue(uint8_t num_channels, uint32_t sample_rate);
+
+	// samples are interleaved 16-bit, timestamp is the time of the first one in any clock.
+	// Returns false if packets were dropped because the queue is full.
+	bool push(std::span<const uint8_t> samples, XrTime timestamp);
+
+	// Blocks until packets are pushed or stop() is called, returns false if stopped
+	bool wait();
+	// The payload of the result is valid until the next call
+	std::optional<audio_data> pop();
+
+	// Wakes the thread in wait()
+	void stop();
+};
+
+// Fills the gaps of lost audio packets on the receiving side.
+//
+// A lost packet is replaced by the previous one, fading out, and the packet after the gap fades
+// in: a loss is heard as a short dip instead of a click or a shift of the stream. Packets
+// arriving after a later one are dropped, waiting for them would add latency.
+class audio_loss_concealment
+{
+	// Larger gaps, such as after a reconnection, are not filled
+	static constexpr uint32_t max_gap = 16;
+
+	const size_t num_channels;
+	std::optional<uint32_t> next_sequence;
+	std::vector<uint8_t> last;
+	XrTime last_timestamp = 0;
+
+public:
+	uint64_t concealed = 0;
+	uint64_t late = 0;
+
+	audio_loss_concealment(uint8_t num_channels);
+
+	// Returns the packets to play: replacements for the missing ones then the packet itself,
+	// or nothing if it is late
+	std::vector<audio_data> operator()(audio_data && packet);
+};
+
+} // namespace wivrn
@@ -25,6 +25,7 @@
 #include <openssl/kdf.h>
 #include <openssl/params.h>
 #include <openssl/pem.h>
+#include <openssl/rand.h>
 #include <stdexcept>
 #include <string>
 
@@ -524,4 +525,10 @@ std::vector<uint8_t> pbkdf2(std::string pass, std::string salt, std::span<uint8_
 	return result;
 }
 
+void random_bytes(std::span<uint8_t> out)
+{
+	if (RAND_bytes(out.data(), out.size()) != 1)
+		throw_openssl_error();
+}
+
 } // namespace crypto
@@ -184,4 +184,7 @@ public:
 // Salt must be at least 8 characters
 std::vector<uint8_t> pbkdf2(std::string pass, std::string salt, std::span<uint8_t> secret, size_t size);
 
+// Fills the buffer from a cryptographically secure generator
+void random_bytes(std::span<uint8_t> out);
+
 } // namespace crypto
@@ -0,0 +1,56 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// Depth is streamed as near_plane / distance, clamped to [0, 1].
+//
+// This is the depth buffer of a reversed Z projection with an infinite far plane, the headset
+// submits it without conversion with XrCompositionLayerDepthInfoKHR{.nearZ = +inf, .farZ = near_plane}.
+// Quantization steps are constant in 1 / distance so that the parallax error for a given head
+// translation does not depend on the distance. 0 is infinity, also used where there is no depth.
+//
+// The server computes it in shaders/foveation.comp, both must match.
+namespace wivrn::depth_packing
+{
+// Closer objects are clamped, in meters
+constexpr float near_plane = 0.1;
+
+// 1 / distance in meters for a value of an OpenXR depth layer, see XrCompositionLayerDepthInfoKHR.
+// The depth is linear in 1 / distance, which also works for reversed Z and infinite planes.
+inline float inverse_distance(float depth, float min_depth, float max_depth, float near_z, float far_z)
+{
+	float d = (depth - min_depth) / (max_depth - min_depth);
+	return std::lerp(1 / near_z, 1 / far_z, d);
+}
+
+inline float pack(float inverse_distance)
+{
+	return std::clamp(near_plane * inverse_distance, 0.f, 1.f);
+}
+
+// Distance in meters, infinity for 0
+inline float unpack(float value)
+{
+	return near_plane / value;
+}
+} // namespace wivrn::depth_packing
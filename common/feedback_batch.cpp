@@ -0,0 +1,133 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "feedback_batch.h"
+
+#include <algorithm>
+
+namespace wivrn
+{
+
+using batch = from_headset::feedback_batch;
+
+namespace
+{
+int32_t pack(XrTime t, XrTime base)
+{
+	if (t == 0)
+		return batch::unset;
+	return std::clamp<int64_t>(t - base, batch::unset + 1, std::numeric_limits<int32_t>::max());
+}
+
+XrTime unpack(int32_t t, XrTime base)
+{
+	if (t == batch::unset)
+		return 0;
+	return base + t;
+}
+} // namespace
+
+batch::frame pack_feedback(uint32_t sequence, std::span<const from_headset::feedback> feedback)
+{
+	batch::frame frame{
+	        .sequence = sequence,
+	        .frame_index = feedback.empty() ? 0 : feedback.front().frame_index,
+	        .time = feedback.empty() ? 0 : feedback.front().blitted,
+	};
+	frame.streams.reserve(feedback.size());
+
+	for (const auto & f: feedback)
+	{
+		int64_t frame_index = int64_t(f.frame_index - frame.frame_index);
+		// Streams are never that far apart
+		if (frame_index < std::numeric_limits<int16_t>::min() or frame_index > std::numeric_limits<int16_t>::max())
+			continue;
+
+		frame.streams.push_back({
+		        .stream_index = f.stream_index,
+		        .times_displayed = f.times_displayed,
+		        .frame_index = int16_t(frame_index),
+		        .encode_begin = pack(f.encode_begin, frame.time),
+		        .encode_end = pack(f.encode_end, frame.time),
+		        .send_begin = pack(f.send_begin, frame.time),
+		        .send_end = pack(f.send_end, frame.time),
+		        .received_first_packet = pack(f.received_first_packet, frame.time),
+		        .received_last_packet = pack(f.received_last_packet, frame.time),
+		        .sent_to_decoder = pack(f.sent_to_decoder, frame.time),
+		        .received_from_decoder = pack(f.received_from_decoder, frame.time),
+		        .blitted = pack(f.blitted, frame.time),
+		        .displayed = pack(f.displayed, frame.time),
+		});
+	}
+	return frame;
+}
+
+from_headset::feedback unpack_feedback(const batch::frame & frame, const batch::stream & s)
+{
+	return {
+	        .frame_index = frame.frame_index + s.frame_index,
+	        .stream_index = s.stream_index,
+	        .encode_begin = unpack(s.encode_begin, frame.time),
+	        .encode_end = unpack(s.encode_end, frame.time),
+	        .send_begin = unpack(s.send_begin, frame.time),
+	        .send_end = unpack(s.send_end, frame.time),
+	        .received_first_packet = unpack(s.received_first_packet, frame.time),
+	        .received_last_packet = unpack(s.received_last_packet, frame.time),
+	        .sent_to_decoder = unpack(s.sent_to_decoder, frame.time),
+	        .received_from_decoder = unpack(s.received_from_decoder, frame.time),
+	        .blitted = unpack(s.blitted, frame.time),
+	        .displayed = unpack(s.displayed, frame.time),
+	        .times_displayed = s.times_displayed,
+	};
+}
+
+batch feedback_batch_sender::push(std::span<const from_headset::feedback> feedback)
+{
+	frames.push_back(pack_feedback(sequence++, feedback));
+	while (frames.size() > batch::history)
+		frames.pop_front();
+
+	// The packet is a copy: encryption modifies the serialized data in place
+	return batch{.frames = {frames.begin(), frames.end()}};
+}
+
+std::span<const batch::frame> feedback_batch_receiver::operator()(const batch & packet)
+{
+	std::span<const batch::frame> frames = packet.frames;
+	if (frames.empty())
+		return {};
+
+	if (next_sequence)
+	{
+		// Late or duplicated packet
+		if (int32_t(frames.back().sequence - *next_sequence) < 0)
+			return {};
+
+		while (not frames.empty() and int32_t(frames.front().sequence - *next_sequence) < 0)
+			frames = frames.subspan(1);
+
+		if (not frames.empty())
+			lost += frames.front().sequence - *next_sequence;
+	}
+
+	next_sequence = packet.frames.back().sequence + 1;
+	return frames;
+}
+
+} // namespace wivrn
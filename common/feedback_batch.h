@@ -0,0 +1,65 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wivrn_packets.h"
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <span>
+
+namespace wivrn
+{
+
+// Packs the feedback of the streams displayed in a headset frame.
+//
+// Timestamps are stored in 32 bits relative to the blit time of the first stream and clamped to
+// ±2.1 s, the frame index of each stream relative to the one of the first stream.
+from_headset::feedback_batch::frame pack_feedback(uint32_t sequence, std::span<const from_headset::feedback>);
+
+from_headset::feedback unpack_feedback(const from_headset::feedback_batch::frame &, const from_headset::feedback_batch::stream &);
+
+// Keeps the last headset frames and builds the packet to send after each one.
+class feedback_batch_sender
+{
+	std::deque<from_headset::feedback_batch::frame> frames;
+	uint32_t sequence = 0;
+
+public:
+	// Feedback of the streams displayed in this frame, returns the packet to send
+	from_headset::feedback_batch push(std::span<const from_headset::feedback>);
+};
+
+// Returns the frames of each packet that were not in the previous ones.
+//
+// Packets arriving after a newer one are ignored.
+class feedback_batch_receiver
+{
+	std::optional<uint32_t> next_sequence;
+
+public:
+	// Frames missing from all received packets
+	uint64_t lost = 0;
+
+	std::span<const from_headset::feedback_batch::frame> operator()(const from_headset::feedback_batch &);
+};
+
+} // namespace wivrn
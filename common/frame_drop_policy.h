@@ -0,0 +1,81 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace wivrn
+{
+
+// Decides which frames the headset drops between reception and decoding.
+//
+// Dropping a frame that later frames reference makes the server send an IDR frame, which is
+// slower to decode: a late decoder must not drop frames, or each IDR frame makes it late again.
+// Frames are only dropped when too many wait for the decoder, then all frames until the next IDR
+// frame are dropped too as they cannot be decoded. Frames still queued when an IDR frame is
+// queued are superseded: they are skipped without feedback.
+//
+// The queue keeps room for IDR frames, so that the one requested after a drop is not dropped
+// too while the decoder is stuck.
+class frame_drop_policy
+{
+public:
+	// Other frames are dropped when that many frames are waiting, the queue must be larger
+	static constexpr size_t max_waiting = 5;
+
+private:
+	// Last IDR frame pushed to the queue, written by the network thread
+	std::atomic<uint64_t> last_idr = 0;
+	// A frame was dropped since the last IDR frame, network thread only
+	bool broken = false;
+
+public:
+	// Network thread: false if the frame must be dropped without trying to queue it
+	bool accept(bool idr, size_t waiting) const
+	{
+		return idr or (not broken and waiting < max_waiting);
+	}
+
+	// Network thread: the frame was pushed to the queue
+	void queued(uint64_t frame_index, bool idr)
+	{
+		if (idr)
+		{
+			last_idr = frame_index;
+			broken = false;
+		}
+	}
+
+	// Network thread: the frame was dropped
+	void dropped()
+	{
+		broken = true;
+	}
+
+	// Decoding thread: true if an IDR frame was queued after this frame
+	bool superseded(uint64_t frame_index) const
+	{
+		return frame_index < last_idr;
+	}
+};
+
+} // namespace wivrn
@@ -18,6 +18,7 @@
  */
 
 #include "secrets.h"
+#include <algorithm>
 #include <cstring>
 #include <type_traits>
 
@@ -30,3 +31,22 @@ secrets::secrets(crypto::key & my_key, crypto::key & peer_key, const std::string
 	static_assert(std::has_unique_object_representations_v<secrets>);
 	memcpy(this, secret.data(), secret.size());
 }
+
+secrets::secrets(const secrets & previous, std::span<const std::uint8_t, 16> headset_nonce, std::span<const std::uint8_t, 16> server_nonce)
+{
+	std::string salt = "resume";
+	salt.append((const char *)headset_nonce.data(), headset_nonce.size());
+	salt.append((const char *)server_nonce.data(), server_nonce.size());
+
+	std::vector<uint8_t> secret = crypto::pbkdf2(std::string((const char *)&previous, sizeof(previous)), salt, {}, sizeof(*this));
+	memcpy(this, secret.data(), secret.size());
+}
+
+std::array<std::uint8_t, 16> secrets::resume_ticket() const
+{
+	std::vector<uint8_t> secret = crypto::pbkdf2(std::string((const char *)this, sizeof(*this)), "resume ticket", {}, 16);
+
+	std::array<std::uint8_t, 16> ticket{};
+	std::ranges::copy(secret, ticket.begin());
+	return ticket;
+}
@@ -22,6 +22,7 @@
 #include "crypto.h"
 #include <array>
 #include <cstdint>
+#include <span>
 #include <string>
 
 struct secrets
@@ -35,4 +36,11 @@ struct secrets
 	std::array<std::uint8_t, 8> stream_iv_header_from_headset;
 
 	secrets(crypto::key & my_key, crypto::key & peer_key, const std::string & pin);
+
+	// Keys of a resumed session, derived from the previous keys and fresh nonces from both ends
+	// so that the cipher streams are never reused
+	secrets(const secrets & previous, std::span<const std::uint8_t, 16> headset_nonce, std::span<const std::uint8_t, 16> server_nonce);
+
+	// Identifies the session when the headset reconnects, only known to both ends
+	std::array<std::uint8_t, 16> resume_ticket() const;
 };
@@ -22,6 +22,7 @@
 #include <array>
 #include <chrono>
 #include <cstdint>
+#include <limits>
 #include <magic_enum.hpp>
 #include <netinet/in.h>
 #include <openssl/aes.h>
@@ -216,6 +217,8 @@ enum class stream_tab : uint8_t
 struct audio_data
 {
 	XrTime timestamp;
+	// Incremented for each packet, to detect losses on the stream socket
+	uint32_t sequence;
 	std::span<uint8_t> payload;
 	data_holder data;
 };
@@ -224,9 +227,17 @@ namespace from_headset
 {
 struct crypto_handshake
 {
+	struct resume_request
+	{
+		std::array<uint8_t, 16> ticket; // See secrets::resume_ticket
+		std::array<uint8_t, 16> nonce;
+	};
+
 	uint64_t protocol_version;
 	std::string public_key; // In PEM format
 	std::string name;
+	// Set when reconnecting after a connection loss, to skip the key exchange
+	std::optional<resume_request> resume;
 };
 
 struct pin_check_1
@@ -323,6 +334,8 @@ struct headset_info_packet
 	bool palm_pose;
 	bool user_presence;
 	bool passthrough;
+	// XR_KHR_composition_layer_depth is available, the stream can include depth
+	bool composition_layer_depth;
 	face_type face_tracking;
 	body_type body_tracking;
 	// htc body only
@@ -629,6 +642,48 @@ struct feedback
 	uint8_t times_displayed;
 };
 
+// Feedback of the frames displayed by the headset, sent on the stream socket once per headset
+// frame with the last frames again so that lost packets can be recovered, see feedback_batch.h
+struct feedback_batch
+{
+	// Number of headset frames in each packet
+	static constexpr size_t history = 4;
+	// Value of timestamps that are 0 in the feedback packet
+	static constexpr int32_t unset = std::numeric_limits<int32_t>::min();
+
+	struct stream
+	{
+		uint8_t stream_index;
+		uint8_t times_displayed;
+		// Difference with frame::frame_index
+		int16_t frame_index;
+
+		// Timestamps relative to frame::time, in ns
+		int32_t encode_begin;
+		int32_t encode_end;
+		int32_t send_begin;
+		int32_t send_end;
+		int32_t received_first_packet;
+		int32_t received_last_packet;
+		int32_t sent_to_decoder;
+		int32_t received_from_decoder;
+		int32_t blitted;
+		int32_t displayed;
+	};
+
+	struct frame
+	{
+		// Consecutive for each headset frame
+		uint32_t sequence;
+		uint64_t frame_index;
+		XrTime time;
+		std::vector<stream> streams;
+	};
+
+	// Oldest first
+	std::vector<frame> frames;
+};
+
 struct battery
 {
 	float charge;
@@ -698,6 +753,7 @@ using packets = std::variant<
         headset_info_packet,
         settings_changed,
         feedback,
+        feedback_batch,
         audio_data,
         handshake,
         tracking,
@@ -736,10 +792,12 @@ struct crypto_handshake
 		client_already_paired,
 		pairing_disabled,
 		incompatible_version,
+		resumed,
 	};
 
 	std::string public_key; // In PEM format
 	crypto_state state;
+	std::array<uint8_t, 16> nonce{}; // Only when resumed
 };
 
 struct pin_check_2
@@ -790,6 +848,17 @@ struct foveation_parameter
 	std::vector<uint16_t> y;
 };
 
+// Sent on the control channel before the first frame that references it
+struct foveation_parameter_set
+{
+	// Ids are never reused, the server sends a set again with a new id
+	// when it is older than headset_history
+	static constexpr uint32_t headset_history = 256;
+
+	uint32_t id;
+	foveation_parameter parameter;
+};
+
 struct audio_stream_description
 {
 	struct device
@@ -810,6 +879,9 @@ struct video_stream_description
 	std::array<video_codec, 3> codec; // left, right, alpha
 	float frame_rate;
 	float refresh_rate;
+	// The alpha stream is full height, with depth below alpha,
+	// see depth_packing.h for the encoding
+	bool depth;
 
 	bool operator==(const video_stream_description &) const = default;
 };
@@ -836,9 +908,14 @@ public:
 
 		std::array<XrPosef, 2> pose;
 		std::array<XrFovf, 2> fov;
-		std::array<foveation_parameter, 2> foveation;
+		// Id of the foveation_parameter_set for each view
+		std::array<uint32_t, 2> foveation;
 		// True when the frame contains an alpha channel
 		bool alpha;
+		// True when the alpha stream of the frame contains depth
+		bool depth;
+		// True when the frame does not reference previous frames
+		bool idr;
 	};
 	std::optional<view_info_t> view_info;
 
@@ -953,7 +1030,8 @@ using packets = std::variant<
         stream_tab_change,
         application_list,
         application_icon,
-        running_applications>;
+        running_applications,
+        foveation_parameter_set>;
 } // namespace to_headset
 } // namespace wivrn
 
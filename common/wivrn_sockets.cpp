@@ -33,11 +33,62 @@
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <system_error>
+#include <time.h>
 #include <unistd.h>
 
 thread_local crypto::encrypt_context wivrn::UDP::encrypter{EVP_aes_128_ctr()};
 std::atomic<uint64_t> wivrn::UDP::iv_counter;
 
+namespace
+{
+int64_t ns(const timespec & ts)
+{
+	return ts.tv_sec * 1'000'000'000ll + ts.tv_nsec;
+}
+
+// Receive timestamps are taken by the kernel when the packet arrives, instead of when the
+// application gets to read it
+void enable_timestamps(int fd)
+{
+	int enable = 1;
+	setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+}
+
+// Kernel timestamps are in CLOCK_REALTIME, returns the current time for messages without one
+class timestamp_converter
+{
+	int64_t monotonic;
+	int64_t realtime;
+
+public:
+	timestamp_converter()
+	{
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		monotonic = ns(ts);
+		clock_gettime(CLOCK_REALTIME, &ts);
+		realtime = ns(ts);
+	}
+
+	int64_t operator()(const msghdr & hdr) const
+	{
+		for (cmsghdr * cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(const_cast<msghdr *>(&hdr), cmsg))
+		{
+			if (cmsg->cmsg_level == SOL_SOCKET and cmsg->cmsg_type == SCM_TIMESTAMPNS)
+			{
+				timespec ts;
+				memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+				// Never in the future, realtime may have been adjusted
+				return std::min(monotonic, monotonic - (realtime - ns(ts)));
+			}
+		}
+		return monotonic;
+	}
+};
+
+using timestamp_control = std::array<uint8_t, CMSG_SPACE(sizeof(timespec))>;
+} // namespace
+
 const char * wivrn::invalid_packet::what() const noexcept
 {
 	return "Invalid packet";
@@ -72,11 +123,13 @@ wivrn::UDP::UDP()
 	if (fd < 0)
 		throw std::system_error{errno, std::generic_category()};
 	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	enable_timestamps(fd);
 }
 
 wivrn::UDP::UDP(int fd)
 {
 	this->fd = fd;
+	enable_timestamps(fd);
 }
 
 void wivrn::UDP::bind(sockaddr_in6 address)
@@ -164,6 +217,7 @@ void wivrn::TCP::init()
 	}
 
 	mutex = std::make_unique<std::mutex>();
+	enable_timestamps(fd);
 }
 
 wivrn::TCP::TCP(int fd)
@@ -290,8 +344,9 @@ wivrn::deserialization_packet wivrn::UDP::receive_pending()
 	if (messages.empty())
 		return {};
 
-	auto span = messages.back();
+	auto [span, time] = messages.back();
 	messages.pop_back();
+	receive_time_ = time;
 	return deserialization_packet{buffer, span};
 }
 
@@ -299,8 +354,9 @@ wivrn::deserialization_packet wivrn::UDP::receive_raw()
 {
 	if (not messages.empty())
 	{
-		auto span = messages.back();
+		auto [span, time] = messages.back();
 		messages.pop_back();
+		receive_time_ = time;
 		return deserialization_packet{buffer, span};
 	}
 
@@ -312,6 +368,7 @@ wivrn::deserialization_packet wivrn::UDP::receive_raw()
 	}
 	std::array<iovec, num_messages> iovecs;
 	std::array<mmsghdr, num_messages> mmsgs;
+	std::array<timestamp_control, num_messages> controls;
 	for (size_t i = 0; i < num_messages; ++i)
 	{
 		iovecs[i] = {
@@ -323,17 +380,24 @@ wivrn::deserialization_packet wivrn::UDP::receive_raw()
 		        .msg_hdr = {
 		                .msg_iov = &iovecs[i],
 		                .msg_iovlen = 1,
+		                .msg_control = controls[i].data(),
+		                .msg_controllen = controls[i].size(),
 		        },
 		};
 	}
 
 	int received = recvmmsg(fd, mmsgs.data(), num_messages, MSG_DONTWAIT, nullptr);
 
+	// Nothing left to read, lets callers drain the socket
+	if (received < 0 and (errno == EAGAIN or errno == EWOULDBLOCK))
+		return {};
 	if (received < 0)
 		throw std::system_error{errno, std::generic_category()};
 	if (received == 0)
 		throw socket_shutdown();
 
+	timestamp_converter timestamp;
+
 	messages.reserve(received);
 
 	for (int i = received - 1; i >= 0; --i)
@@ -358,9 +422,12 @@ wivrn::deserialization_packet wivrn::UDP::receive_raw()
 		}
 
 		if (i == 0)
+		{
+			receive_time_ = timestamp(mmsgs[i].msg_hdr);
 			return deserialization_packet{buffer, message};
+		}
 
-		messages.push_back(message);
+		messages.push_back({message, timestamp(mmsgs[i].msg_hdr)});
 	}
 
 	__builtin_unreachable();
@@ -485,22 +552,39 @@ wivrn::deserialization_packet wivrn::TCP::receive_raw()
 
 	if (capacity_left > 0)
 	{
-		ssize_t received_size = recv(fd, &*data.end(), capacity_left, MSG_DONTWAIT);
+		iovec iov{
+		        .iov_base = &*data.end(),
+		        .iov_len = size_t(capacity_left),
+		};
+		timestamp_control control;
+		msghdr hdr{
+		        .msg_iov = &iov,
+		        .msg_iovlen = 1,
+		        .msg_control = control.data(),
+		        .msg_controllen = control.size(),
+		};
+		ssize_t received_size = recvmsg(fd, &hdr, MSG_DONTWAIT);
 
-		if (received_size < 0)
+		if (received_size < 0 and errno != EAGAIN and errno != EWOULDBLOCK)
 			throw std::system_error{errno, std::generic_category()};
 
 		if (received_size == 0)
 			throw socket_shutdown{};
 
-		if (decrypter)
+		// Nothing left to read, a complete packet may still be buffered
+		if (received_size > 0)
 		{
-			std::span<uint8_t> received_data{&*data.end(), (size_t)received_size};
-			decrypter.decrypt_in_place(received_data);
-		}
+			receive_time_ = timestamp_converter{}(hdr);
+
+			if (decrypter)
+			{
+				std::span<uint8_t> received_data{&*data.end(), (size_t)received_size};
+				decrypter.decrypt_in_place(received_data);
+			}
 
-		data = std::span(data.data(), data.size() + received_size);
-		capacity_left -= received_size;
+			data = std::span(data.data(), data.size() + received_size);
+			capacity_left -= received_size;
+		}
 	}
 
 	if (data.size_bytes() < sizeof(uint32_t))
@@ -95,8 +95,14 @@ public:
 
 class UDP : public fd_base
 {
+	struct message
+	{
+		std::span<uint8_t> data;
+		int64_t receive_time;
+	};
 	std::shared_ptr<uint8_t[]> buffer;
-	std::vector<std::span<uint8_t>> messages;
+	std::vector<message> messages;
+	int64_t receive_time_ = 0;
 
 	crypto::decrypt_context decrypter;
 	static thread_local crypto::encrypt_context encrypter;
@@ -128,6 +134,13 @@ public:
 	void set_tos(int type_of_service);
 
 	void set_aes_key_and_ivs(std::span<std::uint8_t, 16> key, std::span<std::uint8_t, 8> recv_iv_header, std::span<std::uint8_t, 8> send_iv_header);
+
+	// CLOCK_MONOTONIC time at which the kernel received the last packet returned by receive_raw
+	// or receive_pending, in ns
+	int64_t receive_time() const
+	{
+		return receive_time_;
+	}
 };
 
 class TCP : public fd_base
@@ -136,6 +149,7 @@ class TCP : public fd_base
 	ssize_t capacity_left = 0;
 	std::span<uint8_t> data;
 	std::unique_ptr<std::mutex> mutex;
+	int64_t receive_time_ = 0;
 
 	void init();
 
@@ -154,6 +168,13 @@ public:
 	size_t send_many_raw(std::span<serialization_packet> packets);
 
 	void set_aes_key_and_ivs(std::span<std::uint8_t, 16> key, std::span<std::uint8_t, 16> recv_iv, std::span<std::uint8_t, 16> send_iv);
+
+	// CLOCK_MONOTONIC time at which the kernel received the end of the last packet returned by
+	// receive_raw or receive_pending, in ns
+	int64_t receive_time() const
+	{
+		return receive_time_;
+	}
 };
 
 using UnixDatagram = UDP;
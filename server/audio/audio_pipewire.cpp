@@ -18,6 +18,7 @@
 
 #include "audio_pipewire.h"
 
+#include "audio_transport.h"
 #include "driver/wivrn_session.h"
 #include "os/os_time.h"
 #include "util/u_logging.h"
@@ -56,7 +57,11 @@ struct pipewire_device : public audio_device
 	        .version = PW_VERSION_STREAM_EVENTS,
 	        .process = &pipewire_device::speaker_process,
 	};
+	// Filled from the realtime thread, sent from speaker_sender
+	std::optional<audio_send_queue> speaker_queue;
+	std::jthread speaker_sender;
 
+	std::optional<audio_loss_concealment> mic_concealment;
 	utils::ring_buffer<audio_data, 100> mic_samples;
 	std::atomic<size_t> mic_buffer_size_bytes;
 	audio_data mic_current;
@@ -70,6 +75,7 @@ struct pipewire_device : public audio_device
 	std::jthread thread;
 
 	static void speaker_process(void * self_v);
+	void speaker_send();
 	static void mic_process(void * self_v);
 	static void mic_state_changed(void * self_v, pw_stream_state old, pw_stream_state state, const char * error);
 
@@ -101,6 +107,11 @@ struct pipewire_device : public audio_device
 			        .num_channels = info.speaker->num_channels,
 			        .sample_rate = info.speaker->sample_rate,
 			};
+			speaker_queue.emplace(desc.speaker->num_channels, desc.speaker->sample_rate);
+			speaker_sender = std::jthread([this](std::stop_token stop) {
+				std::stop_callback wake(stop, [this]() { speaker_queue->stop(); });
+				speaker_send();
+			});
 
 			// Calculate quantum size: 5ms buffer for low latency while maintaining stability
 			// Smaller buffers (<5ms) risk underruns, larger ones (>10ms) add perceptible latency
@@ -250,6 +261,8 @@ struct pipewire_device : public audio_device
 			            1) < 0)
 				throw std::runtime_error("failed to connect microphone stream");
 			U_LOG_I("pipewire microphone stream created (quantum: %u frames, %.2f ms)", quantum_size, (quantum_size * 1000.0) / desc.microphone->sample_rate);
+
+			mic_concealment.emplace(desc.microphone->num_channels);
 		}
 
 		if (desc.speaker or desc.microphone)
@@ -389,27 +402,41 @@ void pipewire_device::speaker_process(void * self_v)
 	if (not data.data)
 		return;
 
-	try
-	{
-		self->session.send_control(audio_data{
-		        .timestamp = self->session.get_offset().to_headset(os_monotonic_get_ns()),
-		        .payload = std::span(
-		                (uint8_t *)data.data + data.chunk->offset,
-		                data.chunk->size),
-		});
-	}
-	catch (std::exception & e)
+	// Realtime thread: don't send from here, the socket may block
+	if (not self->speaker_queue->push(std::span((const uint8_t *)data.data + data.chunk->offset, data.chunk->size), os_monotonic_get_ns()))
+		U_LOG_D("Audio send queue full, dropping samples");
+	pw_stream_queue_buffer(self->speaker.get(), buffer);
+}
+
+void pipewire_device::speaker_send()
+{
+	while (speaker_queue->wait())
 	{
-		U_LOG_D("Failed to send audio data: %s", e.what());
+		while (auto packet = speaker_queue->pop())
+		{
+			try
+			{
+				packet->timestamp = session.get_offset().to_headset(packet->timestamp);
+				session.send_stream(std::move(*packet));
+			}
+			catch (std::exception & e)
+			{
+				U_LOG_D("Failed to send audio data: %s", e.what());
+			}
+		}
 	}
-	pw_stream_queue_buffer(self->speaker.get(), buffer);
 }
 
 void pipewire_device::process_mic_data(wivrn::audio_data && sample)
 {
-	auto size = sample.payload.size_bytes();
-	if (mic_samples.write(std::move(sample)))
-		mic_buffer_size_bytes += size;
+	if (not mic_concealment)
+		return;
+	for (auto & packet: (*mic_concealment)(std::move(sample)))
+	{
+		auto size = packet.payload.size_bytes();
+		if (mic_samples.write(std::move(packet)))
+			mic_buffer_size_bytes += size;
+	}
 }
 
 void pipewire_device::pause()
@@ -31,7 +31,9 @@
 #include "util/u_time.h"
 #include "vk/vk_helpers.h"
 
+#include "driver/configuration.h"
 #include "driver/wivrn_session.h"
+#include "encoder/encoder_cache.h"
 #include "encoder/video_encoder.h"
 #include "inplace_vector.hpp"
 #include "utils/method.h"
@@ -87,6 +89,17 @@ const comp_swapchain_image & get_layer_image(const comp_layer & layer, uint32_t
 	return reinterpret_cast<struct comp_swapchain *>(comp_layer_get_swapchain(&layer, swapchain_index))->images[image_index];
 }
 
+const comp_swapchain_image & get_layer_depth_image(const comp_layer & layer, uint32_t swapchain_index, uint32_t image_index)
+{
+	return reinterpret_cast<struct comp_swapchain *>(comp_layer_get_depth_swapchain(&layer, swapchain_index))->images[image_index];
+}
+
+// The alpha stream is only encoded for frames with alpha or depth
+bool is_encoded(const wivrn::to_headset::video_stream_data_shard::view_info_t & view_info, uint8_t stream_idx)
+{
+	return stream_idx < 2 or view_info.alpha or view_info.depth;
+}
+
 std::array<vk::Format, 3> image_formats(int bit_depth)
 {
 	switch (bit_depth)
@@ -296,6 +309,32 @@ xrt_result_t compositor::layer_commit(xrt_graphics_sync_handle_t sync_handle)
 		return XRT_SUCCESS;
 	}
 
+	// Check if we can pass a layer directly to foveation
+	const bool direct_layer = layer_accum.layer_count == 1 and
+	                          (layer_accum.layers[0].data.type == XRT_LAYER_PROJECTION or
+	                           layer_accum.layers[0].data.type == XRT_LAYER_PROJECTION_DEPTH);
+
+	if (skip_static_frames)
+	{
+		// Squashed layers are reprojected to the head pose
+		std::optional<xrt_pose> head;
+		if (not direct_layer)
+		{
+			xrt_space_relation rel{};
+			session.get_hmd().get_tracked_pose(XRT_INPUT_GENERIC_HEAD_POSE, frame.rendering.predicted_display_time_ns, &rel);
+			head = rel.pose;
+		}
+
+		if (static_frames.is_static(layer_accum, head, foveation.get_gaze(), os_monotonic_get_ns()))
+		{
+			U_LOG_IFL_T(log_level, "frame %ld is static, not encoded", frame.rendering.id);
+			++static_frame_count;
+			images[i].busy = false;
+			comp_frame_clear_locked(&frame.rendering);
+			return XRT_SUCCESS;
+		}
+	}
+
 #ifdef XRT_FEATURE_RENDERDOC
 	if (auto r = renderdoc())
 		r->StartFrameCapture(NULL, NULL);
@@ -320,13 +359,11 @@ xrt_result_t compositor::layer_commit(xrt_graphics_sync_handle_t sync_handle)
 	std::array<vk::ImageView, 2> src;
 	std::array<xrt_rect, 2> src_rect;
 	std::array<xrt_fov, 2> src_fov;
+	std::optional<std::array<wivrn::foveation::depth_layer, 2>> depth;
 
 	beman::inplace_vector::inplace_vector<vk::ImageMemoryBarrier2, 3> image_barriers;
 
-	// Check if we can pass a layer directly to foveation
-	if (layer_accum.layer_count == 1 and
-	    (layer_accum.layers[0].data.type == XRT_LAYER_PROJECTION or
-	     layer_accum.layers[0].data.type == XRT_LAYER_PROJECTION_DEPTH))
+	if (direct_layer)
 	{
 		const auto & layer = layer_accum.layers[0];
 		for (int view = 0; view < 2; ++view)
@@ -342,6 +379,27 @@ xrt_result_t compositor::layer_commit(xrt_graphics_sync_handle_t sync_handle)
 			view_info.pose[view] = xrt_cast(data.pose);
 			view_info.fov[view] = xrt_cast(data.fov);
 		}
+
+		if (stream_depth and layer.data.type == XRT_LAYER_PROJECTION_DEPTH)
+		{
+			depth.emplace();
+			for (int view = 0; view < 2; ++view)
+			{
+				const auto & data = layer.data.depth.d[view];
+				(*depth)[view] = {
+				        .image = get_image_view(
+				                &get_layer_depth_image(layer, view, data.sub.image_index),
+				                layer.data.flags,
+				                data.sub.array_index),
+				        .rect = data.sub.rect,
+				        .min_depth = data.min_depth,
+				        .max_depth = data.max_depth,
+				        .near_z = data.near_z,
+				        .far_z = data.far_z,
+				};
+			}
+			view_info.depth = true;
+		}
 	}
 	else
 	{
@@ -418,11 +476,18 @@ xrt_result_t compositor::layer_commit(xrt_graphics_sync_handle_t sync_handle)
 	        src,
 	        src_rect,
 	        src_fov,
-	        view_info.alpha);
+	        view_info.alpha,
+	        depth);
+
+	foveation.get_parameters(images[i].foveation);
+
+	// Reliable channel, parameters are received before the frame in most cases
+	for (auto & set: foveation.take_new_parameters())
+		session.send_control(std::move(set));
 
 	for (auto & encoder: encoders)
 	{
-		if (encoder->stream_idx == 2 and not view_info.alpha)
+		if (not is_encoded(view_info, encoder->stream_idx))
 			continue;
 		else if (encoder->need_transfer or encoder->target_queue == vk.queue.family_index)
 		{
@@ -483,10 +548,11 @@ xrt_result_t compositor::layer_commit(xrt_graphics_sync_handle_t sync_handle)
 
 	pacer.mark_timing_point(COMP_TARGET_TIMING_POINT_SUBMIT_END, frame.rendering.id, os_monotonic_get_ns());
 	auto info = pacer.present_to_info(frame.rendering.desired_present_time_ns);
+	encoded_frames[frame.rendering.id % encoded_frames.size()].store(frame.rendering.id, std::memory_order_relaxed);
 
 	for (auto & encoder: encoders)
 	{
-		if (encoder->stream_idx == 2 and not view_info.alpha)
+		if (not is_encoded(view_info, encoder->stream_idx))
 			continue;
 		encoder->present_image(
 		        images[i].image,
@@ -633,8 +699,11 @@ void compositor::encoder_work(std::stop_token tok)
 		{
 			for (auto & encoder: encoders)
 			{
-				if (encoder->stream_idx < 2 or image.view_info.alpha)
-					encoder->encode(session, image.view_info, image.frame_index);
+				if (is_encoded(image.view_info, encoder->stream_idx))
+					encoder->encode(session,
+					                image.view_info,
+					                encoder->stream_idx < 2 ? &image.foveation[encoder->stream_idx] : nullptr,
+					                image.frame_index);
 			}
 		}
 		catch (std::exception & e)
@@ -642,9 +711,34 @@ void compositor::encoder_work(std::stop_token tok)
 			U_LOG_W("encode error: %s", e.what());
 		}
 		image.busy = false;
+
+		if (bitrate_split)
+			reallocate_bitrate();
 	}
 }
 
+void compositor::reallocate_bitrate()
+{
+	auto now = os_monotonic_get_ns();
+	if (rate_stats_begin == 0)
+		rate_stats_begin = now;
+	if (now - rate_stats_begin < bitrate_split->period())
+		return;
+
+	std::array<bitrate_allocator::stream_stats, 3> stats;
+	for (auto [i, encoder]: std::ranges::enumerate_view(encoders))
+		stats[i] = encoder->take_rate_stats();
+
+	if (bitrate_split->update(stats, now - rate_stats_begin))
+	{
+		const auto & shares = bitrate_split->shares();
+		for (auto [i, encoder]: std::ranges::enumerate_view(encoders))
+			encoder->set_bitrate_share(shares[i]);
+		U_LOG_IFL_D(log_level, "Bitrate split: %.1f%% %.1f%% %.1f%%", shares[0] * 100, shares[1] * 100, shares[2] * 100);
+	}
+	rate_stats_begin = now;
+}
+
 void compositor::send_video_stream_description()
 
 {
@@ -652,6 +746,7 @@ void compositor::send_video_stream_description()
 	        .width = uint16_t(images[0].image.info().extent.width),
 	        .height = uint16_t(images[0].image.info().extent.height),
 	        .frame_rate = settings[0].fps,
+	        .depth = stream_depth,
 	};
 	get_display_refresh_rate(&desc.refresh_rate);
 	static_assert(std::tuple_size_v<decltype(settings)> == std::tuple_size_v<decltype(desc.codec)>);
@@ -694,7 +789,9 @@ compositor::compositor(wivrn_session & session) :
         frame_rate(settings[0].fps),
         pacer(U_TIME_1S_IN_NS / frame_rate),
         squasher(vk, render_extent(session.get_info())),
-        foveation(vk, images[0].image.info().extent)
+        foveation(vk, images[0].image.info().extent),
+        skip_static_frames(configuration().skip_static_frames),
+        stream_depth(settings[2].height == settings[0].height)
 {
 	comp_base * c_base = this;
 	// Ensure we can safely cast pointers
@@ -748,13 +845,40 @@ compositor::compositor(wivrn_session & session) :
 		throw std::runtime_error("comp_swapchain_shared_init failed");
 
 	print_encoders(settings);
-	for (auto [i, settings]: std::ranges::enumerate_view(settings))
-		encoders[i] = video_encoder::create(vk, settings, i);
+	try
+	{
+		for (auto [i, settings]: std::ranges::enumerate_view(settings))
+			encoders[i] = video_encoder::create(vk, settings, i);
+	}
+	catch (std::exception &)
+	{
+		// The encoder may have been selected from outdated probing results
+		encoder_cache::invalidate(vk);
+		throw;
+	}
+	if (configuration().dynamic_bitrate)
+	{
+		std::vector<double> shares;
+		for (const auto & i: settings)
+			shares.push_back(i.bitrate_multiplier);
+		bitrate_split.emplace(std::move(shares));
+
+		// libavcodec only reads the rate control settings when the encoder is opened
+		for (auto [i, settings]: std::ranges::enumerate_view(settings))
+		{
+			if (settings.encoder_name == encoder_vaapi)
+				bitrate_split->keep_share(i);
+		}
+	}
 	send_video_stream_description();
 
+	// Save now rather than on disconnection so that the pipelines are cached even if the server is killed
+	vk.save_pipeline_cache();
+
 	u_var_add_root(this, "Compositor", false);
 	u_var_add_f32_timing(this, &squasher_times.var, "layers processing");
 	u_var_add_f32_timing(this, &foveation_times.var, "foveation");
+	u_var_add_ro_u64(this, &static_frame_count, "static frames skipped");
 
 	// Start the thread after everything is initialized
 	encoder_thread = std::jthread{[&](std::stop_token t) { encoder_work(t); }};
@@ -825,8 +949,11 @@ void compositor::update_foveation_center_override(const from_headset::override_f
 
 void compositor::resume()
 {
+	static_frames.invalidate();
 	for (auto & encoder: encoders)
 		encoder->reset();
+	// The headset clears its foveation parameters when it receives the stream description
+	foveation.reset_parameters();
 	send_video_stream_description();
 }
 
@@ -841,4 +968,16 @@ void compositor::on_feedback(const from_headset::feedback & feedback, const cloc
 	pacer.on_feedback(feedback, o);
 }
 
+void compositor::on_feedback(std::span<const from_headset::feedback> frame, const clock_offset & o)
+{
+	for (const auto & feedback: frame)
+	{
+		if (feedback.stream_index < encoders.size())
+			encoders[feedback.stream_index]->on_feedback(feedback);
+	}
+	if (not o)
+		return;
+	pacer.on_feedback(frame, o);
+}
+
 } // namespace wivrn
@@ -24,10 +24,12 @@
 #include "util/comp_base.h"
 #include "util/u_logging.h"
 
+#include "encoder/bitrate_allocator.h"
 #include "encoder/encoder_settings.h"
 #include "foveation.h"
 #include "layer_squasher.h"
 #include "pacer.h"
+#include "static_frame_detector.h"
 #include "utils/wivrn_vk_bundle.h"
 
 #include "main/comp_compositor.h"
@@ -35,6 +37,8 @@
 #include <array>
 #include <atomic>
 #include <memory>
+#include <optional>
+#include <span>
 #include <thread>
 
 namespace wivrn
@@ -53,6 +57,7 @@ public:
 		vk::raii::ImageView view_y;
 		vk::raii::ImageView view_cbcr;
 		to_headset::video_stream_data_shard::view_info_t view_info{};
+		std::array<to_headset::foveation_parameter_set, 2> foveation;
 		uint64_t frame_index;
 	};
 
@@ -97,8 +102,21 @@ private:
 	layer_squasher squasher;
 	wivrn::foveation foveation;
 
+	const bool skip_static_frames;
+	// The alpha stream also carries depth
+	const bool stream_depth;
+	static_frame_detector static_frames;
+	uint64_t static_frame_count = 0;
+
+	// Frames given to the encoders, the headset reports the others as lost
+	std::array<std::atomic<int64_t>, 128> encoded_frames{};
+
 	std::array<std::unique_ptr<video_encoder>, 3> encoders;
 
+	// Moves bitrate between encoders, only used from the encoder thread, nullopt if disabled
+	std::optional<bitrate_allocator> bitrate_split;
+	int64_t rate_stats_begin = 0;
+
 #ifdef __cpp_lib_atomic_lock_free_type_aliases
 	using status_type = std::atomic_signed_lock_free;
 #else
@@ -161,6 +179,7 @@ private:
 	int acquire_image();
 
 	void encoder_work(std::stop_token);
+	void reallocate_bitrate();
 
 	void send_video_stream_description();
 
@@ -194,6 +213,13 @@ public:
 	void resume();
 
 	void on_feedback(const from_headset::feedback &, const clock_offset &);
+	// Feedback of all the streams displayed in a headset frame
+	void on_feedback(std::span<const from_headset::feedback>, const clock_offset &);
+
+	bool is_encoded(uint64_t frame_index) const
+	{
+		return encoded_frames[frame_index % encoded_frames.size()].load(std::memory_order_relaxed) == int64_t(frame_index);
+	}
 };
 
 } // namespace wivrn
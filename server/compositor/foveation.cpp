@@ -19,6 +19,7 @@
 
 #include "foveation.h"
 
+#include "depth_packing.h"
 #include "driver/xrt_cast.h"
 #include "utils/wivrn_vk_bundle.h"
 #include "vk/specialization_constants.h"
@@ -40,6 +41,9 @@ namespace
 {
 struct ubo_data
 {
+	// See shaders/foveation.comp
+	std::array<float, 4> depth_transform[2];
+	std::array<float, 4> depth_range[2];
 	uint32_t x[XRT_MAX_VIEWS * RENDER_FOVEATION_BUFFER_DIMENSIONS];
 	uint32_t y[XRT_MAX_VIEWS * RENDER_FOVEATION_BUFFER_DIMENSIONS];
 };
@@ -88,6 +92,12 @@ vk::raii::DescriptorSetLayout make_ds_layout(wivrn::vk_bundle & vk)
 	                .descriptorCount = 1,
 	                .stageFlags = vk::ShaderStageFlagBits::eCompute,
 	        },
+	        vk::DescriptorSetLayoutBinding{
+	                .binding = 4,
+	                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+	                .descriptorCount = 2,
+	                .stageFlags = vk::ShaderStageFlagBits::eCompute,
+	        },
 	};
 	vk::raii::DescriptorSetLayout res{
 	        vk.device,
@@ -111,39 +121,50 @@ vk::raii::PipelineLayout make_layout(wivrn::vk_bundle & vk, vk::DescriptorSetLay
 	return res;
 }
 
-std::array<vk::raii::Pipeline, 2> make_pipelines(wivrn::vk_bundle & vk, vk::PipelineLayout layout, int32_t alpha_width)
+std::array<vk::raii::Pipeline, 3> make_pipelines(wivrn::vk_bundle & vk, vk::PipelineLayout layout, int32_t alpha_width, int32_t depth_row)
 {
 	auto shader = vk.load_shader("foveation");
 	auto spc = make_specialization_constants(alpha_width);
-	std::array res{
-	        vk::raii::Pipeline{
-	                vk.device,
-	                nullptr,
-	                vk::ComputePipelineCreateInfo{
-	                        .stage = {
-	                                .stage = vk::ShaderStageFlagBits::eCompute,
-	                                .module = *shader,
-	                                .pName = "main",
-	                        },
-	                        .layout = layout,
+	auto spc_depth = make_specialization_constants(alpha_width, depth_row);
+
+	// All variants are created together so that the driver can compile them in parallel
+	std::array create_info{
+	        vk::ComputePipelineCreateInfo{
+	                .stage = {
+	                        .stage = vk::ShaderStageFlagBits::eCompute,
+	                        .module = *shader,
+	                        .pName = "main",
+	                },
+	                .layout = layout,
+	        },
+	        vk::ComputePipelineCreateInfo{
+	                .stage = {
+	                        .stage = vk::ShaderStageFlagBits::eCompute,
+	                        .module = *shader,
+	                        .pName = "main",
+	                        .pSpecializationInfo = spc,
 	                },
+	                .layout = layout,
 	        },
-	        vk::raii::Pipeline{
-	                vk.device,
-	                nullptr,
-	                vk::ComputePipelineCreateInfo{
-	                        .stage = {
-	                                .stage = vk::ShaderStageFlagBits::eCompute,
-	                                .module = *shader,
-	                                .pName = "main",
-	                                .pSpecializationInfo = spc,
-	                        },
-	                        .layout = layout,
+	        vk::ComputePipelineCreateInfo{
+	                .stage = {
+	                        .stage = vk::ShaderStageFlagBits::eCompute,
+	                        .module = *shader,
+	                        .pName = "main",
+	                        .pSpecializationInfo = spc_depth,
 	                },
+	                .layout = layout,
 	        },
 	};
+	auto pipelines = vk.device.createComputePipelines(vk.pipeline_cache, create_info);
+	std::array res{
+	        std::move(pipelines[0]),
+	        std::move(pipelines[1]),
+	        std::move(pipelines[2]),
+	};
 	vk.name(*res[0], "foveation pipeline");
 	vk.name(*res[1], "foveation+alpha pipeline");
+	vk.name(*res[2], "foveation+alpha+depth pipeline");
 	return res;
 }
 
@@ -152,7 +173,7 @@ vk::raii::DescriptorPool make_ds_pool(wivrn::vk_bundle & vk)
 	std::array pool_sizes{
 	        vk::DescriptorPoolSize{
 	                .type = vk::DescriptorType::eCombinedImageSampler,
-	                .descriptorCount = 2,
+	                .descriptorCount = 4,
 	        },
 	        vk::DescriptorPoolSize{
 	                .type = vk::DescriptorType::eStorageImage,
@@ -181,86 +202,6 @@ uint32_t divide_and_round_up(uint32_t a, uint32_t b)
 
 } // namespace
 
-// a, b: parameters computed by solve_foveation
-// λ: pixel ratio between full size and foveated image (in range ]0,1[)
-// c: coordinates in -1,1 range of the full size image where pixel ratio must be 1:1
-// x: coordinates in -1,1 range of the foveated image
-// result: full size image coordinates in -1,1 range
-static double defoveate(double a, double b, double λ, double c, double x)
-{
-	// In order to save encoding, transmit and decoding time, only a portion of the image is encoded in full resolution.
-	// on each axis, foveated coordinates are defined by the following formula.
-	return λ / a * tan(a * x + b) + c;
-	// a and b are defined such as:
-	// edges of the image are not moved
-	// f(-1) = -1
-	// f( 1) =  1
-	// the function also enforces pixel ratio 1:1 at fovea
-	// df⁻¹(x)/dx = 1/scale for x = c
-
-	// We then ensure that source and destination pixel grids match by
-	// rounding to integer pixel ratios: 1:1, 1:2 etc.
-	// Finally, pixel spans are sorted so that we only have increasing
-	// ratios going out from the center.
-}
-
-static std::tuple<float, float> solve_foveation(float λ, float c)
-{
-	// Compute a and b for the foveation function such that:
-	//   foveate(a, b, scale, c, -1) = -1   (eq. 1)
-	//   foveate(a, b, scale, c,  1) =  1   (eq. 2)
-	//
-	// Use eq. 2 to express a as function of b, then replace in eq. 1
-	// equation that needs to be null is:
-	auto b = [λ, c](double a) { return atan(a * (1 - c) / λ) - a; };
-	auto eq = [λ, c](double a) { return atan(a * (1 - c) / λ) + atan(a * (1 + c) / λ) - 2 * a; }; // (eq. 3)
-
-	// function starts positive, reaches a maximum then decreases to -∞
-	double a0 = 0;
-	// Find a negative value by computing eq(2^n)
-	double a1 = 1;
-	while (eq(a1) > 0)
-		a1 *= 2;
-
-	// last computed values for f(a0) and f(a1)
-	std::optional<double> f_a0;
-	double f_a1 = eq(a1);
-
-	int n = 0;
-	double a = 0;
-	while (std::abs(a1 - a0) > 0.0000001 && n++ < 100)
-	{
-		if (not f_a0)
-		{
-			// use binary search
-			a = 0.5 * (a0 + a1);
-			double val = eq(a);
-			if (val > 0)
-			{
-				a0 = a;
-				f_a0 = val;
-			}
-			else
-			{
-				a1 = a;
-				f_a1 = val;
-			}
-		}
-		else
-		{
-			// f(a1) is always defined
-			// when f(a0) is defined, use secant method
-			a = a1 - f_a1 * (a1 - a0) / (f_a1 - *f_a0);
-			a0 = a1;
-			a1 = a;
-			f_a0 = f_a1;
-			f_a1 = eq(a);
-		}
-	}
-
-	return {a, b(a)};
-}
-
 static bool is_zero_quat(xrt_quat q)
 {
 	return q.x == 0 and q.y == 0 and q.z == 0 and q.w == 0;
@@ -310,75 +251,37 @@ static float convergence_angle(float distance, float eye_x, float gaze_yaw)
 	return std::atan2(dx, dz);
 }
 
-static void fill_param_2d(
-        float c,
-        size_t foveated_dim,
-        size_t source_dim,
-        std::vector<uint16_t> & out)
-{
-	float scale = float(foveated_dim) / source_dim;
-	auto [a, b] = solve_foveation(scale, c);
-
-	uint16_t last = 0;
-	std::vector<uint16_t> left; // index 0: 1:1 ratio, then 2:1 etc.
-	std::vector<uint16_t> right;
-	for (size_t i = 1; i < foveated_dim; ++i)
-	{
-		double u = (i * 2.) / foveated_dim - 1;
-		auto f = defoveate(a, b, scale, c, u);
-		uint16_t n = std::clamp<uint16_t>((f * 0.5 + 0.5) * source_dim + 0.5, 0, source_dim);
-		assert(n > last);
-		size_t count = n - last;
-		auto & vec = u < c ? left : right;
-		if (count > vec.size())
-			vec.resize(count);
-		vec[count - 1]++;
-		last = n;
-	}
-	assert(last < source_dim);
-	size_t count = source_dim - last;
-	if (count > right.size())
-		right.resize(count);
-	right[count - 1]++;
-
-	count = std::max(left.size(), right.size());
-	out.clear();
-	out.resize(count - left.size());
-	out.insert(out.end(), left.rbegin(), left.rend());
-	if (not right.empty())
-		out.back() += right.front();
-	if (right.size() > 1)
-		out.insert(out.end(), right.begin() + 1, right.end());
-	out.resize(count * 2 - 1);
-}
-
 namespace wivrn
 {
 
-void foveation::compute_params()
+bool foveation::compute_params()
 {
 	auto e = yaw_pitch(gaze);
 
 	if (manual_foveation.enabled)
 		e.y = manual_foveation.pitch;
 
+	bool changed = false;
 	for (size_t i = 0; i < 2; ++i)
 	{
 		const auto & fov = last.fovs[i];
 
-		size_t extent_w = std::abs(last.src[i].extent.w);
-		if (foveated_size.width < extent_w)
+		foveation_table::axis x{
+		        .foveated_size = uint16_t(foveated_size.width),
+		        .source_size = uint16_t(std::abs(last.src[i].extent.w)),
+		};
+		if (x.foveated_size < x.source_size)
 		{
 			auto distance = manual_foveation.enabled ? manual_foveation.distance : convergence_distance;
 			auto angle_x = convergence_angle(distance, eye_x[i], -e.x);
-			auto center = angles_to_center(angle_x, fov.angle_left, fov.angle_right);
-			fill_param_2d(center, foveated_size.width, extent_w, params[i].x);
+			x.center = angles_to_center(angle_x, fov.angle_left, fov.angle_right);
 		}
-		else
-			params[i].x = {uint16_t(extent_w)};
 
-		size_t extent_h = std::abs(last.src[i].extent.h);
-		if (foveated_size.height < extent_h)
+		foveation_table::axis y{
+		        .foveated_size = uint16_t(foveated_size.height),
+		        .source_size = uint16_t(std::abs(last.src[i].extent.h)),
+		};
+		if (y.foveated_size < y.source_size)
 		{
 			auto angle_y = -e.y;
 			if (is_zero_quat(gaze) and not manual_foveation.enabled)
@@ -386,12 +289,17 @@ void foveation::compute_params()
 				// Natural gaze is not straight forward, adjust the angle
 				angle_y += angle_offset;
 			}
-			auto center = angles_to_center(-angle_y, fov.angle_up, fov.angle_down);
-			fill_param_2d(center, foveated_size.height, extent_h, params[i].y);
+			y.center = angles_to_center(-angle_y, fov.angle_up, fov.angle_down);
+		}
+
+		const auto & set = table.get(x, y);
+		if (set.id != params[i].id)
+		{
+			params[i] = set;
+			changed = true;
 		}
-		else
-			params[i].y = {uint16_t(extent_h)};
 	}
+	return changed;
 }
 
 foveation::foveation(wivrn::vk_bundle & bundle, vk::Extent3D foveated_size) :
@@ -415,7 +323,7 @@ foveation::foveation(wivrn::vk_bundle & bundle, vk::Extent3D foveated_size) :
         sampler(make_sampler(bundle)),
         ds_layout(make_ds_layout(bundle)),
         layout(make_layout(bundle, ds_layout)),
-        pipeline(make_pipelines(bundle, layout, foveated_size.width / 2)),
+        pipeline(make_pipelines(bundle, layout, foveated_size.width / 2, foveated_size.height / 2)),
         descriptor_pool(make_ds_pool(bundle)),
         descriptor_set(bundle.device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{
                 .descriptorPool = descriptor_pool,
@@ -458,6 +366,12 @@ void foveation::update_foveation_center_override(const from_headset::override_fo
 	manual_foveation = center;
 }
 
+xrt_quat foveation::get_gaze()
+{
+	std::lock_guard lock(mutex);
+	return gaze;
+}
+
 static void fill_ubo(
         std::span<uint32_t> ubo,
         const std::vector<uint16_t> & params,
@@ -524,6 +438,11 @@ void foveation::update_ubo(
 	    std::abs(last.manual_foveation.distance - manual_foveation.distance) < 0.0005)
 		return;
 
+	// The gaze moved, but may still be in the same cell of the foveation center grid
+	bool same_geometry = last.flip_y == flip_y and
+	                     last.src[0] == src_rect[0] and
+	                     last.src[1] == src_rect[1];
+
 	last = {
 	        .gaze = gaze,
 	        .flip_y = flip_y,
@@ -533,7 +452,8 @@ void foveation::update_ubo(
 	        .manual_foveation = manual_foveation,
 	};
 
-	compute_params();
+	if (not compute_params() and same_geometry)
+		return;
 
 	ubo_data ubo;
 	for (size_t view = 0; view < 2; ++view)
@@ -553,7 +473,7 @@ void foveation::update_ubo(
 			extent = src_rect[view].extent.w;
 		}
 		fill_ubo(std::span(ubo.x + view * RENDER_FOVEATION_BUFFER_DIMENSIONS, RENDER_FOVEATION_BUFFER_DIMENSIONS),
-		         params[view].x,
+		         params[view].parameter.x,
 		         flip,
 		         offset,
 		         extent,
@@ -572,7 +492,7 @@ void foveation::update_ubo(
 			extent = src_rect[view].extent.h;
 		}
 		fill_ubo(std::span(ubo.y + view * RENDER_FOVEATION_BUFFER_DIMENSIONS, RENDER_FOVEATION_BUFFER_DIMENSIONS),
-		         params[view].y,
+		         params[view].parameter.y,
 		         flip,
 		         offset,
 		         extent,
@@ -582,7 +502,7 @@ void foveation::update_ubo(
 	std::memcpy(gpu_buffer.data<ubo_data>(), &ubo, sizeof(ubo));
 }
 
-std::array<to_headset::foveation_parameter, 2> foveation::foveate(
+std::array<uint32_t, 2> foveation::foveate(
         vk::raii::Device & device,
         vk::raii::CommandBuffer & cmd,
         vk::ImageView y,
@@ -591,11 +511,49 @@ std::array<to_headset::foveation_parameter, 2> foveation::foveate(
         std::array<vk::ImageView, 2> src,
         std::array<xrt_rect, 2> src_rect,
         std::array<xrt_fov, 2> src_fov,
-        bool alpha)
+        bool alpha,
+        const std::optional<std::array<depth_layer, 2>> & depth)
 {
 	update_ubo(cmd, flip_y, src_rect, src_fov);
 	auto ubo = gpu_buffer.data<ubo_data>();
 
+	// Without depth, the colour images are bound instead but not read
+	std::array depth_image_info{
+	        vk::DescriptorImageInfo{
+	                .sampler = *sampler,
+	                .imageView = depth ? (*depth)[0].image : src[0],
+	                .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+	        },
+	        vk::DescriptorImageInfo{
+	                .sampler = *sampler,
+	                .imageView = depth ? (*depth)[1].image : src[1],
+	                .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+	        },
+	};
+
+	if (depth)
+	{
+		for (int view = 0; view < 2; ++view)
+		{
+			const auto & d = (*depth)[view];
+			const auto & s = src_rect[view];
+			float scale_x = float(d.rect.extent.w) / s.extent.w;
+			float scale_y = float(d.rect.extent.h) / s.extent.h;
+			ubo->depth_transform[view] = {
+			        scale_x,
+			        scale_y,
+			        d.rect.offset.w - s.offset.w * scale_x,
+			        d.rect.offset.h - s.offset.h * scale_y,
+			};
+			ubo->depth_range[view] = {
+			        d.min_depth,
+			        d.max_depth,
+			        depth_packing::near_plane / d.near_z,
+			        depth_packing::near_plane / d.far_z,
+			};
+		}
+	}
+
 	std::array src_image_info{
 	        vk::DescriptorImageInfo{
 	                .sampler = *sampler,
@@ -652,16 +610,45 @@ std::array<to_headset::foveation_parameter, 2> foveation::foveate(
 	                .descriptorType = vk::DescriptorType::eStorageImage,
 	                .pImageInfo = &cbcr_info,
 	        },
+	        vk::WriteDescriptorSet{
+	                .dstSet = descriptor_set,
+	                .dstBinding = 4,
+	                .descriptorCount = depth_image_info.size(),
+	                .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+	                .pImageInfo = depth_image_info.data(),
+	        },
 	};
 
 	device.updateDescriptorSets(writes, {});
 
-	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *pipeline[alpha]);
+	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *pipeline[depth ? 2 : alpha]);
 	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *layout, 0, descriptor_set, {});
 	cmd.dispatch(divide_and_round_up(foveated_size.width, 8),
 	             divide_and_round_up(foveated_size.height, 8),
 	             2);
 
-	return params;
+	return {params[0].id, params[1].id};
+}
+
+void foveation::get_parameters(std::array<to_headset::foveation_parameter_set, 2> & out)
+{
+	std::lock_guard lock(mutex);
+	for (size_t i = 0; i < out.size(); ++i)
+	{
+		if (out[i].id != params[i].id)
+			out[i] = params[i];
+	}
+}
+
+std::vector<to_headset::foveation_parameter_set> foveation::take_new_parameters()
+{
+	std::lock_guard lock(mutex);
+	return table.take_new_sets();
+}
+
+void foveation::reset_parameters()
+{
+	std::lock_guard lock(mutex);
+	table.reset();
 }
 } // namespace wivrn
@@ -19,11 +19,13 @@
 
 #pragma once
 
+#include "foveation_table.h"
 #include "vk/allocation.h"
 #include "wivrn_packets.h"
 #include "xrt/xrt_defines.h"
 
 #include <mutex>
+#include <optional>
 #include <vulkan/vulkan_raii.hpp>
 
 struct render_resources;
@@ -48,14 +50,16 @@ class foveation
 	float eye_x[2] = {}; // eye x position
 	xrt_quat gaze = {};
 	from_headset::override_foveation_center manual_foveation = {};
-	std::array<to_headset::foveation_parameter, 2> params;
+	foveation_table table;
+	std::array<to_headset::foveation_parameter_set, 2> params{};
 
 	buffer_allocation gpu_buffer;
 	vk::raii::Sampler sampler;
 
 	vk::raii::DescriptorSetLayout ds_layout;
 	vk::raii::PipelineLayout layout;
-	std::array<vk::raii::Pipeline, 2> pipeline;
+	// Without alpha, with alpha, with alpha and depth
+	std::array<vk::raii::Pipeline, 3> pipeline;
 	vk::raii::DescriptorPool descriptor_pool;
 	vk::DescriptorSet descriptor_set;
 
@@ -73,7 +77,8 @@ class foveation
 	P last;
 
 	// must hold lock on mutex to call it
-	void compute_params();
+	// returns true if the parameters changed
+	bool compute_params();
 
 	void update_ubo(
 	        vk::raii::CommandBuffer & cmd,
@@ -82,13 +87,29 @@ class foveation
 	        std::array<xrt_fov, 2> src_fov);
 
 public:
+	// Depth image of a projection layer, see XrCompositionLayerDepthInfoKHR
+	struct depth_layer
+	{
+		vk::ImageView image;
+		xrt_rect rect;
+		float min_depth;
+		float max_depth;
+		float near_z;
+		float far_z;
+	};
+
 	foveation(wivrn::vk_bundle &,
 	          vk::Extent3D foveated_size);
 
 	void update_tracking(const from_headset::tracking &);
 	void update_foveation_center_override(const from_headset::override_foveation_center &);
 
-	std::array<to_headset::foveation_parameter, 2> foveate(
+	// Last received eye gaze, zero if not tracked
+	xrt_quat get_gaze();
+
+	// Returns the id of the foveation parameters for each view
+	// Alpha is always written when there is depth
+	std::array<uint32_t, 2> foveate(
 	        vk::raii::Device &,
 	        vk::raii::CommandBuffer & cmd,
 	        vk::ImageView y,
@@ -97,6 +118,16 @@ public:
 	        std::array<vk::ImageView, 2> src,
 	        std::array<xrt_rect, 2> src_rect,
 	        std::array<xrt_fov, 2> src_fov,
-	        bool alpha);
+	        bool alpha,
+	        const std::optional<std::array<depth_layer, 2>> & depth);
+
+	// Parameters used by the last call to foveate, out is only modified if they changed
+	void get_parameters(std::array<to_headset::foveation_parameter_set, 2> & out);
+
+	// Parameters used by the frames returned by foveate that were not sent yet
+	std::vector<to_headset::foveation_parameter_set> take_new_parameters();
+
+	// The headset started a new stream and lost the parameters sent so far
+	void reset_parameters();
 };
 } // namespace wivrn
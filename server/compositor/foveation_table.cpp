@@ -0,0 +1,238 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2024  galister <galister@librevr.org>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "foveation_table.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <optional>
+#include <tuple>
+
+// a, b: parameters computed by solve_foveation
+// λ: pixel ratio between full size and foveated image (in range ]0,1[)
+// c: coordinates in -1,1 range of the full size image where pixel ratio must be 1:1
+// x: coordinates in -1,1 range of the foveated image
+// result: full size image coordinates in -1,1 range
+static double defoveate(double a, double b, double λ, double c, double x)
+{
+	// In order to save encoding, transmit and decoding time, only a portion of the image is encoded in full resolution.
+	// on each axis, foveated coordinates are defined by the following formula.
+	return λ / a * tan(a * x + b) + c;
+	// a and b are defined such as:
+	// edges of the image are not moved
+	// f(-1) = -1
+	// f( 1) =  1
+	// the function also enforces pixel ratio 1:1 at fovea
+	// df⁻¹(x)/dx = 1/scale for x = c
+
+	// We then ensure that source and destination pixel grids match by
+	// rounding to integer pixel ratios: 1:1, 1:2 etc.
+	// Finally, pixel spans are sorted so that we only have increasing
+	// ratios going out from the center.
+}
+
+static std::tuple<float, float> solve_foveation(float λ, float c)
+{
+	// Compute a and b for the foveation function such that:
+	//   foveate(a, b, scale, c, -1) = -1   (eq. 1)
+	//   foveate(a, b, scale, c,  1) =  1   (eq. 2)
+	//
+	// Use eq. 2 to express a as function of b, then replace in eq. 1
+	// equation that needs to be null is:
+	auto b = [λ, c](double a) { return atan(a * (1 - c) / λ) - a; };
+	auto eq = [λ, c](double a) { return atan(a * (1 - c) / λ) + atan(a * (1 + c) / λ) - 2 * a; }; // (eq. 3)
+
+	// function starts positive, reaches a maximum then decreases to -∞
+	double a0 = 0;
+	// Find a negative value by computing eq(2^n)
+	double a1 = 1;
+	while (eq(a1) > 0)
+		a1 *= 2;
+
+	// last computed values for f(a0) and f(a1)
+	std::optional<double> f_a0;
+	double f_a1 = eq(a1);
+
+	int n = 0;
+	double a = 0;
+	while (std::abs(a1 - a0) > 0.0000001 && n++ < 100)
+	{
+		if (not f_a0)
+		{
+			// use binary search
+			a = 0.5 * (a0 + a1);
+			double val = eq(a);
+			if (val > 0)
+			{
+				a0 = a;
+				f_a0 = val;
+			}
+			else
+			{
+				a1 = a;
+				f_a1 = val;
+			}
+		}
+		else
+		{
+			// f(a1) is always defined
+			// when f(a0) is defined, use secant method
+			a = a1 - f_a1 * (a1 - a0) / (f_a1 - *f_a0);
+			a0 = a1;
+			a1 = a;
+			f_a0 = f_a1;
+			f_a1 = eq(a);
+		}
+	}
+
+	return {a, b(a)};
+}
+
+static void fill_param_2d(
+        float c,
+        size_t foveated_dim,
+        size_t source_dim,
+        std::vector<uint16_t> & out)
+{
+	float scale = float(foveated_dim) / source_dim;
+	auto [a, b] = solve_foveation(scale, c);
+
+	uint16_t last = 0;
+	std::vector<uint16_t> left; // index 0: 1:1 ratio, then 2:1 etc.
+	std::vector<uint16_t> right;
+	for (size_t i = 1; i < foveated_dim; ++i)
+	{
+		double u = (i * 2.) / foveated_dim - 1;
+		auto f = defoveate(a, b, scale, c, u);
+		uint16_t n = std::clamp<uint16_t>((f * 0.5 + 0.5) * source_dim + 0.5, 0, source_dim);
+		assert(n > last);
+		size_t count = n - last;
+		auto & vec = u < c ? left : right;
+		if (count > vec.size())
+			vec.resize(count);
+		vec[count - 1]++;
+		last = n;
+	}
+	assert(last < source_dim);
+	size_t count = source_dim - last;
+	if (count > right.size())
+		right.resize(count);
+	right[count - 1]++;
+
+	count = std::max(left.size(), right.size());
+	out.clear();
+	out.resize(count - left.size());
+	out.insert(out.end(), left.rbegin(), left.rend());
+	if (not right.empty())
+		out.back() += right.front();
+	if (right.size() > 1)
+		out.insert(out.end(), right.begin() + 1, right.end());
+	out.resize(count * 2 - 1);
+}
+
+namespace wivrn
+{
+
+std::vector<uint16_t> foveation_table::compute_axis(float center, uint16_t foveated_size, uint16_t source_size)
+{
+	if (foveated_size >= source_size)
+		return {source_size};
+
+	std::vector<uint16_t> res;
+	fill_param_2d(center, foveated_size, source_size, res);
+	return res;
+}
+
+static int quantize(float center)
+{
+	return std::lround(std::clamp(center, -1.f, 1.f) * foveation_table::center_steps);
+}
+
+static uint64_t axis_key(const foveation_table::axis & a)
+{
+	uint64_t center = quantize(a.center) + foveation_table::center_steps;
+	return (center << 32) | (uint64_t(a.foveated_size) << 16) | a.source_size;
+}
+
+const std::vector<uint16_t> & foveation_table::get_axis(uint64_t key)
+{
+	auto it = axes.find(key);
+	if (it != axes.end())
+		return it->second;
+
+	float center = float(int(key >> 32) - center_steps) / center_steps;
+	uint16_t foveated_size = key >> 16;
+	uint16_t source_size = key;
+	return axes.emplace(key, compute_axis(center, foveated_size, source_size)).first->second;
+}
+
+const to_headset::foveation_parameter_set & foveation_table::get(axis x, axis y)
+{
+	// The center is irrelevant when the axis is not foveated
+	if (x.foveated_size >= x.source_size)
+		x.center = 0;
+	if (y.foveated_size >= y.source_size)
+		y.center = 0;
+
+	std::pair key{axis_key(x), axis_key(y)};
+
+	auto it = sets.find(key);
+	if (it == sets.end())
+	{
+		if (sets.size() >= max_sets)
+		{
+			sets.clear();
+			axes.clear();
+		}
+
+		it = sets.emplace(key,
+		                  to_headset::foveation_parameter_set{
+		                          .id = next_id++,
+		                          .parameter = {
+		                                  .x = get_axis(key.first),
+		                                  .y = get_axis(key.second),
+		                          },
+		                  })
+		             .first;
+		new_sets.push_back(it->second);
+	}
+	else if (next_id - it->second.id > to_headset::foveation_parameter_set::headset_history)
+	{
+		// The headset may have forgotten it, send it again with a new id
+		it->second.id = next_id++;
+		new_sets.push_back(it->second);
+	}
+
+	return it->second;
+}
+
+std::vector<to_headset::foveation_parameter_set> foveation_table::take_new_sets()
+{
+	return std::exchange(new_sets, {});
+}
+
+void foveation_table::reset()
+{
+	// Ids keep increasing, frames already encoded may still reference the old ones
+	sets.clear();
+	new_sets.clear();
+}
+
+} // namespace wivrn
@@ -0,0 +1,75 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2024  galister <galister@librevr.org>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wivrn_packets.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace wivrn
+{
+
+// Memoized foveation parameters, each combination of x and y parameters gets an
+// id that is sent once to the headset, frames only carry the id.
+class foveation_table
+{
+public:
+	// Foveation centers are rounded to a multiple of 1/center_steps
+	static constexpr int center_steps = 128;
+
+	// Drop everything when that many parameter sets have been computed
+	static constexpr size_t max_sets = 4096;
+
+	struct axis
+	{
+		float center; // in [-1, 1]
+		uint16_t foveated_size;
+		uint16_t source_size;
+	};
+
+	// Run lengths for one axis, see to_headset::foveation_parameter
+	static std::vector<uint16_t> compute_axis(float center, uint16_t foveated_size, uint16_t source_size);
+
+	// Returns the parameter set for the rounded centers, if it is not known by
+	// the headset, it is queued and must be sent with take_new_sets
+	const to_headset::foveation_parameter_set & get(axis x, axis y);
+
+	// Parameter sets to send to the headset before the frames that use them
+	std::vector<to_headset::foveation_parameter_set> take_new_sets();
+
+	// The headset forgot all the parameter sets, the next ones get new ids and are sent again
+	void reset();
+
+private:
+	std::unordered_map<uint64_t, std::vector<uint16_t>> axes;
+	std::map<std::pair<uint64_t, uint64_t>, to_headset::foveation_parameter_set> sets;
+	std::vector<to_headset::foveation_parameter_set> new_sets;
+	// 0 is never used, so that a value-initialized set is not valid
+	uint32_t next_id = 1;
+
+	const std::vector<uint16_t> & get_axis(uint64_t key);
+};
+
+} // namespace wivrn
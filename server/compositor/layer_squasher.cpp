@@ -269,7 +269,7 @@ vk::raii::Pipeline make_pipeline(wivrn::vk_bundle & vk, uint32_t image_array_siz
 	        int32_t(image_array_size));
 	vk::raii::Pipeline res(
 	        vk.device,
-	        nullptr,
+	        vk.pipeline_cache,
 	        vk::ComputePipelineCreateInfo{
 	                .stage = {
 	                        .stage = vk::ShaderStageFlagBits::eCompute,
@@ -27,8 +27,10 @@
 
 #include "os/os_time.h"
 #include "util/u_debug.h"
+#include "util/u_logging.h"
 
 DEBUG_GET_ONCE_FLOAT_OPTION(client_margin_ms, "WIVRN_CLIENT_MARGIN_MS", 1.f)
+DEBUG_GET_ONCE_OPTION(pacer_model, "WIVRN_PACER_MODEL", "histogram")
 
 namespace wivrn
 {
@@ -36,39 +38,31 @@ namespace wivrn
 static const int64_t margin_ns = 3'000'000;
 static const int64_t slop_ns = 500'000;
 
-pacer::pacer(uint64_t frame_duration) :
+static pacing_model make_model(const char * name, int64_t frame_duration)
+{
+	if (not name)
+		name = debug_get_option_pacer_model();
+
+	try
+	{
+		return make_pacing_model(name, frame_duration);
+	}
+	catch (std::exception & e)
+	{
+		U_LOG_W("%s, using %s", e.what(), pacing_model_names[0].data());
+		return make_pacing_model(pacing_model_names[0], frame_duration);
+	}
+}
+
+pacer::pacer(uint64_t frame_duration, const char * model_name) :
         frame_duration_ns(frame_duration),
+        model(make_model(model_name, frame_duration)),
         client_margin_ms{
                 .val = debug_get_float_option_client_margin_ms(),
                 .step = 0.1,
                 .min = 0,
                 .max = 20,
-        },
-        frame_times(5000),
-        frame_times_compute(frame_times),
-        worker([this](std::stop_token t) {
-	        std::vector<XrDuration> samples;
-	        while (not t.stop_requested())
-	        {
-		        samples.clear();
-		        {
-			        std::unique_lock lock(compute_mutex);
-			        compute_cv.wait(lock);
-			        for (const auto & time: frame_times_compute)
-			        {
-				        if (time.decoded > time.present)
-					        samples.push_back(time.decoded - time.present);
-			        }
-		        }
-		        if (samples.empty())
-			        continue;
-		        auto it = samples.begin() + (samples.size() * 995) / 1000;
-		        std::ranges::nth_element(samples, it);
-
-		        std::unique_lock lock(mutex);
-		        safe_present_to_decoded_ns = *it + client_margin_ms.val * U_TIME_1MS_IN_NS;
-	        }
-        })
+        }
 {
 	u_var_add_root(this, "Pacer", false);
 	u_var_add_draggable_f32(this, &client_margin_ms, "headset margin (ms)");
@@ -77,8 +71,6 @@ pacer::pacer(uint64_t frame_duration) :
 pacer::~pacer()
 {
 	u_var_remove_root(this);
-	worker.request_stop();
-	compute_cv.notify_all();
 }
 
 uint64_t pacer::get_frame_duration() const
@@ -91,6 +83,7 @@ void pacer::set_frame_duration(uint64_t frame_duration_ns)
 {
 	std::lock_guard lock(mutex);
 	this->frame_duration_ns = frame_duration_ns;
+	model.phase.set_period(frame_duration_ns);
 }
 
 void pacer::predict(
@@ -99,23 +92,35 @@ void pacer::predict(
         int64_t & out_desired_present_time_ns,
         int64_t & out_present_slop_ns,
         int64_t & out_predicted_display_time_ns)
+{
+	predict(os_monotonic_get_ns(),
+	        frame_id,
+	        out_wake_up_time_ns,
+	        out_desired_present_time_ns,
+	        out_present_slop_ns,
+	        out_predicted_display_time_ns);
+}
+
+void pacer::predict(
+        int64_t now,
+        int64_t & frame_id,
+        int64_t & out_wake_up_time_ns,
+        int64_t & out_desired_present_time_ns,
+        int64_t & out_present_slop_ns,
+        int64_t & out_predicted_display_time_ns)
 {
 	std::lock_guard lock(mutex);
 	frame_id = this->frame_id++;
-	auto now = os_monotonic_get_ns();
 
-	int64_t predicted_client_render = last_ns + frame_duration_ns;
+	int64_t safe_present_to_decoded_ns = model.latency->safe_latency() + client_margin_ms.val * U_TIME_1MS_IN_NS;
 
-	if (now + mean_wake_up_to_present_ns + safe_present_to_decoded_ns > predicted_client_render)
-		predicted_client_render += frame_duration_ns * ((now + mean_wake_up_to_present_ns + safe_present_to_decoded_ns - predicted_client_render) / frame_duration_ns);
+	int64_t predicted_client_render = model.phase.advance(now + mean_wake_up_to_present_ns + safe_present_to_decoded_ns);
 
 	out_predicted_display_time_ns = predicted_client_render + mean_render_to_display_ns;
 	out_desired_present_time_ns = predicted_client_render - safe_present_to_decoded_ns;
 	out_wake_up_time_ns = out_desired_present_time_ns - mean_wake_up_to_present_ns + margin_ns; // we should be awoken early by the application
 	last_wake_up_ns = out_wake_up_time_ns;
 
-	last_ns = predicted_client_render;
-
 	in_flight_frames[frame_id % in_flight_frames.size()] = {
 	        .frame_id = frame_id,
 	        .present_ns = out_desired_present_time_ns,
@@ -126,44 +131,49 @@ void pacer::predict(
 }
 
 void pacer::on_feedback(const wivrn::from_headset::feedback & feedback, const clock_offset & offset)
+{
+	on_feedback(std::span(&feedback, 1), offset);
+}
+
+void pacer::on_feedback(std::span<const wivrn::from_headset::feedback> frame, const clock_offset & offset)
+{
+	std::lock_guard lock(mutex);
+	for (const auto & feedback: frame)
+		on_feedback_locked(feedback, offset);
+}
+
+void pacer::on_feedback_locked(const wivrn::from_headset::feedback & feedback, const clock_offset & offset)
 {
 	if (feedback.times_displayed > 1 or not feedback.blitted)
 		return;
 
-	std::lock_guard lock(mutex);
 	auto & when = in_flight_frames[feedback.frame_index % in_flight_frames.size()];
 	if (when.frame_id != feedback.frame_index)
 		return;
 
-	auto & times = frame_times[feedback.frame_index % frame_times.size()];
-	if (times.frame_id != feedback.frame_index)
+	XrTime decoded = offset.from_headset(feedback.received_from_decoder);
+	if (int64_t(feedback.frame_index) == pending_frame.frame_id)
+		pending_frame.decoded = std::max(pending_frame.decoded, decoded);
+	else if (int64_t(feedback.frame_index) > pending_frame.frame_id)
 	{
-		times.frame_id = feedback.frame_index;
-		times.present = when.present_ns;
-		times.decoded = 0;
+		// All streams of the previous frame have been received
+		if (pending_frame.decoded > pending_frame.present)
+			model.latency->add_sample(pending_frame.decoded - pending_frame.present);
+
+		pending_frame = {
+		        .frame_id = int64_t(feedback.frame_index),
+		        .present = when.present_ns,
+		        .decoded = decoded,
+		};
 	}
-	times.decoded = std::max(times.decoded, offset.from_headset(feedback.received_from_decoder));
 
 	if (feedback.stream_index == 0)
-	{
-		if (feedback.frame_index % 100 == 0)
-		{
-			std::unique_lock lock(compute_mutex);
-			std::swap(frame_times, frame_times_compute);
-			compute_cv.notify_all();
-		}
-		// adjust phase
-		auto d = (frame_duration_ns / 2 + offset.from_headset(feedback.blitted) - last_ns) % frame_duration_ns;
-		if (d < 0)
-			d += frame_duration_ns;
-		d -= frame_duration_ns / 2;
-		auto l = last_ns;
-		last_ns += d / 10;
-	}
+		model.phase.update(offset.from_headset(feedback.blitted));
 
 	if (feedback.displayed and feedback.displayed > feedback.blitted and feedback.displayed < feedback.blitted + 100'000'000)
 		mean_render_to_display_ns = std::lerp(mean_render_to_display_ns, feedback.displayed - feedback.blitted, 0.1);
 }
+
 void pacer::mark_timing_point(
         comp_target_timing_point point,
         int64_t frame_id,
@@ -208,6 +218,7 @@ pacer::frame_info pacer::present_to_info(int64_t present)
 void pacer::reset()
 {
 	std::lock_guard lock(mutex);
-	std::ranges::fill(frame_times, frame_time{});
+	model.latency->reset();
+	pending_frame = {};
 }
 } // namespace wivrn
@@ -19,13 +19,12 @@
 
 #pragma once
 
+#include "pacing_model.h"
 #include "wivrn_packets.h"
 
-#include <condition_variable>
 #include <cstdint>
 #include <mutex>
-#include <thread>
-#include <vector>
+#include <span>
 
 #include "main/comp_target.h"
 #include "util/u_var.h"
@@ -48,39 +47,48 @@ public:
 private:
 	mutable std::mutex mutex;
 	int64_t frame_duration_ns;
-	int64_t last_ns = 0;
 	int64_t frame_id = 0;
 
+	// Latency estimation and phase of the headset frames (time when the headset renders)
+	pacing_model model;
+
 	int64_t mean_wake_up_to_present_ns = 1'000'000;
-	int64_t safe_present_to_decoded_ns = 0;
 	int64_t mean_render_to_display_ns = 0;
 
 	int64_t last_wake_up_ns = 0;
 
 	u_var_draggable_f32 client_margin_ms;
 
+	// Frame for which decoding feedback is being collected, the sample is
+	// added to the model when feedback for a newer frame arrives
 	struct frame_time
 	{
 		int64_t frame_id = -1;
 		XrTime present = 0;
 		XrTime decoded = 0;
 	};
-	std::vector<frame_time> frame_times;
-
-	std::mutex compute_mutex;
-	std::condition_variable compute_cv;
-	std::vector<frame_time> frame_times_compute;
-	std::jthread worker;
+	frame_time pending_frame;
 
 	std::array<frame_info, 8> in_flight_frames;
 
+	void on_feedback_locked(const wivrn::from_headset::feedback &, const clock_offset &);
+
 public:
-	pacer(uint64_t frame_duration);
+	// model: one of pacing_model_names, if null it is read from WIVRN_PACER_MODEL
+	pacer(uint64_t frame_duration, const char * model = nullptr);
 	~pacer();
 
 	uint64_t get_frame_duration() const;
 	void set_frame_duration(uint64_t frame_duration);
 
+	void predict(
+	        int64_t now_ns,
+	        int64_t & out_frame_id,
+	        int64_t & out_wake_up_time_ns,
+	        int64_t & out_desired_present_time_ns,
+	        int64_t & out_present_slop_ns,
+	        int64_t & out_predicted_display_time_ns);
+
 	void predict(
 	        int64_t & out_frame_id,
 	        int64_t & out_wake_up_time_ns,
@@ -89,6 +97,8 @@ public:
 	        int64_t & out_predicted_display_time_ns);
 
 	void on_feedback(const wivrn::from_headset::feedback &, const clock_offset &);
+	// Feedback of all the streams displayed in a headset frame
+	void on_feedback(std::span<const wivrn::from_headset::feedback>, const clock_offset &);
 
 	void mark_timing_point(
 	        comp_target_timing_point point,
@@ -0,0 +1,228 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2024  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2024  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pacing_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace wivrn
+{
+
+percentile_ring_model::percentile_ring_model() :
+        samples(5000),
+        worker([this](std::stop_token t) {
+	        std::vector<int64_t> scratch;
+	        scratch.reserve(samples.size());
+	        while (true)
+	        {
+		        uint64_t computed_generation;
+		        {
+			        std::unique_lock lock(compute_mutex);
+			        if (not compute_cv.wait(lock, t, [this] { return compute_pending; }))
+				        return;
+			        std::swap(scratch, compute_samples);
+			        compute_pending = false;
+			        computed_generation = generation;
+		        }
+		        if (scratch.empty())
+			        continue;
+		        auto it = scratch.begin() + (scratch.size() * 995) / 1000;
+		        std::ranges::nth_element(scratch, it);
+
+		        std::unique_lock lock(compute_mutex);
+		        if (computed_generation == generation)
+			        estimate = *it;
+	        }
+        })
+{
+	compute_samples.reserve(samples.size());
+}
+
+void percentile_ring_model::add_sample(int64_t present_to_decoded_ns)
+{
+	samples[next] = present_to_decoded_ns;
+	next = (next + 1) % samples.size();
+	count = std::min(count + 1, samples.size());
+
+	if (next % 100 != 0)
+		return;
+
+	{
+		std::unique_lock lock(compute_mutex);
+		compute_samples.assign(samples.begin(), samples.begin() + count);
+		compute_pending = true;
+	}
+	compute_cv.notify_one();
+}
+
+void percentile_ring_model::reset()
+{
+	std::unique_lock lock(compute_mutex);
+	next = 0;
+	count = 0;
+	estimate = 0;
+	compute_pending = false;
+	++generation;
+}
+
+bool change_point_detector::add_sample(double x)
+{
+	if (not initialized)
+	{
+		mean = x;
+		initialized = true;
+		return false;
+	}
+
+	mean += (x - mean) * 0.01;
+	sum_up = std::max(0., sum_up + x - mean - tolerance);
+	sum_down = std::max(0., sum_down + mean - x - tolerance);
+
+	if (sum_up > threshold or sum_down > threshold)
+	{
+		mean = x;
+		sum_up = 0;
+		sum_down = 0;
+		return true;
+	}
+	return false;
+}
+
+void change_point_detector::reset()
+{
+	initialized = false;
+	sum_up = 0;
+	sum_down = 0;
+}
+
+decaying_histogram_model::decaying_histogram_model(double half_life, double quantile) :
+        decay(std::exp2(-1 / half_life)),
+        quantile(quantile),
+        // Values are in milliseconds: ignore drifts below 0.5ms,
+        // detect a 5ms shift in about 10 frames
+        detector(0.5, 50)
+{
+}
+
+void decaying_histogram_model::add_sample(int64_t present_to_decoded_ns)
+{
+	if (detector.add_sample(present_to_decoded_ns * 1e-6))
+	{
+		// Keep a trace of the previous distribution so that a single outlier
+		// does not make the estimate collapse
+		for (double & bin: bins)
+			bin *= 0.05;
+		total *= 0.05;
+	}
+
+	size_t bin = std::clamp<int64_t>(present_to_decoded_ns / bin_width_ns, 0, bin_count - 1);
+
+	increment /= decay;
+	bins[bin] += increment;
+	total += increment;
+
+	if (increment > 1e6)
+	{
+		for (double & b: bins)
+			b /= increment;
+		total /= increment;
+		increment = 1;
+	}
+
+	// Walk from the top, the quantile is close to 1
+	double remaining = (1 - quantile) * total;
+	size_t i = bin_count;
+	while (i > 0)
+	{
+		--i;
+		remaining -= bins[i];
+		if (remaining < 0)
+			break;
+	}
+	estimate = (i + 1) * bin_width_ns;
+}
+
+void decaying_histogram_model::reset()
+{
+	bins.fill(0);
+	total = 0;
+	increment = 1;
+	estimate = 0;
+	detector.reset();
+}
+
+phase_locked_loop::phase_locked_loop(int64_t period_ns, double kp, double ki) :
+        nominal_period_ns(period_ns),
+        period_ns(period_ns),
+        kp(kp),
+        ki(ki)
+{
+}
+
+void phase_locked_loop::set_period(int64_t period_ns)
+{
+	nominal_period_ns = period_ns;
+	this->period_ns = period_ns;
+}
+
+int64_t phase_locked_loop::advance(int64_t t)
+{
+	phase_ns += period_ns;
+	if (phase_ns < t)
+		phase_ns += period_ns * std::floor((t - phase_ns) / period_ns);
+	return phase();
+}
+
+void phase_locked_loop::update(int64_t measured_ns)
+{
+	// Phase error in ]-period/2, period/2]
+	double error = std::remainder(measured_ns - phase_ns, period_ns);
+
+	phase_ns += kp * error;
+	period_ns += ki * error;
+
+	// The headset refresh rate is known, only allow for clock drift
+	period_ns = std::clamp<double>(period_ns, nominal_period_ns * 0.995, nominal_period_ns * 1.005);
+}
+
+pacing_model make_pacing_model(std::string_view name, int64_t period_ns)
+{
+	if (name == "histogram")
+	{
+		// Critically damped with a bandwidth of about 1/30 of the frame rate
+		const double omega = 0.03;
+		return {
+		        .latency = std::make_unique<decaying_histogram_model>(),
+		        .phase = phase_locked_loop(period_ns, 2 * omega, omega * omega),
+		};
+	}
+
+	if (name == "legacy")
+		return {
+		        .latency = std::make_unique<percentile_ring_model>(),
+		        .phase = phase_locked_loop(period_ns, 0.1, 0),
+		};
+
+	throw std::invalid_argument("Unknown pacing model " + std::string(name));
+}
+
+} // namespace wivrn
@@ -0,0 +1,180 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2024  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2024  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace wivrn
+{
+
+// Estimates the delay between presenting a frame to the encoders and the
+// headset having decoded it, the pacer schedules frames so that this delay
+// is covered with a high probability.
+class latency_model
+{
+public:
+	virtual ~latency_model() = default;
+
+	virtual void add_sample(int64_t present_to_decoded_ns) = 0;
+
+	// Latency that should not be exceeded by more than a small fraction of frames
+	virtual int64_t safe_latency() const = 0;
+
+	virtual void reset() = 0;
+};
+
+// 99.5th percentile over the last 5000 frames, updated every 100 frames.
+// The percentile is computed on a worker thread, add_sample only copies the samples.
+class percentile_ring_model : public latency_model
+{
+	std::vector<int64_t> samples;
+	size_t next = 0;
+	size_t count = 0;
+	std::atomic<int64_t> estimate = 0;
+
+	std::mutex compute_mutex;
+	std::condition_variable_any compute_cv;
+	std::vector<int64_t> compute_samples;
+	bool compute_pending = false;
+	// Incremented on reset, so that a result computed before is discarded
+	uint64_t generation = 0;
+	std::jthread worker;
+
+public:
+	percentile_ring_model();
+
+	void add_sample(int64_t present_to_decoded_ns) override;
+	int64_t safe_latency() const override
+	{
+		return estimate;
+	}
+	void reset() override;
+};
+
+// Two-sided Page-Hinkley test, detects a shift of the mean of a signal
+class change_point_detector
+{
+	double mean = 0;
+	double sum_up = 0;
+	double sum_down = 0;
+	bool initialized = false;
+
+	// Shifts smaller than this are ignored
+	const double tolerance;
+	// Detection threshold on the cumulated deviation
+	const double threshold;
+
+public:
+	change_point_detector(double tolerance, double threshold) :
+	        tolerance(tolerance), threshold(threshold) {}
+
+	// Returns true if the mean changed, the detector then restarts from x
+	bool add_sample(double x);
+	void reset();
+};
+
+// Quantile of a histogram where older samples have exponentially decreasing weights,
+// forgets faster when the latency distribution changes
+class decaying_histogram_model : public latency_model
+{
+public:
+	static constexpr int64_t bin_width_ns = 250'000;
+	static constexpr size_t bin_count = 1000;
+
+private:
+	std::array<double, bin_count> bins{};
+	double total = 0;
+	// Weight of the next sample, grows instead of decaying all the bins
+	double increment = 1;
+	int64_t estimate = 0;
+
+	const double decay;
+	const double quantile;
+	change_point_detector detector;
+
+public:
+	// half_life: number of samples after which a sample weight is halved
+	decaying_histogram_model(double half_life = 2000, double quantile = 0.995);
+
+	void add_sample(int64_t present_to_decoded_ns) override;
+	int64_t safe_latency() const override
+	{
+		return estimate;
+	}
+	void reset() override;
+};
+
+// Second order phase-locked loop on the headset vsync: tracks both the phase and
+// the period, so that a clock drift between the server and the headset does not
+// leave a constant phase error.
+class phase_locked_loop
+{
+	int64_t nominal_period_ns;
+	double period_ns;
+	double phase_ns = 0;
+
+	double kp;
+	double ki;
+
+public:
+	// ki = 0 gives a first order loop
+	phase_locked_loop(int64_t period_ns, double kp, double ki);
+
+	void set_period(int64_t period_ns);
+	int64_t period() const
+	{
+		return std::llround(period_ns);
+	}
+
+	// Last predicted tick
+	int64_t phase() const
+	{
+		return std::llround(phase_ns);
+	}
+
+	// Move to the next tick, skipping ticks that are more than a period before t
+	int64_t advance(int64_t t);
+
+	// Update the loop with a measured tick time, which may be for an older tick
+	void update(int64_t measured_ns);
+};
+
+struct pacing_model
+{
+	std::unique_ptr<latency_model> latency;
+	phase_locked_loop phase;
+};
+
+// Names accepted by make_pacing_model, the first one is the default
+inline constexpr std::array<std::string_view, 2> pacing_model_names{"histogram", "legacy"};
+
+// Throws std::invalid_argument if the name is unknown
+pacing_model make_pacing_model(std::string_view name, int64_t period_ns);
+
+} // namespace wivrn
@@ -0,0 +1,100 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "static_frame_detector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <span>
+
+namespace wivrn
+{
+
+namespace
+{
+comp_layer normalize(const comp_layer & layer)
+{
+	comp_layer res = layer;
+	// Display time of the frame, it changes even when the application submits the same content
+	res.data.timestamp = 0;
+	return res;
+}
+
+bool same_layer(const comp_layer & reference, const comp_layer & layer)
+{
+	const comp_layer l = normalize(layer);
+	return std::ranges::equal(reference.sc_array, l.sc_array) and
+	       memcmp(&reference.data, &l.data, sizeof(l.data)) == 0;
+}
+
+float angle(const xrt_quat & a, const xrt_quat & b)
+{
+	// Also covers the zero quaternion of an untracked gaze
+	if (memcmp(&a, &b, sizeof(a)) == 0)
+		return 0;
+	float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	return 2 * std::acos(std::min(1.f, std::abs(dot)));
+}
+
+float distance(const xrt_vec3 & a, const xrt_vec3 & b)
+{
+	return std::hypot(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+} // namespace
+
+static_frame_detector::static_frame_detector() :
+        static_frame_detector(thresholds{})
+{
+}
+
+static_frame_detector::static_frame_detector(thresholds limits) :
+        limits(limits)
+{
+}
+
+bool static_frame_detector::is_static(const comp_layer_accum & accum, const std::optional<xrt_pose> & head, const xrt_quat & gaze, int64_t now_ns)
+{
+	std::span new_layers(accum.layers, accum.layer_count);
+
+	bool changed = invalid.exchange(false) or
+	               now_ns - encoded_ns > limits.refresh_ns or
+	               accum.data.env_blend_mode != blend_mode or
+	               angle(gaze, this->gaze) > limits.gaze_angle or
+	               head.has_value() != this->head.has_value() or
+	               not std::ranges::equal(layers, new_layers, same_layer);
+
+	if (not changed and head)
+		changed = angle(head->orientation, this->head->orientation) > limits.head_angle or
+		          distance(head->position, this->head->position) > limits.head_distance;
+
+	if (not changed)
+		return true;
+
+	layers.clear();
+	std::ranges::transform(new_layers, std::back_inserter(layers), normalize);
+	blend_mode = accum.data.env_blend_mode;
+	this->head = head;
+	this->gaze = gaze;
+	encoded_ns = now_ns;
+	return false;
+}
+
+} // namespace wivrn
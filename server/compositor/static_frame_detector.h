@@ -0,0 +1,79 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "util/comp_layer_accum.h"
+#include "xrt/xrt_defines.h"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace wivrn
+{
+
+// Detects frames identical to the last encoded one, the compositor does not render nor
+// encode them and the headset keeps reprojecting the frame it already has.
+//
+// Layers are compared on their swapchain images and parameters, rendering requires acquiring
+// an image so new content always comes with a different image index. Content written to an
+// image without acquiring it is not detected, a frame is still encoded every refresh_ns.
+class static_frame_detector
+{
+public:
+	struct thresholds
+	{
+		// Maximum duration between encoded frames, the headset considers the stream stalled after 1s
+		int64_t refresh_ns = 200'000'000;
+		// Head motion from the last encoded frame above which squashed layers are rendered again
+		float head_angle = 0.005;    // radians
+		float head_distance = 0.002; // meters
+		// Eye motion from the last encoded frame above which foveation is computed again
+		float gaze_angle = 0.02; // radians
+	};
+
+private:
+	const thresholds limits;
+
+	std::atomic<bool> invalid = true;
+	std::vector<comp_layer> layers;
+	xrt_blend_mode blend_mode{};
+	std::optional<xrt_pose> head;
+	xrt_quat gaze{};
+	int64_t encoded_ns = 0;
+
+public:
+	static_frame_detector();
+	static_frame_detector(thresholds limits);
+
+	// head is the pose the layers are squashed for, nullopt if the frame does not depend on it.
+	// If the frame is not static, it becomes the reference for the following frames and the caller
+	// must encode it.
+	bool is_static(const comp_layer_accum &, const std::optional<xrt_pose> & head, const xrt_quat & gaze, int64_t now_ns);
+
+	// Next frame will not be static, can be called from any thread
+	void invalidate()
+	{
+		invalid = true;
+	}
+};
+
+} // namespace wivrn
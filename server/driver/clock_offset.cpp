@@ -23,10 +23,15 @@
 #include "os/os_time.h"
 #include "util/u_logging.h"
 
+#include <cstdlib>
+
 namespace wivrn
 {
 
 static const size_t num_samples = 100;
+static const int num_warm_start_checks = 3;
+// Allowed difference between a sample and the previous estimate, in addition to the uncertainty of the sample
+static const int64_t warm_start_tolerance = 1'000'000;
 
 std::chrono::steady_clock::time_point clock_offset_estimator::next() const
 {
@@ -39,6 +44,18 @@ void clock_offset_estimator::reset()
 	sample_index = 0;
 	samples.clear();
 	b = 0;
+	pending_checks = 0;
+	next_sample = {};
+	sample_interval = std::chrono::milliseconds(10);
+}
+
+void clock_offset_estimator::warm_start()
+{
+	std::lock_guard lock(mutex);
+	if (samples.empty())
+		return;
+	b = b & ~int64_t(1);
+	pending_checks = num_warm_start_checks;
 	next_sample = {};
 	sample_interval = std::chrono::milliseconds(10);
 }
@@ -55,11 +72,33 @@ void clock_offset_estimator::request_sample(std::chrono::steady_clock::time_poin
 	        });
 }
 
-void clock_offset_estimator::add_sample(const wivrn::from_headset::timesync_response & base_sample)
+void clock_offset_estimator::add_sample(const wivrn::from_headset::timesync_response & base_sample, XrTime received)
 {
-	XrTime now = os_monotonic_get_ns();
-	clock_offset_estimator::sample sample{base_sample, now};
+	clock_offset_estimator::sample sample{base_sample, received};
 	std::lock_guard lock(mutex);
+	if (pending_checks > 0)
+	{
+		// The headset replied somewhere between query and received
+		int64_t offset = sample.response - (sample.query + sample.received) / 2;
+		int64_t uncertainty = (sample.received - sample.query) / 2;
+		if (std::abs(offset - (b & ~int64_t(1))) <= uncertainty + warm_start_tolerance)
+		{
+			if (--pending_checks == 0)
+			{
+				U_LOG_I("Clock offset confirmed after reconnection");
+				b |= 1;
+				if (samples.size() == num_samples)
+					sample_interval = std::chrono::milliseconds(100);
+			}
+			return;
+		}
+
+		U_LOG_I("Headset clock changed during reconnection, estimating offset again");
+		pending_checks = 0;
+		sample_index = 0;
+		samples.clear();
+	}
+
 	if (samples.size() < num_samples)
 	{
 		samples.push_back(sample);
@@ -149,13 +188,4 @@ clock_offset clock_offset_estimator::get_offset()
 	};
 }
 
-XrTime clock_offset::from_headset(XrTime ts) const
-{
-	return ts - b;
-}
-
-XrTime clock_offset::to_headset(XrTime timestamp_ns) const
-{
-	return timestamp_ns + b;
-}
 } // namespace wivrn
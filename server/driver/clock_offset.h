@@ -44,9 +44,15 @@ struct clock_offset
 		return stable;
 	}
 
-	XrTime from_headset(XrTime) const;
+	XrTime from_headset(XrTime timestamp_ns) const
+	{
+		return timestamp_ns - b;
+	}
 
-	XrTime to_headset(XrTime timestamp_ns) const;
+	XrTime to_headset(XrTime timestamp_ns) const
+	{
+		return timestamp_ns + b;
+	}
 };
 
 class clock_offset_estimator
@@ -60,6 +66,8 @@ class clock_offset_estimator
 	std::vector<sample> samples;
 	size_t sample_index = 0;
 	std::atomic<int64_t> b = 0; // lest significant bit == stable
+	// Samples that must match the previous estimate before using it again after warm_start
+	int pending_checks = 0;
 
 	std::chrono::steady_clock::time_point next_sample{};
 	std::atomic<std::chrono::milliseconds> sample_interval = std::chrono::milliseconds(10);
@@ -67,8 +75,12 @@ class clock_offset_estimator
 public:
 	std::chrono::steady_clock::time_point next() const;
 	void reset();
+	// Keeps the previous estimate after a reconnection, it is used again once a few new samples
+	// confirm that the headset clock did not change (it does when the headset sleeps)
+	void warm_start();
 	void request_sample(std::chrono::steady_clock::time_point now, wivrn_connection & connection);
-	void add_sample(const wivrn::from_headset::timesync_response & sample);
+	// received: time at which the response was received, in CLOCK_MONOTONIC
+	void add_sample(const wivrn::from_headset::timesync_response & sample, XrTime received);
 
 	clock_offset get_offset();
 };
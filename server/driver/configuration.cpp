@@ -206,9 +206,24 @@ configuration::configuration()
 		if (auto it = json.find("bit-depth"); it != json.end())
 			bit_depth = *it;
 
+		if (auto it = json.find("foveation-qp"); it != json.end())
+			foveation_qp = *it;
+
 		if (auto it = json.find("tcp-only"); it != json.end())
 			tcp_only = *it;
 
+		if (auto it = json.find("skip-static-frames"); it != json.end())
+			skip_static_frames = *it;
+
+		if (auto it = json.find("stream-depth"); it != json.end())
+			stream_depth = *it;
+
+		if (auto it = json.find("dynamic-bitrate"); it != json.end())
+			dynamic_bitrate = *it;
+
+		if (auto it = json.find("warm-start"); it != json.end())
+			warm_start = *it;
+
 		if (auto it = json.find("port"); it != json.end())
 			port = *it;
 
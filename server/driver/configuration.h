@@ -53,6 +53,7 @@ struct configuration
 
 	std::array<encoder, 3> encoders; // left, right, alpha
 	std::optional<uint8_t> bit_depth;
+	float foveation_qp = 0;
 	std::optional<std::array<float, 3>> grip_surface;
 	std::vector<std::string> application;
 	bool debug_gui = false;
@@ -60,6 +61,10 @@ struct configuration
 	std::optional<float> lh_stick_deadzone;
 	bool hid_forwarding = false;
 	bool tcp_only = false;
+	bool skip_static_frames = true;
+	bool stream_depth = false;
+	bool dynamic_bitrate = true;
+	bool warm_start = true;
 	int port = wivrn::default_port;
 	std::string hostname = wivrn::hostname();
 	service_publication publication = service_publication::avahi;
@@ -28,32 +28,34 @@ static_assert(XRT_HAND_JOINT_COUNT == XR_HAND_JOINT_COUNT_EXT);
 namespace wivrn
 {
 
-static xrt_hand_joint_value interpolate(const xrt_hand_joint_value & a, const xrt_hand_joint_value & b, float t)
+void hand_joints_list::interpolate(const sample & a, const sample & b, float t, sample & out)
 {
-	return {
-	        .relation = pose_list::interpolate(a.relation, b.relation, t),
-	        .radius = a.radius * (1 - t) + b.radius * t,
+	out.header = {
+	        .hand_pose = pose_list::interpolate(a.header.hand_pose, b.header.hand_pose, t),
+	        .is_active = a.header.is_active,
 	};
+	decltype(out.joints)::interpolate(a.joints, b.joints, t, out.joints);
 }
 
-xrt_hand_joint_set hand_joints_list::interpolate(const xrt_hand_joint_set & a, const xrt_hand_joint_set & b, float t)
+xrt_hand_joint_set hand_joints_list::to_data(const sample & s)
 {
-	xrt_hand_joint_set j = {
-	        .hand_pose = pose_list::interpolate(a.hand_pose, b.hand_pose, t),
-	        .is_active = a.is_active,
+	xrt_hand_joint_set j{
+	        .hand_pose = s.header.hand_pose,
+	        .is_active = s.header.is_active,
 	};
-	for (int i = 0; i < XRT_HAND_JOINT_COUNT; i++)
+	if (s.header.is_active)
 	{
-		j.values.hand_joint_set_default[i] = ::wivrn::interpolate(a.values.hand_joint_set_default[i], b.values.hand_joint_set_default[i], t);
+		for (int i = 0; i < XRT_HAND_JOINT_COUNT; i++)
+		{
+			j.values.hand_joint_set_default[i] = {
+			        .relation = s.joints.get(i),
+			        .radius = s.joints.radius[i],
+			};
+		}
 	}
 	return j;
 }
 
-xrt_hand_joint_set hand_joints_list::extrapolate(const xrt_hand_joint_set & a, const xrt_hand_joint_set & b, int64_t ta, int64_t tb, int64_t t)
-{
-	return t <= ta ? a : b;
-}
-
 static xrt_space_relation to_relation(const from_headset::hand_tracking::pose & pose)
 {
 	return {
@@ -67,32 +69,31 @@ static xrt_space_relation to_relation(const from_headset::hand_tracking::pose &
 	};
 }
 
-static xrt_hand_joint_set convert_joints(const std::optional<std::array<from_headset::hand_tracking::pose, XR_HAND_JOINT_COUNT_EXT>> & input_joints)
+static hand_joints_list::sample convert_joints(const std::optional<std::array<from_headset::hand_tracking::pose, XR_HAND_JOINT_COUNT_EXT>> & input_joints)
 {
-	xrt_hand_joint_set output_joints{};
+	hand_joints_list::sample output_joints{};
 
 	if (input_joints)
 	{
-		output_joints.is_active = true;
-		output_joints.hand_pose = to_relation((*input_joints)[XRT_HAND_JOINT_WRIST]);
+		output_joints.header.is_active = true;
+		output_joints.header.hand_pose = to_relation((*input_joints)[XRT_HAND_JOINT_WRIST]);
 
 		xrt_relation_chain rel_chain{};
 		xrt_space_relation * joint_rel = m_relation_chain_reserve(&rel_chain);
-		m_relation_chain_push_inverted_relation(&rel_chain, &output_joints.hand_pose);
+		m_relation_chain_push_inverted_relation(&rel_chain, &output_joints.header.hand_pose);
 
 		for (int i = 0; i < XR_HAND_JOINT_COUNT_EXT; i++)
 		{
-			xrt_hand_joint_value & res = output_joints.values.hand_joint_set_default[i];
-
-			res.radius = (*input_joints)[i].radius / 10'000.;
+			xrt_space_relation res;
 			*joint_rel = to_relation((*input_joints)[i]);
+			m_relation_chain_resolve(&rel_chain, &res);
 
-			m_relation_chain_resolve(&rel_chain, &res.relation);
+			output_joints.joints.set(i, res, (*input_joints)[i].radius / 10'000.);
 		}
 	}
 	else
 	{
-		output_joints.is_active = false;
+		output_joints.header.is_active = false;
 	}
 
 	return output_joints;
@@ -19,7 +19,7 @@
 
 #pragma once
 
-#include "history.h"
+#include "joint_history.h"
 #include "wivrn_packets.h"
 #include "xrt/xrt_defines.h"
 
@@ -27,13 +27,19 @@ namespace wivrn
 {
 struct clock_offset;
 
-class hand_joints_list : public history<hand_joints_list, xrt_hand_joint_set>
+struct hand_joints_header
+{
+	xrt_space_relation hand_pose;
+	bool is_active;
+};
+
+class hand_joints_list : public joint_history<hand_joints_list, xrt_hand_joint_set, hand_joints_header, XRT_HAND_JOINT_COUNT>
 {
 public:
 	const int hand_id;
 
-	xrt_hand_joint_set interpolate(const xrt_hand_joint_set & a, const xrt_hand_joint_set & b, float t);
-	xrt_hand_joint_set extrapolate(const xrt_hand_joint_set & a, const xrt_hand_joint_set & b, int64_t ta, int64_t tb, int64_t t);
+	void interpolate(const sample & a, const sample & b, float t, sample & out);
+	xrt_hand_joint_set to_data(const sample &);
 
 	hand_joints_list(int hand_id) :
 	        hand_id(hand_id) {}
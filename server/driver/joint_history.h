@@ -0,0 +1,330 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2022-2024  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2022-2024  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "clock_offset.h"
+#include "util/u_time.h"
+#include "xrt/xrt_defines.h"
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <openxr/openxr.h>
+
+namespace wivrn
+{
+
+// Joint relations stored as a structure of arrays, so that all the joints of a
+// set are interpolated together by loops the compiler can vectorize.
+template <size_t N>
+struct joint_poses
+{
+	static constexpr size_t joint_count = N;
+
+	alignas(32) std::array<float, N> px, py, pz;
+	alignas(32) std::array<float, N> qx, qy, qz, qw;
+	alignas(32) std::array<float, N> vx, vy, vz;
+	alignas(32) std::array<float, N> wx, wy, wz;
+	alignas(32) std::array<float, N> radius;
+	alignas(32) std::array<uint32_t, N> flags;
+
+	void set(size_t i, const xrt_space_relation & r, float joint_radius = 0)
+	{
+		px[i] = r.pose.position.x;
+		py[i] = r.pose.position.y;
+		pz[i] = r.pose.position.z;
+		qx[i] = r.pose.orientation.x;
+		qy[i] = r.pose.orientation.y;
+		qz[i] = r.pose.orientation.z;
+		qw[i] = r.pose.orientation.w;
+		vx[i] = r.linear_velocity.x;
+		vy[i] = r.linear_velocity.y;
+		vz[i] = r.linear_velocity.z;
+		wx[i] = r.angular_velocity.x;
+		wy[i] = r.angular_velocity.y;
+		wz[i] = r.angular_velocity.z;
+		radius[i] = joint_radius;
+		flags[i] = r.relation_flags;
+	}
+
+	xrt_space_relation get(size_t i) const
+	{
+		return {
+		        .relation_flags = xrt_space_relation_flags(flags[i]),
+		        .pose = {
+		                .orientation = {.x = qx[i], .y = qy[i], .z = qz[i], .w = qw[i]},
+		                .position = {.x = px[i], .y = py[i], .z = pz[i]},
+		        },
+		        .linear_velocity = {.x = vx[i], .y = vy[i], .z = vz[i]},
+		        .angular_velocity = {.x = wx[i], .y = wy[i], .z = wz[i]},
+		};
+	}
+
+	// Positions, velocities and radii are linearly interpolated, orientations use
+	// a normalized lerp with a corrected parameter, which stays within about 1e-3
+	// rad of slerp without any trigonometric function.
+	// See https://zeux.io/2015/07/23/approximating-slerp/
+	// Only the first count joints are computed, out must not alias a or b.
+	static void interpolate(const joint_poses & a, const joint_poses & b, float t, joint_poses & out, size_t count = N)
+	{
+		lerp(a.px, b.px, t, out.px, count);
+		lerp(a.py, b.py, t, out.py, count);
+		lerp(a.pz, b.pz, t, out.pz, count);
+		lerp(a.vx, b.vx, t, out.vx, count);
+		lerp(a.vy, b.vy, t, out.vy, count);
+		lerp(a.vz, b.vz, t, out.vz, count);
+		lerp(a.wx, b.wx, t, out.wx, count);
+		lerp(a.wy, b.wy, t, out.wy, count);
+		lerp(a.wz, b.wz, t, out.wz, count);
+		lerp(a.radius, b.radius, t, out.radius, count);
+
+		const uint32_t * __restrict fa = a.flags.data();
+		const uint32_t * __restrict fb = b.flags.data();
+		uint32_t * __restrict fo = out.flags.data();
+		for (size_t i = 0; i < count; ++i)
+			fo[i] = fa[i] & fb[i];
+
+		nlerp(a, b, t, out, count);
+	}
+
+private:
+	// The loops below work on restrict pointers, otherwise the compiler assumes
+	// the arrays may overlap and does not vectorize them.
+	using array = std::array<float, N>;
+
+	static void lerp(const array & a_, const array & b_, float t, array & out_, size_t count)
+	{
+		const float * __restrict a = a_.data();
+		const float * __restrict b = b_.data();
+		float * __restrict out = out_.data();
+		for (size_t i = 0; i < count; ++i)
+			out[i] = a[i] + (b[i] - a[i]) * t;
+	}
+
+	static void weighted_sum(const array & a_, const array & b_, const array & wa_, const array & wb_, array & out_, size_t count)
+	{
+		const float * __restrict a = a_.data();
+		const float * __restrict b = b_.data();
+		const float * __restrict wa = wa_.data();
+		const float * __restrict wb = wb_.data();
+		float * __restrict out = out_.data();
+		for (size_t i = 0; i < count; ++i)
+			out[i] = a[i] * wa[i] + b[i] * wb[i];
+	}
+
+	static void nlerp(const joint_poses & a, const joint_poses & b, float t, joint_poses & out, size_t count)
+	{
+		const float * __restrict ax = a.qx.data();
+		const float * __restrict ay = a.qy.data();
+		const float * __restrict az = a.qz.data();
+		const float * __restrict aw = a.qw.data();
+		const float * __restrict bx = b.qx.data();
+		const float * __restrict by = b.qy.data();
+		const float * __restrict bz = b.qz.data();
+		const float * __restrict bw = b.qw.data();
+
+		// Weights are computed in a separate pass, a single loop is too large to be vectorized
+		alignas(32) array wa;
+		alignas(32) array wb;
+		for (size_t i = 0; i < count; ++i)
+		{
+			float dot = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i] + aw[i] * bw[i];
+			float d = std::abs(dot);
+
+			float k_a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+			float k_b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+			float k = k_a * (t - 0.5f) * (t - 0.5f) + k_b;
+			float ot = t + t * (t - 0.5f) * (t - 1) * k;
+
+			// Take the shortest path
+			wa[i] = 1 - ot;
+			wb[i] = std::copysign(ot, dot);
+		}
+
+		weighted_sum(a.qx, b.qx, wa, wb, out.qx, count);
+		weighted_sum(a.qy, b.qy, wa, wb, out.qy, count);
+		weighted_sum(a.qz, b.qz, wa, wb, out.qz, count);
+		weighted_sum(a.qw, b.qw, wa, wb, out.qw, count);
+
+		float * __restrict ox = out.qx.data();
+		float * __restrict oy = out.qy.data();
+		float * __restrict oz = out.qz.data();
+		float * __restrict ow = out.qw.data();
+		for (size_t i = 0; i < count; ++i)
+		{
+			float inv_norm = 1 / std::sqrt(ox[i] * ox[i] + oy[i] * oy[i] + oz[i] * oz[i] + ow[i] * ow[i]);
+			ox[i] *= inv_norm;
+			oy[i] *= inv_norm;
+			oz[i] *= inv_norm;
+			ow[i] *= inv_norm;
+		}
+	}
+};
+
+// Same role as history, for joint sets: samples are kept as joint_poses and
+// readers do not take a lock. The writer increments a sequence number before and
+// after modifying the samples, readers retry if it changed while they were
+// reading. Samples read during a write are discarded before being used.
+//
+// Derived must provide:
+//   void interpolate(const sample & a, const sample & b, float t, sample & out);
+//   Data to_data(const sample &);
+template <typename Derived, typename Data, typename Header, size_t JointCount, size_t MaxSamples = 10>
+class joint_history
+{
+public:
+	struct sample
+	{
+		Header header;
+		joint_poses<JointCount> joints;
+	};
+
+private:
+	std::array<XrTime, MaxSamples> produced_timestamp{};
+	std::array<XrTime, MaxSamples> at_timestamp_ns{};
+	std::array<sample, MaxSamples> samples{};
+
+	// Odd while the writer modifies the samples
+	std::atomic<uint64_t> sequence = 0;
+	std::mutex writer_mutex;
+
+	void begin_write()
+	{
+		sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	void end_write()
+	{
+		sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+protected:
+	void add_sample(XrTime produced_timestamp, XrTime timestamp, const sample & s, const clock_offset & offset)
+	{
+		XrTime produced = offset.from_headset(produced_timestamp);
+		XrTime t = offset.from_headset(timestamp);
+		std::lock_guard lock(writer_mutex);
+
+		size_t target = 0;
+		if (offset)
+		{
+			for (size_t i = 0; i < MaxSamples; ++i)
+			{
+				// Discard reordered packets
+				if (this->produced_timestamp[i] > produced)
+					return;
+
+				if (std::abs(at_timestamp_ns[i] - t) < 2'000'000)
+				{
+					target = i;
+					break;
+				}
+
+				if (at_timestamp_ns[i] < at_timestamp_ns[target])
+					target = i;
+			}
+		}
+
+		begin_write();
+		this->produced_timestamp[target] = produced;
+		at_timestamp_ns[target] = t;
+		samples[target] = s;
+		end_write();
+	}
+
+public:
+	std::pair<XrTime, Data> get_at(XrTime at_timestamp)
+	{
+		// Large sets do not belong on the stack of the IPC threads
+		thread_local sample result;
+
+		XrTime produced;
+		bool found;
+		uint64_t seq;
+		do
+		{
+			seq = sequence.load(std::memory_order_acquire);
+			if (seq & 1)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			ptrdiff_t before = -1;
+			ptrdiff_t after = -1;
+			for (size_t i = 0; i < MaxSamples; ++i)
+			{
+				XrTime at = at_timestamp_ns[i];
+				if (not at)
+					continue;
+				if (at < at_timestamp)
+				{
+					if (before < 0 or at_timestamp_ns[before] < at)
+						before = i;
+				}
+				else
+				{
+					if (after < 0 or at_timestamp_ns[after] > at)
+						after = i;
+				}
+			}
+
+			produced = 0;
+			if (after >= 0)
+				produced = std::max(produced, produced_timestamp[after]);
+			if (before >= 0)
+				produced = std::max(produced, produced_timestamp[before]);
+
+			found = true;
+			if (before >= 0 and after >= 0)
+			{
+				float t = float(at_timestamp - at_timestamp_ns[before]) /
+				          (at_timestamp_ns[after] - at_timestamp_ns[before]);
+				static_cast<Derived *>(this)->interpolate(samples[before], samples[after], t, result);
+			}
+			else if (before >= 0 and at_timestamp <= at_timestamp_ns[before] + U_TIME_1S_IN_NS)
+				result = samples[before];
+			else if (after >= 0)
+				result = samples[after];
+			else
+				found = false;
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+		} while ((seq & 1) or sequence.load(std::memory_order_relaxed) != seq);
+
+		if (not found)
+			return {};
+		return {produced, static_cast<Derived *>(this)->to_data(result)};
+	}
+
+	void reset()
+	{
+		std::lock_guard lock(writer_mutex);
+		begin_write();
+		produced_timestamp.fill(0);
+		at_timestamp_ns.fill(0);
+		end_write();
+	}
+};
+} // namespace wivrn
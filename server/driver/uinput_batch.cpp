@@ -0,0 +1,95 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "uinput_batch.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace wivrn
+{
+
+void uinput_batch::add(uint16_t type, uint16_t code, int32_t value)
+{
+	input_event & ev = events.emplace_back();
+	ev.type = type;
+	ev.code = code;
+	ev.value = value;
+}
+
+void uinput_batch::syn()
+{
+	const auto first = events.begin() + report_begin;
+	const bool rel_only = first != events.end() and
+	                      std::all_of(first, events.end(), [](const input_event & ev) { return ev.type == EV_REL; });
+
+	if (rel_only and last_rel_only)
+	{
+		// Merge into the previous report, overwriting its SYN_REPORT
+		const size_t last_end = report_begin - 1;
+		size_t out = last_end;
+		for (size_t i = report_begin; i < events.size(); ++i)
+		{
+			const input_event ev = events[i];
+			auto it = std::find_if(events.begin() + last_begin, events.begin() + last_end, [&](const input_event & e) { return e.code == ev.code; });
+			if (it != events.begin() + last_end)
+			{
+				int64_t sum = int64_t(it->value) + ev.value;
+				it->value = std::clamp<int64_t>(sum, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max());
+			}
+			else
+				events[out++] = ev;
+		}
+		events.resize(out);
+	}
+	else
+	{
+		last_begin = report_begin;
+		last_rel_only = rel_only;
+	}
+
+	add(EV_SYN, SYN_REPORT, 0);
+	report_begin = events.size();
+}
+
+void uinput_batch::flush(int fd)
+{
+	if (events.empty())
+		return;
+
+	const size_t size = events.size() * sizeof(input_event);
+	auto res = ::write(fd, events.data(), size);
+
+	events.clear();
+	report_begin = 0;
+	last_begin = 0;
+	last_rel_only = false;
+
+	if (res < 0)
+		throw std::system_error(errno, std::generic_category(), "error during write");
+	if (size_t(res) != size)
+		throw std::runtime_error("byte count mismatch while writing to uinput");
+}
+
+} // namespace wivrn
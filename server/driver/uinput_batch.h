@@ -0,0 +1,62 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <linux/input.h>
+
+namespace wivrn
+{
+
+// Pending events for a uinput device, written with a single syscall on flush.
+//
+// Consecutive reports that only contain relative axes (mouse motion, scroll) are merged into
+// one, with the sum of their values. Other reports are kept in order, so that a button press
+// between two motions still happens at the same position.
+//
+// Event timestamps are left to 0: uinput ignores them and the kernel stamps events when they
+// are injected.
+class uinput_batch
+{
+	std::vector<input_event> events;
+	// First event of the report being built
+	size_t report_begin = 0;
+	// First event of the last complete report
+	size_t last_begin = 0;
+	bool last_rel_only = false;
+
+public:
+	void add(uint16_t type, uint16_t code, int32_t value);
+	// Ends the current report
+	void syn();
+
+	// Writes all pending events, does nothing if there are none
+	void flush(int fd);
+
+	bool empty() const
+	{
+		return events.empty();
+	}
+};
+
+} // namespace wivrn
@@ -73,93 +73,77 @@ static xrt_space_relation to_relation(const wivrn::from_headset::meta_body::pose
 	};
 }
 
-static inline bool is_joint_set_active(wivrn::from_headset::body_type body_type, const xrt_body_joint_set & set)
-{
-	switch (body_type)
-	{
-		case wivrn::from_headset::body_type::fb:
-		case wivrn::from_headset::body_type::meta:
-			return set.base_body_joint_set_meta.is_active;
-		case wivrn::from_headset::body_type::bd:
-			return set.body_joint_set_bd.is_active;
-		default:
-			assert(false);
-			__builtin_unreachable();
-	}
-}
+static_assert(XRT_BODY_JOINT_COUNT_FB <= XRT_FULL_BODY_JOINT_COUNT_META);
+static_assert(XRT_BODY_JOINT_COUNT_BD <= XRT_FULL_BODY_JOINT_COUNT_META);
 
-template <typename T>
-static void interpolate_joints(const T & a, const T & b, T & out, float t)
+template <typename T, size_t N>
+static void copy_joints(T & out, const wivrn::joint_poses<N> & joints, size_t count)
 {
-	for (auto [a, b, out]: std::views::zip(a.joint_locations, b.joint_locations, out.joint_locations))
-		out.relation = wivrn::pose_list::interpolate(a.relation, b.relation, t);
-}
-
-template <typename T>
-static void extrapolate_joints(const T & a, const T & b, T & out, int64_t ta, int64_t tb, int64_t t)
-{
-	for (auto [a, b, out]: std::views::zip(a.joint_locations, b.joint_locations, out.joint_locations))
-		out.relation = wivrn::pose_list::extrapolate(a.relation, b.relation, ta, tb, t);
+	for (size_t i = 0; i < count; i++)
+		out.joint_locations[i].relation = joints.get(i);
 }
 
 namespace wivrn
 {
-xrt_body_joint_set body_joints_list::interpolate(const xrt_body_joint_set & a, const xrt_body_joint_set & b, float t)
+size_t body_joints_list::joint_count() const
 {
-	if (not is_joint_set_active(type, a))
-	{
-		// in case neither is valid, both will be zeroed,
-		// so return the later one for timestamp's sake
-		return b;
-	}
-	else if (not is_joint_set_active(type, b))
-	{
-		return a;
-	}
-
-	xrt_body_joint_set result = b;
 	switch (type)
 	{
 		case wivrn::from_headset::body_type::fb:
-			interpolate_joints(a.body_joint_set_fb, b.body_joint_set_fb, result.body_joint_set_fb, t);
-			break;
+			return XRT_BODY_JOINT_COUNT_FB;
 		case wivrn::from_headset::body_type::meta:
-			interpolate_joints(a.full_body_joint_set_meta, b.full_body_joint_set_meta, result.full_body_joint_set_meta, t);
-			break;
+			return XRT_FULL_BODY_JOINT_COUNT_META;
 		case wivrn::from_headset::body_type::bd:
-			interpolate_joints(a.body_joint_set_bd, b.body_joint_set_bd, result.body_joint_set_bd, t);
-			break;
+			return XRT_BODY_JOINT_COUNT_BD;
 		default:
 			assert(false);
 			__builtin_unreachable();
 	}
-	return result;
 }
 
-xrt_body_joint_set body_joints_list::extrapolate(const xrt_body_joint_set & a, const xrt_body_joint_set & b, int64_t ta, int64_t tb, int64_t t)
+void body_joints_list::interpolate(const sample & a, const sample & b, float t, sample & out)
 {
-	if (not is_joint_set_active(type, a))
+	if (not a.header.is_active)
 	{
 		// in case neither is valid, both will be zeroed,
 		// so return the later one for timestamp's sake
-		return b;
+		out = b;
+		return;
 	}
-	else if (not is_joint_set_active(type, b))
+	else if (not b.header.is_active)
 	{
-		return a;
+		out = a;
+		return;
 	}
 
-	xrt_body_joint_set result = b;
+	out.header = b.header;
+	decltype(out.joints)::interpolate(a.joints, b.joints, t, out.joints, joint_count());
+}
+
+xrt_body_joint_set body_joints_list::to_data(const sample & s)
+{
+	xrt_body_joint_set result{};
 	switch (type)
 	{
 		case wivrn::from_headset::body_type::fb:
-			extrapolate_joints(a.body_joint_set_fb, b.body_joint_set_fb, result.body_joint_set_fb, ta, tb, t);
-			break;
 		case wivrn::from_headset::body_type::meta:
-			extrapolate_joints(a.full_body_joint_set_meta, b.full_body_joint_set_meta, result.full_body_joint_set_meta, ta, tb, t);
+			result.base_body_joint_set_meta = {
+			        .sample_time_ns = s.header.sample_time_ns,
+			        .confidence = s.header.confidence,
+			        .is_active = s.header.is_active,
+			};
+			if (type == wivrn::from_headset::body_type::fb)
+				copy_joints(result.body_joint_set_fb, s.joints, XRT_BODY_JOINT_COUNT_FB);
+			else
+				copy_joints(result.full_body_joint_set_meta, s.joints, XRT_FULL_BODY_JOINT_COUNT_META);
 			break;
 		case wivrn::from_headset::body_type::bd:
-			extrapolate_joints(a.body_joint_set_bd, b.body_joint_set_bd, result.body_joint_set_bd, ta, tb, t);
+			result.body_joint_set_bd = {
+			        .sample_time_ns = s.header.sample_time_ns,
+			        .is_active = s.header.is_active,
+			        .all_joint_poses_tracked = s.header.all_joint_poses_tracked,
+			};
+			copy_joints(result.body_joint_set_bd, s.joints, XRT_BODY_JOINT_COUNT_BD);
 			break;
 		default:
 			assert(false);
@@ -172,8 +156,8 @@ void body_joints_list::update_tracking(const wivrn::from_headset::meta_body & tr
 {
 	assert(type == from_headset::body_type::fb or type == from_headset::body_type::meta);
 
-	xrt_body_joint_set s{
-	        .base_body_joint_set_meta = {
+	sample s{
+	        .header = {
 	                .sample_time_ns = tracking.timestamp,
 	                .confidence = tracking.confidence,
 	                .is_active = not std::holds_alternative<std::monostate>(tracking.joints),
@@ -187,13 +171,11 @@ void body_joints_list::update_tracking(const wivrn::from_headset::meta_body & tr
 		                   }
 	                   },
 	                   [&](auto & joints) {
-		                   s.body_joint_set_fb.joint_locations[XRT_BODY_JOINT_ROOT_FB].relation = to_relation(joints.root);
+		                   s.joints.set(XRT_BODY_JOINT_ROOT_FB, to_relation(joints.root));
 		                   for (size_t joint = XRT_BODY_JOINT_HIPS_FB; joint < std::size(joints.joints) + 1; joint++)
 		                   {
 			                   const auto pose = to_relation(joints.root, joints.joints[joint - 1]);
-			                   static_assert(offsetof(xrt_full_body_joint_set_meta, joint_locations) == offsetof(xrt_body_joint_set_fb, joint_locations));
-			                   static_assert(sizeof(xrt_full_body_joint_set_meta::joint_locations[0]) == sizeof(xrt_body_joint_set_fb::joint_locations[0]));
-			                   s.full_body_joint_set_meta.joint_locations[joint].relation = pose;
+			                   s.joints.set(joint, pose);
 
 			                   if (auto it = parent.virtual_trackers.find(joint); it != parent.virtual_trackers.cend())
 			                   {
@@ -226,8 +208,8 @@ void body_joints_list::update_tracking(const wivrn::from_headset::bd_body & trac
 {
 	assert(type == from_headset::body_type::bd);
 
-	xrt_body_joint_set s{
-	        .body_joint_set_bd = {
+	sample s{
+	        .header = {
 	                .sample_time_ns = tracking.timestamp,
 	                .is_active = true, // FIXME: what is this supposed to be?
 	                .all_joint_poses_tracked = tracking.all_tracked,
@@ -236,7 +218,7 @@ void body_joints_list::update_tracking(const wivrn::from_headset::bd_body & trac
 	for (size_t joint = XRT_BODY_JOINT_PELVIS_BD; joint < XRT_BODY_JOINT_COUNT_BD; joint++)
 	{
 		const auto pose = to_relation(tracking.joints[joint]);
-		s.body_joint_set_bd.joint_locations[joint].relation = pose;
+		s.joints.set(joint, pose);
 
 		if (auto it = parent.virtual_trackers.find(joint); it != parent.virtual_trackers.cend())
 		{
@@ -25,7 +25,7 @@
 #include "xrt/xrt_defines.h"
 #include "xrt/xrt_device.h"
 
-#include "history.h"
+#include "joint_history.h"
 #include "pose_list.h"
 #include "wivrn_packets.h"
 
@@ -38,15 +38,25 @@ class wivrn_session;
 class wivrn_body_tracker;
 struct clock_offset;
 
-class body_joints_list : public history<body_joints_list, xrt_body_joint_set>
+struct body_joints_header
+{
+	int64_t sample_time_ns;
+	float confidence;
+	bool is_active;
+	bool all_joint_poses_tracked;
+};
+
+class body_joints_list : public joint_history<body_joints_list, xrt_body_joint_set, body_joints_header, XRT_FULL_BODY_JOINT_COUNT_META>
 {
 	wivrn::from_headset::body_type type;
 	wivrn_body_tracker & parent;
 
+	size_t joint_count() const;
+
 public:
 	body_joints_list(wivrn::from_headset::body_type type, wivrn_body_tracker & parent) : type(type), parent(parent) {}
-	xrt_body_joint_set interpolate(const xrt_body_joint_set & a, const xrt_body_joint_set & b, float t);
-	xrt_body_joint_set extrapolate(const xrt_body_joint_set & a, const xrt_body_joint_set & b, int64_t ta, int64_t tb, int64_t t);
+	void interpolate(const sample & a, const sample & b, float t, sample & out);
+	xrt_body_joint_set to_data(const sample &);
 
 	void update_tracking(const wivrn::from_headset::meta_body & tracking, const clock_offset & offset);
 	void update_tracking(const wivrn::from_headset::bd_body & tracking, const clock_offset & offset);
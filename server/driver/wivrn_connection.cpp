@@ -27,6 +27,7 @@
 #include <algorithm>
 #include <arpa/inet.h>
 #include <chrono>
+#include <optional>
 #include <poll.h>
 #include <regex>
 #include <sys/socket.h>
@@ -34,6 +35,9 @@
 
 using namespace std::chrono_literals;
 
+// How long after a connection loss the headset can resume the session without a key exchange
+static const auto resume_grace_period = 30s;
+
 // Ignored until connection is established
 static void handle_event_from_main_loop(to_monado::stop) {}
 static void handle_event_from_main_loop(to_monado::disconnect) {}
@@ -181,67 +185,97 @@ void wivrn::wivrn_connection::init(std::stop_token stop_token, std::function<voi
 		        return k.public_key == key;
 	        });
 
-	switch (state)
+	resumed_ = crypto_handshake.resume and resumable and is_public_key_known and
+	           state != encryption_state::disabled and
+	           std::chrono::steady_clock::now() < resumable->deadline and
+	           resumable->public_key == clean_key(crypto_handshake.public_key) and
+	           crypto_handshake.resume->ticket == resumable->keys.resume_ticket();
+
+	std::optional<secrets> keys;
+	if (resumed_)
 	{
-		case encryption_state::disabled:
-			// Encryption and authentication are disabled
-			control.send(to_headset::crypto_handshake{
-			        .state = to_headset::crypto_handshake::crypto_state::encryption_disabled,
-			});
-			break;
-
-		case encryption_state::enabled:
-			if (not is_public_key_known)
-			{
+		// A ticket can only be used once, it changes with the keys. Other handshakes, even
+		// rejected ones, leave it for the headset that owns it.
+		auto previous = std::exchange(resumable, std::nullopt);
+
+		std::array<uint8_t, 16> nonce;
+		crypto::random_bytes(nonce);
+
+		control.send(to_headset::crypto_handshake{
+		        .state = to_headset::crypto_handshake::crypto_state::resumed,
+		        .nonce = nonce,
+		});
+
+		keys.emplace(previous->keys, crypto_handshake.resume->nonce, nonce);
+	}
+	else
+	{
+		switch (state)
+		{
+			case encryption_state::disabled:
+				// Encryption and authentication are disabled
 				control.send(to_headset::crypto_handshake{
-				        .state = to_headset::crypto_handshake::crypto_state::pairing_disabled,
+				        .state = to_headset::crypto_handshake::crypto_state::encryption_disabled,
 				});
-				throw std::runtime_error("Client not known and pairing is disabled");
-			}
+				break;
 
-			[[fallthrough]];
+			case encryption_state::enabled:
+				if (not is_public_key_known)
+				{
+					control.send(to_headset::crypto_handshake{
+					        .state = to_headset::crypto_handshake::crypto_state::pairing_disabled,
+					});
+					throw std::runtime_error("Client not known and pairing is disabled");
+				}
 
-		case encryption_state::pairing:
-			// Generate an ephemeral key pair just for exchanging the AES key
-			crypto::key server_key = crypto::key::generate_x448_keypair();
+				[[fallthrough]];
 
-			control.send(to_headset::crypto_handshake{
-			        .public_key = server_key.public_key(),
-			        .state = is_public_key_known
-			                         ? to_headset::crypto_handshake::crypto_state::client_already_paired
-			                         : to_headset::crypto_handshake::crypto_state::pin_needed,
-			});
+			case encryption_state::pairing:
+				// Generate an ephemeral key pair just for exchanging the AES key
+				crypto::key server_key = crypto::key::generate_x448_keypair();
 
-			if (not is_public_key_known)
-			{
-				try
+				control.send(to_headset::crypto_handshake{
+				        .public_key = server_key.public_key(),
+				        .state = is_public_key_known
+				                         ? to_headset::crypto_handshake::crypto_state::client_already_paired
+				                         : to_headset::crypto_handshake::crypto_state::pin_needed,
+				});
+
+				if (not is_public_key_known)
 				{
-					// Check the PIN
-					crypto::smp pin_check;
+					try
+					{
+						// Check the PIN
+						crypto::smp pin_check;
 
-					auto msg1 = std::get<from_headset::pin_check_1>(receive(2min).first).message;
+						auto msg1 = std::get<from_headset::pin_check_1>(receive(2min).first).message;
 
-					auto msg2 = pin_check.step2(msg1, pin);
-					control.send(to_headset::pin_check_2{msg2});
+						auto msg2 = pin_check.step2(msg1, pin);
+						control.send(to_headset::pin_check_2{msg2});
 
-					auto msg3 = std::get<from_headset::pin_check_3>(receive(10s).first).message;
+						auto msg3 = std::get<from_headset::pin_check_3>(receive(10s).first).message;
 
-					auto [msg4, pin_match] = pin_check.step4(msg3);
-					control.send(to_headset::pin_check_4{msg4});
+						auto [msg4, pin_match] = pin_check.step4(msg3);
+						control.send(to_headset::pin_check_4{msg4});
 
-					if (not pin_match)
-						throw incorrect_pin{};
-				}
-				catch (crypto::smp_cheated &)
-				{
-					throw std::runtime_error("Unable to check PIN");
+						if (not pin_match)
+							throw incorrect_pin{};
+					}
+					catch (crypto::smp_cheated &)
+					{
+						throw std::runtime_error("Unable to check PIN");
+					}
 				}
-			}
 
-			secrets s{server_key, headset_key, is_public_key_known ? "000000" : pin};
-			control.set_aes_key_and_ivs(s.control_key, s.control_iv_from_headset, s.control_iv_to_headset);
-			stream.set_aes_key_and_ivs(s.stream_key, s.stream_iv_header_from_headset, s.stream_iv_header_to_headset);
-			break;
+				keys.emplace(server_key, headset_key, is_public_key_known ? "000000" : pin);
+				break;
+		}
+	}
+
+	if (keys)
+	{
+		control.set_aes_key_and_ivs(keys->control_key, keys->control_iv_from_headset, keys->control_iv_to_headset);
+		stream.set_aes_key_and_ivs(keys->stream_key, keys->stream_iv_header_from_headset, keys->stream_iv_header_to_headset);
 	}
 
 	// Wait for confirmation that the client has set up encryption
@@ -274,6 +308,11 @@ void wivrn::wivrn_connection::init(std::stop_token stop_token, std::function<voi
 	info_packet = std::get<from_headset::headset_info_packet>(receive(10s).first);
 
 	active = true;
+	if (keys)
+		resumable = resumable_session{
+		        .keys = *keys,
+		        .public_key = clean_key(headset_key.public_key()),
+		};
 
 	if (state == encryption_state::pairing and not is_public_key_known)
 		wivrn::add_known_key({
@@ -295,12 +334,20 @@ void wivrn::wivrn_connection::reset(std::stop_token stop, TCP && tcp, std::funct
 
 void wivrn::wivrn_connection::shutdown()
 {
+	resumable.reset();
 	if (stream)
 		::shutdown(stream.get_fd(), SHUT_RDWR);
 	if (control)
 		::shutdown(control.get_fd(), SHUT_RDWR);
 }
 
+void wivrn::wivrn_connection::pause()
+{
+	active = false;
+	if (resumable)
+		resumable->deadline = std::chrono::steady_clock::now() + resume_grace_period;
+}
+
 std::optional<wivrn::from_headset::packets> wivrn::wivrn_connection::poll_control(int timeout)
 {
 	pollfd fds{};
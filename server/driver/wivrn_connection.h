@@ -19,11 +19,14 @@
 
 #pragma once
 
+#include "os/os_time.h"
+#include "secrets.h"
 #include "wivrn_ipc.h"
 #include "wivrn_packets.h"
 #include "wivrn_sockets.h"
 
 #include <atomic>
+#include <chrono>
 #include <optional>
 #include <poll.h>
 #include <stdexcept>
@@ -56,6 +59,17 @@ private:
 	encryption_state state;
 
 	from_headset::headset_info_packet info_packet;
+	int64_t receive_time_ = 0;
+
+	// Keys of the last encrypted connection, the headset can resume it with a ticket derived from them
+	struct resumable_session
+	{
+		secrets keys;
+		std::string public_key;
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+	};
+	std::optional<resumable_session> resumable;
+	bool resumed_ = false;
 
 	void init(std::stop_token stop_token, std::function<void()> tick = []() {});
 
@@ -74,7 +88,16 @@ public:
 		return active;
 	}
 	void reset(std::stop_token stop, TCP && tcp, std::function<void()> tick = {});
+	// Deliberate disconnection, the headset cannot resume the session
 	void shutdown();
+	// Connection lost, the headset can resume the session for a limited time
+	void pause();
+
+	// The headset resumed the previous session during the last handshake
+	bool resumed() const
+	{
+		return resumed_;
+	}
 
 	template <typename T>
 	void send_control(T && packet)
@@ -118,6 +141,12 @@ public:
 		return info_packet;
 	}
 
+	// CLOCK_MONOTONIC time at which the packet being handled by poll was received by the kernel
+	int64_t receive_time() const
+	{
+		return receive_time_;
+	}
+
 	template <typename T>
 	int poll(T && visitor, int timeout)
 	{
@@ -130,9 +159,15 @@ public:
 		fds[2].events = POLLIN;
 
 		while (auto packet = stream.receive_pending())
+		{
+			receive_time_ = stream.receive_time();
 			std::visit(std::forward<T>(visitor), std::move(*packet));
+		}
 		while (auto packet = control.receive_pending())
+		{
+			receive_time_ = control.receive_time();
 			std::visit(std::forward<T>(visitor), std::move(*packet));
+		}
 
 		int r = ::poll(fds, std::size(fds), timeout);
 		if (r < 0)
@@ -151,21 +186,30 @@ public:
 		{
 			auto packet = stream.receive();
 			if (packet)
+			{
+				receive_time_ = stream.receive_time();
 				std::visit(std::forward<T>(visitor), std::move(*packet));
+			}
 		}
 
 		if (fds[1].revents & POLLIN)
 		{
 			auto packet = control.receive();
 			if (packet)
+			{
+				receive_time_ = control.receive_time();
 				std::visit(std::forward<T>(visitor), std::move(*packet));
+			}
 		}
 
 		if (fds[2].revents & POLLIN)
 		{
 			auto packet = receive_from_main();
 			if (packet)
+			{
+				receive_time_ = os_monotonic_get_ns();
 				std::visit(std::forward<T>(visitor), std::move(*packet));
+			}
 		}
 		return r;
 	}
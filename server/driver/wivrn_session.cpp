@@ -401,7 +401,7 @@ void wivrn_session::pause_session()
 	// pause session components
 
 	worker_thread = std::jthread();
-	offset_est.reset();
+	connection->pause();
 
 	if (audio_handle)
 		audio_handle->pause();
@@ -418,6 +418,16 @@ void wivrn_session::resume_session()
 
 	// reset session components and send descriptor packets to headset
 
+	// The headset clock is unchanged if it resumed the session, unless it went to sleep
+	if (connection->resumed())
+		offset_est.warm_start();
+	else
+	{
+		offset_est.reset();
+		// A new headset session numbers its feedback from 0 again
+		feedback_receiver = {};
+	}
+
 	if (audio_handle)
 		audio_handle->resume();
 
@@ -775,18 +785,73 @@ void wivrn_session::operator()(from_headset::hid::input && e)
 	}
 }
 
+void wivrn_session::flush_uinput()
+{
+	try
+	{
+		uinput_handler->flush();
+	}
+	catch (const std::exception & e)
+	{
+		wivrn_ipc_socket_monado->send(from_monado::server_error{
+		        .where = "HID forwarding error",
+		        .message = e.what(),
+		});
+		U_LOG_E("HID forwarding error: %s", e.what());
+		uinput_handler.reset();
+	}
+}
+
 void wivrn_session::operator()(from_headset::timesync_response && timesync)
 {
-	offset_est.add_sample(timesync);
+	// Handling may be delayed by other packets, the kernel timestamp only includes network latency
+	XrTime received = connection->receive_time();
+	statistics::add_round_trip_time(received - timesync.query);
+	offset_est.add_sample(timesync, received);
 }
 
 void wivrn_session::operator()(from_headset::feedback && feedback)
 {
+	// Frames skipped by the compositor are reported as lost
+	if (not compositor.is_encoded(feedback.frame_index))
+		return;
+
+	statistics::add_feedback(feedback);
+
 	clock_offset o = offset_est.get_offset();
 	if (not o)
 		return;
 	compositor.on_feedback(feedback, o);
+	dump_feedback(feedback, o);
+}
+
+void wivrn_session::operator()(from_headset::feedback_batch && batch)
+{
+	clock_offset o = offset_est.get_offset();
+	for (const auto & frame: feedback_receiver(batch))
+	{
+		// One per encoder
+		beman::inplace_vector::inplace_vector<from_headset::feedback, 3> feedbacks;
+		for (const auto & stream: frame.streams)
+		{
+			auto feedback = unpack_feedback(frame, stream);
+			// Frames skipped by the compositor are reported as lost
+			if (feedbacks.size() == feedbacks.capacity() or not compositor.is_encoded(feedback.frame_index))
+				continue;
+			statistics::add_feedback(feedback);
+			feedbacks.push_back(feedback);
+		}
+
+		if (not o)
+			continue;
+		compositor.on_feedback(std::span<const from_headset::feedback>(feedbacks), o);
+		for (const auto & feedback: feedbacks)
+			dump_feedback(feedback, o);
+	}
+}
 
+void wivrn_session::dump_feedback(const from_headset::feedback & feedback, const clock_offset & o)
+{
 	if (feedback.received_first_packet)
 		dump_time("receive_begin", feedback.frame_index, o.from_headset(feedback.received_first_packet), feedback.stream_index);
 	if (feedback.received_last_packet)
@@ -1064,6 +1129,21 @@ struct refresh_rate_adjuster
 	}
 };
 
+// Statistics are sent to the main loop, which updates the D-Bus properties
+struct statistics_publisher
+{
+	std::chrono::seconds period{1};
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now() + period;
+
+	bool advance(std::chrono::steady_clock::time_point now)
+	{
+		if (next > now)
+			return false;
+		next += period;
+		return true;
+	}
+};
+
 void wivrn_session::run_net(std::stop_token stop)
 {
 	while (not stop.stop_requested())
@@ -1072,6 +1152,9 @@ void wivrn_session::run_net(std::stop_token stop)
 		{
 			connection->poll(*this, 20);
 
+			if (uinput_handler)
+				flush_uinput();
+
 			if (uinput_handler)
 			{
 				for (auto & haptics: uinput_handler->read_rumble())
@@ -1103,6 +1186,7 @@ void wivrn_session::run_net(std::stop_token stop)
 void wivrn_session::run_worker(std::stop_token stop)
 {
 	refresh_rate_adjuster refresh(get_info(), settings, app_pacers);
+	statistics_publisher stats;
 	while (not stop.stop_requested())
 	{
 		try
@@ -1112,9 +1196,12 @@ void wivrn_session::run_worker(std::stop_token stop)
 			                refresh.next,
 			                control.next,
 			                offset_est.next(),
+			                stats.next,
 			        }));
 			auto now = std::chrono::steady_clock::now();
 			offset_est.request_sample(now, *connection);
+			if (stats.advance(now))
+				wivrn_ipc_socket_monado->send(statistics::collect(offset_est.get_offset()));
 			const bool do_refresh = refresh.advance(now);
 			const bool do_control = control.advance(now);
 			if (do_refresh or do_control)
@@ -1249,6 +1336,7 @@ std::pair<bool, std::optional<std::string>> wivrn_session::validate_headset_info
 		refuse |= prev_info.palm_pose != info.palm_pose;
 		refuse |= prev_info.user_presence != info.user_presence;
 		refuse |= prev_info.passthrough != info.passthrough;
+		refuse |= prev_info.composition_layer_depth != info.composition_layer_depth;
 		refuse |= prev_info.body_tracking != info.body_tracking;
 
 		refuse |= prev_info.available_refresh_rates != info.available_refresh_rates;
@@ -1283,6 +1371,8 @@ void wivrn_session::reconnect(std::stop_token stop)
 			}
 
 			connection->reset(stop, std::move(*tcp), [this]() { quit_if_no_client(); });
+			if (connection->resumed())
+				U_LOG_I("Headset resumed the previous session");
 
 			// validate if headset is compatible with the current session
 
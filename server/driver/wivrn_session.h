@@ -22,6 +22,7 @@
 #include "app_pacer.h"
 #include "clock_offset.h"
 #include "compositor/compositor.h"
+#include "feedback_batch.h"
 #include "inplace_vector.hpp"
 #include "tracking_control.h"
 #include "utils/thread_safe.h"
@@ -108,6 +109,7 @@ class wivrn_session : public xrt_system_devices
 	bool gamepad_connected = false; // network thread only
 
 	clock_offset_estimator offset_est;
+	feedback_batch_receiver feedback_receiver; // network thread only
 	std::atomic<XrDuration> tracking_latency; // production to reception time
 
 	std::mutex csv_mutex;
@@ -178,6 +180,7 @@ public:
 	void operator()(from_headset::hid::input && e);
 	void operator()(from_headset::timesync_response &&);
 	void operator()(from_headset::feedback &&);
+	void operator()(from_headset::feedback_batch &&);
 	void operator()(from_headset::battery &&);
 	void operator()(from_headset::visibility_mask_changed &&);
 	void operator()(from_headset::session_state_changed &&);
@@ -220,9 +223,11 @@ public:
 	void dump_time(const std::string & event, uint64_t frame, int64_t time, uint8_t stream = -1, const char * extra = "");
 
 private:
+	void dump_feedback(const from_headset::feedback &, const clock_offset &);
 	void run_net(std::stop_token stop);
 	void run_worker(std::stop_token stop);
 	void reconnect(std::stop_token stop);
+	void flush_uinput();
 
 	void pause_session();
 	void resume_session();
@@ -11,7 +11,6 @@
 
 #include <fcntl.h>
 #include <sys/ioctl.h>
-#include <sys/time.h>
 #include <system_error>
 #include <unistd.h>
 
@@ -57,20 +56,13 @@ void fill_ids(uinput_user_dev & uidev, uint16_t product) noexcept
 	fill_ids(uidev, 0x4711, product);
 }
 
-void emit_ev(int fd, uint16_t type, uint16_t code, int32_t value)
+// Takes the integer part of value + remainder and keeps the rest for later
+int32_t take_integer(float value, float & remainder)
 {
-	struct input_event ev;
-	std::memset(&ev, 0, sizeof(ev));
-	gettimeofday(&ev.time, nullptr);
-	ev.type = type;
-	ev.code = code;
-	ev.value = value;
-	write_or_throw(fd, &ev, sizeof(ev));
-}
-
-void syn(int fd)
-{
-	emit_ev(fd, EV_SYN, SYN_REPORT, 0);
+	float total = value + remainder;
+	float integer = std::trunc(total);
+	remainder = total - integer;
+	return int32_t(integer);
 }
 
 void ioctl_or_throw(int fd, unsigned long op)
@@ -145,8 +137,6 @@ void wivrn_uinput::handle_gamepad(const wivrn::from_headset::inputs & inputs)
 			return;
 		init_gamepad();
 	}
-	int fd = gamepad_fd.get_fd();
-
 	bool dpad_left = false, dpad_right = false, dpad_up = false, dpad_down = false;
 
 	for (const auto & value: inputs.values)
@@ -157,14 +147,14 @@ void wivrn_uinput::handle_gamepad(const wivrn::from_headset::inputs & inputs)
 		switch (m.kind)
 		{
 			case gp_value::button:
-				emit_ev(fd, EV_KEY, m.ev_code, value.value != 0);
+				gamepad_events.add(EV_KEY, m.ev_code, value.value != 0);
 				break;
 			case gp_value::trigger:
-				emit_ev(fd, EV_ABS, m.ev_code, scale_trigger(value.value));
+				gamepad_events.add(EV_ABS, m.ev_code, scale_trigger(value.value));
 				break;
 			case gp_value::stick_x:
 			case gp_value::stick_y:
-				emit_ev(fd, EV_ABS, m.ev_code, scale_stick(value.value));
+				gamepad_events.add(EV_ABS, m.ev_code, scale_stick(value.value));
 				break;
 			case gp_value::dpad:
 				switch (m.slot)
@@ -188,9 +178,9 @@ void wivrn_uinput::handle_gamepad(const wivrn::from_headset::inputs & inputs)
 		}
 	}
 
-	emit_ev(fd, EV_ABS, ABS_HAT0X, (dpad_right ? 1 : 0) - (dpad_left ? 1 : 0));
-	emit_ev(fd, EV_ABS, ABS_HAT0Y, (dpad_down ? 1 : 0) - (dpad_up ? 1 : 0));
-	syn(fd);
+	gamepad_events.add(EV_ABS, ABS_HAT0X, (dpad_right ? 1 : 0) - (dpad_left ? 1 : 0));
+	gamepad_events.add(EV_ABS, ABS_HAT0Y, (dpad_down ? 1 : 0) - (dpad_up ? 1 : 0));
+	gamepad_events.syn();
 }
 
 void wivrn_uinput::destroy_gamepad()
@@ -199,9 +189,17 @@ void wivrn_uinput::destroy_gamepad()
 		return;
 	ioctl(gamepad_fd.get_fd(), UI_DEV_DESTROY);
 	gamepad_fd = {};
+	gamepad_events = {};
 	ff_effects.clear();
 }
 
+void wivrn_uinput::flush()
+{
+	kbd_events.flush(kbd_fd);
+	mouse_events.flush(mouse_fd);
+	gamepad_events.flush(gamepad_fd);
+}
+
 std::vector<wivrn::to_headset::haptics> wivrn_uinput::read_rumble()
 {
 	int fd = gamepad_fd.get_fd();
@@ -267,34 +265,42 @@ std::vector<wivrn::to_headset::haptics> wivrn_uinput::read_rumble()
 
 void wivrn_uinput::send_key(uint16_t key, bool down)
 {
-	emit_ev(kbd_fd, EV_KEY, key, down ? 1 : 0);
-	syn(kbd_fd);
+	kbd_events.add(EV_KEY, key, down ? 1 : 0);
+	kbd_events.syn();
 }
 
 /// 0: left, 1: right, 2: middle
 void wivrn_uinput::send_button(uint16_t mouse_button, bool down)
 {
 	mouse_button += BTN_MOUSE;
-	emit_ev(mouse_fd, EV_KEY, mouse_button, down ? 1 : 0);
-	syn(mouse_fd);
+	mouse_events.add(EV_KEY, mouse_button, down ? 1 : 0);
+	mouse_events.syn();
 }
 
-void wivrn_uinput::mouse_move_relative(int16_t x, int16_t y)
+void wivrn_uinput::mouse_move_relative(float x, float y)
 {
-	if (x)
-		emit_ev(mouse_fd, EV_REL, REL_X, x);
-	if (y)
-		emit_ev(mouse_fd, EV_REL, REL_Y, y);
-	syn(mouse_fd);
+	int32_t dx = take_integer(x, mouse_x);
+	int32_t dy = take_integer(y, mouse_y);
+	if (dx == 0 and dy == 0)
+		return;
+	if (dx)
+		mouse_events.add(EV_REL, REL_X, dx);
+	if (dy)
+		mouse_events.add(EV_REL, REL_Y, dy);
+	mouse_events.syn();
 }
 
-void wivrn_uinput::mouse_scroll(int16_t vertical, int16_t horizontal)
+void wivrn_uinput::mouse_scroll(float vertical, float horizontal)
 {
-	if (vertical)
-		emit_ev(mouse_fd, EV_REL, REL_WHEEL, vertical);
-	if (horizontal)
-		emit_ev(mouse_fd, EV_REL, REL_HWHEEL, horizontal);
-	syn(mouse_fd);
+	int32_t v = take_integer(vertical, scroll_v);
+	int32_t h = take_integer(horizontal, scroll_h);
+	if (v == 0 and h == 0)
+		return;
+	if (v)
+		mouse_events.add(EV_REL, REL_WHEEL, v);
+	if (h)
+		mouse_events.add(EV_REL, REL_HWHEEL, h);
+	mouse_events.syn();
 }
 
 void wivrn_uinput::init_keyboard()
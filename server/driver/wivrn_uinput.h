@@ -1,3 +1,4 @@
+#include "uinput_batch.h"
 #include "wivrn_packets.h"
 #include "wivrn_sockets.h"
 
@@ -13,6 +14,7 @@ public:
 	// Devices are created lazily on first use, so only forwarded classes are exposed.
 	wivrn_uinput() = default;
 
+	// Events are queued until flush() is called
 	void handle_input(wivrn::from_headset::hid::input &);
 
 	// The gamepad device is created on the first packet with gamepad inputs
@@ -20,6 +22,10 @@ public:
 	// Remove the virtual gamepad, when the headset stops mirroring or the gamepad disconnects
 	void destroy_gamepad();
 
+	// Writes the events queued since the last call, once per network tick so that
+	// mouse motions received together are merged
+	void flush();
+
 	// Drains pending force-feedback requests from the virtual gamepad and returns the
 	// resulting haptics packets to forward to the headset, if any changed.
 	std::vector<wivrn::to_headset::haptics> read_rumble();
@@ -31,13 +37,21 @@ private:
 
 	void send_key(uint16_t key, bool down);
 	void send_button(uint16_t mouse_button, bool down);
-	void mouse_move_relative(int16_t x, int16_t y);
-	void mouse_scroll(int16_t vertical, int16_t horizontal);
+	void mouse_move_relative(float x, float y);
+	void mouse_scroll(float vertical, float horizontal);
 
 	static constexpr int ff_effects_max = 16;
 
 	wivrn::fd_base kbd_fd;
 	wivrn::fd_base mouse_fd;
 	wivrn::fd_base gamepad_fd;
+	wivrn::uinput_batch kbd_events;
+	wivrn::uinput_batch mouse_events;
+	wivrn::uinput_batch gamepad_events;
+	// Fractional parts of relative motions not sent yet
+	float mouse_x = 0;
+	float mouse_y = 0;
+	float scroll_v = 0;
+	float scroll_h = 0;
 	std::map<int16_t, ff_effect> ff_effects;
 };
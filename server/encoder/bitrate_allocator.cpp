@@ -0,0 +1,150 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bitrate_allocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+
+namespace wivrn
+{
+
+bitrate_allocator::bitrate_allocator(std::vector<double> shares) :
+        bitrate_allocator(std::move(shares), parameters{})
+{
+}
+
+bitrate_allocator::bitrate_allocator(std::vector<double> shares, parameters params) :
+        params(params),
+        initial(shares),
+        current(std::move(shares)),
+        kept(current.size(), false)
+{
+}
+
+bool bitrate_allocator::update(std::span<const stream_stats> stats, int64_t duration_ns)
+{
+	assert(stats.size() == current.size());
+	if (duration_ns <= 0)
+		return false;
+
+	// Reference quantization, over the streams that report it
+	double qp_sum = 0;
+	int qp_count = 0;
+	bool active = false;
+	for (const auto & s: stats)
+	{
+		if (s.frames == 0)
+			continue;
+		active = true;
+		if (s.qp >= 0)
+		{
+			qp_sum += s.qp;
+			++qp_count;
+		}
+	}
+	// Nothing was encoded, e.g. static frames
+	if (not active)
+		return false;
+
+	// Streams that did not encode anything keep their share, the others share the rest
+	std::vector<double> target = current;
+	std::vector<bool> fixed = kept;
+	double budget = 1;
+	for (size_t i = 0; i < current.size(); ++i)
+	{
+		const auto & s = stats[i];
+		if (s.frames == 0)
+			fixed[i] = true;
+		if (fixed[i])
+		{
+			budget -= current[i];
+			continue;
+		}
+
+		if (qp_count > 1 and s.qp >= 0)
+			target[i] *= std::exp2((s.qp - qp_sum / qp_count) / params.qp_per_doubling);
+
+		if (s.bitrate)
+		{
+			double used = s.bytes * 8 / (s.bitrate * duration_ns * 1e-9);
+			if (used < params.underuse)
+				target[i] = std::min(target[i], current[i] * used / params.underuse);
+		}
+	}
+
+	// Scale the targets so that they sum to the budget once clamped. The clamped sum increases
+	// with the scale, and the current shares are a solution within the bounds.
+	auto clamped = [&](double scale, size_t i) {
+		return std::clamp(target[i] * scale, initial[i] * params.min_ratio, initial[i] * params.max_ratio);
+	};
+	auto clamped_sum = [&](double scale) {
+		double sum = 0;
+		for (size_t i = 0; i < target.size(); ++i)
+			if (not fixed[i])
+				sum += clamped(scale, i);
+		return sum;
+	};
+
+	double low = 0;
+	double high = 1;
+	while (clamped_sum(high) < budget and high < 1e9)
+		high *= 2;
+	for (int iteration = 0; iteration < 64; ++iteration)
+	{
+		double mid = (low + high) / 2;
+		if (clamped_sum(mid) < budget)
+			low = mid;
+		else
+			high = mid;
+	}
+
+	for (size_t i = 0; i < target.size(); ++i)
+		if (not fixed[i])
+			target[i] = clamped(high, i);
+
+	// Remove the rounding error of the search from the streams that are not at a bound
+	double error = std::accumulate(target.begin(), target.end(), 0.) - 1;
+	for (size_t i = 0; i < target.size() and error != 0; ++i)
+	{
+		if (fixed[i])
+			continue;
+		double value = std::clamp(target[i] - error, initial[i] * params.min_ratio, initial[i] * params.max_ratio);
+		error -= target[i] - value;
+		target[i] = value;
+	}
+
+	double moved = 0;
+	for (size_t i = 0; i < target.size(); ++i)
+	{
+		target[i] = current[i] + params.smoothing * (target[i] - current[i]);
+		moved += std::abs(target[i] - current[i]);
+	}
+
+	// Each move is counted on both streams
+	if (moved / 2 < params.hysteresis)
+		return false;
+
+	current = std::move(target);
+	return true;
+}
+
+} // namespace wivrn
@@ -0,0 +1,98 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace wivrn
+{
+
+// Moves bitrate between the streams of a session, the total stays the same.
+//
+// Streams start from the split computed with the encoder settings, from pixel counts and codecs.
+// Each period, the bytes produced by a stream are compared to its budget and, when the encoder
+// reports it, its mean quantization to the one of the other streams: a stream that does not use
+// its budget gives the unused part to the others, a stream quantized more coarsely than the
+// others gets more. Shares stay within [min_ratio, max_ratio] times the initial split. A stream
+// that encoded nothing during the period keeps its share.
+class bitrate_allocator
+{
+public:
+	// What a stream produced during a period
+	struct stream_stats
+	{
+		uint64_t bytes = 0;
+		uint32_t frames = 0;
+		// Mean quantization parameter of the frames, negative if the encoder does not report it
+		float qp = -1;
+		// Bitrate of the stream during the period, bit/s
+		uint64_t bitrate = 0;
+	};
+
+	struct parameters
+	{
+		int64_t period_ns = 1'000'000'000;
+		float min_ratio = 0.5;
+		float max_ratio = 2;
+		// A stream using less than this fraction of its budget gives away the rest
+		float underuse = 0.8;
+		// Quantization difference for which the bitrate of a stream is doubled
+		float qp_per_doubling = 6;
+		// Fraction of the way to the target done in each period
+		float smoothing = 0.5;
+		// Fraction of the total bitrate that must move before the shares are changed
+		float hysteresis = 0.03;
+	};
+
+private:
+	const parameters params;
+	const std::vector<double> initial;
+	std::vector<double> current;
+	std::vector<bool> kept;
+
+public:
+	// shares is the initial fraction of the total bitrate of each stream, summing to 1
+	bitrate_allocator(std::vector<double> shares);
+	bitrate_allocator(std::vector<double> shares, parameters params);
+
+	// stats contains one item per stream, covering duration_ns.
+	// Returns true if the shares changed.
+	bool update(std::span<const stream_stats> stats, int64_t duration_ns);
+
+	// The share of the stream never changes, for encoders that cannot change their bitrate in place
+	void keep_share(size_t stream)
+	{
+		kept.at(stream) = true;
+	}
+
+	const std::vector<double> & shares() const
+	{
+		return current;
+	}
+
+	int64_t period() const
+	{
+		return params.period_ns;
+	}
+};
+
+} // namespace wivrn
@@ -0,0 +1,213 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "encoder_cache.h"
+
+#include "driver/configuration.h"
+#include "util/u_logging.h"
+#include "utils/wivrn_vk_bundle.h"
+#include "utils/xdg_base_directory.h"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <magic_enum.hpp>
+#include <nlohmann/json.hpp>
+#include <unistd.h>
+
+namespace wivrn
+{
+
+namespace
+{
+// Same name as the pipeline cache: GPU UUID and driver version
+std::filesystem::path cache_file(const vk_bundle & vk)
+{
+	return xdg_cache_home() / "wivrn" / "encoder_cache" / vk.pipeline_cache_path.filename();
+}
+
+std::string probe_key(std::string_view encoder, video_codec codec, int bit_depth, const std::optional<std::string> & device)
+{
+	return std::format("{} {} {} {}", encoder, magic_enum::enum_name(codec), bit_depth, device.value_or("default"));
+}
+
+video_codec parse_codec(const nlohmann::json & json)
+{
+	auto codec = magic_enum::enum_cast<video_codec>(json.get<std::string>());
+	if (not codec)
+		throw std::runtime_error("invalid codec " + json.get<std::string>());
+	return *codec;
+}
+
+nlohmann::json to_json(const encoder_settings & settings)
+{
+	nlohmann::json json{
+	        {"encoder", settings.encoder_name},
+	        {"codec", std::string(magic_enum::enum_name(settings.codec))},
+	        {"width", settings.width},
+	        {"height", settings.height},
+	        {"fps", settings.fps},
+	        {"bitrate", settings.bitrate},
+	        {"bitrate-multiplier", settings.bitrate_multiplier},
+	        {"bit-depth", settings.bit_depth},
+	        {"foveation-qp", settings.foveation_qp},
+	        {"options", settings.options},
+	};
+	if (settings.device)
+		json["device"] = *settings.device;
+	return json;
+}
+
+encoder_settings from_json(const nlohmann::json & json)
+{
+	encoder_settings settings{
+	        .width = json.at("width"),
+	        .height = json.at("height"),
+	        .codec = parse_codec(json.at("codec")),
+	        .fps = json.at("fps"),
+	        .encoder_name = json.at("encoder").get<std::string>(),
+	        .bitrate = json.at("bitrate"),
+	        .bitrate_multiplier = json.at("bitrate-multiplier"),
+	        .options = json.at("options").get<std::map<std::string, std::string>>(),
+	        .bit_depth = json.at("bit-depth"),
+	        .foveation_qp = json.at("foveation-qp"),
+	};
+	if (auto it = json.find("device"); it != json.end())
+		settings.device = it->get<std::string>();
+	return settings;
+}
+} // namespace
+
+encoder_cache::encoder_cache(const vk_bundle & vk)
+{
+	if (not configuration().warm_start)
+		return;
+
+	path = cache_file(vk);
+	std::ifstream file(path);
+	if (not file)
+		return;
+
+	try
+	{
+		auto json = nlohmann::json::parse(file);
+		probes = json.at("probes").get<std::map<std::string, bool>>();
+		std::erase_if(probes, [](const auto & probe) { return not probe.second; });
+
+		if (auto it = json.find("last"); it != json.end())
+		{
+			last_connection last{
+			        .render_width = it->at("render-width"),
+			        .render_height = it->at("render-height"),
+			};
+			for (const auto & codec: it->at("supported-codecs"))
+				last.supported_codecs.push_back(parse_codec(codec));
+			const auto & encoders = it->at("encoders");
+			if (encoders.size() != last.encoders.size())
+				throw std::runtime_error("invalid number of encoders");
+			for (size_t i = 0; i < last.encoders.size(); ++i)
+				last.encoders[i] = from_json(encoders[i]);
+			last_ = std::move(last);
+		}
+	}
+	catch (std::exception & e)
+	{
+		U_LOG_W("Ignoring encoder cache %s: %s", path.c_str(), e.what());
+		probes.clear();
+		last_.reset();
+	}
+}
+
+std::optional<bool> encoder_cache::supported(std::string_view encoder, video_codec codec, int bit_depth, const std::optional<std::string> & device) const
+{
+	if (auto it = probes.find(probe_key(encoder, codec, bit_depth, device)); it != probes.end())
+		return it->second;
+	return std::nullopt;
+}
+
+void encoder_cache::set_supported(std::string_view encoder, video_codec codec, int bit_depth, const std::optional<std::string> & device, bool supported)
+{
+	probes[probe_key(encoder, codec, bit_depth, device)] = supported;
+	if (supported)
+		modified = true;
+}
+
+void encoder_cache::set_last(last_connection last)
+{
+	last_ = std::move(last);
+	modified = true;
+}
+
+void encoder_cache::save()
+{
+	if (path.empty() or not modified)
+		return;
+
+	try
+	{
+		std::map<std::string, bool> supported;
+		std::ranges::copy_if(probes, std::inserter(supported, supported.end()), [](const auto & probe) { return probe.second; });
+
+		nlohmann::json json{{"probes", supported}};
+		if (last_)
+		{
+			nlohmann::json encoders = nlohmann::json::array();
+			for (const auto & settings: last_->encoders)
+				encoders.push_back(to_json(settings));
+
+			nlohmann::json codecs = nlohmann::json::array();
+			for (auto codec: last_->supported_codecs)
+				codecs.push_back(std::string(magic_enum::enum_name(codec)));
+
+			json["last"] = {
+			        {"supported-codecs", codecs},
+			        {"encoders", encoders},
+			        {"render-width", last_->render_width},
+			        {"render-height", last_->render_height},
+			};
+		}
+
+		std::filesystem::create_directories(path.parent_path());
+
+		// Several processes may write it, replace the file atomically
+		std::filesystem::path tmp = path;
+		tmp += std::format(".{}", getpid());
+		{
+			std::ofstream file(tmp, std::ios::trunc);
+			file.exceptions(std::ofstream::failbit);
+			file << json.dump(1, '\t');
+		}
+		std::filesystem::rename(tmp, path);
+		modified = false;
+	}
+	catch (std::exception & e)
+	{
+		U_LOG_W("Failed to save encoder cache: %s", e.what());
+	}
+}
+
+void encoder_cache::invalidate(const vk_bundle & vk)
+{
+	std::error_code ec;
+	if (std::filesystem::remove(cache_file(vk), ec))
+		U_LOG_I("Encoder cache cleared");
+}
+
+} // namespace wivrn
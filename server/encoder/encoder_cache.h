@@ -0,0 +1,81 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "encoder_settings.h"
+#include "wivrn_packets.h"
+
+#include <array>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wivrn
+{
+struct vk_bundle;
+
+// Encoder probing results and settings of the last connection, persisted per GPU and driver
+// version like the pipeline cache. Every connection is served by a new process, without this the
+// test encoders are created again on each connection.
+class encoder_cache
+{
+public:
+	struct last_connection
+	{
+		std::vector<video_codec> supported_codecs;
+		std::array<encoder_settings, 3> encoders;
+		uint32_t render_width;
+		uint32_t render_height;
+	};
+
+private:
+	std::filesystem::path path;
+	// Key is "encoder codec bit_depth device", only supported ones are saved: a failure may come
+	// from a transient condition and is probed again by the next connection
+	std::map<std::string, bool> probes;
+	std::optional<last_connection> last_;
+	bool modified = false;
+
+public:
+	// Stays empty and is never saved when warm-start is disabled
+	explicit encoder_cache(const vk_bundle &);
+
+	// device is the one configured for the encoder
+	std::optional<bool> supported(std::string_view encoder, video_codec codec, int bit_depth, const std::optional<std::string> & device) const;
+	void set_supported(std::string_view encoder, video_codec codec, int bit_depth, const std::optional<std::string> & device, bool supported);
+
+	const std::optional<last_connection> & last() const
+	{
+		return last_;
+	}
+	void set_last(last_connection);
+
+	// Write the file if it changed
+	void save();
+
+	// Called when an encoder fails after being reported as supported, the next connection probes
+	// again
+	static void invalidate(const vk_bundle &);
+};
+
+} // namespace wivrn
@@ -20,11 +20,13 @@
 
 #include "driver/configuration.h"
 #include "driver/wivrn_session.h"
+#include "encoder_cache.h"
 #include "util/u_logging.h"
 #include "utils/wivrn_vk_bundle.h"
 #include "video_encoder.h"
 #include "wivrn_packets.h"
 
+#include <chrono>
 #include <magic_enum.hpp>
 #include <string>
 #include <vulkan/vulkan.hpp>
@@ -104,16 +106,15 @@ namespace
 class prober
 {
 	wivrn::vk_bundle & vk;
-	const from_headset::headset_info_packet & info;
+	encoder_cache & cache;
+	const std::vector<video_codec> & supported_codecs;
 	const bool nvidia;
 
 #if WIVRN_USE_VAAPI
-	std::unordered_map<video_codec, bool> vaapi_support;
-
-	bool check_vaapi(video_codec codec)
+	bool check_vaapi(video_codec codec, const std::optional<std::string> & device)
 	{
-		if (auto it = vaapi_support.find(codec); it != vaapi_support.end())
-			return it->second;
+		if (auto supported = cache.supported(encoder_vaapi, codec, 8, device))
+			return *supported;
 		try
 		{
 			video_encoder_va test(
@@ -125,14 +126,15 @@ class prober
 			                .fps = 60,
 			                .bitrate = 50'000'000,
 			                .bit_depth = 8,
+			                .device = device,
 			        },
 			        0);
-			vaapi_support[codec] = true;
+			cache.set_supported(encoder_vaapi, codec, 8, device, true);
 			return true;
 		}
 		catch (std::exception & e)
 		{
-			vaapi_support[codec] = false;
+			cache.set_supported(encoder_vaapi, codec, 8, device, false);
 			U_LOG_I("vaapi not supported for %s", std::string(magic_enum::enum_name(codec)).c_str());
 			return false;
 		}
@@ -140,12 +142,10 @@ class prober
 #endif
 
 #if WIVRN_USE_NVENC
-	std::unordered_map<video_codec, bool> nvenc_support;
-
-	bool check_nvenc(video_codec codec)
+	bool check_nvenc(video_codec codec, const std::optional<std::string> & device)
 	{
-		if (auto it = nvenc_support.find(codec); it != nvenc_support.end())
-			return it->second;
+		if (auto supported = cache.supported(encoder_nvenc, codec, 8, device))
+			return *supported;
 		try
 		{
 			video_encoder_nvenc test(
@@ -157,14 +157,15 @@ class prober
 			                .fps = 60,
 			                .bitrate = 50'000'000,
 			                .bit_depth = 8,
+			                .device = device,
 			        },
 			        0);
-			nvenc_support[codec] = true;
+			cache.set_supported(encoder_nvenc, codec, 8, device, true);
 			return true;
 		}
 		catch (std::exception & e)
 		{
-			nvenc_support[codec] = false;
+			cache.set_supported(encoder_nvenc, codec, 8, device, false);
 			U_LOG_I("nvenc not supported for %s", std::string(magic_enum::enum_name(codec)).c_str());
 			return false;
 		}
@@ -215,8 +216,8 @@ class prober
 #endif
 
 public:
-	prober(wivrn::vk_bundle & vk, const from_headset::headset_info_packet & info) :
-	        vk(vk), info(info), nvidia(is_nvidia(vk.physical_device)) {}
+	prober(wivrn::vk_bundle & vk, encoder_cache & cache, const std::vector<video_codec> & supported_codecs) :
+	        vk(vk), cache(cache), supported_codecs(supported_codecs), nvidia(is_nvidia(vk.physical_device)) {}
 
 	std::pair<std::string, video_codec> select_encoder(const configuration::encoder & config)
 	{
@@ -226,9 +227,9 @@ public:
 #if WIVRN_USE_NVENC
 		if ((nvidia and config.name.empty()) or config.name == encoder_nvenc)
 		{
-			for (auto codec: config.codec ? std::vector{*config.codec} : info.supported_codecs)
+			for (auto codec: config.codec ? std::vector{*config.codec} : supported_codecs)
 			{
-				if (check_nvenc(codec))
+				if (check_nvenc(codec, config.device))
 					return {encoder_nvenc, codec};
 			}
 		}
@@ -237,7 +238,7 @@ public:
 #if WIVRN_USE_VULKAN_ENCODE
 		if (config.name.empty() or config.name == encoder_vulkan)
 		{
-			for (auto codec: config.codec ? std::vector{*config.codec} : info.supported_codecs)
+			for (auto codec: config.codec ? std::vector{*config.codec} : supported_codecs)
 			{
 				if (has_vk(codec))
 					return {encoder_vulkan, codec};
@@ -248,9 +249,9 @@ public:
 #if WIVRN_USE_VAAPI
 		if (config.name.empty() or config.name == encoder_vaapi)
 		{
-			for (auto codec: config.codec ? std::vector{*config.codec} : info.supported_codecs)
+			for (auto codec: config.codec ? std::vector{*config.codec} : supported_codecs)
 			{
-				if (check_vaapi(codec))
+				if (check_vaapi(codec, config.device))
 					return {encoder_vaapi, codec};
 			}
 		}
@@ -271,23 +272,37 @@ static uint16_t align(uint16_t value, uint16_t alignment)
 	return ((value + alignment - 1) / alignment) * alignment;
 }
 
+std::array<std::pair<std::string, video_codec>, 3> select_encoders(wivrn::vk_bundle & bundle, encoder_cache & cache, const std::vector<video_codec> & supported_codecs)
+{
+	configuration config;
+	prober prober{bundle, cache, supported_codecs};
+
+	std::array<std::pair<std::string, video_codec>, 3> res;
+	for (auto [src, dst]: std::ranges::zip_view(config.encoders, res))
+		dst = prober.select_encoder(src);
+	return res;
+}
+
 std::array<encoder_settings, 3> get_encoder_settings(wivrn::vk_bundle & bundle, wivrn_session & session)
 {
+	auto start = std::chrono::steady_clock::now();
 	configuration config;
 
 	std::array<wivrn::encoder_settings, 3> res;
 	const auto & info = session.get_info();
 	const auto settings = *session.get_settings();
 
-	prober prober{bundle, info};
+	encoder_cache cache{bundle};
+	auto encoders = select_encoders(bundle, cache, info.supported_codecs);
 
-	for (auto [src, dst]: std::ranges::zip_view(config.encoders, res))
+	for (auto [src, dst, encoder]: std::ranges::zip_view(config.encoders, res, encoders))
 	{
 		dst.fps = session.default_fps();
 		dst.options = src.options;
 		dst.device = src.device;
+		dst.foveation_qp = config.foveation_qp;
 
-		std::tie(dst.encoder_name, dst.codec) = prober.select_encoder(src);
+		std::tie(dst.encoder_name, dst.codec) = encoder;
 	}
 
 	auto width = align(info.stream_eye_width, 64);
@@ -296,11 +311,13 @@ std::array<encoder_settings, 3> get_encoder_settings(wivrn::vk_bundle & bundle,
 	for (size_t i = 0; i < 2; ++i)
 		check_video_size(res[i].encoder_name, res[i].codec, width, height);
 
+	// Depth is below the alpha channel in the same stream
+	const bool depth = config.stream_depth and info.composition_layer_depth;
 	for (auto [i, dst]: std::ranges::enumerate_view(res))
 	{
 		dst.width = width;
 		dst.height = height;
-		if (i == 2) // alpha channel
+		if (i == 2 and not depth) // alpha channel
 			dst.height /= 2;
 	}
 
@@ -340,6 +357,12 @@ std::array<encoder_settings, 3> get_encoder_settings(wivrn::vk_bundle & bundle,
 		{
 			if (encoder.encoder_name == encoder_vaapi)
 			{
+				if (auto supported = cache.supported(encoder_vaapi, encoder.codec, bit_depth, encoder.device))
+				{
+					if (not *supported)
+						return false;
+					continue;
+				}
 				try
 				{
 					video_encoder_va{
@@ -351,12 +374,15 @@ std::array<encoder_settings, 3> get_encoder_settings(wivrn::vk_bundle & bundle,
 					                .fps = 60,
 					                .bitrate = 50'000'000,
 					                .bit_depth = bit_depth,
+					                .device = encoder.device,
 					        },
 					        0};
+					cache.set_supported(encoder_vaapi, encoder.codec, bit_depth, encoder.device, true);
 				}
 				catch (std::exception & e)
 				{
 					U_LOG_I("vaapi not supported for %s %d bits", std::string(magic_enum::enum_name(encoder.codec)).c_str(), bit_depth);
+					cache.set_supported(encoder_vaapi, encoder.codec, bit_depth, encoder.device, false);
 					return false;
 				}
 			}
@@ -383,6 +409,16 @@ std::array<encoder_settings, 3> get_encoder_settings(wivrn::vk_bundle & bundle,
 		i.bit_depth = bit_depth.value_or(10);
 
 	split_bitrate(res, settings.bitrate_bps);
+
+	cache.set_last({
+	        .supported_codecs = info.supported_codecs,
+	        .encoders = res,
+	        .render_width = info.render_eye_width,
+	        .render_height = info.render_eye_height,
+	});
+	cache.save();
+
+	U_LOG_I("Encoder selection took %.1fms", std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
 	return res;
 }
 } // namespace wivrn
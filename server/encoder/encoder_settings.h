@@ -21,14 +21,18 @@
 
 #include "wivrn_packets.h"
 
+#include <array>
 #include <map>
 #include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace wivrn
 {
 struct vk_bundle;
 class wivrn_session;
+class encoder_cache;
 
 struct encoder_settings
 {
@@ -42,9 +46,15 @@ struct encoder_settings
 	double bitrate_multiplier;                  // encoder bitrate / global bitrate
 	std::map<std::string, std::string> options; // additional encoder-specific configuration
 	int bit_depth;
+	// QP increase per doubling of the foveation density, 0 to disable
+	float foveation_qp;
 	std::optional<std::string> device;
 };
 
+// Encoder name and codec of the left, right and alpha streams for a headset that supports the
+// given codecs, from the configuration and the probing results
+std::array<std::pair<std::string, video_codec>, 3> select_encoders(wivrn::vk_bundle &, encoder_cache &, const std::vector<video_codec> & supported_codecs);
+
 std::array<encoder_settings, 3> get_encoder_settings(wivrn::vk_bundle &, wivrn_session &);
 
 void print_encoders(const std::array<wivrn::encoder_settings, 3> & encoders);
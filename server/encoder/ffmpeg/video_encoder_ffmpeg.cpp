@@ -72,7 +72,6 @@ std::optional<wivrn::video_encoder::data> video_encoder_ffmpeg::encode(uint8_t s
 	auto & idr_handler = (default_idr_handler &)*idr;
 	if (auto bitrate = pending_bitrate.exchange(0))
 	{
-		idr_handler.reset();
 		encoder_ctx->bit_rate = bitrate;
 		encoder_ctx->rc_max_rate = bitrate;
 	}
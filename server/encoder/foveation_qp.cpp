@@ -0,0 +1,77 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "foveation_qp.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace wivrn
+{
+
+// Mean of log2(source pixels per pixel) for each block along one axis
+static std::vector<float> axis_density(const std::vector<uint16_t> & runs, uint16_t size, uint16_t block_size)
+{
+	std::vector<float> res((size + block_size - 1) / block_size);
+
+	// See to_headset::foveation_parameter, the middle run is 1:1
+	const int middle = runs.size() / 2;
+	int pixel = 0;
+	for (int i = 0; i < int(runs.size()); ++i)
+	{
+		const float density = std::log2(std::abs(i - middle) + 1);
+		for (int n = 0; n < runs[i] and pixel < size; ++n, ++pixel)
+			res[pixel / block_size] += density;
+	}
+
+	// Pixels after the last run are not foveated, the last block may be partial
+	for (size_t i = 0; i < res.size(); ++i)
+		res[i] /= std::min<int>(block_size, size - i * block_size);
+	return res;
+}
+
+std::vector<float> foveation_qp(const to_headset::foveation_parameter & p,
+                                uint16_t width,
+                                uint16_t height,
+                                uint16_t block_size,
+                                float strength)
+{
+	const auto x = axis_density(p.x, width, block_size);
+	const auto y = axis_density(p.y, height, block_size);
+
+	// The density of a block is the product of both axes
+	std::vector<float> res;
+	res.reserve(x.size() * y.size());
+	float mean = 0;
+	for (float dy: y)
+	{
+		for (float dx: x)
+		{
+			res.push_back(strength * (dx + dy));
+			mean += res.back();
+		}
+	}
+	mean /= res.size();
+
+	for (float & qp: res)
+		qp = std::clamp(qp - mean, -max_foveation_qp, max_foveation_qp);
+	return res;
+}
+
+} // namespace wivrn
@@ -0,0 +1,44 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wivrn_packets.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace wivrn
+{
+
+// Largest offset given to a block, in either direction
+constexpr float max_foveation_qp = 12;
+
+// Quantization parameter offsets for each block of a foveated view, in raster order.
+//
+// A block gets strength × log2 of the number of source pixels per encoded pixel, minus the
+// mean over the image so that the average quantization stays the same: blocks in the fovea
+// get a negative offset and blocks in the periphery a positive one.
+std::vector<float> foveation_qp(const to_headset::foveation_parameter &,
+                                uint16_t width,
+                                uint16_t height,
+                                uint16_t block_size,
+                                float strength);
+
+} // namespace wivrn
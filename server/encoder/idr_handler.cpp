@@ -20,6 +20,7 @@
 
 #include "util/u_logging.h"
 #include "utils/overloaded.h"
+#include "utils/wivrn_statistics.h"
 
 namespace wivrn
 {
@@ -102,6 +103,7 @@ default_idr_handler::frame_type default_idr_handler::get_type(uint64_t frame_ind
 	return std::visit(utils::overloaded{
 	                          [this, frame_index](need_idr) {
 		                          U_LOG_D("IDR frame needed");
+		                          statistics::add_idr(stream_idx);
 		                          state = wait_idr_feedback{frame_index};
 		                          return frame_type::i;
 	                          },
@@ -29,8 +29,16 @@ namespace wivrn
 
 class idr_handler
 {
+protected:
+	// Stream of the encoder using this handler, for statistics
+	uint8_t stream_idx = -1;
+
 public:
 	virtual ~idr_handler();
+	void set_stream(uint8_t stream)
+	{
+		stream_idx = stream;
+	}
 	virtual void on_feedback(const from_headset::feedback &) = 0;
 	virtual void reset() = 0;
 	virtual bool should_skip(uint64_t frame_id) = 0;
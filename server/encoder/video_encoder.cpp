@@ -23,8 +23,11 @@
 #include "video_encoder.h"
 
 #include "encoder_settings.h"
+#include "foveation_qp.h"
 #include "os/os_time.h"
+#include "utils/wivrn_statistics.h"
 #include "utils/wivrn_trace.h"
+#include "video_shards.h"
 #include "wivrn_config.h"
 
 #include <string>
@@ -195,8 +198,10 @@ video_encoder::video_encoder(vk_bundle & vk,
         stream_idx(stream_idx),
         target_queue(target_queue),
         need_transfer(not vk.optimal_transfer(vk.queue.family_index, target_queue)),
-        bitrate_multiplier(settings.bitrate_multiplier),
         shared_sender(async_send ? sender::get() : nullptr),
+        foveation_qp_strength(settings.foveation_qp),
+        total_bitrate(settings.bitrate / settings.bitrate_multiplier),
+        bitrate_multiplier(settings.bitrate_multiplier),
         idr(std::move(idr)),
         extent{
                 .width = settings.width,
@@ -204,6 +209,7 @@ video_encoder::video_encoder(vk_bundle & vk,
         }
 {
 	assert(this->idr);
+	this->idr->set_stream(stream_idx);
 }
 
 video_encoder::~video_encoder()
@@ -225,9 +231,36 @@ void video_encoder::reset()
 
 void video_encoder::set_bitrate(uint32_t bitrate_bps)
 {
+	total_bitrate = bitrate_bps;
 	pending_bitrate = bitrate_bps * bitrate_multiplier;
 }
 
+void video_encoder::set_bitrate_share(double share)
+{
+	bitrate_multiplier = share;
+	pending_bitrate = total_bitrate * share;
+}
+
+bitrate_allocator::stream_stats video_encoder::take_rate_stats()
+{
+	std::lock_guard lock(mutex);
+	auto res = rate_stats;
+	if (qp_frames)
+		res.qp = qp_sum / qp_frames;
+	res.bitrate = total_bitrate * bitrate_multiplier;
+	rate_stats = {};
+	qp_sum = 0;
+	qp_frames = 0;
+	return res;
+}
+
+void video_encoder::report_qp(float qp)
+{
+	std::lock_guard lock(mutex);
+	qp_sum += qp;
+	++qp_frames;
+}
+
 void video_encoder::set_framerate(float framerate)
 {
 	pending_framerate = framerate;
@@ -250,6 +283,7 @@ void video_encoder::present_image(vk::Image y_cbcr, vk::SemaphoreSubmitInfo info
 
 void video_encoder::encode(wivrn_session & cnx,
                            const to_headset::video_stream_data_shard::view_info_t & view_info,
+                           const to_headset::foveation_parameter_set * foveation,
                            uint64_t frame_index)
 {
 	encode_slot = (encode_slot + 1) % num_slots;
@@ -286,9 +320,17 @@ void video_encoder::encode(wivrn_session & cnx,
 	shard.view_info = view_info;
 	shard.timing_info.reset();
 
+	if (qp_block_size and foveation_qp_strength and foveation and foveation->id != qp_offsets_id)
+	{
+		qp_offsets = foveation_qp(foveation->parameter, extent.width, extent.height, qp_block_size, foveation_qp_strength);
+		qp_offsets_id = foveation->id;
+	}
+
 	auto data = encode(encode_slot, frame_index);
+	auto encode_end = os_monotonic_get_ns();
+	statistics::add_encode_time(stream_idx, encode_end - encode_begin);
 	cnx.dump_time("encode_begin", frame_index, encode_begin, stream_idx);
-	cnx.dump_time("encode_end", frame_index, os_monotonic_get_ns(), stream_idx);
+	cnx.dump_time("encode_end", frame_index, encode_end, stream_idx);
 	if (data)
 	{
 		timing_info.encode_end = clock.to_headset(os_monotonic_get_ns());
@@ -316,37 +358,35 @@ void video_encoder::SendData(std::span<uint8_t> data, bool end_of_frame, bool co
 	if (video_dump)
 		video_dump.write((char *)data.data(), data.size());
 
+	// IDR frames are the ones sent on the control socket
+	if (shard.view_info)
+		shard.view_info->idr = control or intra_only;
+
 	ssize_t max_payload_size = (cnx->has_stream() and not control) ? to_headset::video_stream_data_shard::max_payload_size : std::numeric_limits<uint32_t>::max();
 
-	auto begin = data.begin();
-	auto end = data.end();
-	while (begin != end)
-	{
-		const size_t payload_size = std::max(0z, max_payload_size - ssize_t(serialized_size(shard.view_info)));
-		auto next = std::min(end, begin + payload_size);
-		if (next == end)
-		{
-			if (end_of_frame)
-				shard.timing_info = timing_info;
-		}
-		shard.payload = {begin, next};
-		try
-		{
-			if (control)
-				cnx->send_control(to_headset::video_stream_data_shard{shard});
-			else
-				cnx->send_stream(to_headset::video_stream_data_shard{shard});
-		}
-		catch (...)
-		{
-			// Ignore network errors
-		}
-		++shard.shard_idx;
-		shard.view_info.reset();
-		begin = next;
-	}
+	size_t packets = split_shards(
+	        shard,
+	        data,
+	        max_payload_size,
+	        end_of_frame ? std::optional(timing_info) : std::nullopt,
+	        [&](const to_headset::video_stream_data_shard & s) {
+		        try
+		        {
+			        if (control)
+				        cnx->send_control(to_headset::video_stream_data_shard{s});
+			        else
+				        cnx->send_stream(to_headset::video_stream_data_shard{s});
+		        }
+		        catch (...)
+		        {
+			        // Ignore network errors
+		        }
+	        });
+	statistics::add_sent(stream_idx, data.size(), packets);
+	rate_stats.bytes += data.size();
 	if (end_of_frame)
 	{
+		++rate_stats.frames;
 		cnx->dump_time("send_end", shard.frame_idx, os_monotonic_get_ns(), stream_idx);
 		wivrn::trace::cpu_end(wivrn::trace::cpu_track::network, stream_idx, shard.frame_idx, "SendData");
 	}
@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include "bitrate_allocator.h"
 #include "driver/clock_offset.h"
 #include "idr_handler.h"
 #include "wivrn_packets.h"
@@ -31,6 +32,7 @@
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 #include <vulkan/vulkan_raii.hpp>
 
 namespace wivrn
@@ -83,7 +85,6 @@ public:
 	// change after the first frame.
 	vk::ImageLayout target_layout = vk::ImageLayout::eGeneral;
 	static const uint8_t num_slots = 2;
-	const double bitrate_multiplier;
 
 private:
 	using state_t = std::atomic_unsigned_lock_free::value_type;
@@ -109,12 +110,33 @@ private:
 
 	std::shared_ptr<sender> shared_sender;
 
+	const float foveation_qp_strength;
+	uint32_t qp_offsets_id = 0;
+
+	// Bitrate of the whole stream, and fraction given to this encoder
+	std::atomic_uint64_t total_bitrate;
+	std::atomic<double> bitrate_multiplier;
+
+	// Since the last call to take_rate_stats, protected by mutex
+	bitrate_allocator::stream_stats rate_stats;
+	double qp_sum = 0;
+	uint32_t qp_frames = 0;
+
 protected:
 	std::atomic_uint32_t pending_bitrate;
 	std::atomic<float> pending_framerate;
 	std::unique_ptr<idr_handler> idr;
 	const vk::Extent2D extent;
 
+	// Set by encoders whose frames never reference previous frames
+	bool intra_only = false;
+
+	// Size in pixels of the blocks in qp_offsets, set by encoders that support them
+	uint16_t qp_block_size = 0;
+	// Quantization offsets from foveation for the frame being encoded, one per block
+	// in raster order, empty if disabled
+	std::vector<float> qp_offsets;
+
 public:
 	static std::unique_ptr<video_encoder> create(
 	        wivrn::vk_bundle &,
@@ -134,10 +156,17 @@ public:
 	// bitrate_bps is the bitrate for the whole stream
 	// the encoder bitrate will be scaled accordingly
 	void set_bitrate(uint32_t bitrate_bps);
+	// Fraction of the whole stream bitrate given to this encoder
+	void set_bitrate_share(double share);
 	void set_framerate(float framerate);
 
+	// Data produced since the previous call
+	bitrate_allocator::stream_stats take_rate_stats();
+
+	// foveation is the parameter set of the view, nullptr if not applicable
 	void encode(wivrn_session & cnx,
 	            const to_headset::video_stream_data_shard::view_info_t & view_info,
+	            const to_headset::foveation_parameter_set * foveation,
 	            uint64_t frame_index);
 
 protected:
@@ -151,6 +180,9 @@ protected:
 	virtual std::optional<data> encode(uint8_t slot, uint64_t frame_index) = 0;
 
 	void SendData(std::span<uint8_t> data, bool end_of_frame, bool control = false);
+
+	// Mean quantization parameter of an encoded frame, for encoders that know it
+	void report_qp(float qp);
 };
 
 } // namespace wivrn
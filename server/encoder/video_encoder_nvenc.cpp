@@ -34,6 +34,7 @@ bool operator==(const GUID & l, const GUID & r)
 }
 
 #include <algorithm>
+#include <cmath>
 #include <stdexcept>
 
 #define NVENC_CHECK_NOENCODER(x)                                          \
@@ -134,7 +135,7 @@ static void check_profile_guid_supported(std::shared_ptr<video_encoder_nvenc_sha
 
 NV_ENC_RC_PARAMS video_encoder_nvenc::get_rc_params(uint64_t bitrate, float framerate)
 {
-	return {
+	NV_ENC_RC_PARAMS res{
 	        .rateControlMode = NV_ENC_PARAMS_RC_CBR,
 	        .averageBitRate = static_cast<uint32_t>(bitrate),
 	        .vbvBufferSize = static_cast<uint32_t>(bitrate / framerate * 2.0f),
@@ -142,6 +143,9 @@ NV_ENC_RC_PARAMS video_encoder_nvenc::get_rc_params(uint64_t bitrate, float fram
 	        .enableLookahead = 0,
 	        .lowDelayKeyFrameScale = 1,
 	        .multiPass = NV_ENC_TWO_PASS_QUARTER_RESOLUTION};
+	if (qp_block_size)
+		res.qpMapMode = NV_ENC_QP_MAP_DELTA;
+	return res;
 }
 
 void video_encoder_nvenc::set_init_params_fps(float framerate)
@@ -178,6 +182,11 @@ video_encoder_nvenc::video_encoder_nvenc(
 	assert(extent.width % 32 == 0);
 	assert(extent.height % 32 == 0);
 
+	// qpDeltaMap has one value per macroblock for H.264, per CTB for the other codecs
+	if (settings.foveation_qp and settings.codec == video_codec::h264)
+		qp_block_size = 16;
+	h26x = settings.codec != video_codec::av1;
+
 	auto command_buffers = vk.device.allocateCommandBuffers(
 	        {.commandPool = *cmd_pool,
 	         .commandBufferCount = num_slots});
@@ -513,7 +522,7 @@ std::optional<video_encoder::data> video_encoder_nvenc::encode(uint8_t slot, uin
 			new_framerate = fps;
 
 		if (new_bitrate)
-			U_LOG_I("nvenc: reconfiguring bitrate, new value: %d", new_bitrate);
+			U_LOG_D("nvenc: reconfiguring bitrate, new value: %d", new_bitrate);
 		else
 			new_bitrate = bitrate;
 
@@ -523,23 +532,24 @@ std::optional<video_encoder::data> video_encoder_nvenc::encode(uint8_t slot, uin
 		NV_ENC_RECONFIGURE_PARAMS reconfig_params{
 		        .version = NV_ENC_RECONFIGURE_PARAMS_VER,
 		        .reInitEncodeParams = init_params,
-		        .resetEncoder = 1,
-		        .forceIDR = 1};
+		        // Rate control changes do not need a new IDR, they happen every few seconds with dynamic-bitrate
+		        .resetEncoder = 0,
+		        .forceIDR = 0};
 
 		try
 		{
 			NVENC_CHECK(shared_state->fn.nvEncReconfigureEncoder(session_handle, &reconfig_params));
 			fps = new_framerate;
 			bitrate = new_bitrate;
-			idr_handler.reset();
 
-			U_LOG_I("nvenc: reconfiguring succeeded.");
+			U_LOG_D("nvenc: reconfiguring succeeded.");
 		}
 		catch (const std::exception & e)
 		{
 			U_LOG_E("nvenc: reconfiguring failed.");
 			config.rcParams = get_rc_params(bitrate, fps);
 			set_init_params_fps(fps);
+			idr_handler.reset();
 		}
 	}
 
@@ -563,6 +573,14 @@ std::optional<video_encoder::data> video_encoder_nvenc::encode(uint8_t slot, uin
 	        .pictureStruct = NV_ENC_PIC_STRUCT_FRAME,
 	};
 
+	if (not qp_offsets.empty())
+	{
+		qp_delta.resize(qp_offsets.size());
+		std::ranges::transform(qp_offsets, qp_delta.begin(), [](float qp) { return int8_t(std::lround(qp)); });
+		frame_params.qpDeltaMap = qp_delta.data();
+		frame_params.qpDeltaMapSize = qp_delta.size();
+	}
+
 	auto frame_type = idr_handler.get_type(frame_index);
 	switch (frame_type)
 	{
@@ -587,6 +605,8 @@ std::optional<video_encoder::data> video_encoder_nvenc::encode(uint8_t slot, uin
 
 	if (buf_lock_params.pictureType == NV_ENC_PIC_TYPE_NONREF_P)
 		idr_handler.set_non_ref(frame_index);
+	if (h26x)
+		report_qp(buf_lock_params.frameAvgQP);
 
 	CU_CHECK(shared_state->cuda_fn->cuCtxPopCurrent(NULL));
 	return data{
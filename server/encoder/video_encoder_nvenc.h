@@ -59,6 +59,9 @@ private:
 	float fps;
 	uint64_t bitrate;
 	int bytesPerPixel = 1;
+	std::vector<int8_t> qp_delta;
+	// frameAvgQP is a quantizer index for AV1, not comparable to H.264/H.265 QP
+	bool h26x;
 
 	NV_ENC_RC_PARAMS get_rc_params(uint64_t bitrate, float framerate);
 	void set_init_params_fps(float framerate);
@@ -62,6 +62,8 @@ wivrn::video_encoder_raw::video_encoder_raw(
 	if (settings.bit_depth != 8)
 		throw std::runtime_error("Raw encoding is only supported for 8 bit");
 
+	intra_only = true;
+
 	vk::DeviceSize buffer_size = extent.width * extent.height;
 	if (stream_idx < 2)
 		buffer_size += buffer_size / 2;
@@ -22,6 +22,7 @@
 #include "inplace_vector.hpp"
 #include "os/os_time.h"
 #include "util/u_logging.h"
+#include "utils/wivrn_statistics.h"
 #include "utils/wivrn_trace.h"
 #include "utils/wivrn_vk_bundle.h"
 
@@ -112,6 +113,7 @@ public:
 
 		if (not ref_slot)
 		{
+			wivrn::statistics::add_idr(stream_idx);
 			frame_num = 0;
 			for (auto & slot: items)
 			{
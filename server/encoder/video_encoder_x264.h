@@ -21,10 +21,8 @@
 
 #include "video_encoder.h"
 #include "vk/allocation.h"
-#include "x264.h"
+#include "x264_session.h"
 
-#include <list>
-#include <mutex>
 #include <vulkan/vulkan_raii.hpp>
 
 namespace wivrn
@@ -32,14 +30,7 @@ namespace wivrn
 
 class video_encoder_x264 : public video_encoder
 {
-	x264_param_t param = {};
-	x264_t * enc;
-	bool control;
-
-	x264_picture_t pic_out = {};
-
 	wivrn::vk_bundle & vk;
-	uint64_t sem_value = 0; // current value of the semaphore
 	vk::raii::CommandPool cmd_pool;
 
 	struct in_t
@@ -53,17 +44,7 @@ class video_encoder_x264 : public video_encoder
 	std::array<in_t, num_slots> in;
 	uint32_t chroma_width;
 
-	struct pending_nal
-	{
-		int first_mb;
-		int last_mb;
-		std::vector<uint8_t> data;
-	};
-
-	std::mutex mutex;
-	int next_mb;
-	int num_mb; // Number of macroblocks in a frame
-	std::list<pending_nal> pending_nals;
+	x264_session session;
 
 public:
 	video_encoder_x264(wivrn::vk_bundle & vk, const encoder_settings & settings, uint8_t stream_idx);
@@ -71,15 +52,6 @@ public:
 	void present_image(vk::Image y_cbcr, vk::SemaphoreSubmitInfo, uint8_t slot, uint64_t frame_index) override;
 
 	std::optional<data> encode(uint8_t slot, uint64_t frame_index) override;
-
-	~video_encoder_x264();
-
-private:
-	static void ProcessCb(x264_t * h, x264_nal_t * nal, void * opaque);
-
-	void ProcessNal(pending_nal && nal);
-
-	void InsertInPendingNal(pending_nal && nal);
 };
 
 } // namespace wivrn
@@ -0,0 +1,62 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wivrn_packets.h"
+#include "wivrn_serialization.h"
+
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <sys/types.h>
+
+namespace wivrn
+{
+// Splits encoded data in shards and calls send for each of them, returns the number of shards.
+//
+// shard holds the state of the frame: the shard index and the view info are updated so that
+// the next call continues the same frame. timing_info is set on the last shard if present, it
+// must only be given for the end of the frame.
+template <typename F>
+size_t split_shards(to_headset::video_stream_data_shard & shard,
+                    std::span<uint8_t> data,
+                    ssize_t max_payload_size,
+                    const std::optional<to_headset::video_stream_data_shard::timing_info_t> & timing_info,
+                    F && send)
+{
+	auto begin = data.begin();
+	auto end = data.end();
+	size_t packets = 0;
+	while (begin != end)
+	{
+		const size_t payload_size = std::max(0z, max_payload_size - ssize_t(serialized_size(shard.view_info)));
+		auto next = std::min(end, begin + payload_size);
+		if (next == end and timing_info)
+			shard.timing_info = timing_info;
+		shard.payload = {begin, next};
+		send(shard);
+		++packets;
+		++shard.shard_idx;
+		shard.view_info.reset();
+		begin = next;
+	}
+	return packets;
+}
+} // namespace wivrn
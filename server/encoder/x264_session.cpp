@@ -0,0 +1,207 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "x264_session.h"
+
+#include "encoder_settings.h"
+#include "util/u_logging.h"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace wivrn
+{
+
+void x264_session::ProcessCb(x264_t * h, x264_nal_t * nal, void * opaque)
+{
+	x264_session * self = (x264_session *)opaque;
+	std::vector<uint8_t> data(nal->i_payload * 3 / 2 + 5 + 64, 0);
+	x264_nal_encode(h, data.data(), nal);
+	data.resize(nal->i_payload);
+	switch (nal->i_type)
+	{
+		case NAL_SPS:
+		case NAL_PPS: {
+			self->output(data, false, self->control);
+			break;
+		}
+		case NAL_SLICE:
+		case NAL_SLICE_DPA:
+		case NAL_SLICE_DPB:
+		case NAL_SLICE_DPC:
+		case NAL_SLICE_IDR:
+			self->ProcessNal({nal->i_first_mb, nal->i_last_mb, std::move(data)});
+	}
+}
+
+void x264_session::ProcessNal(pending_nal && nal)
+{
+	std::lock_guard lock(mutex);
+	if (nal.first_mb == next_mb)
+	{
+		next_mb = nal.last_mb + 1;
+		output(nal.data, next_mb == num_mb, control);
+	}
+	else
+	{
+		InsertInPendingNal(std::move(nal));
+	}
+	while ((not pending_nals.empty()) and pending_nals.front().first_mb == next_mb)
+	{
+		next_mb = pending_nals.front().last_mb + 1;
+		output(pending_nals.front().data, next_mb == num_mb, false);
+		pending_nals.pop_front();
+	}
+}
+
+void x264_session::InsertInPendingNal(pending_nal && nal)
+{
+	auto it = pending_nals.begin();
+	auto end = pending_nals.end();
+	for (; it != end; ++it)
+	{
+		if (it->first_mb > nal.last_mb)
+		{
+			pending_nals.insert(it, std::move(nal));
+			return;
+		}
+	}
+	pending_nals.push_back(std::move(nal));
+}
+
+x264_session::x264_session(const encoder_settings & settings, output_fn output) :
+        output(std::move(output))
+{
+	num_mb = ((settings.width + 15) / 16) * ((settings.height + 15) / 16);
+
+	auto preset = settings.options.find("preset");
+	x264_param_default_preset(&param, preset == settings.options.end() ? "ultrafast" : preset->second.c_str(), "zerolatency");
+	param.nalu_process = &ProcessCb;
+	// param.i_slice_max_size = 1300;
+	param.i_slice_count = 32;
+	param.i_width = settings.width;
+	param.i_height = settings.height;
+	param.i_log_level = X264_LOG_WARNING;
+	param.i_fps_num = settings.fps * 1'000'000;
+	param.i_fps_den = 1'000'000;
+	param.b_repeat_headers = 1;
+	param.b_aud = 0;
+	param.i_keyint_max = X264_KEYINT_MAX_INFINITE;
+
+	// colour definitions, actually ignored by decoder
+	param.vui.b_fullrange = 1;
+	param.vui.i_colorprim = 1; // BT.709
+	param.vui.i_colmatrix = 1; // BT.709
+	param.vui.i_transfer = 13; // sRGB
+
+	param.vui.i_sar_width = settings.width;
+	param.vui.i_sar_height = settings.height;
+	param.rc.i_rc_method = X264_RC_ABR;
+	param.rc.i_bitrate = settings.bitrate / 1000; // x264 uses kbit/s
+	param.rc.i_vbv_max_bitrate = param.rc.i_bitrate;
+	param.rc.i_vbv_buffer_size = param.rc.i_bitrate / settings.fps * 1.1;
+
+	for (const auto & [name, value]: settings.options)
+	{
+		if (name == "preset")
+			continue;
+		if (x264_param_parse(&param, name.c_str(), value.c_str()) < 0)
+			U_LOG_W("invalid x264 option %s=%s", name.c_str(), value.c_str());
+	}
+
+	// quant_offsets are ignored without adaptive quantization, with a null strength only they are used
+	if (settings.foveation_qp and param.rc.i_aq_mode == X264_AQ_NONE)
+	{
+		param.rc.i_aq_mode = X264_AQ_VARIANCE;
+		param.rc.f_aq_strength = 0;
+	}
+
+	x264_param_apply_profile(&param, "main");
+
+	enc = x264_encoder_open(&param);
+	if (not enc)
+	{
+		throw std::runtime_error("failed to create x264 encoder");
+	}
+
+	assert(x264_encoder_maximum_delayed_frames(enc) == 0);
+}
+
+x264_session::~x264_session()
+{
+	x264_encoder_close(enc);
+}
+
+void x264_session::init_picture(x264_picture_t & pic, uint8_t * luma, uint8_t * chroma)
+{
+	x264_picture_init(&pic);
+	pic.opaque = this;
+	pic.img.i_csp = X264_CSP_NV12;
+	pic.img.i_plane = 2;
+
+	pic.img.i_stride[0] = param.i_width;
+	pic.img.plane[0] = luma;
+	pic.img.i_stride[1] = param.i_width;
+	pic.img.plane[1] = chroma;
+}
+
+bool x264_session::reconfigure(uint32_t bitrate, float framerate)
+{
+	if (not bitrate and not framerate)
+		return false;
+
+	if (framerate)
+	{
+		param.i_fps_num = framerate * 1'000'000;
+		param.i_fps_den = 1'000'000;
+	}
+	if (bitrate)
+	{
+		auto fps_mul = param.i_fps_num / (float)param.i_fps_den;
+		param.rc.i_bitrate = bitrate / 1000;
+		param.rc.i_vbv_buffer_size = param.rc.i_bitrate / fps_mul * 1.1;
+		param.rc.i_vbv_max_bitrate = param.rc.i_bitrate;
+	}
+	x264_encoder_reconfig(enc, &param);
+	return true;
+}
+
+int x264_session::encode(x264_picture_t & pic, bool idr, float * qp_offsets)
+{
+	control = idr;
+	pic.i_type = idr ? X264_TYPE_IDR : X264_TYPE_P;
+	pic.prop.quant_offsets = qp_offsets;
+	next_mb = 0;
+	assert(pending_nals.empty());
+
+	int num_nal;
+	x264_nal_t * nal;
+	int size = x264_encoder_encode(enc, &nal, &num_nal, &pic, &pic_out);
+	if (next_mb != num_mb)
+	{
+		U_LOG_W("unexpected macroblock count: %d", next_mb);
+	}
+	if (size < 0)
+	{
+		U_LOG_W("x264_encoder_encode failed: %d", size);
+	}
+	return size;
+}
+
+} // namespace wivrn
@@ -0,0 +1,104 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "x264.h"
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace wivrn
+{
+struct encoder_settings;
+
+// x264 encoder working on NV12 pictures in host memory, without any Vulkan object.
+//
+// Slices are produced by the x264 threads in any order, they are given to the output
+// function in macroblock order.
+class x264_session
+{
+public:
+	// end_of_frame is set on the last slice, control when the data should use the reliable socket
+	using output_fn = std::function<void(std::span<uint8_t> data, bool end_of_frame, bool control)>;
+
+private:
+	x264_param_t param = {};
+	x264_t * enc;
+	bool control;
+
+	x264_picture_t pic_out = {};
+
+	output_fn output;
+
+	struct pending_nal
+	{
+		int first_mb;
+		int last_mb;
+		std::vector<uint8_t> data;
+	};
+
+	std::mutex mutex;
+	int next_mb;
+	int num_mb; // Number of macroblocks in a frame
+	std::list<pending_nal> pending_nals;
+
+public:
+	// settings.options may contain "preset" (default ultrafast), any other option is given
+	// to x264_param_parse
+	x264_session(const encoder_settings & settings, output_fn output);
+	x264_session(const x264_session &) = delete;
+	x264_session & operator=(const x264_session &) = delete;
+	~x264_session();
+
+	// Sets up pic for planes of the size of the encoder, luma stride is the width
+	void init_picture(x264_picture_t & pic, uint8_t * luma, uint8_t * chroma);
+
+	// 0 to keep the current value, returns true if the encoder was reconfigured
+	bool reconfigure(uint32_t bitrate, float framerate);
+
+	// qp_offsets has one value per macroblock or is nullptr, returns the size of the encoded
+	// frame, negative on error
+	int encode(x264_picture_t & pic, bool idr, float * qp_offsets = nullptr);
+
+	// Mean quantization parameter of the last encoded frame
+	float qp() const
+	{
+		return pic_out.i_qpplus1 - 1;
+	}
+
+	// Reconstructed picture of the last encoded frame
+	const x264_picture_t & reconstructed() const
+	{
+		return pic_out;
+	}
+
+private:
+	static void ProcessCb(x264_t * h, x264_nal_t * nal, void * opaque);
+
+	void ProcessNal(pending_nal && nal);
+
+	void InsertInPendingNal(pending_nal && nal);
+};
+
+} // namespace wivrn
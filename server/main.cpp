@@ -41,12 +41,14 @@
 #include "start_systemd_unit.h"
 #include "utils/overloaded.h"
 #include "version.h"
+#include "warm_start.h"
 #include "wivrn_config.h"
 #include "wivrn_ipc.h"
 #include "wivrn_packets.h"
 #include "wivrn_sockets.h"
 
 #include "wivrn_server_dbus.h"
+#include "wivrn_statistics_dbus.h"
 
 #include <CLI/CLI.hpp>
 #include <avahi-glib/glib-watch.h>
@@ -224,6 +226,7 @@ const std::chrono::milliseconds default_delay_next_try = 10ms;
 std::chrono::milliseconds delay_next_try = default_delay_next_try;
 
 WivrnServer * dbus_server;
+WivrnStatistics * dbus_statistics;
 
 /* TODO: Document FSM
  */
@@ -234,6 +237,7 @@ std::optional<sleep_inhibitor> inhibitor;
 gboolean headset_connected(gint fd, GIOCondition condition, gpointer user_data);
 void stop_listening();
 void on_headset_info_packet(const wivrn::from_headset::headset_info_packet & info);
+void on_statistics(const wivrn::statistics::snapshot & stats);
 void expose_known_keys_on_dbus();
 void set_encryption_state(wivrn_connection::encryption_state new_enc_state);
 
@@ -242,6 +246,48 @@ void stop_publishing();
 
 void update_fsm();
 
+void set_driver_environment()
+{
+	setenv("AMD_DEBUG", "lowlatencyenc", false);
+
+	// https://github.com/WiVRn/WiVRn/issues/695
+	// something is broken with Intel CCS under vaapi
+	setenv("INTEL_DEBUG", "noccs", false);
+
+	setenv("XRT_LOG", "info", false);
+}
+
+// Prepare the caches used on connection in another process, Vulkan must not be initialized in
+// the process that forks the server
+void fork_warm_start()
+{
+	if (not configuration().warm_start)
+		return;
+
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		perror("fork");
+	}
+	else if (pid == 0)
+	{
+		set_driver_environment();
+		try
+		{
+			wivrn::warm_start();
+		}
+		catch (std::exception & e)
+		{
+			std::cerr << "Warm start failed: " << e.what() << std::endl;
+		}
+		_exit(EXIT_SUCCESS);
+	}
+	else
+	{
+		g_child_watch_add(pid, [](pid_t, int status, void *) { display_child_status(status, "Warm start"); }, nullptr);
+	}
+}
+
 void start_server(configuration config)
 {
 	server_pid = do_fork ? fork() : 0;
@@ -253,13 +299,7 @@ void start_server(configuration config)
 	}
 	else if (server_pid == 0)
 	{
-		setenv("AMD_DEBUG", "lowlatencyenc", false);
-
-		// https://github.com/WiVRn/WiVRn/issues/695
-		// something is broken with Intel CCS under vaapi
-		setenv("INTEL_DEBUG", "noccs", false);
-
-		setenv("XRT_LOG", "info", false);
+		set_driver_environment();
 
 		wivrn::ipc_server_cb server_cb;
 
@@ -551,6 +591,7 @@ gboolean control_received(gint fd, GIOCondition condition, gpointer user_data)
 			                   inhibitor.reset();
 			                   wivrn_server_set_headset_connected(dbus_server, false);
 			                   wivrn_server_set_client_tab(dbus_server, "");
+			                   on_statistics({});
 		                   },
 		                   [&](const wivrn::from_headset::stream_tab_changed & event) {
 			                   wivrn_server_set_client_tab(dbus_server, magic_enum::enum_name(event.tab).data());
@@ -558,6 +599,9 @@ gboolean control_received(gint fd, GIOCondition condition, gpointer user_data)
 		                   [&](const from_monado::server_error & e) {
 			                   wivrn_server_emit_server_error(dbus_server, e.where.c_str(), e.message.c_str());
 		                   },
+		                   [&](const wivrn::statistics::snapshot & stats) {
+			                   on_statistics(stats);
+		                   },
 		           },
 		           *packet);
 	}
@@ -833,6 +877,39 @@ void on_headset_info_packet(const wivrn::from_headset::headset_info_packet & inf
 	wivrn_server_set_system_name(dbus_server, info.system_name.c_str());
 }
 
+GVariant * to_variant(const wivrn::statistics::window & w)
+{
+	return g_variant_new("(dddu)", w.min, w.mean, w.max, w.count);
+}
+
+void on_statistics(const wivrn::statistics::snapshot & stats)
+{
+	GVariantBuilder * builder = g_variant_builder_new(G_VARIANT_TYPE("a(y(dddu)ttuu)"));
+	for (const auto & s: stats.streams)
+	{
+		g_variant_builder_add(builder,
+		                      "(y@(dddu)ttuu)",
+		                      s.index,
+		                      to_variant(s.encode_time),
+		                      s.bytes_sent,
+		                      s.packets_sent,
+		                      s.frames_lost,
+		                      s.idr_frames);
+	}
+	GVariant * value_streams = g_variant_new("a(y(dddu)ttuu)", builder);
+	g_variant_builder_unref(builder);
+
+	// Properties changed in the same main loop iteration are sent in a single signal
+	wivrn_statistics_set_duration(dbus_statistics, stats.duration);
+	wivrn_statistics_set_streams(dbus_statistics, value_streams);
+	wivrn_statistics_set_clock_offset(dbus_statistics, stats.clock_offset_ns);
+	wivrn_statistics_set_round_trip_time(dbus_statistics, to_variant(stats.round_trip_time));
+	wivrn_statistics_set_network_latency(dbus_statistics, to_variant(stats.network_latency));
+	wivrn_statistics_set_decode_time(dbus_statistics, to_variant(stats.decode_time));
+	wivrn_statistics_set_pacer_margin(dbus_statistics, to_variant(stats.pacer_margin));
+	wivrn_statistics_set_blit_to_display(dbus_statistics, to_variant(stats.blit_to_display));
+}
+
 void on_name_acquired(GDBusConnection * connection, const gchar * name, gpointer user_data)
 {
 	try
@@ -906,6 +983,13 @@ void on_name_acquired(GDBusConnection * connection, const gchar * name, gpointer
 	                                 "/io/github/wivrn/Server",
 	                                 NULL);
 
+	dbus_statistics = wivrn_statistics_skeleton_new();
+	on_statistics({});
+	g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(dbus_statistics),
+	                                 connection,
+	                                 "/io/github/wivrn/Server",
+	                                 NULL);
+
 	if (enc_state != wivrn_connection::encryption_state::disabled and known_keys().empty())
 		set_encryption_state(wivrn_connection::encryption_state::pairing);
 	else
@@ -959,6 +1043,10 @@ int inner_main(int argc, char * argv[], bool show_instructions)
 
 	if (do_active_runtime)
 		active_runtime::cleanup_openxr();
+
+	// Before any socket or thread is created
+	fork_warm_start();
+
 	listen_socket = create_listen_socket();
 
 	// Initialize main loop
@@ -0,0 +1,304 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Sends a simulated speaker stream through an impaired link and measures glitches and latency.
+//
+// Samples go through audio_send_queue as in the PipeWire callback, then through a link with
+// Gilbert-Elliott burst loss, delay and jitter without reordering, then through audio_loss_concealment and a
+// player that works like the AAudio callback of the headset: 5ms of silence on underrun, data
+// discarded above 50ms of buffer.
+//
+// Each link is also run with a model of the previous transport on the TCP socket, where lost
+// packets are retransmitted after 3 packets and a round trip and block the following ones.
+//
+// Time is simulated so that results do not depend on the load of the machine. A period of the
+// player is a glitch if it plays concealed data or silence, or if data was discarded.
+//
+// Usage: wivrn-audio-transport-test
+// Exits with 1 if a threshold was not met.
+
+#include "audio_transport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+using namespace wivrn;
+
+constexpr uint32_t sample_rate = 48'000;
+constexpr uint8_t num_channels = 2;
+constexpr size_t frame_size = num_channels * sizeof(int16_t);
+constexpr uint32_t quantum = 240; // frames, 5ms
+constexpr int64_t quantum_ns = int64_t(quantum) * 1'000'000'000 / sample_rate;
+constexpr int seconds = 60;
+constexpr int warmup_periods = 200;
+
+struct link_parameters
+{
+	std::string name;
+	double loss = 0;  // average loss rate
+	double burst = 1; // mean number of packets lost in a row
+	double delay = 2; // ms
+	double jitter = 0; // ms, uniformly distributed
+	// Thresholds for the UDP transport
+	double max_glitch_rate = 0;
+	double max_latency_p99 = 0; // ms
+};
+
+// Gilbert-Elliott loss and uniform jitter
+class impaired_link
+{
+	link_parameters params;
+	std::mt19937 rng{42};
+	bool bad = false;
+
+public:
+	impaired_link(const link_parameters & params) :
+	        params(params) {}
+
+	bool lost()
+	{
+		if (params.loss <= 0)
+			return false;
+		double p_bad = params.loss / (params.burst * (1 - params.loss));
+		double p_good = 1 / params.burst;
+		bad = std::bernoulli_distribution(bad ? 1 - p_good : p_bad)(rng);
+		return bad;
+	}
+
+	int64_t delay()
+	{
+		return (params.delay + std::uniform_real_distribution<double>(0, params.jitter)(rng)) * 1'000'000;
+	}
+};
+
+// Consumes one quantum per period, as the AAudio speaker callback of the headset
+class player
+{
+	struct chunk
+	{
+		XrTime timestamp; // capture time of the first frame, 0 for concealed data
+		size_t frames;
+	};
+	std::deque<chunk> buffer;
+	size_t buffered_frames = 0;
+
+public:
+	int periods = 0;
+	int glitches = 0;
+	std::vector<int64_t> latencies;
+
+	void push(XrTime timestamp, size_t frames)
+	{
+		buffer.push_back({timestamp, frames});
+		buffered_frames += frames;
+	}
+
+	void play(int64_t now)
+	{
+		bool glitch = false;
+		size_t needed = quantum;
+		while (needed)
+		{
+			if (buffer.empty())
+			{
+				// Underrun: add 5ms of silence
+				push(0, sample_rate / 200);
+				glitch = true;
+				continue;
+			}
+			auto & c = buffer.front();
+			size_t n = std::min(needed, c.frames);
+			if (c.timestamp)
+				latencies.push_back(now + int64_t(quantum - needed) * 1'000'000'000 / sample_rate - c.timestamp);
+			else
+				glitch = true;
+			needed -= n;
+			buffered_frames -= n;
+			c.frames -= n;
+			if (c.timestamp)
+				c.timestamp += int64_t(n) * 1'000'000'000 / sample_rate;
+			if (c.frames == 0)
+				buffer.pop_front();
+		}
+
+		// More than 50ms of buffered data: discard until 30ms are left
+		if (buffered_frames > sample_rate * 0.05)
+		{
+			while (buffered_frames > sample_rate * 0.03 and buffer.size() > 1)
+			{
+				buffered_frames -= buffer.front().frames;
+				buffer.pop_front();
+			}
+			glitch = true;
+		}
+
+		if (++periods > warmup_periods)
+		{
+			if (glitch)
+				++glitches;
+		}
+		else
+			latencies.clear();
+	}
+};
+
+struct result
+{
+	double glitch_rate;
+	double latency_p50;
+	double latency_p99;
+	uint64_t concealed;
+	uint64_t late;
+};
+
+result run(const link_parameters & params, bool tcp)
+{
+	impaired_link link(params);
+	audio_send_queue queue(num_channels, sample_rate);
+	audio_loss_concealment concealment(num_channels);
+	player p;
+
+	// Packets in flight, by arrival time
+	std::multimap<int64_t, audio_data> in_flight;
+	int64_t last_arrival = 0;
+
+	std::vector<uint8_t> samples(quantum * frame_size);
+	uint64_t phase = 0;
+
+	const int periods = seconds * 1'000'000'000ll / quantum_ns;
+	for (int i = 0; i < periods; ++i)
+	{
+		const int64_t now = (i + 1) * quantum_ns;
+
+		// Capture: a 440Hz sine
+		for (size_t f = 0; f < quantum; ++f, ++phase)
+		{
+			int16_t value = 10000 * std::sin(2 * M_PI * 440 * phase / sample_rate);
+			for (size_t c = 0; c < num_channels; ++c)
+				memcpy(&samples[(f * num_channels + c) * sizeof(int16_t)], &value, sizeof(value));
+		}
+		queue.push(samples, now - quantum_ns);
+
+		// Send
+		while (auto packet = queue.pop())
+		{
+			audio_data copy{
+			        .timestamp = packet->timestamp,
+			        .sequence = packet->sequence,
+			        .payload = {},
+			        .data = {std::make_shared<uint8_t[]>(packet->payload.size())},
+			};
+			memcpy(copy.data.c.get(), packet->payload.data(), packet->payload.size());
+			copy.payload = std::span(copy.data.c.get(), packet->payload.size());
+
+			int64_t arrival = now + link.delay();
+			if (tcp)
+			{
+				// Retransmitted after 3 duplicate acknowledgements and a round trip
+				while (link.lost())
+					arrival += 3 * quantum_ns + 2 * link.delay();
+			}
+			else if (link.lost())
+				continue;
+			// Packets are not reordered, and TCP blocks the following ones until the retransmission
+			arrival = std::max(arrival, last_arrival);
+			last_arrival = arrival;
+			in_flight.emplace(arrival, std::move(copy));
+		}
+
+		// Receive, the player period is offset by half a quantum
+		const int64_t play_time = now + quantum_ns / 2;
+		while (not in_flight.empty() and in_flight.begin()->first <= play_time)
+		{
+			auto packet = std::move(in_flight.begin()->second);
+			in_flight.erase(in_flight.begin());
+			if (tcp)
+			{
+				p.push(packet.timestamp, packet.payload.size() / frame_size);
+				continue;
+			}
+			const uint32_t sequence = packet.sequence;
+			for (auto & out: concealment(std::move(packet)))
+				p.push(out.sequence == sequence ? out.timestamp : 0, out.payload.size() / frame_size);
+		}
+
+		p.play(play_time);
+	}
+
+	std::ranges::sort(p.latencies);
+	auto percentile = [&](double q) {
+		if (p.latencies.empty())
+			return 0.;
+		return p.latencies[std::min(p.latencies.size() - 1, size_t(p.latencies.size() * q))] * 1e-6;
+	};
+	return {
+	        .glitch_rate = double(p.glitches) / (p.periods - warmup_periods),
+	        .latency_p50 = percentile(0.5),
+	        .latency_p99 = percentile(0.99),
+	        .concealed = concealment.concealed,
+	        .late = concealment.late,
+	};
+}
+} // namespace
+
+int main()
+{
+	// Underruns are filled with silence before the concealed packets arrive, latency is bounded by
+	// the 50ms buffer limit of the player
+	const std::vector<link_parameters> links{
+	        {.name = "clean", .delay = 2, .jitter = 1, .max_glitch_rate = 0, .max_latency_p99 = 40},
+	        {.name = "1% loss", .loss = 0.01, .delay = 2, .jitter = 1, .max_glitch_rate = 0.03, .max_latency_p99 = 40},
+	        {.name = "5% loss, bursts of 3", .loss = 0.05, .burst = 3, .delay = 5, .jitter = 4, .max_glitch_rate = 0.1, .max_latency_p99 = 65},
+	        {.name = "1% loss, 20ms jitter", .loss = 0.01, .delay = 5, .jitter = 20, .max_glitch_rate = 0.1, .max_latency_p99 = 60},
+	};
+
+	bool ok = true;
+	std::cout << std::format("{:<24} {:>9} {:>9} {:>9} {:>9} {:>9} {:>6}\n", "link", "transport", "glitch %", "p50 ms", "p99 ms", "concealed", "late");
+	for (const auto & link: links)
+	{
+		for (bool tcp: {false, true})
+		{
+			auto r = run(link, tcp);
+			bool link_ok = tcp or (r.glitch_rate <= link.max_glitch_rate and r.latency_p99 <= link.max_latency_p99);
+			ok = ok and link_ok;
+			std::cout << std::format("{:<24} {:>9} {:>9.2f} {:>9.1f} {:>9.1f} {:>9} {:>6}{}\n",
+			                         link.name,
+			                         tcp ? "tcp model" : "udp",
+			                         r.glitch_rate * 100,
+			                         r.latency_p50,
+			                         r.latency_p99,
+			                         r.concealed,
+			                         r.late,
+			                         link_ok ? "" : " FAIL");
+		}
+	}
+
+	return ok ? 0 : 1;
+}
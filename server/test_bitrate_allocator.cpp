@@ -0,0 +1,302 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Encodes three synthetic streams of different complexity with x264, as the left, right and
+// alpha streams of a session, and lets bitrate_allocator move bitrate between them once per
+// second like the compositor does.
+//
+// The left stream has moving detailed content, the right one a dark static gradient and the
+// alpha stream a mostly uniform mask. The left stream must end up with more than its initial
+// share, the right one with less, and the total must not change.
+//
+// Synthetic statistics then check that a stream that encoded nothing keeps its share, and that
+// shares stay within their bounds whatever the statistics.
+//
+// Usage: wivrn-bitrate-allocator-test
+
+#include "encoder/bitrate_allocator.h"
+#include "encoder/encoder_settings.h"
+#include "encoder/x264_session.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace
+{
+using namespace wivrn;
+
+constexpr uint16_t width = 640;
+constexpr uint16_t height = 704;
+constexpr float fps = 90;
+constexpr uint64_t total_bitrate = 20'000'000;
+constexpr int seconds = 10;
+
+using frame = std::vector<uint8_t>;
+
+// Luma of the frames of a scene, chroma is uniform
+using scene = std::function<uint8_t(int x, int y, int n)>;
+
+std::vector<frame> generate(const scene & luma, int count)
+{
+	std::vector<frame> frames;
+	for (int n = 0; n < count; ++n)
+	{
+		frame & f = frames.emplace_back(width * height * 3 / 2, 128);
+		for (int y = 0; y < height; ++y)
+			for (int x = 0; x < width; ++x)
+				f[y * width + x] = luma(x, y, n);
+	}
+	return frames;
+}
+
+struct stream
+{
+	const char * name;
+	std::vector<frame> frames;
+	std::vector<uint8_t> luma = std::vector<uint8_t>(width * height);
+	std::vector<uint8_t> chroma = std::vector<uint8_t>(width * height / 2);
+	std::unique_ptr<x264_session> session;
+	x264_picture_t pic;
+	bitrate_allocator::stream_stats stats;
+	double qp_sum = 0;
+
+	stream(const char * name, std::vector<frame> frames, uint64_t bitrate) :
+	        name(name), frames(std::move(frames))
+	{
+		encoder_settings settings{
+		        .width = width,
+		        .height = height,
+		        .codec = h264,
+		        .fps = fps,
+		        .encoder_name = "x264",
+		        .bitrate = bitrate,
+		        .bitrate_multiplier = 1,
+		        .options = {},
+		        .bit_depth = 8,
+		        .foveation_qp = 0,
+		        .device = std::nullopt,
+		};
+		session = std::make_unique<x264_session>(settings, [this](std::span<uint8_t> data, bool end_of_frame, bool) {
+			stats.bytes += data.size();
+			if (end_of_frame)
+				++stats.frames;
+		});
+		session->init_picture(pic, luma.data(), chroma.data());
+	}
+
+	void encode(int n)
+	{
+		const auto & f = frames[n % frames.size()];
+		memcpy(luma.data(), f.data(), luma.size());
+		memcpy(chroma.data(), f.data() + luma.size(), chroma.size());
+		pic.i_pts = n;
+		if (session->encode(pic, n == 0) >= 0)
+			qp_sum += session->qp();
+	}
+
+	bitrate_allocator::stream_stats take_stats(uint64_t bitrate)
+	{
+		auto res = stats;
+		res.qp = stats.frames ? qp_sum / stats.frames : -1;
+		res.bitrate = bitrate;
+		stats = {};
+		qp_sum = 0;
+		return res;
+	}
+};
+
+bool check_shares(const bitrate_allocator & allocator, const std::vector<double> & initial, const char * what)
+{
+	bool ok = true;
+	double sum = 0;
+	for (size_t i = 0; i < initial.size(); ++i)
+	{
+		double share = allocator.shares()[i];
+		sum += share;
+		if (share < initial[i] * 0.5 - 1e-9 or share > initial[i] * 2 + 1e-9)
+		{
+			std::cout << std::format("FAIL: {}: share {} is {:.4f}, out of bounds\n", what, i, share);
+			ok = false;
+		}
+	}
+	if (std::abs(sum - 1) > 1e-9)
+	{
+		std::cout << std::format("FAIL: {}: shares sum to {}\n", what, sum);
+		ok = false;
+	}
+	return ok;
+}
+
+bool check_idle_stream(const std::vector<double> & initial)
+{
+	bitrate_allocator allocator(initial);
+	bool ok = true;
+	for (int period = 0; period < 20; ++period)
+	{
+		const auto & shares = allocator.shares();
+		// The right stream uses a tenth of its budget, the alpha stream is not encoded
+		std::array<bitrate_allocator::stream_stats, 3> stats{{
+		        {.bytes = uint64_t(total_bitrate * shares[0] / 8), .frames = 90, .qp = 30, .bitrate = uint64_t(total_bitrate * shares[0])},
+		        {.bytes = uint64_t(total_bitrate * shares[1] / 80), .frames = 90, .qp = 30, .bitrate = uint64_t(total_bitrate * shares[1])},
+		        {.frames = 0},
+		}};
+		allocator.update(stats, 1'000'000'000);
+		ok = check_shares(allocator, initial, "idle stream") and ok;
+	}
+	if (allocator.shares()[2] != initial[2])
+	{
+		std::cout << std::format("FAIL: idle stream share changed to {:.4f}\n", allocator.shares()[2]);
+		ok = false;
+	}
+	if (allocator.shares()[1] >= initial[1])
+	{
+		std::cout << std::format("FAIL: underused stream share {:.4f} did not decrease\n", allocator.shares()[1]);
+		ok = false;
+	}
+	return ok;
+}
+
+// Random splits and statistics, with idle streams
+bool check_bounds()
+{
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<double> uniform(0.02, 1);
+
+	bool ok = true;
+	for (int split = 0; split < 200; ++split)
+	{
+		std::vector<double> initial(3);
+		for (double & share: initial)
+			share = uniform(rng);
+		double sum = std::accumulate(initial.begin(), initial.end(), 0.);
+		for (double & share: initial)
+			share /= sum;
+
+		bitrate_allocator allocator(initial);
+		for (int period = 0; period < 50; ++period)
+		{
+			std::array<bitrate_allocator::stream_stats, 3> stats;
+			for (size_t i = 0; i < stats.size(); ++i)
+			{
+				if (rng() % 4 == 0)
+					continue;
+				uint64_t bitrate = total_bitrate * allocator.shares()[i];
+				stats[i] = {.bytes = uint64_t(bitrate * uniform(rng) / 4), .frames = 90, .qp = float(uniform(rng) * 60), .bitrate = bitrate};
+			}
+			allocator.update(stats, 1'000'000'000);
+			ok = check_shares(allocator, initial, "random statistics") and ok;
+		}
+	}
+	return ok;
+}
+} // namespace
+
+int main()
+{
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> noise(-24, 24);
+
+	const std::vector<double> initial{0.45, 0.45, 0.1};
+	bitrate_allocator allocator(initial);
+
+	std::array<stream, 3> streams{
+	        stream{"detailed", generate([&](int x, int y, int n) {
+		                                    int v = ((x + 4 * n) / 4 + y / 4) % 2 ? 200 : 50;
+		                                    return std::clamp(v + noise(rng), 0, 255);
+	                                    },
+	                                    30),
+	               uint64_t(total_bitrate * initial[0])},
+	        stream{"flat", generate([](int x, int y, int) { return 16 + (x + y) * 32 / (width + height); }, 1), uint64_t(total_bitrate * initial[1])},
+	        stream{"alpha", generate([](int x, int y, int) { return x < width / 4 and y < height / 4 ? 0 : 255; }, 1), uint64_t(total_bitrate * initial[2])},
+	};
+
+	std::cout << std::format("{:>3} |", "s");
+	for (const auto & s: streams)
+		std::cout << std::format(" {:>8} {:>6} {:>6} {:>5} |", s.name, "share", "Mbit/s", "QP");
+	std::cout << "\n";
+
+	bool ok = true;
+	int n = 0;
+	for (int second = 0; second < seconds; ++second)
+	{
+		for (int i = 0; i < fps; ++i, ++n)
+			for (auto & s: streams)
+				s.encode(n);
+
+		std::array<bitrate_allocator::stream_stats, 3> stats;
+		for (size_t i = 0; i < streams.size(); ++i)
+			stats[i] = streams[i].take_stats(total_bitrate * allocator.shares()[i]);
+
+		std::cout << std::format("{:>3} |", second);
+		for (size_t i = 0; i < streams.size(); ++i)
+			std::cout << std::format(" {:>8} {:>6.3f} {:>6.2f} {:>5.1f} |", "", allocator.shares()[i], stats[i].bytes * 8e-6, stats[i].qp);
+		std::cout << "\n";
+
+		if (allocator.update(stats, 1'000'000'000))
+		{
+			for (size_t i = 0; i < streams.size(); ++i)
+				streams[i].session->reconfigure(total_bitrate * allocator.shares()[i], 0);
+		}
+
+		double sum = 0;
+		for (double share: allocator.shares())
+			sum += share;
+		if (std::abs(sum - 1) > 1e-9)
+		{
+			std::cout << std::format("FAIL: shares sum to {}\n", sum);
+			ok = false;
+		}
+	}
+
+	const auto & shares = allocator.shares();
+	for (size_t i = 0; i < shares.size(); ++i)
+	{
+		if (shares[i] < initial[i] * 0.5 - 1e-9 or shares[i] > initial[i] * 2 + 1e-9)
+		{
+			std::cout << std::format("FAIL: {} share {:.3f} out of bounds\n", streams[i].name, shares[i]);
+			ok = false;
+		}
+	}
+	if (shares[0] <= initial[0])
+	{
+		std::cout << std::format("FAIL: detailed stream share {:.3f} did not increase\n", shares[0]);
+		ok = false;
+	}
+	if (shares[1] >= initial[1])
+	{
+		std::cout << std::format("FAIL: flat stream share {:.3f} did not decrease\n", shares[1]);
+		ok = false;
+	}
+
+	ok = check_idle_stream(initial) and ok;
+	ok = check_bounds() and ok;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Estimates the clock offset between both ends of a loopback UDP link with busy handlers.
+//
+// The headset thread answers timesync queries with its clock shifted by a known offset, each
+// packet is handled after a random delay as when the network thread is busy with other packets.
+// The server side is delayed the same way before reading the response. Timestamps are taken
+// either from the kernel or when the packet is handled, the estimated offset must stay close to
+// the real one with kernel timestamps.
+//
+// Usage: wivrn-clock-offset-test
+// Exits with 1 if a threshold was not met.
+
+#include "driver/clock_offset.h"
+#include "os/os_time.h"
+#include "utils/overloaded.h"
+#include "wivrn_packets.h"
+#include "wivrn_sockets.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <poll.h>
+#include <random>
+#include <sys/socket.h>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using namespace wivrn;
+using server_socket = typed_socket<UDP, from_headset::packets, to_headset::packets>;
+using headset_socket = typed_socket<UDP, to_headset::packets, from_headset::packets>;
+
+constexpr int64_t headset_offset = 1'234'567'890;
+constexpr int samples = 300;
+// Only the last samples are evaluated, the estimator needs 100 samples to use the regression
+constexpr int evaluated_samples = 100;
+constexpr int64_t max_handler_delay_us = 8000;
+
+uint16_t bind_loopback(UDP & socket)
+{
+	sockaddr_in6 address{};
+	address.sin6_family = AF_INET6;
+	address.sin6_addr = in6addr_loopback;
+	socket.bind(address);
+	socklen_t size = sizeof(address);
+	if (getsockname(socket, (sockaddr *)&address, &size) < 0)
+		throw std::system_error(errno, std::generic_category());
+	return ntohs(address.sin6_port);
+}
+
+bool wait_readable(int fd, int timeout_ms)
+{
+	pollfd pfd{.fd = fd, .events = POLLIN, .revents = 0};
+	return ::poll(&pfd, 1, timeout_ms) > 0;
+}
+
+// Simulates the time spent on other packets before this one is handled
+class busy_handler
+{
+	std::mt19937 rng;
+	std::uniform_int_distribution<int64_t> delay{0, max_handler_delay_us};
+
+public:
+	busy_handler(int seed) :
+	        rng(seed) {}
+
+	void operator()()
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(delay(rng)));
+	}
+};
+
+struct result
+{
+	double mean_error; // µs
+	double stddev;     // µs
+};
+
+result run(bool kernel_timestamps)
+{
+	server_socket server;
+	headset_socket headset;
+	uint16_t server_port = bind_loopback(server);
+	uint16_t headset_port = bind_loopback(headset);
+	server.connect(in6addr_loopback, headset_port);
+	headset.connect(in6addr_loopback, server_port);
+
+	std::atomic<bool> stop = false;
+	std::thread headset_thread([&]() {
+		busy_handler busy(1);
+		while (not stop)
+		{
+			if (not wait_readable(headset.get_fd(), 100))
+				continue;
+			auto packet = headset.receive();
+			if (not packet)
+				continue;
+			busy();
+			std::visit(utils::overloaded{
+			                   [&](to_headset::timesync_query & query) {
+				                   int64_t now = os_monotonic_get_ns();
+				                   int64_t received = kernel_timestamps ? (headset.receive_time() + now) / 2 : now;
+				                   headset.send(from_headset::timesync_response{
+				                           .query = query.query,
+				                           .response = received + headset_offset,
+				                   });
+			                   },
+			                   [](auto &) {},
+			           },
+			           *packet);
+		}
+	});
+
+	clock_offset_estimator estimator;
+	busy_handler busy(2);
+	std::vector<int64_t> offsets;
+	for (int i = 0; i < samples; ++i)
+	{
+		server.send(to_headset::timesync_query{.query = XrTime(os_monotonic_get_ns())});
+		if (not wait_readable(server.get_fd(), 1000))
+			continue;
+		busy();
+		auto packet = server.receive();
+		if (not packet)
+			continue;
+		if (auto response = std::get_if<from_headset::timesync_response>(&*packet))
+		{
+			XrTime received = kernel_timestamps ? server.receive_time() : os_monotonic_get_ns();
+			estimator.add_sample(*response, received);
+			offsets.push_back(estimator.get_offset().b);
+		}
+	}
+	stop = true;
+	headset_thread.join();
+
+	if (offsets.size() < size_t(evaluated_samples))
+		throw std::runtime_error("too many lost packets");
+
+	double sum = 0;
+	double sum2 = 0;
+	for (auto it = offsets.end() - evaluated_samples; it != offsets.end(); ++it)
+	{
+		double error = (*it - headset_offset) * 1e-3;
+		sum += error;
+		sum2 += error * error;
+	}
+	double mean = sum / evaluated_samples;
+	return {
+	        .mean_error = mean,
+	        .stddev = std::sqrt(std::max(0., sum2 / evaluated_samples - mean * mean)),
+	};
+}
+} // namespace
+
+int main()
+{
+	// Loopback latency is a few µs, handlers are delayed up to 8ms
+	const double max_error = 500;  // µs
+	const double max_stddev = 200; // µs
+
+	bool ok = true;
+	std::cout << std::format("{:<20} {:>14} {:>14}\n", "timestamps", "mean error µs", "stddev µs");
+	for (bool kernel: {true, false})
+	{
+		auto r = run(kernel);
+		bool run_ok = not kernel or (std::abs(r.mean_error) <= max_error and r.stddev <= max_stddev);
+		ok = ok and run_ok;
+		std::cout << std::format("{:<20} {:>14.1f} {:>14.1f}{}\n", kernel ? "kernel" : "handler", r.mean_error, r.stddev, run_ok ? "" : " FAIL");
+	}
+
+	return ok ? 0 : 1;
+}
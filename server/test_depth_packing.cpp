@@ -0,0 +1,140 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Checks the depth packing of the depth stream.
+//
+// Depth layers are generated for known distances with the conventions allowed by
+// XrCompositionLayerDepthInfoKHR (reversed, infinite planes, partial depth range), packed, then
+// read back as the headset submits them. Packed values are also quantized to the bit depth of the
+// video stream and the resulting parallax error for a head translation is compared to the size
+// of a display pixel.
+//
+// Usage: wivrn-depth-packing-test
+// Exits with 1 if a threshold was not met.
+
+#include "depth_packing.h"
+
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace
+{
+using namespace wivrn;
+
+constexpr float inf = std::numeric_limits<float>::infinity();
+
+// Head translation between rendering and display, 2cm is 20ms at 1m/s
+constexpr float head_translation = 0.02;
+// Angular size of a display pixel, about 20 pixels per degree
+constexpr float pixel_angle = 0.00087;
+
+struct convention
+{
+	std::string name;
+	float min_depth;
+	float max_depth;
+	float near_z;
+	float far_z;
+
+	// Value written by an application with this projection
+	float depth(float distance) const
+	{
+		float d = (1 / distance - 1 / near_z) / (1 / far_z - 1 / near_z);
+		return min_depth + d * (max_depth - min_depth);
+	}
+};
+
+std::vector<float> distances()
+{
+	std::vector<float> res;
+	for (float d = depth_packing::near_plane; d < 1000; d *= 1.1)
+		res.push_back(d);
+	return res;
+}
+
+float quantize(float value, int bits)
+{
+	const float max = (1 << bits) - 1;
+	return std::round(value * max) / max;
+}
+} // namespace
+
+int main()
+{
+	bool ok = true;
+
+	const std::vector<convention> conventions{
+	        {"standard", 0, 1, 0.05, 200},
+	        {"reversed", 0, 1, 200, 0.05},
+	        {"infinite far", 0, 1, 0.05, inf},
+	        {"reversed infinite far", 0, 1, inf, 0.05},
+	        {"partial range", 0.25, 0.75, 0.05, 200},
+	};
+
+	std::cout << std::format("{:<24} {:>16} {:>16}\n", "convention", "max error", "headset error");
+	for (const auto & c: conventions)
+	{
+		// Difference of the packed value with the exact one, and of 1 / distance read by the headset
+		float max_error = 0;
+		float max_headset_error = 0;
+		for (float distance: distances())
+		{
+			float packed = depth_packing::pack(depth_packing::inverse_distance(c.depth(distance), c.min_depth, c.max_depth, c.near_z, c.far_z));
+			max_error = std::max(max_error, std::abs(packed - depth_packing::near_plane / distance));
+
+			float headset = depth_packing::inverse_distance(packed, 0, 1, inf, depth_packing::near_plane);
+			max_headset_error = std::max(max_headset_error, std::abs(headset - 1 / distance));
+		}
+		bool c_ok = max_error < 1e-4 and max_headset_error < 1e-3;
+		ok = ok and c_ok;
+		std::cout << std::format("{:<24} {:>16.2e} {:>16.2e}{}\n", c.name, max_error, max_headset_error, c_ok ? "" : " FAIL");
+	}
+
+	bool clamp_ok = depth_packing::pack(1 / (depth_packing::near_plane / 2)) == 1 and
+	                depth_packing::pack(0) == 0 and
+	                std::isinf(depth_packing::unpack(0));
+	ok = ok and clamp_ok;
+	std::cout << std::format("\nclamped below {}m and at infinity{}\n", depth_packing::near_plane, clamp_ok ? "" : " FAIL");
+
+	std::cout << std::format("\n{:<6} {:>20} {:>20} {:>20}\n", "bits", "distance at 1m (m)", "distance at 10m (m)", "parallax (pixels)");
+	for (int bits: {8, 10})
+	{
+		float max_parallax = 0;
+		for (float distance: distances())
+		{
+			float unpacked = depth_packing::unpack(quantize(depth_packing::pack(1 / distance), bits));
+			max_parallax = std::max(max_parallax, head_translation * std::abs(1 / unpacked - 1 / distance));
+		}
+		max_parallax /= pixel_angle;
+		bool bits_ok = max_parallax < 1;
+		ok = ok and bits_ok;
+		std::cout << std::format("{:<6} {:>20.4f} {:>20.2f} {:>20.3f}{}\n",
+		                         bits,
+		                         depth_packing::unpack(quantize(depth_packing::pack(1), bits)),
+		                         depth_packing::unpack(quantize(depth_packing::pack(0.1), bits)),
+		                         max_parallax,
+		                         bits_ok ? "" : " FAIL");
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,479 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Encodes NV12 frames with the x264 encoder, without Vulkan device nor compositor.
+//
+// video_encoder_x264 copies the image from the compositor into host buffers and gives them to
+// x264_session; here the frames are copied from memory instead, either generated or read from a
+// raw dump (WIVRN_DUMP_VIDEO with the raw encoder, streams 0 and 1 are NV12). The encoded data is
+// split in shards like video_encoder::SendData but not sent.
+//
+// Every combination of the comma separated presets, slice counts and foveation QP strengths is
+// measured, so that the encoder settings can be chosen from data.
+//
+// The frames are considered foveated with a fixed center: the PSNR of the reconstructed image is
+// reported separately for the fovea (1:1 pixels) and the periphery, to compare the foveation QP
+// offsets at the same bitrate.
+//
+// Usage: wivrn-encoder-bench [--option value...], see usage() for the options.
+
+#include "compositor/foveation_table.h"
+#include "encoder/encoder_settings.h"
+#include "encoder/foveation_qp.h"
+#include "encoder/video_shards.h"
+#include "encoder/x264_session.h"
+#include "os/os_time.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+using namespace wivrn;
+
+struct options
+{
+	uint16_t width = 1600;
+	uint16_t height = 1760;
+	float fps = 90;
+	double bitrate = 25; // Mbit/s
+	int frames = 900;
+	int idr_interval = 0; // 0 for only the first frame
+	std::vector<std::string> presets{"ultrafast"};
+	std::vector<std::string> slices{"32"};
+	std::vector<float> foveation_qp{0};
+	float foveation = 1.5; // source size / encoded size
+	std::map<std::string, std::string> x264_options;
+	std::optional<std::string> input;
+};
+
+void usage(const char * name)
+{
+	options o;
+	std::cerr << std::format(
+	        "Usage: {} [--option value...]\n"
+	        "  --width         frame width ({})\n"
+	        "  --height        frame height ({})\n"
+	        "  --fps           frame rate ({})\n"
+	        "  --bitrate       target bitrate, Mbit/s ({})\n"
+	        "  --frames        number of frames ({})\n"
+	        "  --idr-interval  request an I frame every n frames, 0 for only the first one ({})\n"
+	        "  --preset        comma separated list of x264 presets ({})\n"
+	        "  --slices        comma separated list of slice counts ({})\n"
+	        "  --foveation-qp  comma separated list of foveation QP strengths ({})\n"
+	        "  --foveation     foveation ratio, source size over encoded size ({})\n"
+	        "  --x264          additional x264 option, name=value\n"
+	        "  --input         NV12 file with frames of the given size, generated if unset\n",
+	        name,
+	        o.width,
+	        o.height,
+	        o.fps,
+	        o.bitrate,
+	        o.frames,
+	        o.idr_interval,
+	        o.presets.front(),
+	        o.slices.front(),
+	        o.foveation_qp.front(),
+	        o.foveation);
+}
+
+std::vector<std::string> split(const std::string & list)
+{
+	std::vector<std::string> result;
+	std::stringstream stream(list);
+	for (std::string item; std::getline(stream, item, ',');)
+		result.push_back(item);
+	return result;
+}
+
+std::optional<options> parse(int argc, char ** argv)
+{
+	options o;
+	for (int i = 1; i < argc; i += 2)
+	{
+		std::string name = argv[i];
+		if (i + 1 == argc)
+		{
+			std::cerr << "Missing value for " << name << std::endl;
+			return std::nullopt;
+		}
+		std::string value = argv[i + 1];
+		if (name == "--width")
+			o.width = std::stoi(value);
+		else if (name == "--height")
+			o.height = std::stoi(value);
+		else if (name == "--fps")
+			o.fps = std::stof(value);
+		else if (name == "--bitrate")
+			o.bitrate = std::stod(value);
+		else if (name == "--frames")
+			o.frames = std::stoi(value);
+		else if (name == "--idr-interval")
+			o.idr_interval = std::stoi(value);
+		else if (name == "--preset")
+			o.presets = split(value);
+		else if (name == "--slices")
+			o.slices = split(value);
+		else if (name == "--foveation-qp")
+		{
+			o.foveation_qp.clear();
+			for (const auto & item: split(value))
+				o.foveation_qp.push_back(std::stof(item));
+		}
+		else if (name == "--foveation")
+			o.foveation = std::stof(value);
+		else if (name == "--input")
+			o.input = value;
+		else if (name == "--x264" and value.find('=') != std::string::npos)
+			o.x264_options[value.substr(0, value.find('='))] = value.substr(value.find('=') + 1);
+		else
+		{
+			std::cerr << "Invalid option " << name << " " << value << std::endl;
+			return std::nullopt;
+		}
+	}
+
+	if (o.width % 2 or o.height % 2 or o.frames < 1 or o.presets.empty() or o.slices.empty() or o.foveation_qp.empty() or o.foveation < 1)
+		return std::nullopt;
+	return o;
+}
+
+using frame = std::vector<uint8_t>;
+
+// Smooth gradients, a textured block moving across the image and some noise, so that the
+// encoder has both static and moving areas
+std::vector<frame> generate(uint16_t width, uint16_t height, int count)
+{
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<int> noise(-8, 8);
+
+	std::vector<frame> frames;
+	for (int n = 0; n < count; ++n)
+	{
+		frame & f = frames.emplace_back(width * height * 3 / 2);
+		uint8_t * luma = f.data();
+		uint8_t * chroma = f.data() + width * height;
+
+		int block_x = (n * 7) % (width / 2);
+		int block_y = height / 4 + (n * 3) % (height / 2);
+		int block_size = std::min(width, height) / 4;
+
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				int value = (x + y) * 255 / (width + height) + noise(rng);
+				if (x >= block_x and x < block_x + block_size and y >= block_y and y < block_y + block_size)
+					value = ((x - block_x) / 8 + (y - block_y) / 8) % 2 ? 230 : 30;
+				luma[y * width + x] = std::clamp(value, 0, 255);
+			}
+		}
+		for (int y = 0; y < height / 2; ++y)
+		{
+			for (int x = 0; x < width / 2; ++x)
+			{
+				chroma[y * width + 2 * x] = 128 + (x * 64 / width);
+				chroma[y * width + 2 * x + 1] = 128 - (y * 64 / height);
+			}
+		}
+	}
+	return frames;
+}
+
+std::vector<frame> load(const std::string & filename, uint16_t width, uint16_t height, int max_count)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (not file)
+		throw std::runtime_error("Cannot open " + filename);
+
+	std::vector<frame> frames;
+	while (int(frames.size()) < max_count)
+	{
+		frame f(width * height * 3 / 2);
+		if (not file.read((char *)f.data(), f.size()))
+			break;
+		frames.push_back(std::move(f));
+	}
+	if (frames.empty())
+		throw std::runtime_error(filename + " does not contain a full frame");
+	return frames;
+}
+
+struct frame_result
+{
+	bool idr = false;
+	int64_t encode = 0;    // ns
+	int64_t first_nal = 0; // ns, from the start of the encode to the first slice
+	size_t size = 0;       // bytes
+	size_t shards = 0;
+	// Squared error sum and pixel count of the luma plane
+	double fovea_error = 0;
+	size_t fovea_pixels = 0;
+	double periphery_error = 0;
+	size_t periphery_pixels = 0;
+};
+
+// H.264 NAL unit type, after the Annex B start code
+bool is_slice(std::span<uint8_t> nal)
+{
+	size_t header = nal.size() > 3 and nal[2] == 1 ? 3 : 4;
+	if (nal.size() <= header)
+		return false;
+	int type = nal[header] & 0x1f;
+	return type >= 1 and type <= 5;
+}
+
+struct stats
+{
+	double mean = 0;
+	double p50 = 0;
+	double p99 = 0;
+	double max = 0;
+};
+
+template <typename T, typename F>
+stats compute(const std::vector<T> & items, F && value)
+{
+	std::vector<double> values;
+	for (const auto & item: items)
+		values.push_back(value(item));
+	if (values.empty())
+		return {};
+	std::ranges::sort(values);
+	stats s;
+	for (double v: values)
+		s.mean += v;
+	s.mean /= values.size();
+	s.p50 = values[values.size() / 2];
+	s.p99 = values[std::min(values.size() - 1, values.size() * 99 / 100)];
+	s.max = values.back();
+	return s;
+}
+
+double psnr(double error, size_t pixels)
+{
+	if (pixels == 0)
+		return 0;
+	return 10 * std::log10(255. * 255. * pixels / std::max(error, 1.));
+}
+
+std::vector<frame_result> run(const options & o, const std::vector<frame> & input, const std::string & preset, const std::string & slices, float foveation_qp)
+{
+	encoder_settings settings{
+	        .width = o.width,
+	        .height = o.height,
+	        .codec = h264,
+	        .fps = o.fps,
+	        .encoder_name = "x264",
+	        .bitrate = uint64_t(o.bitrate * 1'000'000),
+	        .bitrate_multiplier = 1,
+	        .options = o.x264_options,
+	        .bit_depth = 8,
+	        .foveation_qp = foveation_qp,
+	        .device = std::nullopt,
+	};
+	settings.options["preset"] = preset;
+	settings.options["slices"] = slices;
+
+	std::vector<frame_result> results;
+	int64_t encode_begin = 0;
+	to_headset::video_stream_data_shard shard{};
+
+	x264_session session(settings, [&](std::span<uint8_t> data, bool end_of_frame, bool) {
+		auto & result = results.back();
+		if (result.first_nal == 0 and is_slice(data))
+			result.first_nal = os_monotonic_get_ns() - encode_begin;
+		result.size += data.size();
+		result.shards += split_shards(shard,
+		                              data,
+		                              to_headset::video_stream_data_shard::max_payload_size,
+		                              std::nullopt,
+		                              [](const auto &) {});
+		if (end_of_frame)
+			shard.shard_idx = 0;
+	});
+
+	// Centered foveation, blocks with a negative offset are in the fovea
+	to_headset::foveation_parameter foveation{
+	        .x = foveation_table::compute_axis(0, o.width, o.width * o.foveation),
+	        .y = foveation_table::compute_axis(0, o.height, o.height * o.foveation),
+	};
+	const uint16_t mb_width = (o.width + 15) / 16;
+	const auto fovea = wivrn::foveation_qp(foveation, o.width, o.height, 16, 1);
+	auto qp_offsets = wivrn::foveation_qp(foveation, o.width, o.height, 16, foveation_qp);
+
+	std::vector<uint8_t> luma(o.width * o.height);
+	std::vector<uint8_t> chroma(o.width * o.height / 2);
+	x264_picture_t pic;
+	session.init_picture(pic, luma.data(), chroma.data());
+
+	const int64_t period = 1e9 / o.fps;
+	for (int i = 0; i < o.frames; ++i)
+	{
+		const auto & f = input[i % input.size()];
+		bool idr = i == 0 or (o.idr_interval > 0 and i % o.idr_interval == 0);
+		results.push_back({.idr = idr});
+
+		memcpy(luma.data(), f.data(), luma.size());
+		memcpy(chroma.data(), f.data() + luma.size(), chroma.size());
+
+		encode_begin = os_monotonic_get_ns();
+
+		shard.view_info.emplace();
+		pic.i_pts = i * period;
+		session.encode(pic, idr, foveation_qp ? qp_offsets.data() : nullptr);
+		auto & result = results.back();
+		result.encode = os_monotonic_get_ns() - encode_begin;
+
+		const auto & recon = session.reconstructed().img;
+		for (int y = 0; y < o.height; ++y)
+		{
+			for (int x = 0; x < o.width; ++x)
+			{
+				double error = int(recon.plane[0][y * recon.i_stride[0] + x]) - int(f[y * o.width + x]);
+				if (fovea[(y / 16) * mb_width + x / 16] < 0)
+				{
+					result.fovea_error += error * error;
+					++result.fovea_pixels;
+				}
+				else
+				{
+					result.periphery_error += error * error;
+					++result.periphery_pixels;
+				}
+			}
+		}
+	}
+	return results;
+}
+} // namespace
+
+int main(int argc, char ** argv)
+{
+	auto o = parse(argc, argv);
+	if (not o)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	try
+	{
+		// Frames are copied from memory, avoid generating them all
+		auto input = o->input ? load(*o->input, o->width, o->height, o->frames)
+		                      : generate(o->width, o->height, std::min(o->frames, 90));
+
+		std::cout << std::format("{}x{} at {} fps, {} Mbit/s, {} frames ({} distinct), foveation {}\n\n",
+		                         o->width,
+		                         o->height,
+		                         o->fps,
+		                         o->bitrate,
+		                         o->frames,
+		                         input.size(),
+		                         o->foveation);
+
+		std::cout << std::format("{:<10} {:>6} {:>6} | {:>8} {:>8} {:>8} | {:>9} {:>9} | {:>8} {:>8} {:>7} | {:>8} {:>7} | {:>8} {:>8}\n",
+		                         "preset",
+		                         "slices",
+		                         "fov qp",
+		                         "enc ms",
+		                         "p99",
+		                         "max",
+		                         "1st NAL",
+		                         "p99",
+		                         "P kB",
+		                         "I kB",
+		                         "shards",
+		                         "Mbit/s",
+		                         "error %",
+		                         "fovea dB",
+		                         "periph");
+
+		for (const auto & preset: o->presets)
+		{
+			for (const auto & slices: o->slices)
+			{
+				for (float foveation_qp: o->foveation_qp)
+				{
+					auto results = run(*o, input, preset, slices, foveation_qp);
+
+					auto encode = compute(results, [](const frame_result & r) { return r.encode * 1e-6; });
+					auto first_nal = compute(results, [](const frame_result & r) { return r.first_nal * 1e-6; });
+					auto shards = compute(results, [](const frame_result & r) { return double(r.shards); });
+
+					std::vector<frame_result> p_frames;
+					std::vector<frame_result> i_frames;
+					std::ranges::partition_copy(results, std::back_inserter(i_frames), std::back_inserter(p_frames), &frame_result::idr);
+					auto p_size = compute(p_frames, [](const frame_result & r) { return r.size * 1e-3; });
+					auto i_size = compute(i_frames, [](const frame_result & r) { return r.size * 1e-3; });
+
+					// Skip the first second, where the rate control converges
+					size_t skip = std::min<size_t>(o->fps, results.size() / 2);
+					double bytes = 0;
+					for (size_t i = skip; i < results.size(); ++i)
+						bytes += results[i].size;
+					double bitrate = bytes * 8e-6 * o->fps / (results.size() - skip);
+
+					frame_result total;
+					for (const auto & r: results)
+					{
+						total.fovea_error += r.fovea_error;
+						total.fovea_pixels += r.fovea_pixels;
+						total.periphery_error += r.periphery_error;
+						total.periphery_pixels += r.periphery_pixels;
+					}
+
+					std::cout << std::format("{:<10} {:>6} {:>6} | {:>8.3f} {:>8.3f} {:>8.3f} | {:>9.3f} {:>9.3f} | {:>8.1f} {:>8.1f} {:>7.1f} | {:>8.2f} {:>7.1f} | {:>8.2f} {:>8.2f}\n",
+					                         preset,
+					                         slices,
+					                         foveation_qp,
+					                         encode.mean,
+					                         encode.p99,
+					                         encode.max,
+					                         first_nal.mean,
+					                         first_nal.p99,
+					                         p_size.mean,
+					                         i_size.mean,
+					                         shards.mean,
+					                         bitrate,
+					                         100 * (bitrate - o->bitrate) / o->bitrate,
+					                         psnr(total.fovea_error, total.fovea_pixels),
+					                         psnr(total.periphery_error, total.periphery_pixels));
+				}
+			}
+		}
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
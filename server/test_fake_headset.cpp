@@ -0,0 +1,1075 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Headless headset that connects to a running server, for soak and load testing.
+//
+// It runs the same handshake as the client, then sends scripted tracking, hand, body and face
+// tracking, inputs and application list requests at the given rates. Video shards are
+// reassembled and discarded, feedback is sent for every frame as if it had been displayed on
+// time. Timesync queries are answered so that the server starts streaming.
+//
+// Sessions are opened one after the other to exercise connection churn. For each session it
+// reports the handshake time, the time until the first frame, the received frames and bitrate,
+// and the latency from the timing information of the frames. With --server-pid, the CPU usage
+// and memory growth of the server are also reported: run the server with --no-fork, or give
+// the pid of the process that serves the connection.
+//
+// The server must accept the headset: either run it with --no-encrypt, or pair the key given
+// with --key once using --pin, later runs with the same key do not need the PIN.
+// The server does not send frames while no OpenXR application is running.
+//
+// Usage: wivrn-fake-headset [--option value...], see usage() for the options.
+// Exits with 1 if a session failed or if a threshold was not met.
+
+#include "crypto.h"
+#include "feedback_batch.h"
+#include "protocol_version.h"
+#include "secrets.h"
+#include "smp.h"
+#include "utils/overloaded.h"
+#include "wivrn_packets.h"
+#include "wivrn_sockets.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <numbers>
+#include <optional>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+using namespace wivrn;
+using control_socket_t = typed_socket<TCP, to_headset::packets, from_headset::packets>;
+using stream_socket_t = typed_socket<UDP, to_headset::packets, from_headset::packets>;
+using data_shard = to_headset::video_stream_data_shard;
+using from_headset::pose_flags;
+
+constexpr size_t stream_count = 3;
+constexpr uint8_t tracked = pose_flags::orientation_valid | pose_flags::position_valid | pose_flags::orientation_tracked | pose_flags::position_tracked;
+
+struct options
+{
+	std::string address = "127.0.0.1";
+	std::string pin;
+	std::string key; // file with the private key, created if it does not exist
+
+	double port = 9757;
+	double tcp_only = 0;
+	double sessions = 1;
+	double duration = 10; // s, per session
+	double pause = 1;     // s, between sessions
+
+	// Headset
+	double eye_width = 1024;
+	double eye_height = 1024;
+	double refresh_rate = 90;
+	double bitrate = 50; // Mbit/s
+
+	// Packets sent, Hz, 0 to disable
+	double tracking_rate = 90;
+	double hand_rate = 0;
+	double body_rate = 0;
+	double face = 0; // face tracking in the tracking packets
+	double input_rate = 30;
+	double app_list_interval = 5; // s
+
+	double server_pid = 0;
+
+	// Thresholds, ignored if negative
+	double min_frames = -1;     // complete frames of the left eye per session
+	double max_p99 = -1;        // ms, encode begin to last shard received
+	double max_rss_growth = -1; // MiB, over all sessions
+};
+
+void usage(const char * name)
+{
+	options o;
+	std::cerr << std::format(
+	        "Usage: {} [--option value...]\n"
+	        "  --address            server address ({})\n"
+	        "  --port               server port ({})\n"
+	        "  --pin                PIN if the headset is not paired yet\n"
+	        "  --key                file with the headset private key, created if needed\n"
+	        "  --tcp-only           do not use UDP for the stream ({})\n"
+	        "  --sessions           number of successive connections ({})\n"
+	        "  --duration           duration of each session, s ({})\n"
+	        "  --pause              time between sessions, s ({})\n"
+	        "  --eye-width          stream width of each eye ({})\n"
+	        "  --eye-height         stream height of each eye ({})\n"
+	        "  --refresh-rate       display refresh rate, Hz ({})\n"
+	        "  --bitrate            requested bitrate, Mbit/s ({})\n"
+	        "  --tracking-rate      head and controller tracking, Hz ({})\n"
+	        "  --hand-rate          hand tracking, Hz ({})\n"
+	        "  --body-rate          body tracking, Hz ({})\n"
+	        "  --face               send face tracking with the head tracking ({})\n"
+	        "  --input-rate         controller inputs, Hz ({})\n"
+	        "  --app-list-interval  application list requests, s ({})\n"
+	        "  --server-pid         process to measure CPU and memory usage\n"
+	        "  --min-frames         fail if a session receives fewer frames\n"
+	        "  --max-p99            fail if the 99th percentile of the latency is higher, ms\n"
+	        "  --max-rss-growth     fail if the server memory grows more, MiB\n",
+	        name,
+	        o.address,
+	        o.port,
+	        o.tcp_only,
+	        o.sessions,
+	        o.duration,
+	        o.pause,
+	        o.eye_width,
+	        o.eye_height,
+	        o.refresh_rate,
+	        o.bitrate,
+	        o.tracking_rate,
+	        o.hand_rate,
+	        o.body_rate,
+	        o.face,
+	        o.input_rate,
+	        o.app_list_interval);
+}
+
+std::optional<options> parse(int argc, char ** argv)
+{
+	options o;
+	const std::map<std::string, std::string *> strings{
+	        {"--address", &o.address},
+	        {"--pin", &o.pin},
+	        {"--key", &o.key},
+	};
+	const std::map<std::string, double *> names{
+	        {"--port", &o.port},
+	        {"--tcp-only", &o.tcp_only},
+	        {"--sessions", &o.sessions},
+	        {"--duration", &o.duration},
+	        {"--pause", &o.pause},
+	        {"--eye-width", &o.eye_width},
+	        {"--eye-height", &o.eye_height},
+	        {"--refresh-rate", &o.refresh_rate},
+	        {"--bitrate", &o.bitrate},
+	        {"--tracking-rate", &o.tracking_rate},
+	        {"--hand-rate", &o.hand_rate},
+	        {"--body-rate", &o.body_rate},
+	        {"--face", &o.face},
+	        {"--input-rate", &o.input_rate},
+	        {"--app-list-interval", &o.app_list_interval},
+	        {"--server-pid", &o.server_pid},
+	        {"--min-frames", &o.min_frames},
+	        {"--max-p99", &o.max_p99},
+	        {"--max-rss-growth", &o.max_rss_growth},
+	};
+
+	for (int i = 1; i < argc; i += 2)
+	{
+		if (i + 1 == argc)
+			return std::nullopt;
+		if (auto it = strings.find(argv[i]); it != strings.end())
+			*it->second = argv[i + 1];
+		else if (auto it = names.find(argv[i]); it != names.end())
+			*it->second = std::stod(argv[i + 1]);
+		else
+			return std::nullopt;
+	}
+
+	if (o.sessions < 1 or o.duration <= 0 or o.eye_width < 16 or o.eye_height < 16 or o.refresh_rate <= 0)
+		return std::nullopt;
+	return o;
+}
+
+// Same clock as the kernel timestamps of the sockets, used as XrTime
+int64_t now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1'000'000'000ll + ts.tv_nsec;
+}
+
+crypto::key load_key(const std::string & path)
+{
+	if (path.empty())
+		return crypto::key::generate_x448_keypair();
+
+	if (std::ifstream file{path})
+	{
+		std::stringstream pem;
+		pem << file.rdbuf();
+		return crypto::key::from_private_key(pem.str());
+	}
+
+	crypto::key key = crypto::key::generate_x448_keypair();
+	std::ofstream{path} << key.private_key();
+	return key;
+}
+
+// CPU time and resident memory of a process
+struct process_usage
+{
+	double cpu = 0; // s
+	double rss = 0; // MiB
+};
+
+std::optional<process_usage> read_usage(int pid)
+{
+	if (pid <= 0)
+		return std::nullopt;
+
+	process_usage usage;
+	std::ifstream stat(std::format("/proc/{}/stat", pid));
+	std::string line;
+	if (not std::getline(stat, line))
+		return std::nullopt;
+
+	// The command name may contain spaces, fields are counted after it
+	std::istringstream fields(line.substr(line.rfind(')') + 2));
+	std::string field;
+	uint64_t utime = 0, stime = 0;
+	for (int i = 3; fields >> field; ++i)
+	{
+		if (i == 14)
+			utime = std::stoull(field);
+		else if (i == 15)
+		{
+			stime = std::stoull(field);
+			break;
+		}
+	}
+	usage.cpu = double(utime + stime) / sysconf(_SC_CLK_TCK);
+
+	std::ifstream status(std::format("/proc/{}/status", pid));
+	while (std::getline(status, line))
+	{
+		if (line.starts_with("VmRSS:"))
+			usage.rss = std::stod(line.substr(6)) / 1024;
+	}
+	return usage;
+}
+
+struct percentiles
+{
+	double p50 = 0;
+	double p90 = 0;
+	double p99 = 0;
+	double max = 0;
+};
+
+percentiles compute(std::vector<int64_t> values)
+{
+	if (values.empty())
+		return {};
+	std::ranges::sort(values);
+	auto at = [&](double p) { return values[std::min<size_t>(values.size() - 1, values.size() * p)] * 1e-6; };
+	return {
+	        .p50 = at(0.5),
+	        .p90 = at(0.9),
+	        .p99 = at(0.99),
+	        .max = values.back() * 1e-6,
+	};
+}
+
+struct latencies
+{
+	std::vector<int64_t> encode;  // encode begin to end
+	std::vector<int64_t> send;    // send begin to end
+	std::vector<int64_t> network; // send end to last shard received
+	std::vector<int64_t> total;   // encode begin to last shard received
+	std::vector<int64_t> app_list;
+
+	void append(const latencies & other)
+	{
+		encode.insert(encode.end(), other.encode.begin(), other.encode.end());
+		send.insert(send.end(), other.send.begin(), other.send.end());
+		network.insert(network.end(), other.network.begin(), other.network.end());
+		total.insert(total.end(), other.total.begin(), other.total.end());
+		app_list.insert(app_list.end(), other.app_list.begin(), other.app_list.end());
+	}
+};
+
+struct session_result
+{
+	int64_t handshake = 0;                  // ns
+	std::optional<int64_t> first_frame;     // ns after the handshake
+	std::array<uint64_t, stream_count> complete{};
+	std::array<uint64_t, stream_count> lost{};
+	uint64_t late_shards = 0;
+	uint64_t video_bytes = 0;
+	uint64_t packets_sent = 0;
+	uint64_t packets_received = 0;
+	uint64_t timesync_queries = 0;
+	double duration = 0; // s
+	latencies latency;
+	std::optional<process_usage> server_begin;
+	std::optional<process_usage> server_end;
+};
+
+// Shards of the frame being received on a stream, like the client shard_accumulator
+struct frame_assembly
+{
+	std::optional<uint64_t> frame_index;
+	std::optional<uint64_t> done; // last frame that was completed or reported lost
+	std::vector<bool> received;
+	size_t count = 0;
+	std::optional<uint16_t> last_shard;
+	from_headset::feedback feedback;
+	XrTime display_time = 0;
+
+	void reset(uint8_t stream_index, uint64_t index)
+	{
+		frame_index = index;
+		received.clear();
+		count = 0;
+		last_shard.reset();
+		feedback = {
+		        .frame_index = index,
+		        .stream_index = stream_index,
+		};
+		display_time = 0;
+	}
+};
+
+class periodic
+{
+	int64_t period = 0;
+	int64_t next_ = 0;
+
+public:
+	periodic(double rate, int64_t start) :
+	        period(rate > 0 ? 1e9 / rate : 0),
+	        next_(start) {}
+
+	bool due(int64_t t)
+	{
+		if (not period or t < next_)
+			return false;
+		next_ += period;
+		// Do not try to catch up after a stall
+		if (next_ < t)
+			next_ = t + period;
+		return true;
+	}
+
+	int64_t next() const
+	{
+		return period ? next_ : std::numeric_limits<int64_t>::max();
+	}
+};
+
+// 90° field of view for both eyes
+const XrFovf fov{
+        .angleLeft = -std::numbers::pi_v<float> / 4,
+        .angleRight = std::numbers::pi_v<float> / 4,
+        .angleUp = std::numbers::pi_v<float> / 4,
+        .angleDown = -std::numbers::pi_v<float> / 4,
+};
+
+XrQuaternionf yaw_pitch(float yaw, float pitch)
+{
+	// yaw around y, then pitch around x
+	float cy = std::cos(yaw / 2), sy = std::sin(yaw / 2);
+	float cp = std::cos(pitch / 2), sp = std::sin(pitch / 2);
+	return {
+	        .x = cy * sp,
+	        .y = sy * cp,
+	        .z = -sy * sp,
+	        .w = cy * cp,
+	};
+}
+
+class fake_headset
+{
+	const options & o;
+	crypto::key & keypair;
+	// Connection time, then start of the session after the handshake
+	int64_t start = now();
+	control_socket_t control;
+	stream_socket_t stream{-1};
+	int64_t receive_time = 0;
+
+	std::array<frame_assembly, stream_count> frames;
+	feedback_batch_sender feedback_sender;
+	std::optional<int64_t> app_list_request;
+	std::vector<XrDuration> predictions{0};
+
+	session_result result;
+
+	template <typename T>
+	void send_control(T && packet)
+	{
+		control.send(std::forward<T>(packet));
+		++result.packets_sent;
+	}
+
+	template <typename T>
+	void send_stream(T && packet)
+	{
+		if (stream)
+			stream.send(std::forward<T>(packet));
+		else
+			control.send(std::forward<T>(packet));
+		++result.packets_sent;
+	}
+
+	to_headset::packets receive_control(std::chrono::seconds timeout)
+	{
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (std::chrono::steady_clock::now() < deadline)
+		{
+			pollfd fds{.fd = control.get_fd(), .events = POLLIN};
+			if (::poll(&fds, 1, 100) < 0)
+				throw std::system_error(errno, std::system_category());
+			if (fds.revents & (POLLHUP | POLLERR))
+				throw std::runtime_error("Connection closed by the server");
+			if (fds.revents & POLLIN)
+			{
+				if (auto packet = control.receive())
+					return std::move(*packet);
+			}
+		}
+		throw std::runtime_error("Timeout");
+	}
+
+	template <typename T>
+	void handshake(T address)
+	{
+		control.send(from_headset::crypto_handshake{
+		        .protocol_version = wivrn::protocol_version,
+		        .public_key = keypair.public_key(),
+		        .name = "WiVRn fake headset",
+		});
+
+		using crypto_state = to_headset::crypto_handshake::crypto_state;
+		auto crypto_handshake = std::get<to_headset::crypto_handshake>(receive_control(std::chrono::seconds(10)));
+
+		std::optional<secrets> keys;
+		std::string pin = "000000";
+		switch (crypto_handshake.state)
+		{
+			case crypto_state::encryption_disabled:
+				break;
+
+			case crypto_state::pin_needed: {
+				if (o.pin.empty())
+					throw std::runtime_error("The server needs a PIN, use --pin or start the server with --no-encrypt");
+				pin = o.pin;
+
+				crypto::smp pin_check;
+				control.send(from_headset::pin_check_1{pin_check.step1(pin)});
+				auto msg2 = std::get<to_headset::pin_check_2>(receive_control(std::chrono::seconds(10))).message;
+				control.send(from_headset::pin_check_3{pin_check.step3(msg2)});
+				auto msg4 = std::get<to_headset::pin_check_4>(receive_control(std::chrono::seconds(10))).message;
+				if (not pin_check.step5(msg4))
+					throw std::runtime_error("Incorrect PIN");
+			}
+				[[fallthrough]];
+
+			case crypto_state::client_already_paired: {
+				crypto::key server_key = crypto::key::from_public_key(crypto_handshake.public_key);
+				keys.emplace(keypair, server_key, pin);
+				control.set_aes_key_and_ivs(keys->control_key, keys->control_iv_to_headset, keys->control_iv_from_headset);
+				break;
+			}
+
+			case crypto_state::pairing_disabled:
+				throw std::runtime_error("Pairing is disabled on server");
+
+			case crypto_state::incompatible_version:
+				throw std::runtime_error("Incompatible server version");
+
+			case crypto_state::resumed:
+				throw std::runtime_error("Invalid handshake");
+		}
+
+		// Confirm that encryption is set up
+		control.send(from_headset::crypto_handshake{});
+
+		auto h = std::get<to_headset::handshake>(receive_control(std::chrono::seconds(10)));
+		if (h.stream_port > 0 and not o.tcp_only)
+		{
+			stream = stream_socket_t();
+			if (keys)
+				stream.set_aes_key_and_ivs(keys->stream_key, keys->stream_iv_header_to_headset, keys->stream_iv_header_from_headset);
+			stream.connect(address, h.stream_port);
+			stream.set_receive_buffer_size(1024 * 1024 * 5);
+		}
+
+		// The handshake on the stream socket may be lost, send it until the server answers
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (true)
+		{
+			if (stream)
+				stream.send(from_headset::handshake{});
+			else
+				control.send(from_headset::handshake{});
+
+			bool done = false;
+			poll([&](auto && packet) {
+				done |= std::is_same_v<std::remove_cvref_t<decltype(packet)>, to_headset::handshake>;
+			},
+			     100);
+			if (done)
+				return;
+
+			if (std::chrono::steady_clock::now() >= deadline)
+				throw std::runtime_error("Timeout");
+		}
+	}
+
+	template <typename F>
+	void poll(F && visitor, int timeout_ms)
+	{
+		pollfd fds[2] = {
+		        {.fd = stream.get_fd(), .events = POLLIN},
+		        {.fd = control.get_fd(), .events = POLLIN},
+		};
+
+		while (auto packet = stream.receive_pending())
+		{
+			receive_time = stream.receive_time();
+			std::visit(visitor, std::move(*packet));
+		}
+		while (auto packet = control.receive_pending())
+		{
+			receive_time = control.receive_time();
+			std::visit(visitor, std::move(*packet));
+		}
+
+		if (::poll(fds, std::size(fds), timeout_ms) < 0)
+			throw std::system_error(errno, std::system_category());
+
+		if ((fds[0].revents | fds[1].revents) & (POLLHUP | POLLERR))
+			throw std::runtime_error("Connection closed by the server");
+
+		if (fds[0].revents & POLLIN)
+		{
+			if (auto packet = stream.receive())
+			{
+				receive_time = stream.receive_time();
+				std::visit(visitor, std::move(*packet));
+			}
+		}
+
+		if (fds[1].revents & POLLIN)
+		{
+			if (auto packet = control.receive())
+			{
+				receive_time = control.receive_time();
+				std::visit(visitor, std::move(*packet));
+			}
+		}
+	}
+
+	from_headset::headset_info_packet headset_info() const
+	{
+		return {
+		        .render_eye_width = uint16_t(o.eye_width),
+		        .render_eye_height = uint16_t(o.eye_height),
+		        .stream_eye_width = uint16_t(o.eye_width),
+		        .stream_eye_height = uint16_t(o.eye_height),
+		        .available_refresh_rates = {float(o.refresh_rate)},
+		        .settings = {
+		                .preferred_refresh_rate = float(o.refresh_rate),
+		                .minimum_refresh_rate = float(o.refresh_rate),
+		                .bitrate_bps = uint32_t(o.bitrate * 1'000'000),
+		                .enabled_body_parts = 0,
+		        },
+		        .fov = {fov, fov},
+		        .hand_tracking = o.hand_rate > 0,
+		        .eye_gaze = false,
+		        .palm_pose = false,
+		        .user_presence = false,
+		        .passthrough = false,
+		        .composition_layer_depth = false,
+		        .face_tracking = o.face ? from_headset::face_type::fb2 : from_headset::face_type::none,
+		        .body_tracking = o.body_rate > 0 ? from_headset::body_type::fb : from_headset::body_type::none,
+		        .num_generic_trackers = 0,
+		        .supported_codecs = {h264, h265, av1, raw},
+		        .bit_depth = 8,
+		        .system_name = "WiVRn fake headset",
+		        .language = "en",
+		        .country = "US",
+		        .variant = "",
+		};
+	}
+
+	// Scripted motion: looking around slowly while moving the head a little
+	XrPosef head_pose(XrTime t) const
+	{
+		float s = (t - start) * 1e-9;
+		return {
+		        .orientation = yaw_pitch(0.6 * std::sin(0.5 * s), 0.2 * std::sin(0.31 * s)),
+		        .position = {0.05f * std::sin(0.7f * s), 1.6f + 0.02f * std::sin(1.1f * s), 0.03f * std::cos(0.7f * s)},
+		};
+	}
+
+	XrPosef hand_pose(XrTime t, bool left) const
+	{
+		float s = (t - start) * 1e-9;
+		float side = left ? -1 : 1;
+		return {
+		        .orientation = yaw_pitch(0.4 * std::sin(0.9 * s + side), 0.3 * std::sin(0.6 * s)),
+		        .position = {side * 0.2f + 0.05f * std::sin(1.3f * s), 1.2f + 0.1f * std::sin(0.8f * s + side), -0.3f},
+		};
+	}
+
+	void send_tracking(XrTime t)
+	{
+		const uint8_t flags = tracked | pose_flags::linear_velocity_valid | pose_flags::angular_velocity_valid;
+
+		// One packet per prediction requested by the server, like the client
+		for (XrDuration prediction: predictions)
+		{
+			XrTime at = t + prediction;
+			from_headset::tracking tracking{
+			        .interaction_profiles = {interaction_profile::oculus_touch_controller, interaction_profile::oculus_touch_controller, interaction_profile::none},
+			        .production_timestamp = t,
+			        .timestamp = at,
+			        .view_flags = XR_VIEW_STATE_ORIENTATION_VALID_BIT | XR_VIEW_STATE_POSITION_VALID_BIT |
+			                      XR_VIEW_STATE_ORIENTATION_TRACKED_BIT | XR_VIEW_STATE_POSITION_TRACKED_BIT,
+			        .state_flags = 0,
+			};
+
+			for (int eye = 0; eye < 2; ++eye)
+				tracking.views[eye] = {
+				        .pose = {.orientation = {0, 0, 0, 1}, .position = {eye ? 0.032f : -0.032f, 0, 0}},
+				        .fov = fov,
+				};
+
+			auto add = [&](device_id device, XrPosef pose) {
+				tracking.device_poses.push_back({
+				        .pose = pose,
+				        .linear_velocity = {},
+				        .angular_velocity = {},
+				        .device = device,
+				        .flags = flags,
+				});
+			};
+			add(device_id::HEAD, head_pose(at));
+			add(device_id::LEFT_GRIP, hand_pose(at, true));
+			add(device_id::LEFT_AIM, hand_pose(at, true));
+			add(device_id::RIGHT_GRIP, hand_pose(at, false));
+			add(device_id::RIGHT_AIM, hand_pose(at, false));
+
+			if (o.face)
+			{
+				from_headset::tracking::fb_face2 face{
+				        .time = at,
+				        .is_valid = true,
+				        .is_eye_following_blendshapes_valid = true,
+				};
+				float s = (at - start) * 1e-9;
+				for (size_t i = 0; i < face.weights.size(); ++i)
+					face.weights[i] = 0.5 + 0.5 * std::sin(s + i);
+				face.confidences.fill(1);
+				tracking.face = face;
+			}
+
+			send_stream(std::move(tracking));
+		}
+	}
+
+	void send_hands(XrTime t)
+	{
+		for (auto hand: {from_headset::hand_tracking::left, from_headset::hand_tracking::right})
+		{
+			XrPosef wrist = hand_pose(t, hand == from_headset::hand_tracking::left);
+			from_headset::hand_tracking packet{
+			        .production_timestamp = t,
+			        .timestamp = t,
+			        .hand = hand,
+			};
+			auto & joints = packet.joints.emplace();
+			for (size_t i = 0; i < joints.size(); ++i)
+			{
+				joints[i] = {
+				        .position = {wrist.position.x, wrist.position.y, wrist.position.z - 0.01f * i},
+				        .orientation = packed_quaternion::from_quaternion(wrist.orientation),
+				        .linear_velocity = {},
+				        .angular_velocity = {},
+				        .radius = 100,
+				        .flags = tracked,
+				};
+			}
+			send_stream(std::move(packet));
+		}
+	}
+
+	void send_body(XrTime t)
+	{
+		XrPosef head = head_pose(t);
+		from_headset::meta_body::fb_joints joints{
+		        .root = {
+		                .position = {head.position.x, head.position.y - 0.6f, head.position.z},
+		                .orientation = packed_quaternion::from_quaternion(head.orientation),
+		                .flags = tracked,
+		        },
+		};
+		for (size_t i = 0; i < joints.joints.size(); ++i)
+		{
+			joints.joints[i] = {
+			        .position = {0, int16_t(100 * i), 0},
+			        .orientation = packed_quaternion::from_quaternion({0, 0, 0, 1}),
+			        .flags = tracked,
+			};
+		}
+		send_stream(from_headset::meta_body{
+		        .production_timestamp = t,
+		        .timestamp = t,
+		        .confidence = 1,
+		        .joints = joints,
+		});
+	}
+
+	void send_inputs(XrTime t)
+	{
+		float s = (t - start) * 1e-9;
+		from_headset::inputs inputs;
+		auto add = [&](device_id id, float value) {
+			inputs.values.push_back({.id = id, .value = value, .last_change_time = t});
+		};
+		add(device_id::LEFT_TRIGGER_VALUE, 0.5 + 0.5 * std::sin(2 * s));
+		add(device_id::RIGHT_TRIGGER_VALUE, 0.5 + 0.5 * std::cos(2 * s));
+		add(device_id::LEFT_SQUEEZE_VALUE, 0.5 + 0.5 * std::sin(s));
+		add(device_id::RIGHT_SQUEEZE_VALUE, 0.5 + 0.5 * std::cos(s));
+		add(device_id::LEFT_THUMBSTICK_X, std::sin(s));
+		add(device_id::LEFT_THUMBSTICK_Y, std::cos(s));
+		add(device_id::RIGHT_THUMBSTICK_X, std::cos(s));
+		add(device_id::RIGHT_THUMBSTICK_Y, std::sin(s));
+		add(device_id::A_CLICK, std::fmod(s, 2) < 1);
+		add(device_id::X_CLICK, std::fmod(s + 1, 2) < 1);
+		send_stream(std::move(inputs));
+	}
+
+	void on_shard(data_shard && shard)
+	{
+		uint8_t idx = shard.stream_item_idx;
+		if (idx >= stream_count)
+			return;
+		auto & frame = frames[idx];
+
+		if (frame.done and shard.frame_idx <= *frame.done)
+		{
+			++result.late_shards;
+			return;
+		}
+
+		if (not frame.frame_index or shard.frame_idx > *frame.frame_index)
+		{
+			// The previous frame cannot be completed, report it as the client does
+			if (frame.frame_index)
+			{
+				send_control(from_headset::feedback{frame.feedback});
+				++result.lost[idx];
+				frame.done = frame.frame_index;
+			}
+			frame.reset(idx, shard.frame_idx);
+			frame.feedback.received_first_packet = receive_time;
+		}
+		else if (shard.frame_idx < *frame.frame_index)
+		{
+			++result.late_shards;
+			return;
+		}
+
+		if (shard.shard_idx >= frame.received.size())
+			frame.received.resize(shard.shard_idx + 1);
+		if (frame.received[shard.shard_idx])
+			return;
+		frame.received[shard.shard_idx] = true;
+		++frame.count;
+		result.video_bytes += shard.payload.size();
+
+		if (shard.view_info)
+			frame.display_time = shard.view_info->display_time;
+		if (shard.timing_info)
+		{
+			frame.last_shard = shard.shard_idx;
+			frame.feedback.encode_begin = shard.timing_info->encode_begin;
+			frame.feedback.encode_end = shard.timing_info->encode_end;
+			frame.feedback.send_begin = shard.timing_info->send_begin;
+			frame.feedback.send_end = shard.timing_info->send_end;
+		}
+
+		if (not frame.last_shard or frame.count != *frame.last_shard + 1u)
+			return;
+
+		// Complete: the frame is considered decoded and displayed when it was meant to be
+		auto & f = frame.feedback;
+		f.received_last_packet = receive_time;
+		f.sent_to_decoder = receive_time;
+		f.received_from_decoder = receive_time;
+		f.blitted = receive_time;
+		f.displayed = std::max(frame.display_time, receive_time);
+		f.times_displayed = 1;
+		// The client batches the streams displayed in a frame, each stream is a frame here
+		send_stream(feedback_sender.push(std::span(&f, 1)));
+
+		result.latency.encode.push_back(f.encode_end - f.encode_begin);
+		result.latency.send.push_back(f.send_end - f.send_begin);
+		result.latency.network.push_back(f.received_last_packet - f.send_end);
+		result.latency.total.push_back(f.received_last_packet - f.encode_begin);
+		if (not result.first_frame)
+			result.first_frame = receive_time - start;
+		++result.complete[idx];
+		frame.done = frame.frame_index;
+		frame.frame_index.reset();
+	}
+
+	void on_packet(to_headset::packets && packet)
+	{
+		++result.packets_received;
+		std::visit(utils::overloaded{
+		                   [&](data_shard && shard) { on_shard(std::move(shard)); },
+		                   [&](const to_headset::timesync_query & query) {
+			                   ++result.timesync_queries;
+			                   send_stream(from_headset::timesync_response{
+			                           .query = query.query,
+			                           .response = (receive_time + now()) / 2,
+			                   });
+		                   },
+		                   [&](const to_headset::tracking_control & control) {
+			                   predictions.clear();
+			                   for (const auto & sample: control.pattern)
+				                   if (sample.device == device_id::HEAD)
+					                   predictions.push_back(sample.prediction_ns);
+			                   if (predictions.empty())
+				                   predictions.push_back(0);
+		                   },
+		                   [&](const to_headset::application_list &) {
+			                   if (app_list_request)
+				                   result.latency.app_list.push_back(receive_time - *app_list_request);
+			                   app_list_request.reset();
+		                   },
+		                   [](const auto &) {},
+		           },
+		           std::move(packet));
+	}
+
+public:
+	template <typename T>
+	fake_headset(const options & o, crypto::key & keypair, T address) :
+	        o(o), keypair(keypair), control(address, int(o.port))
+	{
+		handshake(address);
+		result.handshake = now() - start;
+	}
+
+	session_result run()
+	{
+		start = now();
+		result.server_begin = read_usage(o.server_pid);
+
+		send_control(headset_info());
+		send_control(from_headset::session_state_changed{.state = XR_SESSION_STATE_VISIBLE});
+		send_control(from_headset::session_state_changed{.state = XR_SESSION_STATE_FOCUSED});
+
+		periodic tracking(o.tracking_rate, start);
+		periodic hands(o.hand_rate, start);
+		periodic body(o.body_rate, start);
+		periodic inputs(o.input_rate, start);
+		periodic app_list(o.app_list_interval > 0 ? 1 / o.app_list_interval : 0, start);
+
+		const int64_t end = start + o.duration * 1e9;
+		for (int64_t t = start; t < end; t = now())
+		{
+			int64_t next = std::min({end, tracking.next(), hands.next(), body.next(), inputs.next(), app_list.next()});
+			poll([&](auto && packet) { on_packet(std::move(packet)); }, std::clamp<int64_t>((next - t) / 1'000'000, 0, 100));
+
+			t = now();
+			if (tracking.due(t))
+				send_tracking(t);
+			if (hands.due(t))
+				send_hands(t);
+			if (body.due(t))
+				send_body(t);
+			if (inputs.due(t))
+				send_inputs(t);
+			if (app_list.due(t))
+			{
+				app_list_request = t;
+				send_control(from_headset::get_application_list{.language = "en", .country = "US", .variant = ""});
+			}
+		}
+
+		result.duration = (now() - start) * 1e-9;
+		result.server_end = read_usage(o.server_pid);
+		return std::move(result);
+	}
+};
+
+session_result run_session(const options & o, crypto::key & keypair)
+{
+	in_addr address4;
+	in6_addr address6;
+	if (inet_pton(AF_INET, o.address.c_str(), &address4) == 1)
+		return fake_headset(o, keypair, address4).run();
+	if (inet_pton(AF_INET6, o.address.c_str(), &address6) == 1)
+		return fake_headset(o, keypair, address6).run();
+	throw std::runtime_error("Invalid address " + o.address);
+}
+
+void print_latency(const char * name, const std::vector<int64_t> & values)
+{
+	auto p = compute(values);
+	std::cout << std::format("{:<20} {:>8} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f}\n", name, values.size(), p.p50, p.p90, p.p99, p.max);
+}
+} // namespace
+
+int main(int argc, char ** argv)
+{
+	auto o = parse(argc, argv);
+	if (not o)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	int result = 0;
+	try
+	{
+		crypto::key keypair = load_key(o->key);
+
+		latencies all;
+		std::array<uint64_t, stream_count> complete{};
+		std::array<uint64_t, stream_count> lost{};
+		uint64_t bytes = 0;
+		uint64_t packets_sent = 0;
+		uint64_t packets_received = 0;
+		double duration = 0;
+		size_t failed = 0;
+		std::optional<process_usage> server_first;
+		std::optional<process_usage> server_last;
+		double server_cpu = 0;
+
+		for (int i = 0; i < o->sessions; ++i)
+		{
+			if (i > 0)
+				std::this_thread::sleep_for(std::chrono::duration<double>(o->pause));
+
+			session_result r;
+			try
+			{
+				r = run_session(*o, keypair);
+			}
+			catch (std::exception & e)
+			{
+				std::cerr << std::format("session {}: {}", i + 1, e.what()) << std::endl;
+				++failed;
+				continue;
+			}
+
+			std::string line = std::format("session {}: handshake {:.1f} ms, first frame {}, frames {}/{}/{} complete, {}/{}/{} lost, {:.1f} Mbit/s, {} packets sent, {} received",
+			                               i + 1,
+			                               r.handshake * 1e-6,
+			                               r.first_frame ? std::format("{:.1f} ms", *r.first_frame * 1e-6) : "never",
+			                               r.complete[0],
+			                               r.complete[1],
+			                               r.complete[2],
+			                               r.lost[0],
+			                               r.lost[1],
+			                               r.lost[2],
+			                               r.video_bytes * 8e-6 / r.duration,
+			                               r.packets_sent,
+			                               r.packets_received);
+			if (r.server_begin and r.server_end)
+			{
+				double cpu = r.server_end->cpu - r.server_begin->cpu;
+				server_cpu += cpu;
+				line += std::format(", server CPU {:.1f} %, RSS {:.1f} MiB", 100 * cpu / r.duration, r.server_end->rss);
+				if (not server_first)
+					server_first = r.server_begin;
+				server_last = r.server_end;
+			}
+			std::cout << line << std::endl;
+
+			if (o->min_frames >= 0 and r.complete[0] < o->min_frames)
+			{
+				std::cerr << std::format("session {}: {} frames received, below {}", i + 1, r.complete[0], o->min_frames) << std::endl;
+				result = 1;
+			}
+
+			all.append(r.latency);
+			for (size_t j = 0; j < stream_count; ++j)
+			{
+				complete[j] += r.complete[j];
+				lost[j] += r.lost[j];
+			}
+			bytes += r.video_bytes;
+			packets_sent += r.packets_sent;
+			packets_received += r.packets_received;
+			duration += r.duration;
+		}
+
+		std::cout << std::format("\n{} sessions, {} failed, {:.1f} s connected\n", o->sessions, failed, duration);
+		if (duration > 0)
+			std::cout << std::format("{:.1f} Mbit/s of video, {:.0f} packets/s sent, {:.0f} packets/s received\n",
+			                         bytes * 8e-6 / duration,
+			                         packets_sent / duration,
+			                         packets_received / duration);
+		for (size_t j = 0; j < stream_count; ++j)
+			std::cout << std::format("stream {}: {} frames complete, {} lost\n", j, complete[j], lost[j]);
+
+		std::cout << std::format("\n{:<20} {:>8} {:>8} {:>8} {:>8} {:>8}\n", "ms", "count", "p50", "p90", "p99", "max");
+		print_latency("encode", all.encode);
+		print_latency("send", all.send);
+		print_latency("network", all.network);
+		print_latency("total", all.total);
+		print_latency("application list", all.app_list);
+
+		if (server_first and server_last)
+		{
+			double growth = server_last->rss - server_first->rss;
+			std::cout << std::format("\nserver: {:.1f} % CPU while connected, RSS {:.1f} MiB to {:.1f} MiB ({:+.1f} MiB)\n",
+			                         duration > 0 ? 100 * server_cpu / duration : 0.,
+			                         server_first->rss,
+			                         server_last->rss,
+			                         growth);
+			if (o->max_rss_growth >= 0 and growth > o->max_rss_growth)
+			{
+				std::cerr << std::format("Server memory grew by {:.1f} MiB, above {:.1f} MiB", growth, o->max_rss_growth) << std::endl;
+				result = 1;
+			}
+		}
+
+		if (failed)
+			result = 1;
+		if (o->max_p99 >= 0 and compute(all.total).p99 > o->max_p99)
+		{
+			std::cerr << std::format("Latency p99 {:.3f} ms above {:.3f} ms", compute(all.total).p99, o->max_p99) << std::endl;
+			result = 1;
+		}
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return result;
+}
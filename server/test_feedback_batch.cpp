@@ -0,0 +1,287 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Checks the feedback batches sent by the headset for each displayed frame.
+//
+// Feedback for 3 streams at 90 Hz is generated like the render loop of the client does, with
+// streams that are sometimes a frame behind, frames displayed twice and missing timestamps. It is
+// sent through feedback_batch_sender, over loopback UDP with 10% of the packets dropped, and
+// through feedback_batch_receiver, as in wivrn_session. The feedback given to the pacer must be
+// identical to the one sent, except for frames missing from all received packets.
+//
+// The serialized size is compared to the previous transport: one feedback packet per stream on
+// the control socket.
+//
+// Usage: wivrn-feedback-batch-test
+// Exits with 1 if a check failed.
+
+#include "feedback_batch.h"
+#include "wivrn_packets.h"
+#include "wivrn_serialization.h"
+#include "wivrn_sockets.h"
+
+#include <array>
+#include <boost/pfr.hpp>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+using namespace wivrn;
+using server_socket = typed_socket<UDP, from_headset::packets, to_headset::packets>;
+using headset_socket = typed_socket<UDP, to_headset::packets, from_headset::packets>;
+
+constexpr int stream_count = 3;
+constexpr int frame_count = 20'000;
+constexpr XrDuration frame_duration = 11'111'111;
+constexpr double loss = 0.1;
+// Frames missing from 4 packets in a row: 0.1^4 of the frames
+constexpr double max_unrecovered = 0.001;
+
+// Feedback of the streams displayed in each headset frame
+std::vector<std::vector<from_headset::feedback>> generate()
+{
+	std::mt19937 rng{42};
+	std::uniform_int_distribution<XrDuration> jitter(0, 2'000'000);
+	std::bernoulli_distribution late(0.05);
+	std::bernoulli_distribution missing(0.01);
+
+	std::vector<std::vector<from_headset::feedback>> frames;
+	std::array<from_headset::feedback, stream_count> shown{};
+	XrTime t = 1'000'000'000'000;
+	for (uint64_t frame = 0; frame < frame_count; ++frame, t += frame_duration)
+	{
+		auto & streams = frames.emplace_back();
+		for (uint8_t stream = 0; stream < stream_count; ++stream)
+		{
+			auto & f = shown[stream];
+			// A late stream displays its previous frame again
+			if (frame == 0 or not late(rng))
+			{
+				XrTime received = t - 8'000'000 - jitter(rng);
+				f = {
+				        .frame_index = frame,
+				        .stream_index = stream,
+				        .encode_begin = received - 9'000'000 - jitter(rng),
+				        .encode_end = received - 5'000'000,
+				        .send_begin = received - 5'000'000 + jitter(rng) / 10,
+				        .send_end = received - 3'000'000,
+				        .received_first_packet = received - 1'000'000 - jitter(rng),
+				        .received_last_packet = received,
+				        .sent_to_decoder = received + 100'000,
+				        .received_from_decoder = received + 4'000'000 + jitter(rng),
+				};
+				// Frames without timing information
+				if (missing(rng))
+					f.encode_begin = f.encode_end = f.send_begin = f.send_end = 0;
+			}
+			f.blitted = t + stream * 20'000;
+			f.displayed = t + 22'000'000;
+			++f.times_displayed;
+			streams.push_back(f);
+		}
+	}
+	return frames;
+}
+
+uint16_t bind_loopback(UDP & socket)
+{
+	sockaddr_in6 address{};
+	address.sin6_family = AF_INET6;
+	address.sin6_addr = in6addr_loopback;
+	socket.bind(address);
+	socklen_t size = sizeof(address);
+	if (getsockname(socket, (sockaddr *)&address, &size) < 0)
+		throw std::system_error(errno, std::system_category());
+	return ntohs(address.sin6_port);
+}
+
+} // namespace
+
+int main()
+{
+	const auto frames = generate();
+	bool ok = true;
+
+	// Serialized size, including the variant index
+	{
+		size_t per_stream = 0;
+		size_t batched = 0;
+		feedback_batch_sender sender;
+		for (const auto & frame: frames)
+		{
+			for (const auto & f: frame)
+				per_stream += 1 + serialized_size(f);
+			batched += 1 + serialized_size(sender.push(frame));
+		}
+
+		size_t single = 0;
+		for (const auto & frame: frames)
+			single += 1 + serialized_size(from_headset::feedback_batch{.frames = {pack_feedback(0, frame)}});
+
+		std::cout << std::format("{:<32} {:>12} {:>12}\n", "transport", "packets/frame", "bytes/frame");
+		std::cout << std::format("{:<32} {:>12} {:>12.1f}\n", "feedback per stream (control)", stream_count, double(per_stream) / frames.size());
+		std::cout << std::format("{:<32} {:>12} {:>12.1f}\n", "batch, 1 frame", 1, double(single) / frames.size());
+		std::cout << std::format("{:<32} {:>12} {:>12.1f}\n", std::format("batch, {} frames (stream)", from_headset::feedback_batch::history), 1, double(batched) / frames.size());
+	}
+
+	// Delivery under loss
+	{
+		server_socket server;
+		headset_socket headset;
+		server.set_receive_buffer_size(1024 * 1024);
+		headset.connect(in6addr_loopback, bind_loopback(server));
+
+		std::mt19937 rng{1234};
+		std::bernoulli_distribution drop(loss);
+		feedback_batch_sender sender;
+		feedback_batch_receiver receiver;
+
+		// Feedback given to the pacer, by headset frame
+		std::vector<std::vector<from_headset::feedback>> delivered(frames.size());
+		size_t sent = 0;
+		size_t duplicates = 0;
+		for (const auto & frame: frames)
+		{
+			auto batch = sender.push(frame);
+			if (drop(rng))
+				continue;
+			headset.send(std::move(batch));
+			++sent;
+
+			auto packet = server.receive();
+			if (not packet)
+				throw std::runtime_error("packet not received on loopback");
+			auto & received = std::get<from_headset::feedback_batch>(*packet);
+			for (const auto & f: receiver(received))
+			{
+				auto & out = delivered[f.sequence];
+				if (not out.empty())
+					++duplicates;
+				for (const auto & stream: f.streams)
+					out.push_back(unpack_feedback(f, stream));
+			}
+
+			// Packets received twice are ignored
+			if (not receiver(received).empty())
+				++duplicates;
+		}
+
+		size_t recovered = 0;
+		size_t unrecovered = 0;
+		size_t mismatches = 0;
+		for (size_t i = 0; i < frames.size(); ++i)
+		{
+			if (delivered[i].empty())
+			{
+				++unrecovered;
+				continue;
+			}
+			++recovered;
+			if (delivered[i].size() != frames[i].size())
+			{
+				++mismatches;
+				continue;
+			}
+			for (size_t j = 0; j < frames[i].size(); ++j)
+			{
+				if (not boost::pfr::eq(delivered[i][j], frames[i][j]))
+					++mismatches;
+			}
+		}
+
+		std::cout << std::format("\n{:.0f}% loss: {} packets sent of {}, {} frames recovered, {} lost, {} mismatches, {} duplicates\n",
+		                         loss * 100,
+		                         sent,
+		                         frames.size(),
+		                         recovered,
+		                         unrecovered,
+		                         mismatches,
+		                         duplicates);
+		std::cout << std::format("Feedback per stream on an unreliable socket: {:.1f}% of the frames lost\n", loss * 100);
+
+		if (mismatches or duplicates)
+		{
+			std::cout << "FAILED: feedback differs from the one sent\n";
+			ok = false;
+		}
+		// Only the last frames can be missing without the receiver seeing a gap
+		if (unrecovered < receiver.lost or unrecovered > receiver.lost + from_headset::feedback_batch::history)
+		{
+			std::cout << std::format("FAILED: {} frames reported lost by the receiver\n", receiver.lost);
+			ok = false;
+		}
+		if (unrecovered > max_unrecovered * frames.size())
+		{
+			std::cout << std::format("FAILED: {} frames lost, max {}\n", unrecovered, max_unrecovered * frames.size());
+			ok = false;
+		}
+	}
+
+	auto check = [&](bool condition, const char * what) {
+		if (not condition)
+		{
+			std::cout << "FAILED: " << what << "\n";
+			ok = false;
+		}
+	};
+
+	// Late packets are ignored, gaps longer than the history are counted
+	{
+		std::vector<from_headset::feedback> frame{{.frame_index = 1, .blitted = 1000}};
+		feedback_batch_sender sender;
+		feedback_batch_receiver receiver;
+		auto first = sender.push(frame);
+		for (size_t i = 0; i < from_headset::feedback_batch::history + 2; ++i)
+			sender.push(frame);
+		auto last = sender.push(frame);
+
+		check(receiver(last).size() == from_headset::feedback_batch::history, "first packet");
+		check(receiver(first).empty(), "late packet");
+		check(receiver(sender.push(frame)).size() == 1, "next packet");
+		for (size_t i = 0; i < from_headset::feedback_batch::history + 1; ++i)
+			sender.push(frame);
+		check(receiver(sender.push(frame)).size() == from_headset::feedback_batch::history, "packet after a gap");
+		check(receiver.lost == 2, "lost frames count");
+	}
+
+	// A headset that reconnects without resuming the session starts again from sequence 0,
+	// wivrn_session resets the receiver
+	{
+		std::vector<from_headset::feedback> frame{{.frame_index = 1, .blitted = 1000}};
+		feedback_batch_sender sender;
+		feedback_batch_receiver receiver;
+		for (size_t i = 0; i < 100; ++i)
+			receiver(sender.push(frame));
+
+		auto packet = feedback_batch_sender{}.push(frame);
+		check(receiver(packet).empty(), "restarted sender without reset");
+		receiver = {};
+		check(receiver(packet).size() == 1, "restarted sender after reset");
+		check(receiver.lost == 0, "lost frames count after reset");
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Compares computing the foveation parameters on every frame with the memoized
+// foveation_table, on a synthetic eye tracking trace made of fixations and saccades.
+//
+// Usage: wivrn-foveation-bench [duration in seconds]
+
+#include "compositor/foveation_table.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+constexpr float frame_rate = 90;
+constexpr uint16_t source_width = 2064;
+constexpr uint16_t source_height = 2208;
+constexpr uint16_t foveated_width = 1400;
+constexpr uint16_t foveated_height = 1500;
+const float half_fov = 50 * M_PI / 180;
+
+struct gaze_sample
+{
+	float yaw;
+	float pitch;
+};
+
+float to_rad(float degrees)
+{
+	return degrees * M_PI / 180;
+}
+
+// Fixations of 150 to 400ms with tracker noise, separated by saccades of 2 to 30°
+std::vector<gaze_sample> saccade_trace(float duration)
+{
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> fixation_duration(0.15, 0.4);
+	std::uniform_real_distribution<float> target(to_rad(-20), to_rad(20));
+	std::normal_distribution<float> noise(0, to_rad(0.1));
+
+	std::vector<gaze_sample> trace;
+	gaze_sample current{};
+	const float dt = 1 / frame_rate;
+	float t = 0;
+	while (t < duration)
+	{
+		float end = t + fixation_duration(rng);
+		for (; t < end; t += dt)
+			trace.push_back({current.yaw + noise(rng), current.pitch + noise(rng)});
+
+		gaze_sample next{target(rng), target(rng)};
+		float amplitude = std::hypot(next.yaw - current.yaw, next.pitch - current.pitch) * 180 / M_PI;
+		// Main sequence: about 2.2ms per degree plus 21ms
+		float saccade_duration = 0.021 + 0.0022 * amplitude;
+		float start = t;
+		for (; t < start + saccade_duration; t += dt)
+		{
+			float k = (t - start) / saccade_duration;
+			trace.push_back({std::lerp(current.yaw, next.yaw, k), std::lerp(current.pitch, next.pitch, k)});
+		}
+		current = next;
+	}
+	return trace;
+}
+
+float to_center(float angle)
+{
+	return std::tan(angle) / std::tan(half_fov);
+}
+
+size_t bytes(const std::vector<uint16_t> & v)
+{
+	return sizeof(uint16_t) * (v.size() + 1);
+}
+} // namespace
+
+int main(int argc, char ** argv)
+{
+	float duration = argc > 1 ? std::atof(argv[1]) : 60;
+	auto trace = saccade_trace(duration);
+
+	using clock = std::chrono::steady_clock;
+
+	// Previous behaviour: parameters computed on every frame and sent with it
+	size_t direct_bytes = 0;
+	auto t0 = clock::now();
+	for (const auto & gaze: trace)
+	{
+		for (int view = 0; view < 2; ++view)
+		{
+			auto x = wivrn::foveation_table::compute_axis(to_center(gaze.yaw), foveated_width, source_width);
+			auto y = wivrn::foveation_table::compute_axis(to_center(gaze.pitch), foveated_height, source_height);
+			direct_bytes += bytes(x) + bytes(y);
+		}
+	}
+	auto t1 = clock::now();
+
+	wivrn::foveation_table table;
+	size_t table_bytes = 0;
+	size_t sets = 0;
+	for (const auto & gaze: trace)
+	{
+		for (int view = 0; view < 2; ++view)
+		{
+			table.get({to_center(gaze.yaw), foveated_width, source_width},
+			          {to_center(gaze.pitch), foveated_height, source_height});
+			table_bytes += sizeof(uint32_t);
+		}
+		for (const auto & set: table.take_new_sets())
+		{
+			++sets;
+			table_bytes += sizeof(set.id) + bytes(set.parameter.x) + bytes(set.parameter.y);
+		}
+	}
+	auto t2 = clock::now();
+
+	auto per_frame = [&](auto d) {
+		return std::chrono::duration<double, std::micro>(d).count() / trace.size();
+	};
+
+	std::cout << std::format("{} frames at {} Hz, {}x{} foveated to {}x{}\n\n",
+	                         trace.size(),
+	                         frame_rate,
+	                         source_width,
+	                         source_height,
+	                         foveated_width,
+	                         foveated_height);
+	std::cout << std::format("{:<10} {:>12} {:>16} {:>10}\n", "", "µs/frame", "bytes/frame", "sets");
+	std::cout << std::format("{:<10} {:>12.3f} {:>16.1f} {:>10}\n", "direct", per_frame(t1 - t0), double(direct_bytes) / trace.size(), trace.size() * 2);
+	std::cout << std::format("{:<10} {:>12.3f} {:>16.1f} {:>10}\n", "table", per_frame(t2 - t1), double(table_bytes) / trace.size(), sets);
+}
@@ -0,0 +1,225 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Simulates a headset decoder that cannot always keep up with the stream.
+//
+// The server decides between I and P frames with default_idr_handler, the headset queues
+// complete frames like the client shard_accumulator and decides which ones to drop with
+// frame_drop_policy. Decoding an IDR frame takes several frame periods: a late decoder must
+// not drop frames, or each IDR frame makes it late again and requests another one.
+//
+// The simulation runs on a virtual clock, it is deterministic.
+//
+// Usage: wivrn-idr-storm-test
+// Exits with 1 if a scenario requested too many IDR frames or decoded a broken frame.
+
+#include "encoder/idr_handler.h"
+#include "frame_drop_policy.h"
+#include "utils/ring_buffer.h"
+#include "wivrn_packets.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <string>
+
+namespace
+{
+using namespace wivrn;
+
+// µs
+constexpr int64_t period = 11'111;
+constexpr int64_t feedback_delay = 5'000;
+
+struct scenario
+{
+	std::string name;
+	int64_t p_cost;
+	int64_t idr_cost;
+	uint64_t frames = 900;
+	// Decoder blocked for stall µs after decoding frame stall_at
+	uint64_t stall_at = 0;
+	int64_t stall = 0;
+	uint64_t max_idr;
+};
+
+struct result
+{
+	uint64_t idr = 0;
+	uint64_t dropped = 0;
+	uint64_t superseded = 0;
+	uint64_t decoded = 0;
+	uint64_t broken = 0;
+	uint64_t last_decoded = 0;
+};
+
+struct queued_frame
+{
+	uint64_t index;
+	bool idr;
+	// Frame referenced by a P frame
+	uint64_t reference;
+	int64_t arrival;
+};
+
+result run(const scenario & s)
+{
+	result r;
+	default_idr_handler handler;
+	handler.set_stream(0);
+
+	utils::ring_buffer<queued_frame, 8> queue;
+	frame_drop_policy policy;
+	std::deque<std::pair<int64_t, from_headset::feedback>> feedback;
+
+	int64_t decoder_free = 0;
+	uint64_t last_encoded = 0;
+	// The last decoded frame and all the frames it depends on were decoded
+	bool valid = false;
+
+	auto send_feedback = [&](int64_t now, uint64_t frame_index, bool decoded) {
+		feedback.emplace_back(now + feedback_delay,
+		                      from_headset::feedback{
+		                              .frame_index = frame_index,
+		                              .sent_to_decoder = decoded ? now : 0,
+		                      });
+	};
+
+	// Decoding thread
+	auto decode = [&](int64_t now) {
+		while (decoder_free < now)
+		{
+			auto f = queue.read();
+			if (not f)
+				return;
+			if (policy.superseded(f->index))
+			{
+				++r.superseded;
+				continue;
+			}
+
+			valid = f->idr or (valid and f->reference == r.last_decoded);
+			if (not valid)
+				++r.broken;
+
+			// Feedback is sent when the frame is submitted to the decoder
+			int64_t start = std::max(decoder_free, f->arrival);
+			send_feedback(start, f->index, true);
+			decoder_free = start + (f->idr ? s.idr_cost : s.p_cost);
+			if (f->index == s.stall_at)
+				decoder_free += s.stall;
+			++r.decoded;
+			r.last_decoded = f->index;
+		}
+	};
+
+	for (uint64_t index = 1; index <= s.frames; ++index)
+	{
+		int64_t now = index * period;
+		decode(now);
+
+		while (not feedback.empty() and feedback.front().first <= now)
+		{
+			handler.on_feedback(feedback.front().second);
+			feedback.pop_front();
+		}
+
+		if (handler.should_skip(index))
+			continue;
+
+		bool idr = handler.get_type(index) == default_idr_handler::frame_type::i;
+		if (idr)
+			++r.idr;
+		queued_frame f{.index = index, .idr = idr, .reference = last_encoded, .arrival = now};
+		last_encoded = index;
+
+		// Network thread
+		if (policy.accept(idr, queue.size()) and queue.write(std::move(f)))
+			policy.queued(index, idr);
+		else
+		{
+			++r.dropped;
+			policy.dropped();
+			send_feedback(now, index, false);
+		}
+	}
+	decode(std::numeric_limits<int64_t>::max());
+
+	return r;
+}
+} // namespace
+
+int main()
+{
+	const scenario scenarios[] = {
+	        {
+	                // The decoder is busy 90% of the time and takes 4 frames for an IDR frame
+	                .name = "slow IDR",
+	                .p_cost = 10'000,
+	                .idr_cost = 4 * period,
+	                .max_idr = 1,
+	        },
+	        {
+	                .name = "decoder stall",
+	                .p_cost = 10'000,
+	                .idr_cost = 4 * period,
+	                .stall_at = 300,
+	                .stall = 30 * period,
+	                .max_idr = 2,
+	        },
+	        {
+	                .name = "long stall",
+	                .p_cost = 8'000,
+	                .idr_cost = 3 * period,
+	                .frames = 2000,
+	                .stall_at = 1000,
+	                .stall = 100 * period,
+	                .max_idr = 3,
+	        },
+	};
+
+	bool ok = true;
+	std::cout << std::format("{:<16} | {:>5} {:>7} {:>10} {:>7} {:>6}\n", "scenario", "IDR", "dropped", "superseded", "decoded", "broken");
+	for (const auto & s: scenarios)
+	{
+		auto r = run(s);
+		std::cout << std::format("{:<16} | {:>5} {:>7} {:>10} {:>7} {:>6}\n", s.name, r.idr, r.dropped, r.superseded, r.decoded, r.broken);
+
+		if (r.idr > s.max_idr)
+		{
+			std::cerr << std::format("{}: {} IDR frames, expected at most {}\n", s.name, r.idr, s.max_idr);
+			ok = false;
+		}
+		if (r.broken)
+		{
+			std::cerr << std::format("{}: {} frames decoded without their reference\n", s.name, r.broken);
+			ok = false;
+		}
+		if (r.last_decoded != s.frames)
+		{
+			std::cerr << std::format("{}: last decoded frame {}, expected {}\n", s.name, r.last_decoded, s.frames);
+			ok = false;
+		}
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,220 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2024  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2024  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Compares the per-query cost of the history template, which stores whole joint
+// sets and interpolates them joint by joint under a mutex, with joint_history,
+// for hand (26), FB body (70) and Meta full body (84) joint sets.
+//
+// Readers query a random time between the stored samples while a writer thread
+// adds a sample every 10ms, as the headset does.
+//
+// Usage: wivrn-joint-history-bench [queries per thread] [max reader threads]
+
+#include "driver/history.h"
+#include "driver/joint_history.h"
+
+#include "math/m_api.h"
+#include "math/m_space.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr XrTime sample_period = 10'000'000;
+
+xrt_space_relation random_relation(std::mt19937 & rng)
+{
+	std::normal_distribution<float> n;
+	xrt_quat q{n(rng), n(rng), n(rng), n(rng)};
+	math_quat_normalize(&q);
+	return {
+	        .relation_flags = XRT_SPACE_RELATION_BITMASK_ALL,
+	        .pose = {
+	                .orientation = q,
+	                .position = {n(rng), n(rng), n(rng)},
+	        },
+	        .linear_velocity = {n(rng), n(rng), n(rng)},
+	        .angular_velocity = {n(rng), n(rng), n(rng)},
+	};
+}
+
+// Same as pose_list::interpolate
+xrt_space_relation interpolate(const xrt_space_relation & a, const xrt_space_relation & b, float t)
+{
+	xrt_space_relation result;
+	auto flags = xrt_space_relation_flags(a.relation_flags & b.relation_flags);
+	xrt_space_relation b2 = b;
+	if (math_quat_dot(&a.pose.orientation, &b.pose.orientation) < 0)
+	{
+		b2.pose.orientation.x = -b.pose.orientation.x;
+		b2.pose.orientation.y = -b.pose.orientation.y;
+		b2.pose.orientation.z = -b.pose.orientation.z;
+		b2.pose.orientation.w = -b.pose.orientation.w;
+	}
+	m_space_relation_interpolate(const_cast<xrt_space_relation *>(&a), &b2, t, flags, &result);
+	return result;
+}
+
+template <size_t N>
+struct joint_set
+{
+	std::array<xrt_space_relation, N> joints;
+};
+
+template <size_t N>
+class legacy_list : public wivrn::history<legacy_list<N>, joint_set<N>>
+{
+public:
+	joint_set<N> interpolate(const joint_set<N> & a, const joint_set<N> & b, float t)
+	{
+		joint_set<N> result;
+		for (size_t i = 0; i < N; ++i)
+			result.joints[i] = ::interpolate(a.joints[i], b.joints[i], t);
+		return result;
+	}
+
+	void add(XrTime t, const joint_set<N> & s)
+	{
+		this->add_sample(t, t, s, {.stable = true});
+	}
+};
+
+struct empty_header
+{};
+
+template <size_t N>
+class soa_list : public wivrn::joint_history<soa_list<N>, joint_set<N>, empty_header, N>
+{
+	using base = wivrn::joint_history<soa_list<N>, joint_set<N>, empty_header, N>;
+
+public:
+	using typename base::sample;
+
+	void interpolate(const sample & a, const sample & b, float t, sample & out)
+	{
+		decltype(out.joints)::interpolate(a.joints, b.joints, t, out.joints);
+	}
+
+	joint_set<N> to_data(const sample & s)
+	{
+		joint_set<N> result;
+		for (size_t i = 0; i < N; ++i)
+			result.joints[i] = s.joints.get(i);
+		return result;
+	}
+
+	void add(XrTime t, const joint_set<N> & s)
+	{
+		sample converted;
+		for (size_t i = 0; i < N; ++i)
+			converted.joints.set(i, s.joints[i]);
+		this->add_sample(t, t, converted, {.stable = true});
+	}
+};
+
+// Returns the mean time per query in ns
+template <typename List, size_t N>
+double run(size_t queries, int readers)
+{
+	List list;
+	std::mt19937 rng(42);
+
+	std::vector<joint_set<N>> sets(16);
+	for (auto & s: sets)
+		for (auto & j: s.joints)
+			j = random_relation(rng);
+
+	XrTime now = sample_period;
+	for (int i = 0; i < 10; ++i, now += sample_period)
+		list.add(now, sets[i % sets.size()]);
+
+	std::atomic<XrTime> latest = now - sample_period;
+	std::atomic<bool> quit = false;
+	std::thread writer([&] {
+		XrTime t = latest;
+		for (size_t i = 0; not quit; ++i)
+		{
+			t += sample_period;
+			list.add(t, sets[i % sets.size()]);
+			latest = t;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	});
+
+	std::atomic<int64_t> total_ns = 0;
+	// Keeps the queries from being optimized out
+	std::atomic<float> checksum = 0;
+	std::vector<std::thread> threads;
+	for (int r = 0; r < readers; ++r)
+	{
+		threads.emplace_back([&, r] {
+			std::mt19937 rng(r);
+			std::uniform_int_distribution<XrTime> offset(-5 * sample_period, 0);
+			float sum = 0;
+
+			auto t0 = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < queries; ++i)
+			{
+				auto [produced, set] = list.get_at(latest + offset(rng));
+				sum += set.joints[i % N].pose.position.x;
+			}
+			auto t1 = std::chrono::steady_clock::now();
+
+			total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+			checksum = sum;
+		});
+	}
+
+	for (auto & t: threads)
+		t.join();
+	quit = true;
+	writer.join();
+
+	return double(total_ns) / (queries * readers);
+}
+
+template <size_t N>
+void compare(const char * name, size_t queries, int max_readers)
+{
+	for (int readers = 1; readers <= max_readers; readers *= 2)
+	{
+		double legacy = run<legacy_list<N>, N>(queries, readers);
+		double soa = run<soa_list<N>, N>(queries, readers);
+		std::cout << std::format("{:<16} {:>4} {:>8} {:>14.1f} {:>14.1f} {:>8.2f}\n", name, N, readers, legacy, soa, legacy / soa);
+	}
+}
+} // namespace
+
+int main(int argc, char ** argv)
+{
+	size_t queries = argc > 1 ? std::atoll(argv[1]) : 200'000;
+	int max_readers = argc > 2 ? std::atoi(argv[2]) : 4;
+
+	std::cout << std::format("{:<16} {:>4} {:>8} {:>14} {:>14} {:>8}\n", "set", "N", "readers", "history ns", "soa ns", "speedup");
+	compare<XRT_HAND_JOINT_COUNT>("hand", queries, max_readers);
+	compare<XRT_BODY_JOINT_COUNT_FB>("body fb", queries, max_readers);
+	compare<XRT_FULL_BODY_JOINT_COUNT_META>("full body meta", queries, max_readers);
+}
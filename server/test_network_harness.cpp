@@ -0,0 +1,839 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Streams video shards over loopback UDP sockets through an impaired link.
+//
+// The server side splits frames with the same code as video_encoder::SendData and decides between
+// I and P frames with default_idr_handler, driven by the feedback of the headset. The headset side
+// reassembles the shards like the client shard_accumulator and checks the payload of every
+// complete frame. A P frame can only be decoded if the frame it references was decoded.
+//
+// Frames are synthetic: the encoders need a Vulkan device and the client decoders an OpenXR
+// instance, this runs without any GPU.
+//
+// The link between both ends is simulated by a relay thread: Gilbert-Elliott burst loss,
+// reordering, delay with jitter and a bandwidth cap with a bounded queue. Feedback from the
+// headset goes through the relay without impairment.
+//
+// Usage: wivrn-network-harness [--option value...], see usage() for the options.
+// Exits with 1 if a frame was corrupted or if a threshold was not met.
+
+#include "encoder/idr_handler.h"
+#include "encoder/video_shards.h"
+#include "os/os_time.h"
+#include "utils/overloaded.h"
+#include "wivrn_packets.h"
+#include "wivrn_sockets.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using namespace wivrn;
+using data_shard = to_headset::video_stream_data_shard;
+using server_socket = typed_socket<UDP, from_headset::packets, to_headset::packets>;
+using headset_socket = typed_socket<UDP, to_headset::packets, from_headset::packets>;
+
+struct options
+{
+	// Link
+	double loss = 0;          // average packet loss rate
+	double burst = 1;         // mean number of packets lost in a row
+	double reorder = 0;       // probability for a packet to be overtaken
+	double reorder_depth = 3; // number of packets that overtake it
+	double delay = 2;         // ms
+	double jitter = 0;        // ms, uniformly distributed
+	double bandwidth = 0;     // Mbit/s, 0 for unlimited
+	double queue = 50;        // ms of data queued before tail drop
+
+	// Stream
+	double bitrate = 50; // Mbit/s
+	double idr_ratio = 4;
+	double fps = 90;
+	double frames = 900;
+	double seed = 1;
+
+	// Thresholds, ignored if negative
+	double min_completion = -1; // ratio of frames fully received
+	double max_p99 = -1;        // ms, send to last shard received
+};
+
+void usage(const char * name)
+{
+	options o;
+	std::cerr << std::format(
+	        "Usage: {} [--option value...]\n"
+	        "  --loss            packet loss rate ({})\n"
+	        "  --burst           mean loss burst length, in packets ({})\n"
+	        "  --reorder         probability for a packet to be reordered ({})\n"
+	        "  --reorder-depth   packets overtaking a reordered one ({})\n"
+	        "  --delay           one way delay, ms ({})\n"
+	        "  --jitter          additional random delay, ms ({})\n"
+	        "  --bandwidth       link capacity, Mbit/s, 0 for unlimited ({})\n"
+	        "  --queue           link queue before dropping packets, ms ({})\n"
+	        "  --bitrate         stream bitrate, Mbit/s ({})\n"
+	        "  --idr-ratio       size of an I frame relative to a P frame ({})\n"
+	        "  --fps             frame rate ({})\n"
+	        "  --frames          number of frames ({})\n"
+	        "  --seed            random seed ({})\n"
+	        "  --min-completion  fail if fewer frames are fully received\n"
+	        "  --max-p99         fail if the 99th percentile of the latency is higher, ms\n",
+	        name,
+	        o.loss,
+	        o.burst,
+	        o.reorder,
+	        o.reorder_depth,
+	        o.delay,
+	        o.jitter,
+	        o.bandwidth,
+	        o.queue,
+	        o.bitrate,
+	        o.idr_ratio,
+	        o.fps,
+	        o.frames,
+	        o.seed);
+}
+
+std::optional<options> parse(int argc, char ** argv)
+{
+	options o;
+	const std::map<std::string, double *> names{
+	        {"--loss", &o.loss},
+	        {"--burst", &o.burst},
+	        {"--reorder", &o.reorder},
+	        {"--reorder-depth", &o.reorder_depth},
+	        {"--delay", &o.delay},
+	        {"--jitter", &o.jitter},
+	        {"--bandwidth", &o.bandwidth},
+	        {"--queue", &o.queue},
+	        {"--bitrate", &o.bitrate},
+	        {"--idr-ratio", &o.idr_ratio},
+	        {"--fps", &o.fps},
+	        {"--frames", &o.frames},
+	        {"--seed", &o.seed},
+	        {"--min-completion", &o.min_completion},
+	        {"--max-p99", &o.max_p99},
+	};
+
+	for (int i = 1; i < argc; i += 2)
+	{
+		auto it = names.find(argv[i]);
+		if (it == names.end() or i + 1 == argc)
+			return std::nullopt;
+		*it->second = std::stod(argv[i + 1]);
+	}
+
+	if (o.loss < 0 or o.loss >= 1 or o.burst < 1 or o.fps <= 0 or o.frames < 1)
+		return std::nullopt;
+	return o;
+}
+
+sockaddr_in6 loopback(uint16_t port)
+{
+	sockaddr_in6 address{};
+	address.sin6_family = AF_INET6;
+	address.sin6_port = htons(port);
+	address.sin6_addr = in6addr_loopback;
+	return address;
+}
+
+uint16_t bind_loopback(UDP & socket)
+{
+	sockaddr_in6 address = loopback(0);
+	socket.bind(address);
+	socklen_t size = sizeof(address);
+	if (getsockname(socket, (sockaddr *)&address, &size) < 0)
+		throw std::system_error(errno, std::generic_category());
+	// Avoid drops in the kernel when a large I frame is sent at once
+	socket.set_receive_buffer_size(8 * 1024 * 1024);
+	socket.set_send_buffer_size(8 * 1024 * 1024);
+	return ntohs(address.sin6_port);
+}
+
+bool wait_readable(int fd, int64_t timeout_ns)
+{
+	pollfd pfd{.fd = fd, .events = POLLIN, .revents = 0};
+	timespec ts{
+	        .tv_sec = timeout_ns / 1'000'000'000,
+	        .tv_nsec = timeout_ns % 1'000'000'000,
+	};
+	return ppoll(&pfd, 1, &ts, nullptr) > 0;
+}
+
+// Synthetic encoded frame: a header followed by bytes that depend on their position
+struct frame_header
+{
+	uint64_t frame_index;
+	uint64_t reference; // previous encoded frame for P frames
+	uint32_t size;
+	uint8_t idr;
+};
+
+uint8_t pattern(uint64_t frame_index, size_t offset)
+{
+	return uint8_t(frame_index * 31 + offset);
+}
+
+// Results, indexed by frame
+struct frame_record
+{
+	std::atomic<bool> sent = false;
+	bool idr = false;
+	std::optional<int64_t> latency; // send begin to last shard received
+	bool decoded = false;
+};
+
+class impaired_link
+{
+	struct packet
+	{
+		std::vector<uint8_t> data;
+		int depth = 0; // for reordered packets, number of packets left to overtake it
+	};
+
+	const options & o;
+	UDP socket;
+	sockaddr_in6 server{};
+	sockaddr_in6 headset{};
+	std::mt19937_64 rng;
+	std::uniform_real_distribution<double> uniform{0, 1};
+
+	bool bad_state = false;
+	int64_t link_free = 0;
+	int64_t last_release = 0;
+	std::multimap<int64_t, packet> queue;
+	std::vector<packet> held;
+
+	std::jthread thread;
+
+public:
+	uint64_t forwarded = 0;
+	uint64_t lost = 0;
+	uint64_t tail_dropped = 0;
+	uint64_t reordered = 0;
+
+	explicit impaired_link(const options & o) :
+	        o(o), rng(o.seed)
+	{
+	}
+
+	uint16_t bind()
+	{
+		return bind_loopback(socket);
+	}
+
+	void start(uint16_t server_port, uint16_t headset_port)
+	{
+		server = loopback(server_port);
+		headset = loopback(headset_port);
+		thread = std::jthread([this](std::stop_token stop) { run(stop); });
+	}
+
+	void stop()
+	{
+		thread = {};
+	}
+
+private:
+	// Gilbert-Elliott model: all packets are lost in the bad state
+	bool lose()
+	{
+		if (o.loss == 0)
+			return false;
+		double p_bad_good = 1 / o.burst;
+		double p_good_bad = o.loss * p_bad_good / (1 - o.loss);
+		if (bad_state)
+			bad_state = uniform(rng) >= p_bad_good;
+		else
+			bad_state = uniform(rng) < p_good_bad;
+		return bad_state;
+	}
+
+	void schedule(packet && p, int64_t now)
+	{
+		int64_t departure = now;
+		if (o.bandwidth > 0)
+		{
+			if (link_free - now > o.queue * 1e6)
+			{
+				++tail_dropped;
+				return;
+			}
+			link_free = std::max(link_free, now) + int64_t(p.data.size() * 8e3 / o.bandwidth);
+			departure = link_free;
+		}
+
+		int64_t release = departure + int64_t((o.delay + o.jitter * uniform(rng)) * 1e6);
+		// Jitter alone does not reorder packets
+		release = std::max(release, last_release);
+		last_release = release;
+		queue.emplace(release, std::move(p));
+
+		for (auto it = held.begin(); it != held.end();)
+		{
+			if (--it->depth > 0)
+			{
+				++it;
+				continue;
+			}
+			queue.emplace(release, std::move(*it));
+			it = held.erase(it);
+		}
+	}
+
+	void receive(int64_t now)
+	{
+		while (true)
+		{
+			packet p{.data = std::vector<uint8_t>(2048)};
+			sockaddr_in6 from{};
+			socklen_t from_size = sizeof(from);
+			ssize_t size = recvfrom(socket, p.data.data(), p.data.size(), MSG_DONTWAIT, (sockaddr *)&from, &from_size);
+			if (size < 0)
+				return;
+			p.data.resize(size);
+
+			if (from.sin6_port != server.sin6_port)
+			{
+				// Feedback from the headset
+				sendto(socket, p.data.data(), p.data.size(), 0, (sockaddr *)&server, sizeof(server));
+				continue;
+			}
+
+			if (lose())
+			{
+				++lost;
+				continue;
+			}
+
+			if (o.reorder_depth >= 1 and uniform(rng) < o.reorder)
+			{
+				++reordered;
+				p.depth = o.reorder_depth;
+				held.push_back(std::move(p));
+				continue;
+			}
+
+			schedule(std::move(p), now);
+		}
+	}
+
+	void run(std::stop_token stop)
+	{
+		while (not stop.stop_requested())
+		{
+			int64_t now = os_monotonic_get_ns();
+			int64_t timeout = 10'000'000;
+			if (not queue.empty())
+				timeout = std::clamp<int64_t>(queue.begin()->first - now, 0, timeout);
+
+			if (wait_readable(socket, timeout))
+				receive(os_monotonic_get_ns());
+
+			now = os_monotonic_get_ns();
+			while (not queue.empty() and queue.begin()->first <= now)
+			{
+				auto & data = queue.begin()->second.data;
+				sendto(socket, data.data(), data.size(), 0, (sockaddr *)&headset, sizeof(headset));
+				++forwarded;
+				queue.erase(queue.begin());
+			}
+		}
+	}
+};
+
+// Checks the synthetic frames and the dependency between them
+class decoder
+{
+	std::vector<uint8_t> buffer;
+	uint64_t current_frame = -1;
+	std::optional<uint64_t> last_decoded;
+
+public:
+	uint64_t corrupted = 0;
+
+	void push_data(std::span<std::span<const uint8_t>> payload, uint64_t frame_index)
+	{
+		if (frame_index != current_frame)
+		{
+			buffer.clear();
+			current_frame = frame_index;
+		}
+		for (const auto & span: payload)
+			buffer.insert(buffer.end(), span.begin(), span.end());
+	}
+
+	// Returns true if the frame can be displayed
+	bool frame_completed(uint64_t frame_index)
+	{
+		frame_header header;
+		if (frame_index != current_frame or buffer.size() < sizeof(header))
+		{
+			++corrupted;
+			return false;
+		}
+		memcpy(&header, buffer.data(), sizeof(header));
+		bool valid = header.frame_index == frame_index and header.size == buffer.size();
+		for (size_t i = sizeof(header); valid and i < buffer.size(); ++i)
+			valid = buffer[i] == pattern(frame_index, i);
+		buffer.clear();
+
+		if (not valid)
+		{
+			++corrupted;
+			last_decoded.reset();
+			return false;
+		}
+
+		if (header.idr or (last_decoded and *last_decoded == header.reference))
+		{
+			last_decoded = frame_index;
+			return true;
+		}
+		last_decoded.reset();
+		return false;
+	}
+};
+
+// Same logic as client/decoder/shard_accumulator.cpp, which depends on the OpenXR instance and
+// the Vulkan decoder
+class shard_accumulator
+{
+	struct shard_set
+	{
+		std::vector<std::optional<data_shard>> data;
+		from_headset::feedback feedback{};
+
+		void reset(uint64_t frame_index)
+		{
+			data.clear();
+			feedback = {};
+			feedback.frame_index = frame_index;
+		}
+
+		bool empty() const
+		{
+			return data.empty();
+		}
+
+		std::optional<uint16_t> insert(data_shard && shard)
+		{
+			if (empty())
+				feedback.received_first_packet = os_monotonic_get_ns();
+
+			auto idx = shard.shard_idx;
+			if (idx >= data.size())
+				data.resize(idx + 1);
+			if (data[idx])
+				return {};
+			data[idx] = std::move(shard);
+			return idx;
+		}
+
+		uint64_t frame_index() const
+		{
+			return feedback.frame_index;
+		}
+	};
+
+	shard_set current;
+	shard_set next;
+	decoder decoder_;
+	headset_socket & socket;
+	std::vector<frame_record> & records;
+
+	std::optional<int64_t> broken_since;
+
+public:
+	std::vector<int64_t> recovery_times;
+
+	shard_accumulator(headset_socket & socket, std::vector<frame_record> & records) :
+	        socket(socket), records(records)
+	{
+		next.reset(1);
+	}
+
+	uint64_t corrupted() const
+	{
+		return decoder_.corrupted;
+	}
+
+	void push_shard(data_shard && shard)
+	{
+		uint8_t frame_diff = shard.frame_idx - current.frame_index();
+		if (shard.frame_idx < current.frame_index())
+		{
+			// frame is in the past, drop it
+		}
+		else if (frame_diff == 0)
+		{
+			auto shard_idx = current.insert(std::move(shard));
+			if (shard_idx)
+				try_submit_frame(*shard_idx);
+		}
+		else if (frame_diff == 1)
+		{
+			next.insert(std::move(shard));
+			if (is_complete(next))
+			{
+				send_feedback(current.feedback);
+				advance();
+			}
+		}
+		else if (frame_diff == 2)
+		{
+			send_feedback(current.feedback);
+			advance();
+			push_shard(std::move(shard));
+		}
+		else
+		{
+			send_feedback(current.feedback);
+			send_feedback(next.feedback);
+			current.reset(shard.frame_idx);
+			next.reset(shard.frame_idx + 1);
+			push_shard(std::move(shard));
+		}
+	}
+
+private:
+	static bool is_complete(const shard_set & shards)
+	{
+		const auto & frame = shards.data;
+		if (frame.empty())
+			return false;
+		if (not(frame.back() and frame.back()->timing_info))
+			return false;
+		for (const auto & shard: frame)
+			if (not shard)
+				return false;
+		return true;
+	}
+
+	void advance()
+	{
+		std::swap(current, next);
+		next.reset(current.frame_index() + 1);
+
+		// Shards received while the frame was next have not been sent to the decoder yet
+		if (not current.empty() and current.data.front())
+			try_submit_frame(0);
+	}
+
+	void try_submit_frame(uint16_t shard_idx)
+	{
+		auto & data_shards = current.data;
+
+		for (size_t idx = 0; idx < shard_idx; ++idx)
+			if (not data_shards[idx])
+				return;
+
+		uint16_t last_idx = shard_idx + 1;
+		for (size_t size = data_shards.size();
+		     last_idx < size and data_shards[last_idx];
+		     ++last_idx)
+		{
+		}
+
+		std::vector<std::span<const uint8_t>> payload;
+		payload.reserve(last_idx - shard_idx);
+		for (size_t idx = shard_idx; idx < last_idx; ++idx)
+			payload.emplace_back(data_shards[idx]->payload);
+
+		bool frame_complete = last_idx == data_shards.size() and data_shards.back()->timing_info;
+		decoder_.push_data(payload, data_shards[shard_idx]->frame_idx);
+
+		if (not frame_complete)
+			return;
+
+		current.feedback.received_last_packet = os_monotonic_get_ns();
+		current.feedback.sent_to_decoder = current.feedback.received_last_packet;
+		auto timing_info = *data_shards.back()->timing_info;
+		current.feedback.encode_begin = timing_info.encode_begin;
+		current.feedback.encode_end = timing_info.encode_end;
+		current.feedback.send_begin = timing_info.send_begin;
+		current.feedback.send_end = timing_info.send_end;
+
+		if (decoder_.frame_completed(current.frame_index()))
+			current.feedback.received_from_decoder = os_monotonic_get_ns();
+
+		send_feedback(current.feedback);
+
+		advance();
+	}
+
+	void send_feedback(from_headset::feedback & feedback)
+	{
+		int64_t now = os_monotonic_get_ns();
+		if (not feedback.received_last_packet)
+			feedback.received_first_packet = now;
+
+		if (feedback.frame_index < records.size() and records[feedback.frame_index].sent)
+		{
+			auto & record = records[feedback.frame_index];
+			if (feedback.received_last_packet)
+				record.latency = feedback.received_last_packet - feedback.send_begin;
+			record.decoded = feedback.received_from_decoder;
+
+			if (not record.decoded and not broken_since)
+				broken_since = now;
+			if (record.decoded and record.idr and broken_since)
+			{
+				recovery_times.push_back(now - *broken_since);
+				broken_since.reset();
+			}
+		}
+
+		try
+		{
+			socket.send(from_headset::feedback{feedback});
+		}
+		catch (...)
+		{
+		}
+	}
+};
+
+struct percentiles
+{
+	double p50 = 0;
+	double p90 = 0;
+	double p99 = 0;
+	double max = 0;
+};
+
+percentiles compute(std::vector<int64_t> values)
+{
+	if (values.empty())
+		return {};
+	std::ranges::sort(values);
+	auto at = [&](double p) { return values[std::min<size_t>(values.size() - 1, values.size() * p)] * 1e-6; };
+	return {
+	        .p50 = at(0.5),
+	        .p90 = at(0.9),
+	        .p99 = at(0.99),
+	        .max = values.back() * 1e-6,
+	};
+}
+} // namespace
+
+int main(int argc, char ** argv)
+{
+	auto o = parse(argc, argv);
+	if (not o)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	try
+	{
+		const size_t frames = o->frames;
+		std::vector<frame_record> records(frames);
+
+		server_socket server;
+		headset_socket headset;
+		impaired_link relay(*o);
+		uint16_t server_port = bind_loopback(server);
+		uint16_t headset_port = bind_loopback(headset);
+		uint16_t relay_port = relay.bind();
+		server.connect(in6addr_loopback, relay_port);
+		headset.connect(in6addr_loopback, relay_port);
+		relay.start(server_port, headset_port);
+
+		default_idr_handler idr;
+		idr.reset();
+
+		std::jthread feedback_thread([&](std::stop_token stop) {
+			while (not stop.stop_requested())
+			{
+				if (not wait_readable(server, 10'000'000))
+					continue;
+				for (auto packet = server.receive(); packet; packet = server.receive_pending())
+				{
+					std::visit(utils::overloaded{
+					                   [&](const from_headset::feedback & f) { idr.on_feedback(f); },
+					                   [](const auto &) {},
+					           },
+					           *packet);
+				}
+			}
+		});
+
+		shard_accumulator accumulator(headset, records);
+		std::jthread headset_thread([&](std::stop_token stop) {
+			while (not stop.stop_requested())
+			{
+				if (not wait_readable(headset, 10'000'000))
+					continue;
+				for (auto packet = headset.receive(); packet; packet = headset.receive_pending())
+				{
+					if (auto shard = std::get_if<data_shard>(&*packet))
+						accumulator.push_shard(std::move(*shard));
+				}
+			}
+		});
+
+		// Server
+		std::mt19937_64 rng(o->seed);
+		std::uniform_real_distribution<double> size_variation(0.8, 1.2);
+		const int64_t period = 1e9 / o->fps;
+		const double p_frame_size = o->bitrate * 1e6 / 8 / o->fps;
+		uint64_t skipped = 0;
+		uint64_t encoded = 0;
+		uint64_t bytes = 0;
+		std::optional<uint64_t> reference;
+		std::vector<uint8_t> payload;
+
+		int64_t start = os_monotonic_get_ns();
+		for (uint64_t frame_index = 0; frame_index < frames; ++frame_index)
+		{
+			int64_t wake_up = start + frame_index * period;
+			std::this_thread::sleep_for(std::chrono::nanoseconds(wake_up - os_monotonic_get_ns()));
+
+			if (idr.should_skip(frame_index))
+			{
+				++skipped;
+				continue;
+			}
+
+			bool is_idr = idr.get_type(frame_index) == default_idr_handler::frame_type::i;
+			frame_header header{
+			        .frame_index = frame_index,
+			        .reference = reference.value_or(-1),
+			        .size = uint32_t(p_frame_size * size_variation(rng) * (is_idr ? o->idr_ratio : 1)),
+			        .idr = is_idr,
+			};
+			header.size = std::max<uint32_t>(header.size, sizeof(header));
+			payload.resize(header.size);
+			memcpy(payload.data(), &header, sizeof(header));
+			for (size_t i = sizeof(header); i < payload.size(); ++i)
+				payload[i] = pattern(frame_index, i);
+			reference = frame_index;
+
+			records[frame_index].idr = is_idr;
+			records[frame_index].sent = true;
+
+			int64_t now = os_monotonic_get_ns();
+			data_shard shard{};
+			shard.frame_idx = frame_index;
+			shard.view_info.emplace().display_time = now;
+			data_shard::timing_info_t timing_info{
+			        .encode_begin = now,
+			        .encode_end = now,
+			        .send_begin = now,
+			        .send_end = now,
+			};
+			split_shards(shard, payload, data_shard::max_payload_size, timing_info, [&](const data_shard & s) {
+				try
+				{
+					server.send(data_shard{s});
+				}
+				catch (...)
+				{
+					// Ignore network errors
+				}
+			});
+			++encoded;
+			bytes += payload.size();
+		}
+
+		// Let the last frames arrive
+		std::this_thread::sleep_for(std::chrono::milliseconds(200) + std::chrono::nanoseconds(int64_t((o->delay + o->jitter) * 1e6)));
+		relay.stop();
+		headset_thread = {};
+		feedback_thread = {};
+		double duration = (os_monotonic_get_ns() - start) * 1e-9;
+
+		uint64_t idr_frames = 0;
+		uint64_t complete = 0;
+		uint64_t decoded = 0;
+		std::vector<int64_t> latency;
+		for (const auto & record: records)
+		{
+			if (not record.sent)
+				continue;
+			idr_frames += record.idr;
+			decoded += record.decoded;
+			if (record.latency)
+			{
+				++complete;
+				latency.push_back(*record.latency);
+			}
+		}
+
+		double completion = encoded ? double(complete) / encoded : 0;
+		auto l = compute(latency);
+		auto r = compute(accumulator.recovery_times);
+
+		std::cout << std::format("{} frames in {:.2f} s, {:.1f} Mbit/s sent\n", frames, duration, bytes * 8e-6 / duration);
+		std::cout << std::format("link: {} packets forwarded, {} lost, {} dropped by the queue, {} reordered\n",
+		                         relay.forwarded,
+		                         relay.lost,
+		                         relay.tail_dropped,
+		                         relay.reordered);
+		std::cout << std::format("server: {} encoded, {} skipped waiting for an I frame, {} I frames\n", encoded, skipped, idr_frames);
+		std::cout << std::format("headset: {} complete ({:.2f} %), {} decoded ({:.2f} % of all frames), {} corrupted\n",
+		                         complete,
+		                         100 * completion,
+		                         decoded,
+		                         100. * decoded / frames,
+		                         accumulator.corrupted());
+		std::cout << std::format("\n{:<20} {:>8} {:>8} {:>8} {:>8} {:>8}\n", "ms", "count", "p50", "p90", "p99", "max");
+		std::cout << std::format("{:<20} {:>8} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f}\n", "latency", latency.size(), l.p50, l.p90, l.p99, l.max);
+		std::cout << std::format("{:<20} {:>8} {:>8.3f} {:>8.3f} {:>8.3f} {:>8.3f}\n", "recovery", accumulator.recovery_times.size(), r.p50, r.p90, r.p99, r.max);
+
+		int result = 0;
+		if (accumulator.corrupted())
+		{
+			std::cerr << "Corrupted frames received" << std::endl;
+			result = 1;
+		}
+		if (o->min_completion >= 0 and completion < o->min_completion)
+		{
+			std::cerr << std::format("Completion {:.4f} below {:.4f}", completion, o->min_completion) << std::endl;
+			result = 1;
+		}
+		if (o->max_p99 >= 0 and l.p99 > o->max_p99)
+		{
+			std::cerr << std::format("Latency p99 {:.3f} ms above {:.3f} ms", l.p99, o->max_p99) << std::endl;
+			result = 1;
+		}
+		return result;
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,296 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2024  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2024  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Replays a timing dump (WIVRN_DUMP_TIMINGS) through the pacer and compares the pacing models.
+//
+// The dump gives, for each frame, the time between presenting the frame and the headset decoding
+// it, the application CPU time and the headset vsync. Those are fed back to a simulated pacer in
+// the same order: frames are presented when the pacer wakes the application up, they are decoded
+// after the recorded latency and blitted on the first headset vsync where they are both decoded
+// and expected. A frame that is decoded after the vsync it was scheduled for is missed.
+//
+// Usage: wivrn-pacer-replay timings.csv [model...]
+
+#include "compositor/pacer.h"
+#include "compositor/pacing_model.h"
+#include "driver/clock_offset.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct recorded_frame
+{
+	int64_t wake_up = 0;
+	int64_t begin = 0;
+	int64_t decoded = 0;
+	int64_t blit = 0;
+	int64_t display = 0;
+};
+
+struct trace
+{
+	std::vector<int64_t> latency;  // present to decoded
+	std::vector<int64_t> app_time; // wake up to present
+	std::vector<int64_t> vsync;
+	int64_t period = 0;
+	int64_t render_to_display = 0;
+};
+
+int64_t median(std::vector<int64_t> values)
+{
+	if (values.empty())
+		return 0;
+	auto it = values.begin() + values.size() / 2;
+	std::ranges::nth_element(values, it);
+	return *it;
+}
+
+trace read_trace(const std::string & filename)
+{
+	std::ifstream file(filename);
+	if (not file)
+		throw std::runtime_error("Cannot open " + filename);
+
+	std::map<int64_t, recorded_frame> frames;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream ss(line);
+		std::string event, field;
+		int64_t frame, time;
+		int stream;
+
+		if (not std::getline(ss, event, ','))
+			continue;
+		event.erase(std::remove(event.begin(), event.end(), '"'), event.end());
+
+		try
+		{
+			std::getline(ss, field, ',');
+			frame = std::stoll(field);
+			std::getline(ss, field, ',');
+			time = std::stoll(field);
+			std::getline(ss, field, ',');
+			stream = std::stoi(field);
+		}
+		catch (std::exception &)
+		{
+			continue;
+		}
+
+		if (frame < 0 or time == 0)
+			continue;
+
+		auto & f = frames[frame];
+		if (event == "wake_up")
+			f.wake_up = time;
+		else if (event == "begin")
+			f.begin = time;
+		else if (event == "decode_end")
+			f.decoded = std::max(f.decoded, time);
+		else if (event == "blit" and stream == 0 and f.blit == 0)
+			f.blit = time;
+		else if (event == "display" and stream == 0 and f.display == 0)
+			f.display = time;
+	}
+
+	trace t;
+	std::vector<int64_t> blits;
+	std::vector<int64_t> render_to_display;
+	for (const auto & [_, f]: frames)
+	{
+		if (f.begin and f.decoded > f.begin)
+		{
+			t.latency.push_back(f.decoded - f.begin);
+			t.app_time.push_back(f.wake_up and f.wake_up < f.begin ? f.begin - f.wake_up : 0);
+		}
+		if (f.blit)
+			blits.push_back(f.blit);
+		if (f.blit and f.display > f.blit)
+			render_to_display.push_back(f.display - f.blit);
+	}
+
+	std::ranges::sort(blits);
+	blits.erase(std::unique(blits.begin(), blits.end()), blits.end());
+	if (blits.size() < 2 or t.latency.empty())
+		throw std::runtime_error("Not enough frames in " + filename);
+
+	std::vector<int64_t> intervals;
+	for (size_t i = 1; i < blits.size(); i++)
+		intervals.push_back(blits[i] - blits[i - 1]);
+	t.period = median(intervals);
+	t.render_to_display = median(render_to_display);
+
+	// Blits only happen for frames that were received, fill the gaps to get every vsync
+	t.vsync.push_back(blits[0]);
+	for (size_t i = 1; i < blits.size(); i++)
+	{
+		while (blits[i] - t.vsync.back() > t.period * 3 / 2)
+			t.vsync.push_back(t.vsync.back() + t.period);
+		t.vsync.push_back(blits[i]);
+	}
+
+	return t;
+}
+
+// First vsync at or after t
+int64_t next_vsync(const trace & t, int64_t time)
+{
+	auto it = std::ranges::lower_bound(t.vsync, time);
+	if (it != t.vsync.end())
+		return *it;
+
+	int64_t last = t.vsync.back();
+	return last + t.period * ((time - last + t.period - 1) / t.period);
+}
+
+struct result
+{
+	size_t frames = 0;
+	size_t missed = 0;
+	std::vector<int64_t> present_to_blit;
+};
+
+result replay(const trace & t, const char * model)
+{
+	wivrn::pacer pacer(t.period, model);
+	wivrn::clock_offset offset{.b = 0, .stable = true};
+
+	struct pending_feedback
+	{
+		int64_t arrival;
+		wivrn::from_headset::feedback feedback;
+		bool operator>(const pending_feedback & other) const
+		{
+			return arrival > other.arrival;
+		}
+	};
+	std::priority_queue<pending_feedback, std::vector<pending_feedback>, std::greater<>> feedback;
+
+	result r;
+	int64_t now = t.vsync.front();
+	for (size_t i = 0; i < t.latency.size(); i++)
+	{
+		while (not feedback.empty() and feedback.top().arrival <= now)
+		{
+			pacer.on_feedback(feedback.top().feedback, offset);
+			feedback.pop();
+		}
+
+		int64_t frame_id, wake_up, desired_present, slop, predicted_display;
+		pacer.predict(now, frame_id, wake_up, desired_present, slop, predicted_display);
+
+		int64_t present = std::max(now, wake_up) + t.app_time[i];
+		pacer.mark_timing_point(COMP_TARGET_TIMING_POINT_SUBMIT_END, frame_id, present);
+
+		int64_t decoded = present + t.latency[i];
+		int64_t target = next_vsync(t, predicted_display - t.render_to_display - t.period / 2);
+		int64_t blit = next_vsync(t, std::max(decoded, target));
+
+		r.frames++;
+		if (blit != target)
+			r.missed++;
+		r.present_to_blit.push_back(blit - present);
+
+		// Feedback is sent after the frame is displayed
+		feedback.push({
+		        .arrival = blit + t.render_to_display,
+		        .feedback = {
+		                .frame_index = uint64_t(frame_id),
+		                .stream_index = 0,
+		                .received_from_decoder = decoded,
+		                .blitted = blit,
+		                .displayed = blit + t.render_to_display,
+		                .times_displayed = 1,
+		        },
+		});
+
+		now = present;
+	}
+
+	return r;
+}
+} // namespace
+
+int main(int argc, char ** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " timings.csv [model...]" << std::endl;
+		return 1;
+	}
+
+	std::vector<std::string> models(argv + 2, argv + argc);
+	if (models.empty())
+		models.assign(wivrn::pacing_model_names.begin(), wivrn::pacing_model_names.end());
+
+	// The pacer falls back to the default model, results would be labelled with the wrong name
+	for (const auto & model: models)
+	{
+		if (std::ranges::find(wivrn::pacing_model_names, model) == wivrn::pacing_model_names.end())
+		{
+			std::cerr << "Unknown pacing model " << model << std::endl;
+			return 1;
+		}
+	}
+
+	try
+	{
+		trace t = read_trace(argv[1]);
+		std::cout << std::format("{} frames, period {:.3f} ms, median latency {:.3f} ms\n\n",
+		                         t.latency.size(),
+		                         t.period * 1e-6,
+		                         median(t.latency) * 1e-6);
+
+		std::cout << std::format("{:<12} {:>10} {:>10} {:>12} {:>12}\n", "model", "frames", "missed %", "latency ms", "p99 ms");
+		for (const auto & model: models)
+		{
+			result r = replay(t, model.c_str());
+			auto & l = r.present_to_blit;
+			std::ranges::sort(l);
+
+			double mean = 0;
+			for (int64_t i: l)
+				mean += i;
+			mean /= l.size();
+
+			std::cout << std::format("{:<12} {:>10} {:>10.3f} {:>12.3f} {:>12.3f}\n",
+			                         model,
+			                         r.frames,
+			                         100. * r.missed / r.frames,
+			                         mean * 1e-6,
+			                         l[l.size() * 99 / 100] * 1e-6);
+		}
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,359 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Compares the receive loops of the headset over loopback UDP.
+//
+// A sender thread sends video shards in bursts, like the encoder does for each frame, to a stream
+// socket; an idle socket stands for the control socket. The receiving thread runs one of:
+//  - poll: the loop wivrn_session::poll used before epoll, a pollfd array built on each call and
+//    one packet read per readable socket and wakeup,
+//  - epoll: the current loop, sockets drained until they would block,
+//  - epoll+busy: the same with busy polling, as used while streaming in high power mode.
+//
+// The client cannot be built here, the loops are copies of wivrn_session::poll.
+//
+// Usage: wivrn-receive-bench [--option value...], see usage() for the options.
+
+#include "wivrn_packets.h"
+#include "wivrn_sockets.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <format>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <poll.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using namespace wivrn;
+using data_shard = to_headset::video_stream_data_shard;
+using server_socket = typed_socket<UDP, from_headset::packets, to_headset::packets>;
+using headset_socket = typed_socket<UDP, to_headset::packets, from_headset::packets>;
+
+struct options
+{
+	double duration = 3;     // s, for each loop
+	double rate = 100'000;   // packets/s, 0 for unlimited
+	double burst = 64;       // packets sent at once
+	double size = 1400;      // payload bytes
+	double busy_poll = 200;  // µs
+	double max_batch = 256;  // packets read from a socket per wakeup
+};
+
+void usage(const char * name)
+{
+	options o;
+	std::cerr << std::format(
+	        "Usage: {} [--option value...]\n"
+	        "  --duration   duration of each run, s ({})\n"
+	        "  --rate       packets per second, 0 for unlimited ({})\n"
+	        "  --burst      packets sent at once ({})\n"
+	        "  --size       payload size, bytes ({})\n"
+	        "  --busy-poll  busy polling time, µs ({})\n"
+	        "  --max-batch  packets read from a socket per wakeup ({})\n",
+	        name,
+	        o.duration,
+	        o.rate,
+	        o.burst,
+	        o.size,
+	        o.busy_poll,
+	        o.max_batch);
+}
+
+std::optional<options> parse(int argc, char ** argv)
+{
+	options o;
+	const std::map<std::string, double *> names{
+	        {"--duration", &o.duration},
+	        {"--rate", &o.rate},
+	        {"--burst", &o.burst},
+	        {"--size", &o.size},
+	        {"--busy-poll", &o.busy_poll},
+	        {"--max-batch", &o.max_batch},
+	};
+
+	for (int i = 1; i < argc; i += 2)
+	{
+		auto it = names.find(argv[i]);
+		if (it == names.end() or i + 1 == argc)
+			return std::nullopt;
+		*it->second = std::stod(argv[i + 1]);
+	}
+
+	if (o.duration <= 0 or o.rate < 0 or o.burst < 1 or o.size < 1 or o.size > data_shard::max_payload_size or o.busy_poll < 0 or o.max_batch < 1)
+		return std::nullopt;
+	return o;
+}
+
+uint16_t bind_loopback(UDP & socket)
+{
+	sockaddr_in6 address{};
+	address.sin6_family = AF_INET6;
+	address.sin6_addr = in6addr_loopback;
+	socket.bind(address);
+	socklen_t size = sizeof(address);
+	if (getsockname(socket, (sockaddr *)&address, &size) < 0)
+		throw std::system_error(errno, std::system_category());
+	return ntohs(address.sin6_port);
+}
+
+int64_t thread_cpu_time()
+{
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1'000'000'000 + ts.tv_nsec;
+}
+
+struct counters
+{
+	uint64_t packets = 0;
+	uint64_t bytes = 0;
+	uint64_t wakeups = 0;
+	int64_t cpu_time = 0;
+};
+
+// Reads the payload so that the packet is not optimised out
+void dispatch(counters & c, to_headset::packets && packet)
+{
+	if (auto shard = std::get_if<data_shard>(&packet))
+		c.bytes += shard->payload.size();
+	++c.packets;
+}
+
+// wivrn_session::poll before epoll
+void poll_loop(headset_socket & stream, headset_socket & control, std::stop_token stop, counters & c)
+{
+	while (not stop.stop_requested())
+	{
+		pollfd fds[2] = {};
+		fds[0].events = POLLIN;
+		fds[0].fd = stream.get_fd();
+		fds[1].events = POLLIN;
+		fds[1].fd = control.get_fd();
+
+		while (auto packet = stream.receive_pending())
+			dispatch(c, std::move(*packet));
+		while (auto packet = control.receive_pending())
+			dispatch(c, std::move(*packet));
+
+		int r = ::poll(fds, std::size(fds), 10);
+		if (r < 0)
+			throw std::system_error(errno, std::system_category());
+		if (r > 0)
+			++c.wakeups;
+
+		if (fds[0].revents & POLLIN)
+		{
+			if (auto packet = stream.receive())
+				dispatch(c, std::move(*packet));
+		}
+		if (fds[1].revents & POLLIN)
+		{
+			if (auto packet = control.receive())
+				dispatch(c, std::move(*packet));
+		}
+	}
+}
+
+// wivrn_session::poll
+void epoll_loop(headset_socket & stream, headset_socket & control, std::stop_token stop, counters & c, std::chrono::microseconds busy_poll, int max_batch)
+{
+	fd_base epoll(epoll_create1(EPOLL_CLOEXEC));
+	for (auto [socket, id]: {std::pair{&stream, 0u}, std::pair{&control, 1u}})
+	{
+		epoll_event event{
+		        .events = EPOLLIN,
+		        .data = {.u32 = id},
+		};
+		if (epoll_ctl(epoll, EPOLL_CTL_ADD, socket->get_fd(), &event) < 0)
+			throw std::system_error(errno, std::system_category());
+	}
+
+	auto dispatch_pending = [&](headset_socket & socket) {
+		int n = 0;
+		while (auto packet = socket.receive_pending())
+		{
+			dispatch(c, std::move(*packet));
+			++n;
+		}
+		return n;
+	};
+
+	auto drain = [&](headset_socket & socket) {
+		int n = 0;
+		while (n < max_batch)
+		{
+			auto packet = socket.receive();
+			if (not packet)
+				break;
+			dispatch(c, std::move(*packet));
+			n += 1 + dispatch_pending(socket);
+		}
+	};
+
+	while (not stop.stop_requested())
+	{
+		int packets = dispatch_pending(stream) + dispatch_pending(control);
+
+		epoll_event events[2];
+		int r = 0;
+		if (busy_poll.count() > 0 or packets > 0)
+		{
+			auto deadline = std::chrono::steady_clock::now() + busy_poll;
+			do
+			{
+				r = epoll_wait(epoll, events, std::size(events), 0);
+			} while (r == 0 and std::chrono::steady_clock::now() < deadline);
+		}
+		if (r == 0 and packets == 0)
+			r = epoll_wait(epoll, events, std::size(events), 10);
+
+		if (r < 0)
+			throw std::system_error(errno, std::system_category());
+		if (r > 0)
+			++c.wakeups;
+
+		for (int i = 0; i < r; ++i)
+			drain(events[i].data.u32 == 0 ? stream : control);
+	}
+}
+
+struct result
+{
+	uint64_t sent = 0;
+	counters received;
+	double elapsed = 0; // s
+};
+
+template <typename Loop>
+result run(const options & o, Loop && loop)
+{
+	server_socket server;
+	headset_socket stream;
+	headset_socket control;
+	stream.set_receive_buffer_size(1024 * 1024 * 5);
+	uint16_t stream_port = bind_loopback(stream);
+	bind_loopback(control);
+	server.connect(in6addr_loopback, stream_port);
+
+	result res;
+	std::jthread receiver([&](std::stop_token stop) {
+		int64_t cpu = thread_cpu_time();
+		loop(stream, control, stop, res.received);
+		res.received.cpu_time = thread_cpu_time() - cpu;
+	});
+
+	std::vector<uint8_t> payload(o.size, 0x5a);
+	std::vector<data_shard> shards(o.burst);
+	std::vector<serialization_packet> packets(o.burst);
+	const auto period = o.rate > 0 ? std::chrono::nanoseconds(int64_t(1e9 * o.burst / o.rate)) : std::chrono::nanoseconds(0);
+
+	auto start = std::chrono::steady_clock::now();
+	auto end = start + std::chrono::nanoseconds(int64_t(o.duration * 1e9));
+	auto next = start;
+	uint64_t frame_idx = 0;
+	while (std::chrono::steady_clock::now() < end)
+	{
+		for (size_t i = 0; i < shards.size(); ++i)
+		{
+			shards[i] = data_shard{
+			        .stream_item_idx = 0,
+			        .frame_idx = frame_idx,
+			        .shard_idx = uint16_t(i),
+			        .payload = payload,
+			};
+			server_socket::serialize(packets[i], shards[i]);
+		}
+		try
+		{
+			server.send(packets);
+			res.sent += packets.size();
+		}
+		catch (std::system_error &)
+		{
+			// Send buffer full, the packets are lost
+		}
+		++frame_idx;
+
+		next += period;
+		if (period.count() > 0)
+			std::this_thread::sleep_until(next);
+	}
+	// Let the receiver catch up
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	res.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	receiver.request_stop();
+	receiver.join();
+	return res;
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+	auto o = parse(argc, argv);
+	if (not o)
+	{
+		usage(argv[0]);
+		return 2;
+	}
+
+	std::cout << std::format("{:<12} {:>10} {:>8} {:>12} {:>12} {:>10}\n",
+	                         "loop",
+	                         "received",
+	                         "lost %",
+	                         "packets/s",
+	                         "cpu µs/pkt",
+	                         "pkt/wakeup");
+
+	auto print = [](const char * name, const result & r) {
+		const counters & c = r.received;
+		std::cout << std::format("{:<12} {:>10} {:>8.2f} {:>12.0f} {:>12.3f} {:>10.1f}\n",
+		                         name,
+		                         c.packets,
+		                         r.sent ? 100. * (r.sent - std::min(r.sent, c.packets)) / r.sent : 0.,
+		                         c.packets / r.elapsed,
+		                         c.packets ? c.cpu_time * 1e-3 / c.packets : 0.,
+		                         c.wakeups ? double(c.packets) / c.wakeups : 0.);
+	};
+
+	print("poll", run(*o, [](headset_socket & stream, headset_socket & control, std::stop_token stop, counters & c) {
+		      poll_loop(stream, control, stop, c);
+	      }));
+
+	print("epoll", run(*o, [&](headset_socket & stream, headset_socket & control, std::stop_token stop, counters & c) {
+		      epoll_loop(stream, control, stop, c, std::chrono::microseconds(0), o->max_batch);
+	      }));
+
+	print("epoll+busy", run(*o, [&](headset_socket & stream, headset_socket & control, std::stop_token stop, counters & c) {
+		      epoll_loop(stream, control, stop, c, std::chrono::microseconds(int64_t(o->busy_poll)), o->max_batch);
+	      }));
+
+	return 0;
+}
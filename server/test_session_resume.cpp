@@ -0,0 +1,210 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Simulates disconnections over a loopback link and measures the time until the first frame.
+//
+// The compositor does not send frames until the clock offset is stable, this test reconnects
+// with new sockets and measures how long it takes for each kind of reconnection. A resumed
+// session keeps the previous estimate, unless the headset clock changed while it was asleep.
+// It also checks that both ends derive the same keys when resuming a session.
+//
+// Usage: wivrn-session-resume-test
+// Exits with 1 if a threshold was not met.
+
+#include "driver/clock_offset.h"
+#include "os/os_time.h"
+#include "secrets.h"
+#include "wivrn_packets.h"
+#include "wivrn_sockets.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using namespace wivrn;
+using server_socket = typed_socket<UDP, from_headset::packets, to_headset::packets>;
+using headset_socket = typed_socket<UDP, to_headset::packets, from_headset::packets>;
+
+// Interval between timesync queries until the offset is stable
+constexpr auto query_interval = std::chrono::milliseconds(10);
+constexpr auto max_duration = std::chrono::seconds(5);
+
+uint16_t bind_loopback(UDP & socket)
+{
+	sockaddr_in6 address{};
+	address.sin6_family = AF_INET6;
+	address.sin6_addr = in6addr_loopback;
+	socket.bind(address);
+	socklen_t size = sizeof(address);
+	if (getsockname(socket, (sockaddr *)&address, &size) < 0)
+		throw std::system_error(errno, std::generic_category());
+	return ntohs(address.sin6_port);
+}
+
+bool wait_readable(int fd, int timeout_ms)
+{
+	pollfd pfd{.fd = fd, .events = POLLIN, .revents = 0};
+	return ::poll(&pfd, 1, timeout_ms) > 0;
+}
+
+// A connection between the server and a headset answering timesync queries
+class loopback_link
+{
+	server_socket server;
+	headset_socket headset;
+	std::atomic<bool> stop = false;
+	std::jthread headset_thread;
+
+public:
+	loopback_link(const std::atomic<int64_t> & headset_offset)
+	{
+		uint16_t server_port = bind_loopback(server);
+		uint16_t headset_port = bind_loopback(headset);
+		server.connect(in6addr_loopback, headset_port);
+		headset.connect(in6addr_loopback, server_port);
+
+		headset_thread = std::jthread([this, &headset_offset]() {
+			while (not stop)
+			{
+				if (not wait_readable(headset.get_fd(), 100))
+					continue;
+				auto packet = headset.receive();
+				if (not packet)
+					continue;
+				if (auto query = std::get_if<to_headset::timesync_query>(&*packet))
+					headset.send(from_headset::timesync_response{
+					        .query = query->query,
+					        .response = headset.receive_time() + headset_offset,
+					});
+			}
+		});
+	}
+
+	~loopback_link()
+	{
+		stop = true;
+	}
+
+	// Returns the time until the offset is stable, or nullopt if it never is
+	std::optional<std::chrono::nanoseconds> wait_stable(clock_offset_estimator & estimator)
+	{
+		auto start = std::chrono::steady_clock::now();
+		while (std::chrono::steady_clock::now() - start < max_duration)
+		{
+			server.send(to_headset::timesync_query{.query = XrTime(os_monotonic_get_ns())});
+			if (wait_readable(server.get_fd(), 100))
+			{
+				auto packet = server.receive();
+				if (auto response = packet ? std::get_if<from_headset::timesync_response>(&*packet) : nullptr)
+					estimator.add_sample(*response, server.receive_time());
+			}
+			if (estimator.get_offset())
+				return std::chrono::steady_clock::now() - start;
+			std::this_thread::sleep_for(query_interval);
+		}
+		return std::nullopt;
+	}
+};
+
+bool check_keys()
+{
+	crypto::key headset_key = crypto::key::generate_x448_keypair();
+	crypto::key server_key = crypto::key::generate_x448_keypair();
+	crypto::key headset_public = crypto::key::from_public_key(headset_key.public_key());
+	crypto::key server_public = crypto::key::from_public_key(server_key.public_key());
+
+	secrets headset{headset_key, server_public, "000000"};
+	secrets server{server_key, headset_public, "000000"};
+
+	std::array<uint8_t, 16> headset_nonce;
+	std::array<uint8_t, 16> server_nonce;
+	crypto::random_bytes(headset_nonce);
+	crypto::random_bytes(server_nonce);
+
+	secrets headset_resumed{headset, headset_nonce, server_nonce};
+	secrets server_resumed{server, headset_nonce, server_nonce};
+
+	bool ok = memcmp(&headset_resumed, &server_resumed, sizeof(secrets)) == 0 and
+	          memcmp(&headset_resumed, &headset, sizeof(secrets)) != 0 and
+	          headset.resume_ticket() == server.resume_ticket() and
+	          headset_resumed.resume_ticket() != headset.resume_ticket();
+	std::cout << std::format("resumed keys: {}\n\n", ok ? "ok" : "FAIL");
+	return ok;
+}
+
+struct phase
+{
+	std::string name;
+	std::function<void(clock_offset_estimator &, std::atomic<int64_t> & headset_offset)> reconnect;
+	std::chrono::milliseconds max_time_to_first_frame;
+};
+} // namespace
+
+int main()
+{
+	bool ok = check_keys();
+
+	std::atomic<int64_t> headset_offset = 1'234'567'890;
+	// Maximum error on the offset, loopback latency is a few µs
+	const int64_t max_error = 500'000;
+
+	const std::vector<phase> phases{
+	        {"first connection", [](auto &, auto &) {}, std::chrono::milliseconds(3000)},
+	        {"resumed", [](auto & estimator, auto &) { estimator.warm_start(); }, std::chrono::milliseconds(200)},
+	        {"resumed, headset slept", [](auto & estimator, auto & offset) {
+		         estimator.warm_start();
+		         offset += 3'000'000'000;
+	         },
+	         std::chrono::milliseconds(3000)},
+	        {"new session", [](auto & estimator, auto &) { estimator.reset(); }, std::chrono::milliseconds(3000)},
+	};
+
+	clock_offset_estimator estimator;
+	std::cout << std::format("{:<25} {:>20} {:>12}\n", "reconnection", "first frame (ms)", "error µs");
+	for (const auto & phase: phases)
+	{
+		phase.reconnect(estimator, headset_offset);
+		loopback_link l(headset_offset);
+		auto time = l.wait_stable(estimator);
+		int64_t error = estimator.get_offset().b - headset_offset;
+
+		bool phase_ok = time and *time <= phase.max_time_to_first_frame and std::abs(error) <= max_error;
+		ok = ok and phase_ok;
+		std::cout << std::format("{:<25} {:>20} {:>12.1f}{}\n",
+		                         phase.name,
+		                         time ? std::format("{:.1f}", std::chrono::duration<double, std::milli>(*time).count()) : "never",
+		                         error * 1e-3,
+		                         phase_ok ? "" : " FAIL");
+	}
+
+	return ok ? 0 : 1;
+}
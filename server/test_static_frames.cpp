@@ -0,0 +1,162 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Feeds the static frame detector with a scripted application and checks which frames are encoded.
+//
+// The fake application submits either a projection layer (compositor fast path) or a quad in
+// front of the user (squashed, depends on the head pose). Each phase of the script changes what
+// the application renders or how the head moves, the number of encoded frames must match.
+//
+// Usage: wivrn-static-frames-test
+
+#include "compositor/static_frame_detector.h"
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr int64_t frame_ns = 1'000'000'000 / 90;
+
+struct fake_application
+{
+	std::array<xrt_swapchain, 2> swapchains{};
+	uint32_t image_index = 0;
+	bool quad = false;
+	xrt_pose quad_pose{.orientation = {0, 0, 0, 1}, .position = {0, 0, -1}};
+
+	// Acquires a new image, as when rendering
+	void render()
+	{
+		image_index = (image_index + 1) % 3;
+	}
+
+	comp_layer_accum submit(int64_t display_time)
+	{
+		comp_layer_accum accum{};
+		accum.layer_count = 1;
+		auto & layer = accum.layers[0];
+		layer.sc_array[0] = &swapchains[0];
+		layer.data.timestamp = display_time;
+		if (quad)
+		{
+			layer.data.type = XRT_LAYER_QUAD;
+			layer.data.quad.sub.image_index = image_index;
+			layer.data.quad.pose = quad_pose;
+			layer.data.quad.size = {1, 1};
+		}
+		else
+		{
+			layer.sc_array[1] = &swapchains[1];
+			layer.data.type = XRT_LAYER_PROJECTION;
+			for (auto & view: layer.data.proj.v)
+			{
+				view.sub.image_index = image_index;
+				view.pose.orientation.w = 1;
+			}
+		}
+		return accum;
+	}
+};
+
+struct phase
+{
+	std::string name;
+	int frames;
+	int expected_encoded;
+	// Called before each frame of the phase
+	std::function<void(fake_application &, xrt_pose & head, xrt_quat & gaze)> step;
+};
+
+xrt_quat yaw(float angle)
+{
+	return {0, std::sin(angle / 2), 0, std::cos(angle / 2)};
+}
+} // namespace
+
+int main()
+{
+	wivrn::static_frame_detector detector;
+	fake_application app;
+	xrt_pose head{.orientation = {0, 0, 0, 1}, .position = {0, 0, 0}};
+	xrt_quat gaze{};
+	int64_t now = 0;
+
+	std::mt19937 rng(42);
+	std::normal_distribution<float> noise(0, 0.0002);
+
+	// Without changes, one frame in 19 is encoded (200ms refresh interval at 90Hz)
+	const std::vector<phase> script{
+	        {"first frame", 1, 1, [](auto &, auto &, auto &) {}},
+	        {"idle projection", 90, 4, [](auto &, auto &, auto &) {}},
+	        {"rendering", 30, 30, [](auto & app, auto &, auto &) { app.render(); }},
+	        {"rendering every 3rd frame", 30, 10, [i = 0](auto & app, auto &, auto &) mutable {
+		         if (i++ % 3 == 0)
+			         app.render();
+	         }},
+	        {"idle, head moves (fast path)", 30, 1, [](auto &, auto & head, auto &) { head.orientation = yaw(0.01); }},
+	        {"idle quad", 36, 2, [](auto & app, auto &, auto &) { app.quad = true; }},
+	        {"quad, tracking noise", 36, 2, [&](auto &, auto & head, auto &) {
+		         head.orientation = yaw(0.01 + noise(rng));
+		         head.position.x = noise(rng);
+	         }},
+	        {"quad, head turns", 30, 30, [a = 0.01f](auto &, auto & head, auto &) mutable { head.orientation = yaw(a += 0.01); }},
+	        {"quad moves", 10, 10, [](auto & app, auto &, auto &) { app.quad_pose.position.x += 0.01; }},
+	        {"gaze tracked", 1, 1, [](auto &, auto &, auto & gaze) { gaze = yaw(0); }},
+	        {"gaze fixation", 10, 0, [](auto &, auto &, auto & gaze) { gaze = yaw(0.001); }},
+	        {"saccade", 1, 1, [](auto &, auto &, auto & gaze) { gaze = yaw(0.2); }},
+	        {"reconnection", 1, 1, [&](auto &, auto &, auto &) { detector.invalidate(); }},
+	};
+
+	bool ok = true;
+	int total = 0;
+	int total_encoded = 0;
+	std::cout << std::format("{:<30} {:>8} {:>8} {:>8}\n", "phase", "frames", "encoded", "expected");
+	for (const auto & phase: script)
+	{
+		int encoded = 0;
+		for (int i = 0; i < phase.frames; ++i)
+		{
+			phase.step(app, head, gaze);
+			now += frame_ns;
+			auto layers = app.submit(now + 2 * frame_ns);
+			std::optional<xrt_pose> squash_head;
+			if (app.quad)
+				squash_head = head;
+			if (not detector.is_static(layers, squash_head, gaze, now))
+				++encoded;
+		}
+		bool phase_ok = encoded == phase.expected_encoded;
+		ok = ok and phase_ok;
+		total += phase.frames;
+		total_encoded += encoded;
+		std::cout << std::format("{:<30} {:>8} {:>8} {:>8}{}\n", phase.name, phase.frames, encoded, phase.expected_encoded, phase_ok ? "" : " FAIL");
+	}
+	std::cout << std::format("\n{} frames, {} encoded ({:.1f}%)\n", total, total_encoded, 100. * total_encoded / total);
+
+	return ok ? 0 : 1;
+}
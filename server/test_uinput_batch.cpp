@@ -0,0 +1,216 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Writes a scripted mouse stream to a fake uinput device, one event per write as the kernel
+// accepts it and through uinput_batch, and checks that both produce the same input.
+//
+// The fake device is a SOCK_SEQPACKET socket pair: each write is received as one message, which
+// gives the number of syscalls. Events are replayed on a simulated mouse: the pointer position
+// at each button change and the final state must be identical.
+//
+// Usage: wivrn-uinput-batch-test
+
+#include "driver/uinput_batch.h"
+
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+struct report
+{
+	uint16_t type;
+	uint16_t code;
+	int32_t value;
+	uint16_t code2 = 0;
+	int32_t value2 = 0;
+};
+
+struct mouse_state
+{
+	int64_t x = 0;
+	int64_t y = 0;
+	int64_t wheel = 0;
+	int64_t hwheel = 0;
+	// Pointer position and button state at each button change
+	std::vector<std::string> clicks;
+	int reports = 0;
+
+	void apply(const input_event & ev)
+	{
+		if (ev.type == EV_SYN)
+			++reports;
+		else if (ev.type == EV_KEY)
+			clicks.push_back(std::format("{} {} at {},{}", ev.code, ev.value, x, y));
+		else if (ev.type == EV_REL)
+		{
+			switch (ev.code)
+			{
+				case REL_X:
+					x += ev.value;
+					break;
+				case REL_Y:
+					y += ev.value;
+					break;
+				case REL_WHEEL:
+					wheel += ev.value;
+					break;
+				case REL_HWHEEL:
+					hwheel += ev.value;
+					break;
+			}
+		}
+	}
+
+	bool operator==(const mouse_state & other) const
+	{
+		return x == other.x and y == other.y and wheel == other.wheel and hwheel == other.hwheel and clicks == other.clicks;
+	}
+};
+
+struct fake_uinput
+{
+	int fd[2];
+
+	fake_uinput()
+	{
+		if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0, fd) < 0)
+			throw std::runtime_error("socketpair failed");
+		int size = 16 * 1024 * 1024;
+		setsockopt(fd[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+		setsockopt(fd[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	}
+	~fake_uinput()
+	{
+		close(fd[0]);
+		close(fd[1]);
+	}
+
+	// Reads what was written since the last call, returns the number of writes
+	int drain(mouse_state & state)
+	{
+		int writes = 0;
+		std::vector<input_event> buffer(4096);
+		while (true)
+		{
+			auto n = recv(fd[1], buffer.data(), buffer.size() * sizeof(input_event), 0);
+			if (n < 0)
+				return writes;
+			++writes;
+			for (size_t i = 0; i < n / sizeof(input_event); ++i)
+				state.apply(buffer[i]);
+		}
+	}
+};
+
+void write_event(int fd, uint16_t type, uint16_t code, int32_t value)
+{
+	input_event ev{};
+	ev.type = type;
+	ev.code = code;
+	ev.value = value;
+	if (write(fd, &ev, sizeof(ev)) != sizeof(ev))
+		throw std::runtime_error("write failed");
+}
+
+// Mostly motion, with a button change or a scroll from time to time
+std::vector<report> make_script(std::mt19937 & rng, int count)
+{
+	std::uniform_int_distribution<int> kind(0, 99);
+	std::uniform_int_distribution<int> delta(-20, 20);
+	std::vector<report> res;
+	bool pressed = false;
+	for (int i = 0; i < count; ++i)
+	{
+		int k = kind(rng);
+		if (k < 3)
+		{
+			pressed = not pressed;
+			res.push_back({EV_KEY, BTN_LEFT, pressed});
+		}
+		else if (k < 10)
+			res.push_back({EV_REL, REL_WHEEL, delta(rng) / 10});
+		else
+			res.push_back({EV_REL, REL_X, delta(rng), REL_Y, delta(rng)});
+	}
+	return res;
+}
+} // namespace
+
+int main()
+{
+	std::mt19937 rng(42);
+	const auto script = make_script(rng, 10'000);
+
+	// Reference: one write per event, as before batching
+	fake_uinput reference_dev;
+	mouse_state reference;
+	int reference_writes = 0;
+	for (const auto & r: script)
+	{
+		write_event(reference_dev.fd[0], r.type, r.code, r.value);
+		if (r.code2)
+			write_event(reference_dev.fd[0], r.type, r.code2, r.value2);
+		write_event(reference_dev.fd[0], EV_SYN, SYN_REPORT, 0);
+		reference_writes += reference_dev.drain(reference);
+	}
+
+	bool ok = true;
+	std::cout << std::format("{:<20} {:>8} {:>8} {:>8}\n", "reports per tick", "writes", "reports", "result");
+	std::cout << std::format("{:<20} {:>8} {:>8}\n", "unbatched", reference_writes, reference.reports);
+	for (int per_tick: {1, 2, 5, 20, 100})
+	{
+		fake_uinput dev;
+		mouse_state state;
+		wivrn::uinput_batch batch;
+		int writes = 0;
+		for (size_t i = 0; i < script.size(); ++i)
+		{
+			const auto & r = script[i];
+			batch.add(r.type, r.code, r.value);
+			if (r.code2)
+				batch.add(r.type, r.code2, r.value2);
+			batch.syn();
+			if ((i + 1) % per_tick == 0 or i + 1 == script.size())
+			{
+				batch.flush(dev.fd[0]);
+				writes += dev.drain(state);
+			}
+		}
+
+		const bool same = state == reference;
+		const int expected_writes = (script.size() + per_tick - 1) / per_tick;
+		ok = ok and same and writes == expected_writes;
+		std::cout << std::format("{:<20} {:>8} {:>8} {:>8}\n",
+		                         per_tick,
+		                         writes,
+		                         state.reports,
+		                         not same ? "FAIL" : writes != expected_writes ? "FAIL (writes)" : "ok");
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "wivrn_statistics.h"
+
+#include "driver/clock_offset.h"
+#include "os/os_time.h"
+
+#include <array>
+#include <atomic>
+#include <limits>
+
+namespace wivrn::statistics
+{
+namespace
+{
+constexpr auto relaxed = std::memory_order_relaxed;
+
+// Values may be added while the window is collected, they are then counted in
+// either period or partially in both, which is fine for monitoring
+class atomic_window
+{
+	std::atomic<int64_t> sum = 0;
+	std::atomic<uint32_t> count = 0;
+	std::atomic<int64_t> min = std::numeric_limits<int64_t>::max();
+	std::atomic<int64_t> max = std::numeric_limits<int64_t>::min();
+
+public:
+	void add(int64_t value_ns)
+	{
+		sum.fetch_add(value_ns, relaxed);
+		count.fetch_add(1, relaxed);
+
+		int64_t current = min.load(relaxed);
+		while (value_ns < current and not min.compare_exchange_weak(current, value_ns, relaxed))
+		{}
+
+		current = max.load(relaxed);
+		while (value_ns > current and not max.compare_exchange_weak(current, value_ns, relaxed))
+		{}
+	}
+
+	window collect()
+	{
+		uint32_t n = count.exchange(0, relaxed);
+		int64_t s = sum.exchange(0, relaxed);
+		int64_t lo = min.exchange(std::numeric_limits<int64_t>::max(), relaxed);
+		int64_t hi = max.exchange(std::numeric_limits<int64_t>::min(), relaxed);
+
+		if (n == 0 or lo > hi)
+			return {};
+
+		return {
+		        .min = lo * 1e-6,
+		        .mean = s * 1e-6 / n,
+		        .max = hi * 1e-6,
+		        .count = n,
+		};
+	}
+};
+
+// Each stream is updated by its own encoder thread
+struct alignas(64) stream_counters
+{
+	atomic_window encode_time;
+	std::atomic<uint64_t> bytes_sent = 0;
+	std::atomic<uint64_t> packets_sent = 0;
+	std::atomic<uint32_t> frames_lost = 0;
+	std::atomic<uint32_t> idr_frames = 0;
+};
+
+struct counters
+{
+	std::array<stream_counters, max_streams> streams;
+
+	alignas(64) atomic_window round_trip_time;
+	atomic_window network_latency;
+	atomic_window decode_time;
+	atomic_window pacer_margin;
+	atomic_window blit_to_display;
+
+	std::atomic<int64_t> last_collect = 0;
+};
+
+counters & get()
+{
+	static counters instance;
+	return instance;
+}
+} // namespace
+
+void add_encode_time(uint8_t stream, int64_t duration_ns)
+{
+	if (stream < max_streams)
+		get().streams[stream].encode_time.add(duration_ns);
+}
+
+void add_sent(uint8_t stream, size_t bytes, size_t packets)
+{
+	if (stream >= max_streams)
+		return;
+	auto & s = get().streams[stream];
+	s.bytes_sent.fetch_add(bytes, relaxed);
+	s.packets_sent.fetch_add(packets, relaxed);
+}
+
+void add_idr(uint8_t stream)
+{
+	if (stream < max_streams)
+		get().streams[stream].idr_frames.fetch_add(1, relaxed);
+}
+
+void add_feedback(const from_headset::feedback & feedback)
+{
+	auto & c = get();
+
+	// Timestamps are all in the headset clock
+	if (not feedback.received_last_packet)
+	{
+		if (feedback.stream_index < max_streams)
+			c.streams[feedback.stream_index].frames_lost.fetch_add(1, relaxed);
+		return;
+	}
+
+	if (feedback.send_begin)
+		c.network_latency.add(feedback.received_last_packet - feedback.send_begin);
+	if (feedback.sent_to_decoder and feedback.received_from_decoder)
+		c.decode_time.add(feedback.received_from_decoder - feedback.sent_to_decoder);
+	if (feedback.received_from_decoder and feedback.blitted)
+		c.pacer_margin.add(feedback.blitted - feedback.received_from_decoder);
+	if (feedback.blitted and feedback.displayed)
+		c.blit_to_display.add(feedback.displayed - feedback.blitted);
+}
+
+void add_round_trip_time(int64_t duration_ns)
+{
+	get().round_trip_time.add(duration_ns);
+}
+
+snapshot collect(const clock_offset & offset)
+{
+	auto & c = get();
+
+	int64_t now = os_monotonic_get_ns();
+	int64_t last = c.last_collect.exchange(now, relaxed);
+
+	snapshot result{
+	        .duration = last ? (now - last) * 1e-9 : 0,
+	        .clock_offset_ns = offset.b,
+	        .round_trip_time = c.round_trip_time.collect(),
+	        .network_latency = c.network_latency.collect(),
+	        .decode_time = c.decode_time.collect(),
+	        .pacer_margin = c.pacer_margin.collect(),
+	        .blit_to_display = c.blit_to_display.collect(),
+	};
+
+	for (size_t i = 0; i < max_streams; ++i)
+	{
+		auto & s = c.streams[i];
+		stream item{
+		        .index = uint8_t(i),
+		        .encode_time = s.encode_time.collect(),
+		        .bytes_sent = s.bytes_sent.exchange(0, relaxed),
+		        .packets_sent = s.packets_sent.exchange(0, relaxed),
+		        .frames_lost = s.frames_lost.exchange(0, relaxed),
+		        .idr_frames = s.idr_frames.exchange(0, relaxed),
+		};
+		if (item.packets_sent or item.encode_time.count)
+			result.streams.push_back(item);
+	}
+
+	return result;
+}
+
+} // namespace wivrn::statistics
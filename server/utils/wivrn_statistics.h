@@ -0,0 +1,92 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "wivrn_packets.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Streaming statistics exposed on D-Bus (io.github.wivrn.Statistics).
+//
+// Values are accumulated in relaxed atomics by the threads that produce them
+// (encoders, sender, network thread) and collected by the session worker
+// thread, which sends a snapshot to the main loop once per period.
+
+namespace wivrn
+{
+struct clock_offset;
+}
+
+namespace wivrn::statistics
+{
+// Streams with a higher index are not counted
+inline constexpr size_t max_streams = 8;
+
+// Values in milliseconds, all 0 if there was no sample
+struct window
+{
+	double min;
+	double mean;
+	double max;
+	uint32_t count;
+};
+
+struct stream
+{
+	uint8_t index;
+	window encode_time;
+	uint64_t bytes_sent;
+	uint64_t packets_sent;
+	// Frames for which the headset did not receive all the shards
+	uint32_t frames_lost;
+	uint32_t idr_frames;
+};
+
+struct snapshot
+{
+	// Duration covered by the windows, in seconds
+	double duration;
+	// Only the streams that sent data during the period
+	std::vector<stream> streams;
+
+	int64_t clock_offset_ns;
+	window round_trip_time;
+	// From sending the first shard to receiving the last one
+	window network_latency;
+	window decode_time;
+	// Time between the end of decoding and the blit, negative if the frame was late
+	window pacer_margin;
+	window blit_to_display;
+};
+
+void add_encode_time(uint8_t stream, int64_t duration_ns);
+void add_sent(uint8_t stream, size_t bytes, size_t packets);
+void add_idr(uint8_t stream);
+
+// Called on the network thread
+void add_feedback(const from_headset::feedback &);
+void add_round_trip_time(int64_t duration_ns);
+
+// Collects the values accumulated since the previous call and resets them
+snapshot collect(const clock_offset &);
+
+} // namespace wivrn::statistics
@@ -21,11 +21,15 @@
 #include "util/u_debug.h"
 #include "util/u_logging.h"
 #include "wivrn-server_shaders.h"
+#include "utils/xdg_base_directory.h"
 #include "wivrn_config.h"
 
+#include <cstring>
 #include <format>
+#include <fstream>
 #include <ranges>
 #include <set>
+#include <unistd.h>
 
 DEBUG_GET_ONCE_NUM_OPTION(force_gpu_index, "XRT_COMPOSITOR_FORCE_GPU_INDEX", -1)
 
@@ -132,6 +136,45 @@ int get_queue_index(const std::vector<vk::QueueFamilyProperties> & queues, std::
 	});
 	return 0;
 }
+
+std::filesystem::path pipeline_cache_file(const vk::raii::PhysicalDevice & physical_device)
+{
+	auto [prop, dev_id] = physical_device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+
+	std::string name;
+	for (uint8_t i: dev_id.deviceUUID)
+		name += std::format("{:02x}", i);
+	name += std::format("-{:08x}", prop.properties.driverVersion);
+
+	return xdg_cache_home() / "wivrn" / "pipeline_cache" / name;
+}
+
+// Returns an empty vector if the file does not exist or was created by a different driver
+std::vector<char> read_pipeline_cache(const std::filesystem::path & path, const vk::PhysicalDeviceProperties & prop)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (not file)
+		return {};
+
+	std::vector<char> data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+	vk::PipelineCacheHeaderVersionOne header;
+	if (data.size() < sizeof(header))
+		return {};
+
+	memcpy(&header, data.data(), sizeof(header));
+	if (header.headerSize < sizeof(header) or
+	    header.headerVersion != vk::PipelineCacheHeaderVersion::eOne or
+	    header.vendorID != prop.vendorID or
+	    header.deviceID != prop.deviceID or
+	    header.pipelineCacheUUID != prop.pipelineCacheUUID)
+	{
+		U_LOG_I("Ignoring pipeline cache %s, it was created by another driver", path.c_str());
+		return {};
+	}
+
+	return data;
+}
 } // namespace
 
 wivrn::vk_bundle::vk_bundle() :
@@ -385,6 +428,18 @@ wivrn::vk_bundle::vk_bundle() :
 	                  *debug != VK_NULL_HANDLE);
 
 	auto prop = physical_device.getProperties();
+
+	pipeline_cache_path = pipeline_cache_file(physical_device);
+	auto pipeline_cache_data = read_pipeline_cache(pipeline_cache_path, prop);
+	pipeline_cache = vk::raii::PipelineCache(
+	        device,
+	        vk::PipelineCacheCreateInfo{
+	                .initialDataSize = pipeline_cache_data.size(),
+	                .pInitialData = pipeline_cache_data.data(),
+	        });
+	pipeline_cache_saved_size = pipeline_cache_data.size();
+	name(pipeline_cache, "server pipeline cache");
+
 	U_LOG_I("Vulkan instance created:\n"
 	        "\tGPU: %s\n"
 	        "\tqueue families: %d %d %d (main, encode, transfer)\n",
@@ -394,6 +449,41 @@ wivrn::vk_bundle::vk_bundle() :
 	        int32_t(transfer_queue.family_index));
 }
 
+wivrn::vk_bundle::~vk_bundle()
+{
+	if (*pipeline_cache)
+		save_pipeline_cache();
+}
+
+void wivrn::vk_bundle::save_pipeline_cache()
+{
+	try
+	{
+		auto data = pipeline_cache.getData();
+		if (data.size() == pipeline_cache_saved_size)
+			return;
+
+		std::filesystem::create_directories(pipeline_cache_path.parent_path());
+
+		// Several processes may write it, replace the file atomically
+		std::filesystem::path tmp = pipeline_cache_path;
+		tmp += std::format(".{}", getpid());
+		{
+			std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+			file.exceptions(std::ofstream::failbit);
+			file.write(reinterpret_cast<const char *>(data.data()), data.size());
+		}
+		std::filesystem::rename(tmp, pipeline_cache_path);
+
+		pipeline_cache_saved_size = data.size();
+		U_LOG_D("Saved %zu bytes of pipeline cache to %s", data.size(), pipeline_cache_path.c_str());
+	}
+	catch (std::exception & e)
+	{
+		U_LOG_W("Failed to save pipeline cache: %s", e.what());
+	}
+}
+
 uint32_t wivrn::vk_bundle::get_memory_type(uint32_t type_bits, vk::MemoryPropertyFlags memory_props)
 {
 	auto mem_prop = physical_device.getMemoryProperties();
@@ -21,6 +21,7 @@
 
 #include "vk/vk_allocator.h"
 #include <cstdint>
+#include <filesystem>
 #include <inplace_vector.hpp>
 #include <pthread.h>
 #include <type_traits>
@@ -114,6 +115,11 @@ struct vk_bundle
 	vk::raii::Device device;
 	std::optional<vk_allocator> allocator;
 
+	// Persisted in the XDG cache directory, one file per device UUID and driver version
+	vk::raii::PipelineCache pipeline_cache = nullptr;
+	std::filesystem::path pipeline_cache_path;
+	size_t pipeline_cache_saved_size = 0;
+
 	queue_data queue;
 	queue_data transfer_queue;
 	beman::inplace_vector::inplace_vector<queue_data, 3> encode_queues;
@@ -142,6 +148,7 @@ struct vk_bundle
 	std::vector<const char *> device_extensions;
 
 	vk_bundle();
+	~vk_bundle();
 
 	uint32_t get_memory_type(uint32_t type_bits, vk::MemoryPropertyFlags memory_props);
 
@@ -160,6 +167,9 @@ struct vk_bundle
 
 	vk::raii::ShaderModule load_shader(const char * name);
 
+	// Write the pipeline cache to disk if new pipelines were added since the last save
+	void save_pipeline_cache();
+
 private:
 	void name(vk::ObjectType, uint64_t handle, const char * value);
 	void name(vk::ObjectType t, uint64_t handle, const std::string & value)
@@ -0,0 +1,83 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "warm_start.h"
+
+#include "compositor/foveation.h"
+#include "compositor/layer_squasher.h"
+#include "encoder/encoder_cache.h"
+#include "encoder/encoder_settings.h"
+#include "encoder/video_encoder.h"
+#include "util/u_logging.h"
+#include "utils/wivrn_vk_bundle.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ranges>
+
+void wivrn::warm_start()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	vk_bundle vk;
+	encoder_cache cache{vk};
+
+	// Before the first connection, only the pipelines can be prepared
+	vk::Extent3D render_size{.width = 1920, .height = 1920, .depth = 1};
+	vk::Extent3D stream_size = render_size;
+
+	if (const auto & last = cache.last())
+	{
+		render_size.width = last->render_width;
+		render_size.height = last->render_height;
+		stream_size.width = last->encoders[0].width;
+		stream_size.height = last->encoders[0].height;
+
+		// Probing results are refreshed if they were invalidated or the driver changed
+		auto encoders = select_encoders(vk, cache, last->supported_codecs);
+
+		// Changed configuration: the sizes are only known when the headset connects
+		bool same_encoders = std::ranges::equal(encoders, last->encoders, [](const auto & selected, const encoder_settings & settings) {
+			return selected.first == settings.encoder_name and selected.second == settings.codec;
+		});
+
+		if (same_encoders)
+		{
+			try
+			{
+				for (auto [i, settings]: std::ranges::enumerate_view(last->encoders))
+					video_encoder::create(vk, settings, i);
+			}
+			catch (std::exception & e)
+			{
+				U_LOG_W("Warm start: cannot create encoder: %s", e.what());
+				encoder_cache::invalidate(vk);
+				return;
+			}
+		}
+	}
+
+	layer_squasher squasher(vk, render_size);
+	foveation foveator(vk, stream_size);
+
+	cache.save();
+	vk.save_pipeline_cache();
+
+	U_LOG_I("Warm start done in %.1fms", std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
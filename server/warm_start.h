@@ -0,0 +1,32 @@
+/*
+ * WiVRn VR streaming
+ * Copyright (C) 2025  Guillaume Meunier <guillaume.meunier@centraliens.net>
+ * Copyright (C) 2025  Patrick Nicolas <patricknicolas@laposte.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+namespace wivrn
+{
+// Does ahead of the connection what the compositor does when a headset connects: creates the
+// Vulkan device, compiles the pipelines into the pipeline cache, probes the encoders and creates
+// them with the settings of the last connection. Vulkan objects cannot be given to the process
+// that serves the connection, they are destroyed; the connection then finds the pipelines and the
+// probing results in the caches, and the driver has loaded what the encoders need.
+//
+// Runs in a process forked at server start, only if warm-start is enabled.
+void warm_start();
+} // namespace wivrn
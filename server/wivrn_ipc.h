@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include "utils/wivrn_statistics.h"
 #include "wivrn_packets.h"
 #include "wivrn_sockets.h"
 
@@ -55,7 +56,8 @@ using packets = std::variant<
         wivrn::from_headset::stream_tab_changed,
         headset_connected,
         headset_disconnected,
-        server_error>;
+        server_error,
+        wivrn::statistics::snapshot>;
 } // namespace from_monado
 
 namespace to_monado
@@ -30,7 +30,7 @@ _wivrnctl()
     # Global options
     if [[ $COMP_CWORD -eq 1 ]]; then
         COMPREPLY=( $(compgen -W \
-            "--help pair unpair rename list-paired stop-server disconnect tab" \
+            "--help pair unpair rename list-paired stop-server disconnect stats tab" \
             -- "$cur") )
         return
     fi
@@ -82,6 +82,12 @@ _wivrnctl()
                 -- "$cur") )
             ;;
 
+        stats)
+            COMPREPLY=( $(compgen -W \
+                "-h --help -w --watch" \
+                -- "$cur") )
+            ;;
+
         stop-server|disconnect)
             COMPREPLY=( $(compgen -W \
                 "-h --help" \
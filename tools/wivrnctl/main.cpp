@@ -49,6 +49,7 @@ using sd_bus_message_ptr = std::unique_ptr<sd_bus_message, deleter>;
 const char * destination = "io.github.wivrn.Server";
 const char * path = "/io/github/wivrn/Server";
 const char * interface = "io.github.wivrn.Server";
+const char * statistics_interface = "io.github.wivrn.Statistics";
 
 sd_bus_ptr get_user_bus()
 {
@@ -75,11 +76,11 @@ sd_bus_message_ptr call_method(const sd_bus_ptr & bus, const char * member, cons
 	return sd_bus_message_ptr(msg);
 }
 
-sd_bus_message_ptr get_property(const sd_bus_ptr & bus, const char * member, const char * signature)
+sd_bus_message_ptr get_property(const sd_bus_ptr & bus, const char * member, const char * signature, const char * iface = interface)
 {
 	sd_bus_error error = SD_BUS_ERROR_NULL;
 	sd_bus_message * msg = nullptr;
-	int ret = sd_bus_get_property(bus.get(), destination, path, interface, member, &error, &msg, signature);
+	int ret = sd_bus_get_property(bus.get(), destination, path, iface, member, &error, &msg, signature);
 	if (ret < 0)
 	{
 		std::runtime_error e(std::string("read property ") + member + " failed: " + error.message);
@@ -316,6 +317,173 @@ void rename(size_t headset_id, const std::string & headset_name)
 	call_method(bus, "RenameKey", "ss", values.at(headset_id - 1).public_key.c_str(), headset_name.c_str());
 }
 
+struct window
+{
+	double min;
+	double mean;
+	double max;
+	uint32_t count;
+};
+
+struct stream_statistics
+{
+	uint8_t index;
+	window encode_time;
+	uint64_t bytes_sent;
+	uint64_t packets_sent;
+	uint32_t frames_lost;
+	uint32_t idr_frames;
+};
+
+struct statistics
+{
+	double duration;
+	std::vector<stream_statistics> streams;
+	int64_t clock_offset;
+	std::vector<std::pair<std::string, window>> latencies;
+};
+
+template <typename T>
+T get_statistics_value(const sd_bus_ptr & bus, const char * member, const char * signature)
+{
+	auto msg = get_property(bus, member, signature, statistics_interface);
+	T value{};
+	int ret = sd_bus_message_read_basic(msg.get(), signature[0], &value);
+	if (ret < 0)
+		throw std::system_error(-ret, std::system_category(), std::string("Failed to read ") + member);
+	return value;
+}
+
+window get_window(const sd_bus_ptr & bus, const char * member)
+{
+	auto msg = get_property(bus, member, "(dddu)", statistics_interface);
+	window w;
+	int ret = sd_bus_message_read(msg.get(), "(dddu)", &w.min, &w.mean, &w.max, &w.count);
+	if (ret < 0)
+		throw std::system_error(-ret, std::system_category(), std::string("Failed to read ") + member);
+	return w;
+}
+
+statistics get_statistics(const sd_bus_ptr & bus)
+{
+	statistics stats{
+	        .duration = get_statistics_value<double>(bus, "Duration", "d"),
+	        .clock_offset = get_statistics_value<int64_t>(bus, "ClockOffset", "x"),
+	};
+
+	auto msg = get_property(bus, "Streams", "a(y(dddu)ttuu)", statistics_interface);
+	int ret = sd_bus_message_enter_container(msg.get(), 'a', "(y(dddu)ttuu)");
+	if (ret < 0)
+		throw std::system_error(-ret, std::system_category(), "Failed to get stream statistics");
+
+	while (true)
+	{
+		stream_statistics s;
+		auto & e = s.encode_time;
+		ret = sd_bus_message_read(msg.get(), "(y(dddu)ttuu)", &s.index, &e.min, &e.mean, &e.max, &e.count, &s.bytes_sent, &s.packets_sent, &s.frames_lost, &s.idr_frames);
+		if (ret == 0)
+			break;
+		if (ret < 0)
+			throw std::system_error(-ret, std::system_category(), "Failed to get stream statistics");
+		stats.streams.push_back(s);
+	}
+
+	for (auto [label, member]: {
+	             std::pair{"Round trip time", "RoundTripTime"},
+	             std::pair{"Network latency", "NetworkLatency"},
+	             std::pair{"Decode time", "DecodeTime"},
+	             std::pair{"Pacer margin", "PacerMargin"},
+	             std::pair{"Blit to display", "BlitToDisplay"},
+	     })
+		stats.latencies.emplace_back(label, get_window(bus, member));
+
+	return stats;
+}
+
+void print_statistics(const statistics & stats)
+{
+	if (stats.duration == 0)
+	{
+		std::cout << "No statistics, is a headset connected?" << std::endl;
+		return;
+	}
+
+	std::cout << std::format("Period: {:.2f}s, clock offset: {:.3f}ms\n\n", stats.duration, stats.clock_offset * 1e-6);
+
+	auto ms = [](double value) { return std::format("{:.2f}", value); };
+
+	print_table({"Stream", "Frames", "Encode mean (ms)", "Encode max (ms)", "Mbit/s", "Packets/s", "Lost frames", "IDR frames"},
+	            stats.streams | std::views::transform([&](const stream_statistics & s) {
+		            return std::tuple(s.index,
+		                              s.encode_time.count,
+		                              ms(s.encode_time.mean),
+		                              ms(s.encode_time.max),
+		                              ms(s.bytes_sent * 8e-6 / stats.duration),
+		                              std::format("{:.0f}", s.packets_sent / stats.duration),
+		                              s.frames_lost,
+		                              s.idr_frames);
+	            }));
+	std::cout << "\n";
+
+	print_table({"", "Min (ms)", "Mean (ms)", "Max (ms)", "Samples"},
+	            stats.latencies | std::views::transform([&](const auto & item) {
+		            const auto & [label, w] = item;
+		            return std::tuple(label, ms(w.min), ms(w.mean), ms(w.max), w.count);
+	            }));
+}
+
+void show_statistics(bool watch)
+{
+	auto bus = get_user_bus();
+
+	if (not watch)
+	{
+		print_statistics(get_statistics(bus));
+		return;
+	}
+
+	// The server updates the statistics once per second, all the properties in a single signal
+	bool changed = true;
+	int ret = sd_bus_match_signal(
+	        bus.get(),
+	        nullptr,
+	        destination,
+	        path,
+	        "org.freedesktop.DBus.Properties",
+	        "PropertiesChanged",
+	        [](sd_bus_message * msg, void * userdata, sd_bus_error *) {
+		        const char * iface;
+		        if (sd_bus_message_read(msg, "s", &iface) > 0 and std::string_view(iface) == statistics_interface)
+			        *static_cast<bool *>(userdata) = true;
+		        return 0;
+	        },
+	        &changed);
+	if (ret < 0)
+		throw std::system_error(-ret, std::system_category(), "Failed to watch statistics");
+
+	while (true)
+	{
+		ret = sd_bus_process(bus.get(), nullptr);
+		if (ret < 0)
+			throw std::system_error(-ret, std::system_category(), "Failed to process D-Bus messages");
+		if (ret > 0)
+			continue;
+
+		if (changed)
+		{
+			changed = false;
+			// Clear the terminal
+			std::cout << "\033[H\033[2J";
+			print_statistics(get_statistics(bus));
+			std::cout << std::flush;
+		}
+
+		ret = sd_bus_wait(bus.get(), UINT64_MAX);
+		if (ret < 0)
+			throw std::system_error(-ret, std::system_category(), "Failed to wait for D-Bus messages");
+	}
+}
+
 void stop_server()
 {
 	call_method(get_user_bus(), "Quit", "");
@@ -373,6 +541,11 @@ int main(int argc, char ** argv)
 	app.add_subcommand("disconnect", "Disconnect headset")
 	        ->callback(disconnect);
 
+	bool watch = false;
+	app.add_subcommand("stats", "Show streaming statistics")
+	        ->callback([&]() { return show_statistics(watch); })
+	        ->add_flag("--watch,-w", watch, "Keep updating the statistics");
+
 	std::string tab_name;
 	app.add_subcommand("tab", "Show or set current tab on headset")
 	        ->callback([&]() { return tab(tab_name); })